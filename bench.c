@@ -0,0 +1,602 @@
+/*
+ * File:   bench.c
+ * Author: Mark Bersalona
+ *
+ * Created on 2024.07.15
+ * Microbenchmarks of the WSG30 Temperature Display Diagnostic hot paths
+ *
+ * Times the receive FIFO, the parser (one benchmark per rule), the Receive
+ * text view at growing buffer sizes and the logfile, with fixed inputs.
+ * Each benchmark is warmed up, then run BENCH_RUNS times; the median and
+ * best (fastest run) ns/op are written as JSON. With --baseline, each best
+ * is compared with a previous run's (the fastest run is the one least
+ * disturbed by the rest of the system), and the exit status is 1 if any
+ * is more than --threshold percent slower:
+ *
+ *   ./WSG30TempDisplay_bench --out=bench_results.json --baseline=bench_baseline.json
+ *
+ * The text view benchmarks time display_receive_write() itself, so they
+ * need a display (make bench runs under xvfb-run if there isn't one);
+ * without one they're skipped. A benchmark missing from either the results
+ * or the baseline fails the comparison, so a baseline recorded without a
+ * display can't pass for one that gates the text view.
+ */
+
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Includes
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#define _GNU_SOURCE
+#include <gtk/gtk.h>
+#include <glib/gstdio.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "gconfig.h"
+#include "main.h"
+#include "display.h"
+#include "fifo.h"
+#include "logfile.h"
+#include "metrics.h"
+#include "parse.h"
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Definitions
+//
+///////////////////////////////////////////////////////////////////////////////
+
+// Runs per benchmark after the warm-up
+#define BENCH_RUNS                (7)
+#define BENCH_RESULTS_MAX         (32)
+#define BENCH_NAME_LENGTH_MAX     (64)
+
+// Default regression threshold, percent slower than the baseline best
+#define BENCH_THRESHOLD_PERCENT   (25)
+
+// Operations per run
+#define BENCH_FIFO_OPS            (100000)
+#define BENCH_PARSE_OPS           (20000)
+#define BENCH_DISPLAY_OPS         (500)
+#define BENCH_LOGFILE_OPS         (2000)    // must fit in LOGFILE_QUEUE_BYTES
+
+// A benchmark: perform lulOps operations, return the nsec they took
+typedef guint64 (*BenchRoutine)(guint32 lulOps, gpointer pvData);
+
+typedef struct
+{
+    char    ucName[BENCH_NAME_LENGTH_MAX];
+    guint32 ulOps;
+    gdouble dMedian_ns;         // per op
+    gdouble dBest_ns;           // per op
+} BenchResult;
+
+// A parser rule, and two lines it matches (alternated, so fields change
+// the way they do in a live stream)
+typedef struct
+{
+    char *pucName;
+    char *pucLine[2];
+} BenchParseRule;
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Variables and tables
+//
+///////////////////////////////////////////////////////////////////////////////
+
+// Command line options
+static gchar *gpcBenchOut      = NULL;
+static gchar *gpcBenchBaseline = NULL;
+static gint   giBenchThreshold = BENCH_THRESHOLD_PERCENT;
+
+static GOptionEntry gsBenchOptions[] =
+{
+    { "out",       'o', 0, G_OPTION_ARG_FILENAME, &gpcBenchOut,      "Write the JSON results to FILE (default stdout)", "FILE" },
+    { "baseline",  'b', 0, G_OPTION_ARG_FILENAME, &gpcBenchBaseline, "Compare with the JSON results in FILE", "FILE" },
+    { "threshold", 't', 0, G_OPTION_ARG_INT,      &giBenchThreshold, "Regression if a best is over PERCENT slower than the baseline (default 25)", "PERCENT" },
+    { NULL }
+};
+
+static BenchResult gsBenchResults[BENCH_RESULTS_MAX];
+static guint8      gucBenchResultCount;
+
+// Typical STATUS line, as it arrives from the device
+static char gucBenchStatusLine[] =
+    "STATUS >> Timestamp 1721044800 UTC TEMP:72.5 MIN:68.0 MAX:75.1 AlHI:90 AlLO:40 Alarm:0 "
+    "Scale:F SampleRateSeconds:60 ACK:1 HostCal:0 Buzzer:0 Mains:ON";
+
+// Parser rules, in parse_msg() order
+// (" seconds to Diagnostic mode disable..." isn't benchmarked: it writes
+//  to the serial port)
+static BenchParseRule gsBenchParseRules[] =
+{
+    { "warning",            { "*** WARNING *** Sensor read retry, attempt 2 of 3",
+                              "*** WARNING *** Sensor read retry, attempt 3 of 3" } },
+    { "error",              { "*** ERROR *** Sensor not responding on channel 1",
+                              "*** ERROR *** Sensor not responding on channel 2" } },
+    { "uut_reset",          { "Sensaphone WSG30 Temperature Sensor Display starting...",
+                              "Sensaphone WSG30 Temperature Sensor Display starting..." } },
+    { "board_revision",     { "Board revision = C",
+                              "Board revision = D" } },
+    { "firmware_version",   { "WSG30 Temperature Display firmware version is 1.4.2",
+                              "WSG30 Temperature Display firmware version is 1.4.3" } },
+    { "network_transition", { "Network_Connection_StateMachine: Transitioning from CONNECTING to CONNECTED",
+                              "Network_Connection_StateMachine: Transitioning from CONNECTED to DISCONNECTED" } },
+    { "battery",            { "InputTask: Battery reading: 3012 mV, Battery voltage 3.01 V Percentage 87",
+                              "InputTask: Battery reading: 3008 mV, Battery voltage 3.00 V Percentage 86" } },
+    { "status",             { "STATUS >> Timestamp 1721044800 UTC TEMP:72.5 MIN:68.0 MAX:75.1 AlHI:90 AlLO:40 Alarm:0 "
+                              "Scale:F SampleRateSeconds:60 ACK:1 HostCal:0 Buzzer:0 Mains:ON",
+                              "STATUS >> Timestamp 1721044860 UTC TEMP:72.6 MIN:68.0 MAX:75.1 AlHI:90 AlLO:40 Alarm:0 "
+                              "Scale:F SampleRateSeconds:60 ACK:1 HostCal:0 Buzzer:0 Mains:ON" } },
+    { "xbee",               { "XBEE >> SerialNumber:0013A20041B2C3D4 Device:WSG30 PAN_ID:1234 Channel:15 Connection:CONNECTED",
+                              "XBEE >> SerialNumber:0013A20041B2C3D4 Device:WSG30 PAN_ID:1234 Channel:15 Connection:SEARCHING" } },
+    { "modem_status",       { "Network_XBee_Modem_Status: Associated",
+                              "Network_XBee_Modem_Status: Disassociated" } },
+    { "pcb_revision",       { "PCB revision = 3",
+                              "PCB revision = 4" } },
+    { "serial_number",      { "Serial number = 2407150042",
+                              "Serial number = 2407150043" } },
+    { "calibration_date",   { "Calibration date = 20240715",
+                              "Calibration date = 20240716" } },
+    { "vref",               { "Voltage reference (mV) = 2048",
+                              "Voltage reference (mV) = 2049" } },
+    { "pan_id_channel",     { "Network_Join: PAN_ID:1234 Channel:15",
+                              "Network_Join: PAN_ID:1235 Channel:16" } },
+    { "no_match",           { "AppTask: heartbeat 12345, free heap 40960 bytes",
+                              "AppTask: heartbeat 12346, free heap 40952 bytes" } },
+};
+
+// Receive text view sizes, lines already in the buffer
+static guint32 gulBenchDisplayLines[] = { 0, 1000, 10000, 100000 };
+
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// main.c's side of display.c
+//
+// display.c is linked for display_receive_write(); there is no Main window
+// here, so none of these is ever called
+//
+///////////////////////////////////////////////////////////////////////////////
+
+GtkBuilder *builder = NULL;
+gint64 gllDataUpdate_usec = 0;
+
+void main_BOARDREV_clicked(void) {}
+void main_CALDATE_clicked(void) {}
+void main_SERIALNUM_clicked(void) {}
+void main_VREF_clicked(void) {}
+void main_LOGENABLE_state_set(void) {}
+void main_MENU_clicked(void) {}
+void main_REPLAY_clicked(void) {}
+void main_REPLAY_SPEED_changed(void) {}
+gboolean main_REPLAY_scrub(GtkRange *lgRange, GtkScrollType lgScroll, gdouble ldValue, gpointer data) { return FALSE; }
+void main_REBOOT_clicked(void) {}
+void main_SEQUENCE_clicked(void) {}
+void main_RTD_clicked(void) {}
+void main_status_timestamp_restart(void) {}
+
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Benchmarks
+//
+///////////////////////////////////////////////////////////////////////////////
+
+////////////////////////////////////////////////////////////////////////////
+// Name:         bench_fifo
+// Description:  Receive FIFO: fifo_write() then fifo_read() of a STATUS line
+// Parameters:   lulOps - operations
+//               pvData - unused
+// Return:       nsec
+////////////////////////////////////////////////////////////////////////////
+static guint64
+bench_fifo(guint32 lulOps, gpointer pvData)
+{
+    guint64 lullStart_ns = metrics_now_ns();
+    guint32 lulOp;
+
+    for (lulOp = 0; lulOp < lulOps; ++lulOp)
+    {
+        fifo_write(gucBenchStatusLine);
+        fifo_read();
+    }
+    return metrics_now_ns() - lullStart_ns;
+}
+// end bench_fifo
+
+
+////////////////////////////////////////////////////////////////////////////
+// Name:         bench_parse
+// Description:  parse_msg() of a rule's lines, alternately
+// Parameters:   lulOps - operations
+//               pvData - BenchParseRule
+// Return:       nsec
+////////////////////////////////////////////////////////////////////////////
+static guint64
+bench_parse(guint32 lulOps, gpointer pvData)
+{
+    BenchParseRule *plsRule = (BenchParseRule *)pvData;
+    guint64 lullStart_ns = metrics_now_ns();
+    guint32 lulOp;
+
+    for (lulOp = 0; lulOp < lulOps; ++lulOp)
+    {
+        parse_msg(plsRule->pucLine[lulOp & 1]);
+    }
+    return metrics_now_ns() - lullStart_ns;
+}
+// end bench_parse
+
+
+////////////////////////////////////////////////////////////////////////////
+// Name:         bench_display
+// Description:  Receive text view: display_receive_write() of lines, the
+//               way display_receive_line() writes them, then let GTK lay
+//               them out.
+//               The lines are then deleted again (not timed), so each run
+//               starts with the same buffer
+// Parameters:   lulOps - operations
+//               pvData - lines already in the buffer
+// Return:       nsec
+////////////////////////////////////////////////////////////////////////////
+static guint64
+bench_display(guint32 lulOps, gpointer pvData)
+{
+    guint32 lulLines = GPOINTER_TO_UINT(pvData);
+    guint64 lullStart_ns = metrics_now_ns();
+    guint64 lullElapsed_ns;
+    guint32 lulOp;
+
+    for (lulOp = 0; lulOp < lulOps; ++lulOp)
+    {
+        display_receive_write(gucBenchStatusLine);
+        display_receive_write("\r\n");
+    }
+    while (gtk_events_pending()) gtk_main_iteration();
+    lullElapsed_ns = metrics_now_ns() - lullStart_ns;
+
+    // (display_receive_write() keeps using textiterReceiveEnd, so it's the
+    //  one revalidated by the delete)
+    gtk_text_buffer_get_iter_at_line(textbufReceive, &textiterReceiveStart, lulLines);
+    gtk_text_buffer_get_end_iter(textbufReceive, &textiterReceiveEnd);
+    gtk_text_buffer_delete(textbufReceive, &textiterReceiveStart, &textiterReceiveEnd);
+    while (gtk_events_pending()) gtk_main_iteration();
+    return lullElapsed_ns;
+}
+// end bench_display
+
+
+////////////////////////////////////////////////////////////////////////////
+// Name:         bench_display_fill
+// Description:  Fill the Receive text view with a number of STATUS lines
+// Parameters:   lulLines - lines
+// Return:       None
+////////////////////////////////////////////////////////////////////////////
+static void
+bench_display_fill(guint32 lulLines)
+{
+    GString *plsText = g_string_sized_new((sizeof(gucBenchStatusLine) + 2) * lulLines + 1);
+    guint32 lulLine;
+
+    for (lulLine = 0; lulLine < lulLines; ++lulLine)
+    {
+        g_string_append(plsText, gucBenchStatusLine);
+        g_string_append(plsText, "\r\n");
+    }
+    gtk_text_buffer_get_start_iter(textbufReceive, &textiterReceiveStart);
+    gtk_text_buffer_get_end_iter(textbufReceive, &textiterReceiveEnd);
+    gtk_text_buffer_delete(textbufReceive, &textiterReceiveStart, &textiterReceiveEnd);
+    display_receive_write(plsText->str);
+    g_string_free(plsText, TRUE);
+    while (gtk_events_pending()) gtk_main_iteration();
+}
+// end bench_display_fill
+
+
+////////////////////////////////////////////////////////////////////////////
+// Name:         bench_logfile_name
+// Description:  Scratch logfile name
+// Parameters:   None
+// Return:       Name, in the temporary directory
+////////////////////////////////////////////////////////////////////////////
+static char *
+bench_logfile_name(void)
+{
+    static char lcName[100];
+
+    if (0 == lcName[0])
+    {
+        g_snprintf(lcName, sizeof(lcName), "%s/WSG30TempDisplay_bench_%d.txt", g_get_tmp_dir(), (int)getpid());
+    }
+    return lcName;
+}
+// end bench_logfile_name
+
+
+////////////////////////////////////////////////////////////////////////////
+// Name:         bench_logfile
+// Description:  logfile_write() of STATUS lines: with pvData NULL, just the
+//               caller's cost (queueing for the writer thread); otherwise
+//               until the writer thread has written them all
+// Parameters:   lulOps - operations
+//               pvData - NULL, or non-NULL to include the writes
+// Return:       nsec
+////////////////////////////////////////////////////////////////////////////
+static guint64
+bench_logfile(guint32 lulOps, gpointer pvData)
+{
+    guint64 lullStart_ns;
+    guint64 lullElapsed_ns;
+    guint32 lulOp;
+
+    if (!logfile_open(bench_logfile_name(), NULL)) return 0;
+
+    lullStart_ns = metrics_now_ns();
+    for (lulOp = 0; lulOp < lulOps; ++lulOp)
+    {
+        logfile_write(gucBenchStatusLine);
+    }
+    lullElapsed_ns = metrics_now_ns() - lullStart_ns;
+    logfile_close();
+    if (pvData) lullElapsed_ns = metrics_now_ns() - lullStart_ns;
+
+    g_unlink(bench_logfile_name());
+    return lullElapsed_ns;
+}
+// end bench_logfile
+
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Running, reporting
+//
+///////////////////////////////////////////////////////////////////////////////
+
+////////////////////////////////////////////////////////////////////////////
+// Name:         bench_compare_ns
+// Description:  qsort() comparison of two nsec values
+// Parameters:   pavA, pavB - guint64 values
+// Return:       <0, 0, >0
+////////////////////////////////////////////////////////////////////////////
+static int
+bench_compare_ns(const void *pavA, const void *pavB)
+{
+    guint64 lullA = *(const guint64 *)pavA;
+    guint64 lullB = *(const guint64 *)pavB;
+
+    return (lullA > lullB) - (lullA < lullB);
+}
+// end bench_compare_ns
+
+
+////////////////////////////////////////////////////////////////////////////
+// Name:         bench_run
+// Description:  Run a benchmark: once to warm up, then BENCH_RUNS times,
+//               and record the median and best ns/op
+// Parameters:   paucName  - benchmark name
+//               pafRoutine - the benchmark
+//               lulOps    - operations per run
+//               pvData    - passed to the benchmark
+// Return:       None
+////////////////////////////////////////////////////////////////////////////
+static void
+bench_run(char *paucName, BenchRoutine pafRoutine, guint32 lulOps, gpointer pvData)
+{
+    guint64 lullRun_ns[BENCH_RUNS];
+    BenchResult *plsResult;
+    guint8 lucRun;
+
+    if (gucBenchResultCount >= BENCH_RESULTS_MAX) return;
+
+    pafRoutine(lulOps, pvData);
+    for (lucRun = 0; lucRun < BENCH_RUNS; ++lucRun)
+    {
+        lullRun_ns[lucRun] = pafRoutine(lulOps, pvData);
+    }
+    qsort(lullRun_ns, BENCH_RUNS, sizeof(lullRun_ns[0]), bench_compare_ns);
+
+    plsResult = &gsBenchResults[gucBenchResultCount++];
+    g_strlcpy(plsResult->ucName, paucName, sizeof(plsResult->ucName));
+    plsResult->ulOps      = lulOps;
+    plsResult->dMedian_ns = (gdouble)lullRun_ns[BENCH_RUNS/2] / lulOps;
+    plsResult->dBest_ns   = (gdouble)lullRun_ns[0] / lulOps;
+    g_printerr("%-40s %12.1f ns/op (best %.1f)\r\n", paucName, plsResult->dMedian_ns, plsResult->dBest_ns);
+}
+// end bench_run
+
+
+////////////////////////////////////////////////////////////////////////////
+// Name:         bench_write_json
+// Description:  Write the results as JSON, one benchmark per line
+// Parameters:   plsFile - output
+// Return:       None
+////////////////////////////////////////////////////////////////////////////
+static void
+bench_write_json(FILE *plsFile)
+{
+    guint8 lucResult;
+
+    fprintf(plsFile, "{\n\"version\": \"%s.%s.%s\", \"runs\": %d, \"unit\": \"ns/op\",\n\"benchmarks\": [\n",
+            VERSION_A, VERSION_B, VERSION_C, BENCH_RUNS);
+    for (lucResult = 0; lucResult < gucBenchResultCount; ++lucResult)
+    {
+        fprintf(plsFile, "{\"name\": \"%s\", \"ops\": %u, \"median\": %.1f, \"best\": %.1f}%s\n",
+                gsBenchResults[lucResult].ucName, gsBenchResults[lucResult].ulOps,
+                gsBenchResults[lucResult].dMedian_ns, gsBenchResults[lucResult].dBest_ns,
+                (lucResult + 1 < gucBenchResultCount) ? "," : "");
+    }
+    fprintf(plsFile, "]\n}\n");
+}
+// end bench_write_json
+
+
+////////////////////////////////////////////////////////////////////////////
+// Name:         bench_compare_baseline
+// Description:  Compare each result's best with the baseline's (a file
+//               written by bench_write_json) and print the changes
+//               A result the baseline doesn't have, or a baseline entry
+//               that wasn't run (no display, say), counts as a regression:
+//               a benchmark that isn't compared isn't gated
+// Parameters:   paucName - baseline file name
+// Return:       Number of regressions, or -1 if the baseline can't be read
+////////////////////////////////////////////////////////////////////////////
+static int
+bench_compare_baseline(char *paucName)
+{
+    gchar *plcContents;
+    char *plcEntry;
+    char *plcNameEnd;
+    char lcKey[BENCH_NAME_LENGTH_MAX + 16];
+    gdouble ldBaseline_ns;
+    gdouble ldChange;
+    guint8 lucResult;
+    int liRegressions = 0;
+
+    if (!g_file_get_contents(paucName, &plcContents, NULL, NULL)) return -1;
+
+    g_printerr("\r\nCompared with %s (regression: over %d%% slower)\r\n", paucName, giBenchThreshold);
+    for (lucResult = 0; lucResult < gucBenchResultCount; ++lucResult)
+    {
+        g_snprintf(lcKey, sizeof(lcKey), "\"name\": \"%s\",", gsBenchResults[lucResult].ucName);
+        plcEntry = strstr(plcContents, lcKey);
+        if (!plcEntry || !(plcEntry = strstr(plcEntry, "\"best\": ")) ||
+            1 != sscanf(plcEntry + 8, "%lf", &ldBaseline_ns) || ldBaseline_ns <= 0)
+        {
+            g_printerr("%-40s %12.1f ns/op  NOT IN BASELINE\r\n", gsBenchResults[lucResult].ucName,
+                       gsBenchResults[lucResult].dBest_ns);
+            ++liRegressions;
+            continue;
+        }
+        ldChange = (gsBenchResults[lucResult].dBest_ns - ldBaseline_ns) * 100 / ldBaseline_ns;
+        g_printerr("%-40s %12.1f ns/op  baseline %10.1f  %+6.1f%%%s\r\n", gsBenchResults[lucResult].ucName,
+                   gsBenchResults[lucResult].dBest_ns, ldBaseline_ns, ldChange,
+                   (ldChange > giBenchThreshold) ? "  REGRESSION" : "");
+        if (ldChange > giBenchThreshold) ++liRegressions;
+    }
+
+    // Baseline entries that weren't run
+    for (plcEntry = strstr(plcContents, "\"name\": \""); plcEntry; plcEntry = strstr(plcNameEnd, "\"name\": \""))
+    {
+        plcEntry  += 9;
+        plcNameEnd = strchr(plcEntry, '"');
+        if (!plcNameEnd) break;
+        for (lucResult = 0; lucResult < gucBenchResultCount; ++lucResult)
+        {
+            if (strlen(gsBenchResults[lucResult].ucName) == (size_t)(plcNameEnd - plcEntry) &&
+                0 == strncmp(gsBenchResults[lucResult].ucName, plcEntry, plcNameEnd - plcEntry)) break;
+        }
+        if (lucResult == gucBenchResultCount)
+        {
+            g_printerr("%-40.*s %12s        NOT RUN\r\n", (int)(plcNameEnd - plcEntry), plcEntry, "");
+            ++liRegressions;
+        }
+    }
+    g_free(plcContents);
+    return liRegressions;
+}
+// end bench_compare_baseline
+
+
+////////////////////////////////////////////////////////////////////////////
+// Name:         main
+// Description:  Run the benchmarks, write the results, compare with the
+//               baseline
+// Parameters:   Standard main arguments, see gsBenchOptions
+// Return:       0 if no regressions; 1 otherwise, or on error
+////////////////////////////////////////////////////////////////////////////
+int main(int argc, char** argv)
+{
+    GError *error = NULL;
+    GOptionContext *lgOptionContext;
+    ParseHooks lsHooks = { NULL, NULL, NULL, NULL };
+    GtkWidget *plsWindow;
+    FILE *plsOut;
+    char lcName[BENCH_NAME_LENGTH_MAX];
+    guint8 lucIndex;
+    int liRegressions = 0;
+
+    lgOptionContext = g_option_context_new("- WSG30 Temperature Display Diagnostic hot path benchmarks");
+    g_option_context_add_main_entries(lgOptionContext, gsBenchOptions, NULL);
+    if (!g_option_context_parse(lgOptionContext, &argc, &argv, &error))
+    {
+        g_printerr("%s\r\n", error->message);
+        g_clear_error(&error);
+        return 1;
+    }
+    g_option_context_free(lgOptionContext);
+
+    // Receive FIFO
+    bench_run("fifo_write_read", bench_fifo, BENCH_FIFO_OPS, NULL);
+
+    // Parser, per rule
+    parse_initialize(&lsHooks);
+    for (lucIndex = 0; lucIndex < G_N_ELEMENTS(gsBenchParseRules); ++lucIndex)
+    {
+        g_snprintf(lcName, sizeof(lcName), "parse_msg/%s", gsBenchParseRules[lucIndex].pucName);
+        bench_run(lcName, bench_parse, BENCH_PARSE_OPS, &gsBenchParseRules[lucIndex]);
+    }
+
+    // Receive text view, in an offscreen window the size of the real one,
+    // set up the way display_main_initialize() does it
+    if (gtk_init_check(&argc, &argv))
+    {
+        plsWindow       = gtk_offscreen_window_new();
+        textviewReceive = gtk_text_view_new();
+        scrolledwindowReceive = GTK_SCROLLED_WINDOW(gtk_scrolled_window_new(NULL, NULL));
+        textbufReceive        = gtk_text_view_get_buffer(GTK_TEXT_VIEW(textviewReceive));
+        gtk_text_buffer_get_start_iter(textbufReceive, &textiterReceiveStart);
+        gtk_text_buffer_get_end_iter  (textbufReceive, &textiterReceiveEnd);
+        gtk_text_view_set_monospace(GTK_TEXT_VIEW(textviewReceive), TRUE);
+        gtk_widget_set_size_request(textviewReceive, -1, 300);
+        gtk_container_add(GTK_CONTAINER(scrolledwindowReceive), textviewReceive);
+        gtk_container_add(GTK_CONTAINER(plsWindow), GTK_WIDGET(scrolledwindowReceive));
+        gtk_window_set_default_size(GTK_WINDOW(plsWindow), 1366, 300);
+        gtk_widget_show_all(plsWindow);
+
+        for (lucIndex = 0; lucIndex < G_N_ELEMENTS(gulBenchDisplayLines); ++lucIndex)
+        {
+            bench_display_fill(gulBenchDisplayLines[lucIndex]);
+            g_snprintf(lcName, sizeof(lcName), "display_receive_write/lines=%u", gulBenchDisplayLines[lucIndex]);
+            bench_run(lcName, bench_display, BENCH_DISPLAY_OPS, GUINT_TO_POINTER(gulBenchDisplayLines[lucIndex]));
+        }
+        gtk_widget_destroy(plsWindow);
+    }
+    else
+    {
+        g_printerr("No display, Receive text view benchmarks skipped\r\n");
+    }
+
+    // Logfile
+    bench_run("logfile_write", bench_logfile, BENCH_LOGFILE_OPS, NULL);
+    bench_run("logfile_write_drained", bench_logfile, BENCH_LOGFILE_OPS, GINT_TO_POINTER(1));
+
+    // Results
+    plsOut = gpcBenchOut ? fopen(gpcBenchOut, "w") : stdout;
+    if (!plsOut)
+    {
+        g_printerr("Couldn't write %s\r\n", gpcBenchOut);
+        return 1;
+    }
+    bench_write_json(plsOut);
+    if (gpcBenchOut) fclose(plsOut);
+
+    if (gpcBenchBaseline)
+    {
+        liRegressions = bench_compare_baseline(gpcBenchBaseline);
+        if (liRegressions < 0)
+        {
+            g_printerr("Couldn't read baseline %s\r\n", gpcBenchBaseline);
+            return 1;
+        }
+        if (liRegressions) g_printerr("%d benchmark(s) regressed\r\n", liRegressions);
+    }
+    return liRegressions ? 1 : 0;
+}
+// end main
+
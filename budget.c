@@ -0,0 +1,344 @@
+/*
+ * File:   budget.c
+ * Author: Mark Bersalona
+ *
+ * Created on 2024.07.15
+ * Buffer budgets and memory footprint
+ *
+ * The receive FIFO size, the longest line kept and the periodic interval
+ * were compile-time constants; they can now be set for a deployment in
+ * the [budget] group of a keyfile, e.g.
+ *
+ *     [budget]
+ *     fifo-lines=1000
+ *     fifo-lines-min=64
+ *     fifo-lines-max=4096
+ *     fifo-line-bytes=512
+ *     periodic-msec=100
+ *     render-usec=40000
+ *     serial-line-bytes=512
+ *
+ * or on the command line (--budget=fifo-lines:1000,periodic-msec:100),
+ * which overrides the keyfile. budget_report() shows what they cost: the
+ * process RSS and each subsystem's reserved and used bytes.
+ */
+
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Includes
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#define _GNU_SOURCE
+#include <glib.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "gconfig.h"
+#include "budget.h"
+#include "fifo.h"
+#include "flightrec.h"
+#include "logfile.h"
+#include "serial.h"
+#include "trace.h"
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Definitions
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#define BUDGET_GROUP  "budget"
+
+typedef struct
+{
+    char    *pcName;            // keyfile key and --budget item
+    guint32 *plValue;
+    guint32  lulMin;
+    guint32  lulMax;
+} BudgetItem;
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Variables and tables
+//
+///////////////////////////////////////////////////////////////////////////////
+
+guint32 gulBudgetFifoLines       = RECEIVE_FIFO_MSG_COUNT;
+guint32 gulBudgetFifoLinesMin    = RECEIVE_FIFO_LINES_MIN;
+guint32 gulBudgetFifoLinesMax    = RECEIVE_FIFO_LINES_MAX;
+guint32 gulBudgetFifoLineBytes   = RECEIVE_FIFO_MSG_LENGTH_MAX;
+guint32 gulBudgetPeriodic_msec   = MAIN_PERIODIC_INTERVAL_MSEC;
+guint32 gulBudgetRender_usec     = RECEIVE_RENDER_BUDGET_USEC;
+guint32 gulBudgetSerialLineBytes = RECEIVE_FIFO_MSG_LENGTH_MAX;
+
+static BudgetItem gsBudgetItems[] =
+{
+    { "fifo-lines",        &gulBudgetFifoLines,       BUDGET_FIFO_LINES_MIN,    BUDGET_FIFO_LINES_MAX },
+    { "fifo-lines-min",    &gulBudgetFifoLinesMin,    BUDGET_FIFO_LINES_MIN,    BUDGET_FIFO_LINES_MAX },
+    { "fifo-lines-max",    &gulBudgetFifoLinesMax,    BUDGET_FIFO_LINES_MIN,    BUDGET_FIFO_LINES_MAX },
+    { "fifo-line-bytes",   &gulBudgetFifoLineBytes,   BUDGET_LINE_BYTES_MIN,    RECEIVE_FIFO_MSG_LENGTH_MAX },
+    { "periodic-msec",     &gulBudgetPeriodic_msec,   BUDGET_PERIODIC_MSEC_MIN, BUDGET_PERIODIC_MSEC_MAX },
+    { "render-usec",       &gulBudgetRender_usec,     BUDGET_RENDER_USEC_MIN,   BUDGET_RENDER_USEC_MAX },
+    { "serial-line-bytes", &gulBudgetSerialLineBytes, BUDGET_LINE_BYTES_MIN,    RECEIVE_FIFO_MSG_LENGTH_MAX },
+};
+
+
+////////////////////////////////////////////////////////////////////////////
+// Name:         budget_item
+// Description:  Look up a budget by name
+// Parameters:   paucName - name, e.g. "fifo-lines"
+//               lulLength - length of name
+// Return:       Budget, or NULL if unknown
+////////////////////////////////////////////////////////////////////////////
+static BudgetItem *
+budget_item(const char *paucName, gsize lulLength)
+{
+    guint8 lucIndex;
+
+    for (lucIndex = 0; lucIndex < G_N_ELEMENTS(gsBudgetItems); ++lucIndex)
+    {
+        if (strlen(gsBudgetItems[lucIndex].pcName) == lulLength &&
+            0 == strncmp(gsBudgetItems[lucIndex].pcName, paucName, lulLength))
+        {
+            return &gsBudgetItems[lucIndex];
+        }
+    }
+    return NULL;
+}
+// end budget_item
+
+
+////////////////////////////////////////////////////////////////////////////
+// Name:         budget_status_kb
+// Description:  Read a "Name:   N kB" line from /proc/self/status
+// Parameters:   paucStatus - contents of /proc/self/status
+//               paucName   - e.g. "VmRSS:"
+// Return:       Value, kB; 0 if not found
+////////////////////////////////////////////////////////////////////////////
+static guint32
+budget_status_kb(const char *paucStatus, const char *paucName)
+{
+    const char *plcLine = strstr(paucStatus, paucName);
+
+    return plcLine ? (guint32)strtoul(plcLine + strlen(paucName), NULL, 10) : 0;
+}
+// end budget_status_kb
+
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Public routines
+//
+///////////////////////////////////////////////////////////////////////////////
+
+////////////////////////////////////////////////////////////////////////////
+// Name:         budget_load
+// Description:  Read budgets from the [budget] group of a keyfile
+// Parameters:   paucName - keyfile; NULL for BUDGET_KEYFILE, which is
+//                          skipped if it doesn't exist
+//               error    - set if the keyfile can't be read, or has an
+//                          unknown key or an out of range value
+// Return:       TRUE if read (or skipped)
+////////////////////////////////////////////////////////////////////////////
+gboolean
+budget_load(char *paucName, GError **error)
+{
+    GKeyFile *lgKeyFile;
+    gchar   **pplcKeys = NULL;
+    gchar   **pplcKey;
+    BudgetItem *plsItem;
+    guint64   lullValue;
+    GError   *lgError = NULL;
+    gboolean  lfIsOK;
+
+    if (!paucName)
+    {
+        if (!g_file_test(BUDGET_KEYFILE, G_FILE_TEST_EXISTS)) return TRUE;
+        paucName = BUDGET_KEYFILE;
+    }
+
+    lgKeyFile = g_key_file_new();
+    lfIsOK = g_key_file_load_from_file(lgKeyFile, paucName, G_KEY_FILE_NONE, error);
+    if (lfIsOK && g_key_file_has_group(lgKeyFile, BUDGET_GROUP))
+    {
+        pplcKeys = g_key_file_get_keys(lgKeyFile, BUDGET_GROUP, NULL, error);
+        lfIsOK = (NULL != pplcKeys);
+    }
+    for (pplcKey = pplcKeys; pplcKey && lfIsOK && *pplcKey; ++pplcKey)
+    {
+        plsItem = budget_item(*pplcKey, strlen(*pplcKey));
+        if (!plsItem)
+        {
+            g_set_error(error, G_KEY_FILE_ERROR, G_KEY_FILE_ERROR_KEY_NOT_FOUND,
+                        "%s: unknown budget \"%s\"", paucName, *pplcKey);
+            lfIsOK = FALSE;
+            break;
+        }
+        lullValue = g_key_file_get_uint64(lgKeyFile, BUDGET_GROUP, *pplcKey, &lgError);
+        if (lgError)
+        {
+            g_propagate_error(error, lgError);
+            lfIsOK = FALSE;
+        }
+        else if (lullValue < plsItem->lulMin || lullValue > plsItem->lulMax)
+        {
+            g_set_error(error, G_KEY_FILE_ERROR, G_KEY_FILE_ERROR_INVALID_VALUE,
+                        "%s: %s must be %u..%u", paucName, *pplcKey, plsItem->lulMin, plsItem->lulMax);
+            lfIsOK = FALSE;
+        }
+        else
+        {
+            *plsItem->plValue = (guint32)lullValue;
+        }
+    }
+    g_strfreev(pplcKeys);
+    g_key_file_free(lgKeyFile);
+    return lfIsOK;
+}
+// end budget_load
+
+
+////////////////////////////////////////////////////////////////////////////
+// Name:         budget_set
+// Description:  Set budgets from a comma-separated string of name:N,
+//               the names being the keyfile's:
+//                 "fifo-lines:N"        - receive FIFO entries to start with
+//                 "fifo-lines-min:N"    - least it shrinks to
+//                 "fifo-lines-max:N"    - most it grows to
+//                 "fifo-line-bytes:N"   - bytes per FIFO entry
+//                 "periodic-msec:N"     - periodic callback interval
+//                 "render-usec:N"       - Receive view time per tick
+//                 "serial-line-bytes:N" - longest received line kept
+//               e.g. "fifo-lines:1000,periodic-msec:100"
+//               Nothing is set unless the whole string is understood
+// Parameters:   paucSpec - budget string
+// Return:       TRUE if the string was understood and in range
+////////////////////////////////////////////////////////////////////////////
+gboolean
+budget_set(char *paucSpec)
+{
+    gchar **pplcItems;
+    gchar **pplcItem;
+    char *plcColon;
+    char *plcEnd;
+    unsigned long lulValue;
+    BudgetItem *plsItem;
+    guint32 lulValues[G_N_ELEMENTS(gsBudgetItems)];
+    guint8 lucIndex;
+    gboolean lfIsOK = TRUE;
+
+    for (lucIndex = 0; lucIndex < G_N_ELEMENTS(gsBudgetItems); ++lucIndex)
+    {
+        lulValues[lucIndex] = *gsBudgetItems[lucIndex].plValue;
+    }
+
+    pplcItems = g_strsplit(paucSpec, ",", -1);
+    for (pplcItem = pplcItems; *pplcItem && lfIsOK; ++pplcItem)
+    {
+        plcColon = strchr(*pplcItem, ':');
+        plsItem  = plcColon ? budget_item(*pplcItem, plcColon - *pplcItem) : NULL;
+        if (!plsItem)
+        {
+            lfIsOK = FALSE;
+            break;
+        }
+        lulValue = strtoul(plcColon+1, &plcEnd, 10);
+        if (*plcEnd || plcEnd == plcColon+1 || lulValue < plsItem->lulMin || lulValue > plsItem->lulMax)
+        {
+            lfIsOK = FALSE;
+            break;
+        }
+        lulValues[plsItem - gsBudgetItems] = (guint32)lulValue;
+    }
+    g_strfreev(pplcItems);
+
+    if (lfIsOK)
+    {
+        for (lucIndex = 0; lucIndex < G_N_ELEMENTS(gsBudgetItems); ++lucIndex)
+        {
+            *gsBudgetItems[lucIndex].plValue = lulValues[lucIndex];
+        }
+    }
+    return lfIsOK;
+}
+// end budget_set
+
+
+////////////////////////////////////////////////////////////////////////////
+// Name:         budget_apply
+// Description:  Allocate the receive FIFO and serial line buffer to the
+//               budgets; call once, before the serial port is read
+//               (the periodic interval and render budget are read by
+//               whoever uses them)
+//               The FIFO's bounds take in fifo-lines, and a
+//               fifo-lines-max under fifo-lines-min is taken as the min
+// Parameters:   None
+// Return:       None
+////////////////////////////////////////////////////////////////////////////
+void
+budget_apply(void)
+{
+    fifo_set_bounds(gulBudgetFifoLinesMin, gulBudgetFifoLinesMax);
+    fifo_initialize(gulBudgetFifoLines, gulBudgetFifoLineBytes);
+    serial_set_line_max(gulBudgetSerialLineBytes);
+}
+// end budget_apply
+
+
+////////////////////////////////////////////////////////////////////////////
+// Name:         budget_report
+// Description:  Format the memory footprint for Status: process RSS and
+//               its peak, and bytes reserved/in use by each buffer
+// Parameters:   paucReport - buffer for the report, CRLF terminated
+//               lulSize    - size of buffer
+// Return:       None
+////////////////////////////////////////////////////////////////////////////
+void
+budget_report(char *paucReport, guint32 lulSize)
+{
+    char    lcStatus[4096];
+    ssize_t llBytes;
+    int     liFd;
+    guint32 lulRss_kb = 0;
+    guint32 lulPeak_kb = 0;
+    guint32 lulFifoReserved, lulFifoUsed;
+    guint32 lulSerialReserved, lulSerialUsed;
+    guint32 lulLogfileReserved, lulLogfileUsed;
+    guint32 lulFlightrecReserved, lulFlightrecUsed;
+    guint32 lulTraceReserved, lulTraceUsed;
+
+    // Read with a stack buffer, so the report doesn't allocate (--soak)
+    liFd = open("/proc/self/status", O_RDONLY);
+    if (liFd >= 0)
+    {
+        llBytes = read(liFd, lcStatus, sizeof(lcStatus) - 1);
+        close(liFd);
+        if (llBytes > 0)
+        {
+            lcStatus[llBytes] = '\0';
+            lulRss_kb  = budget_status_kb(lcStatus, "VmRSS:");
+            lulPeak_kb = budget_status_kb(lcStatus, "VmHWM:");
+        }
+    }
+    fifo_memory(&lulFifoReserved, &lulFifoUsed);
+    serial_memory(&lulSerialReserved, &lulSerialUsed);
+    logfile_memory(&lulLogfileReserved, &lulLogfileUsed);
+    flightrec_memory(&lulFlightrecReserved, &lulFlightrecUsed);
+    trace_memory(&lulTraceReserved, &lulTraceUsed);
+
+    snprintf(paucReport, lulSize,
+             "Memory: RSS %u KB (peak %u KB); KB reserved/used: receive FIFO %ux%u %.1f/%.1f, "
+             "serial line %.1f/%.1f, logfile queue %.1f/%.1f, flight recorder %.1f/%.1f, trace %.1f/%.1f\r\n",
+             lulRss_kb, lulPeak_kb,
+             fifo_size(), gulBudgetFifoLineBytes, lulFifoReserved/1024.0, lulFifoUsed/1024.0,
+             lulSerialReserved/1024.0, lulSerialUsed/1024.0,
+             lulLogfileReserved/1024.0, lulLogfileUsed/1024.0,
+             lulFlightrecReserved/1024.0, lulFlightrecUsed/1024.0,
+             lulTraceReserved/1024.0, lulTraceUsed/1024.0);
+}
+// end budget_report
+
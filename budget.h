@@ -0,0 +1,46 @@
+/*
+ * File:   budget.h
+ * Author: Mark Bersalona
+ *
+ * Created on 2024.07.15
+ */
+
+#ifndef BUDGET_H
+#define BUDGET_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Public routines
+//
+///////////////////////////////////////////////////////////////////////////////
+
+void budget_apply(void);
+gboolean budget_load(char *paucName, GError **error);
+void budget_report(char *paucReport, guint32 lulSize);
+gboolean budget_set(char *paucSpec);
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Public variables
+//
+///////////////////////////////////////////////////////////////////////////////
+
+extern guint32 gulBudgetFifoLines;
+extern guint32 gulBudgetFifoLinesMin;
+extern guint32 gulBudgetFifoLinesMax;
+extern guint32 gulBudgetFifoLineBytes;
+extern guint32 gulBudgetPeriodic_msec;
+extern guint32 gulBudgetRender_usec;
+extern guint32 gulBudgetSerialLineBytes;
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* BUDGET_H */
+
@@ -0,0 +1,312 @@
+/*
+ * File:   correlate.c
+ * Author: Mark Bersalona
+ *
+ * Created on 2024.07.15
+ * Sensaphone WSG30 Temperature Display Diagnostic command/response
+ * correlation
+ *
+ * The MENU commands are sent by serial_write() and their replies are
+ * recognized by the parser later, with nothing linking the two. Each
+ * "+++MENU:x" command that has a known reply is tagged here with a number
+ * and its send time, and the next received line containing that reply
+ * answers the oldest command of its kind still waiting. Lines are checked
+ * as soon as serial.c assembles them, not when the periodic callback gets
+ * to them, and only while a command is waiting. The round trip goes into
+ * the command's metrics histogram, so p50/p99/max show in the Statistics
+ * panel and the Prometheus file; a command not answered within its
+ * timeout is reported in Status and counted.
+ */
+
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Includes
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include <glib.h>
+#include <stdio.h>
+#include <string.h>
+#include "gconfig.h"
+#include "metrics.h"
+#include "correlate.h"
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Definitions
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#define CORRELATE_PREFIX         "+++MENU:"
+
+// Commands with a known reply; the set commands (upper case) and the read
+// commands (lower case) are answered alike
+typedef struct
+{
+    char   *pcCommands;                 // command letters
+    char   *pcReply;                    // text in the reply line
+    char   *pcName;
+    guint8  ucHistogram;                // METRICS_RTT_xxx_NS
+    guint32 ulTimeout_msec;
+
+    // Waiting for replies, oldest first
+    gint64  llSent_usec[CORRELATE_PENDING_MAX];
+    guint32 ulTag[CORRELATE_PENDING_MAX];
+    char    cSent[CORRELATE_PENDING_MAX];
+    guint8  ucPendingFirst;
+    guint8  ucPendingCount;
+
+    guint32 ulSent;
+    guint32 ulReplied;
+    guint32 ulTimedOut;
+} CorrelateCommand;
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Variables and tables
+//
+///////////////////////////////////////////////////////////////////////////////
+
+static CorrelateCommand gsCorrelateCommand[] =
+{
+    { "Nn", "Serial number = ",          "serial",   METRICS_RTT_SERIAL_NS,  CORRELATE_TIMEOUT_MSEC },
+    { "Dd", "Calibration date = ",       "cal date", METRICS_RTT_CALDATE_NS, CORRELATE_TIMEOUT_MSEC },
+    { "Pp", "PCB revision = ",           "PCB rev",  METRICS_RTT_PCBREV_NS,  CORRELATE_TIMEOUT_MSEC },
+    { "Vv", "Voltage reference (mV) = ", "Vref",     METRICS_RTT_VREF_NS,    CORRELATE_TIMEOUT_MSEC },
+    { "Z",  "Sensaphone WSG30 Temperature Sensor Display starting...", "reboot", METRICS_RTT_REBOOT_NS, CORRELATE_REBOOT_TIMEOUT_MSEC },
+};
+#define CORRELATE_COMMAND_COUNT  (sizeof(gsCorrelateCommand)/sizeof(gsCorrelateCommand[0]))
+
+static void (*correlate_status_write)(char *paucWriteBuf) = NULL;
+static guint32 gulCorrelateTag;
+
+// Commands waiting, over all kinds; lines are checked only while there
+// are some. The lock is for --pipeline, where lines arrive on the reader
+// thread and commands are sent from the UI thread
+static guint32 gulCorrelatePending;
+static GMutex  gCorrelateMutex;
+
+static char lcTempCorrelateString[200];
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Public routines
+//
+///////////////////////////////////////////////////////////////////////////////
+
+
+////////////////////////////////////////////////////////////////////////////
+// Name:         correlate_find
+// Description:  Find the entry for a command sent to the UUT
+// Parameters:   paucMessage - NULL-terminated message, e.g. "+++MENU:n"
+// Return:       Pointer to the entry, or NULL if it isn't a command with a
+//               known reply
+////////////////////////////////////////////////////////////////////////////
+static CorrelateCommand *
+correlate_find(char *paucMessage)
+{
+    char lcCommand;
+    guint8 lucIndex;
+
+    if (strncmp(paucMessage, CORRELATE_PREFIX, sizeof(CORRELATE_PREFIX) - 1)) return NULL;
+    lcCommand = paucMessage[sizeof(CORRELATE_PREFIX) - 1];
+    if (!lcCommand) return NULL;
+
+    for (lucIndex = 0; lucIndex < CORRELATE_COMMAND_COUNT; ++lucIndex)
+    {
+        if (strchr(gsCorrelateCommand[lucIndex].pcCommands, lcCommand)) return &gsCorrelateCommand[lucIndex];
+    }
+    return NULL;
+}
+// end correlate_find
+
+
+////////////////////////////////////////////////////////////////////////////
+// Name:         correlate_timed_out
+// Description:  Give up on the oldest command of a kind still waiting
+// Parameters:   pasCommand - command entry, with at least one waiting
+// Return:       None
+////////////////////////////////////////////////////////////////////////////
+static void
+correlate_timed_out(CorrelateCommand *pasCommand)
+{
+    guint8 lucPending = pasCommand->ucPendingFirst;
+
+    ++pasCommand->ulTimedOut;
+    metrics_add(METRICS_COMMAND_TIMEOUTS, 1);
+    if (correlate_status_write)
+    {
+        snprintf(lcTempCorrelateString, sizeof(lcTempCorrelateString),
+                 "No reply to command #%u (" CORRELATE_PREFIX "%c) within %u msec\r\n",
+                 pasCommand->ulTag[lucPending], pasCommand->cSent[lucPending], pasCommand->ulTimeout_msec);
+        correlate_status_write(lcTempCorrelateString);
+    }
+    pasCommand->ucPendingFirst = (lucPending + 1) % CORRELATE_PENDING_MAX;
+    --pasCommand->ucPendingCount;
+    __atomic_sub_fetch(&gulCorrelatePending, 1, __ATOMIC_RELAXED);
+}
+// end correlate_timed_out
+
+
+////////////////////////////////////////////////////////////////////////////
+// Name:         correlate_initialize
+// Description:  Set where timeouts are reported
+// Parameters:   pafStatusWrite - Status routine
+// Return:       None
+////////////////////////////////////////////////////////////////////////////
+void
+correlate_initialize(void (*pafStatusWrite)(char *paucWriteBuf))
+{
+    correlate_status_write = pafStatusWrite;
+}
+// end correlate_initialize
+
+
+////////////////////////////////////////////////////////////////////////////
+// Name:         correlate_line
+// Description:  Serial reply handler - a line has been received: if it's
+//               the reply to a waiting command, record the round trip
+//               (any thread)
+// Parameters:   paucLine - NULL-terminated line
+// Return:       None
+////////////////////////////////////////////////////////////////////////////
+void
+correlate_line(char *paucLine)
+{
+    CorrelateCommand *plsCommand;
+    gint64 llNow_usec;
+    guint8 lucIndex;
+
+    if (0 == __atomic_load_n(&gulCorrelatePending, __ATOMIC_RELAXED)) return;
+
+    llNow_usec = g_get_monotonic_time();
+    g_mutex_lock(&gCorrelateMutex);
+    for (lucIndex = 0; lucIndex < CORRELATE_COMMAND_COUNT; ++lucIndex)
+    {
+        plsCommand = &gsCorrelateCommand[lucIndex];
+        if (0 == plsCommand->ucPendingCount || !strstr(paucLine, plsCommand->pcReply)) continue;
+
+        metrics_record(plsCommand->ucHistogram,
+                       (guint64)(llNow_usec - plsCommand->llSent_usec[plsCommand->ucPendingFirst]) * 1000);
+        ++plsCommand->ulReplied;
+        plsCommand->ucPendingFirst = (plsCommand->ucPendingFirst + 1) % CORRELATE_PENDING_MAX;
+        --plsCommand->ucPendingCount;
+        __atomic_sub_fetch(&gulCorrelatePending, 1, __ATOMIC_RELAXED);
+    }
+    g_mutex_unlock(&gCorrelateMutex);
+}
+// end correlate_line
+
+
+////////////////////////////////////////////////////////////////////////////
+// Name:         correlate_reply
+// Description:  What the reply to a command contains
+// Parameters:   paucCommand - NULL-terminated command, e.g. "+++MENU:n"
+// Return:       Text in the reply line, or NULL if no reply is known
+////////////////////////////////////////////////////////////////////////////
+char *
+correlate_reply(char *paucCommand)
+{
+    CorrelateCommand *plsCommand = correlate_find(paucCommand);
+
+    return plsCommand ? plsCommand->pcReply : NULL;
+}
+// end correlate_reply
+
+
+////////////////////////////////////////////////////////////////////////////
+// Name:         correlate_report
+// Description:  Report commands sent, replied and timed out, and the
+//               round trip percentiles, for each kind of command sent
+// Parameters:   paucReport - buffer for the report (ends with CRLF)
+//               lulSize    - size of buffer
+// Return:       None
+////////////////////////////////////////////////////////////////////////////
+void
+correlate_report(char *paucReport, guint32 lulSize)
+{
+    CorrelateCommand *plsCommand;
+    guint32 lulUsed;
+    guint8 lucIndex;
+
+    g_mutex_lock(&gCorrelateMutex);
+    lulUsed = snprintf(paucReport, lulSize, "Commands:");
+    for (lucIndex = 0; lucIndex < CORRELATE_COMMAND_COUNT && lulUsed < lulSize; ++lucIndex)
+    {
+        plsCommand = &gsCorrelateCommand[lucIndex];
+        if (0 == plsCommand->ulSent) continue;
+        lulUsed += snprintf(paucReport + lulUsed, lulSize - lulUsed,
+                            " %s %u/%u replied p50 %.0f p99 %.0f msec, %u timed out;",
+                            plsCommand->pcName, plsCommand->ulReplied, plsCommand->ulSent,
+                            metrics_percentile(plsCommand->ucHistogram, 50) / 1e6,
+                            metrics_percentile(plsCommand->ucHistogram, 99) / 1e6,
+                            plsCommand->ulTimedOut);
+    }
+    g_mutex_unlock(&gCorrelateMutex);
+    if (lulUsed >= lulSize) lulUsed = lulSize - 1;
+    if (';' == paucReport[lulUsed-1]) --lulUsed;
+    else lulUsed += snprintf(paucReport + lulUsed, lulSize - lulUsed, " none with a known reply sent");
+    if (lulUsed < lulSize) snprintf(paucReport + lulUsed, lulSize - lulUsed, "\r\n");
+}
+// end correlate_report
+
+
+////////////////////////////////////////////////////////////////////////////
+// Name:         correlate_sent
+// Description:  Serial write handler - tag a command with a known reply
+//               and start timing it
+// Parameters:   paucMessage - NULL-terminated message written
+// Return:       None
+////////////////////////////////////////////////////////////////////////////
+void
+correlate_sent(char *paucMessage)
+{
+    CorrelateCommand *plsCommand = correlate_find(paucMessage);
+    guint8 lucPending;
+
+    if (!plsCommand) return;
+
+    g_mutex_lock(&gCorrelateMutex);
+    if (plsCommand->ucPendingCount >= CORRELATE_PENDING_MAX) correlate_timed_out(plsCommand);
+    lucPending = (plsCommand->ucPendingFirst + plsCommand->ucPendingCount) % CORRELATE_PENDING_MAX;
+    plsCommand->llSent_usec[lucPending] = g_get_monotonic_time();
+    plsCommand->ulTag[lucPending]       = ++gulCorrelateTag;
+    plsCommand->cSent[lucPending]       = paucMessage[sizeof(CORRELATE_PREFIX) - 1];
+    ++plsCommand->ucPendingCount;
+    ++plsCommand->ulSent;
+    __atomic_add_fetch(&gulCorrelatePending, 1, __ATOMIC_RELAXED);
+    g_mutex_unlock(&gCorrelateMutex);
+}
+// end correlate_sent
+
+
+////////////////////////////////////////////////////////////////////////////
+// Name:         correlate_tick
+// Description:  Once a second: give up on commands past their timeout
+// Parameters:   None
+// Return:       None
+////////////////////////////////////////////////////////////////////////////
+void
+correlate_tick(void)
+{
+    CorrelateCommand *plsCommand;
+    gint64 llNow_usec = g_get_monotonic_time();
+    guint8 lucIndex;
+
+    if (0 == __atomic_load_n(&gulCorrelatePending, __ATOMIC_RELAXED)) return;
+
+    g_mutex_lock(&gCorrelateMutex);
+    for (lucIndex = 0; lucIndex < CORRELATE_COMMAND_COUNT; ++lucIndex)
+    {
+        plsCommand = &gsCorrelateCommand[lucIndex];
+        while (plsCommand->ucPendingCount &&
+               llNow_usec - plsCommand->llSent_usec[plsCommand->ucPendingFirst] >= (gint64)plsCommand->ulTimeout_msec * 1000)
+        {
+            correlate_timed_out(plsCommand);
+        }
+    }
+    g_mutex_unlock(&gCorrelateMutex);
+}
+// end correlate_tick
+
@@ -0,0 +1,36 @@
+/*
+ * File:   correlate.h
+ * Author: Mark Bersalona
+ *
+ * Created on 2024.07.15
+ */
+
+#ifndef CORRELATE_H
+#define CORRELATE_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Public routines
+//
+///////////////////////////////////////////////////////////////////////////////
+
+// Control and reporting on the UI thread (main loop); correlate_line()
+// on whichever thread reads the serial port
+void correlate_initialize(void (*pafStatusWrite)(char *paucWriteBuf));
+void correlate_line(char *paucLine);
+char *correlate_reply(char *paucCommand);
+void correlate_report(char *paucReport, guint32 lulSize);
+void correlate_sent(char *paucMessage);
+void correlate_tick(void);
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* CORRELATE_H */
+
@@ -19,8 +19,13 @@
 #include <stdlib.h>
 #include "gconfig.h"
 #include "main.h"
+#include "budget.h"
 #include "serial.h"
 #include "display.h"
+#include "parse.h"
+#include "pipeline.h"
+#include "flightrec.h"
+#include "metrics.h"
 
 ///////////////////////////////////////////////////////////////////////////////
 //
@@ -63,6 +68,17 @@ GtkWidget *lblHostCal, *lblBuzzer;
 
 GtkWidget *lblStatusTitle, *textviewStatus;
 GtkWidget *lblReceiveTitle, *lblLogfileTitle, *swLogfileEnable, *lblLogfile;
+GtkWidget *btnReplayOpen, *cbtReplaySpeed, *scaleReplay, *lblReplay;
+GtkWidget *btnSequence, *lblSequence;
+GtkWidget *expStats, *lblStats;
+GtkWidget *lblPluginFields;
+
+// A parser plugin field has changed since the label was last refreshed
+static gboolean gfDisplayPluginFieldsChanged = FALSE;
+
+// A field's update was dropped while the window was hidden
+static gboolean gfDisplayFieldChangedWhileHidden[PARSE_FIELD_COUNT];
+
 GtkWidget *textviewReceive;
 
 // Receive view
@@ -121,6 +137,62 @@ char* pucMenuCMD[] =
 
 char lcTempString[40];
 
+// Window visibility: no Receive inserts or label updates while the
+// window is minimized or unmapped (e.g. on another workspace)
+static gboolean gfDisplayIsMapped    = TRUE;
+static gboolean gfDisplayIsIconified = FALSE;
+static gboolean gfDisplayIsConnected = FALSE;
+static char     gucReceiveHiddenTail[2*RECEIVE_HIDDEN_TAIL_BYTES];
+static gsize    gsizeReceiveHiddenTail      = 0;
+static guint32  gulReceiveHiddenLines       = 0;
+static guint32  gulReceiveHiddenLinesInTail = 0;
+static void display_receive_hidden_append(char * paucLine);
+
+// Widget showing each parsed field
+// (labels, except the text entries for PCB rev, serial number, cal date and Vref)
+static GtkWidget **gpwDisplayFieldWidgets[PARSE_FIELD_COUNT] =
+{
+    [PARSE_FIELD_FWVER]              = &lblFWVer,
+    [PARSE_FIELD_TIMESTAMP]          = &lblTimestamp,
+    [PARSE_FIELD_ELAPSED_TIME]       = &lblElapsedTime,
+    [PARSE_FIELD_BATTERY_VOLTAGE]    = &lblBatteryVoltage,
+    [PARSE_FIELD_BATTERY_PERCENTAGE] = &lblBatteryPercentage,
+    [PARSE_FIELD_MAINS]              = &lblMains,
+    [PARSE_FIELD_SCALE]              = &lblTemperatureTitle,
+    [PARSE_FIELD_MINIMUM]            = &lblMinimum,
+    [PARSE_FIELD_TEMPERATURE]        = &lblTemperature,
+    [PARSE_FIELD_MAXIMUM]            = &lblMaximum,
+    [PARSE_FIELD_ALARM_HI]           = &lblAlarmHI,
+    [PARSE_FIELD_ALARM_LO]           = &lblAlarmLO,
+    [PARSE_FIELD_ALARM]              = &lblAlarm,
+    [PARSE_FIELD_SAMPLE_RATE]        = &lblSampleRate,
+    [PARSE_FIELD_ACK]                = &lblACK,
+    [PARSE_FIELD_HOSTCAL]            = &lblHostCal,
+    [PARSE_FIELD_BUZZER]             = &lblBuzzer,
+    [PARSE_FIELD_XBEE_SN]            = &lblXBeeSN,
+    [PARSE_FIELD_DEVICE]             = &lblDevice,
+    [PARSE_FIELD_PANID]              = &lblPANID,
+    [PARSE_FIELD_CHANNEL]            = &lblChannel,
+    [PARSE_FIELD_CONNECTION]         = &lblConnection,
+    [PARSE_FIELD_PCB_REV]            = &txtentPCBRev,
+    [PARSE_FIELD_SERIAL_NUM]         = &txtentSerialNum,
+    [PARSE_FIELD_CAL_DATE]           = &txtentCalDate,
+    [PARSE_FIELD_VREF]               = &txtentVref,
+    [PARSE_FIELD_STATUS_TITLE]       = &lblStatusTitle,
+};
+
+// Receive view render scheduler ("firehose" mode)
+static gboolean lfIsReceiveFirehose       = FALSE;
+static guint32  lulReceiveFrameLines      = 0;  // lines received this periodic tick
+static guint32  lulReceiveFrameDisplayed  = 0;  // lines displayed this periodic tick
+static gint64   llReceiveFrameInsert_usec = 0;  // GTK insert time spent this periodic tick
+static gint64   llReceiveLineCost_usec16  = 0;  // average insert cost per line, x16
+static guint8   lucReceiveRecoverTicks    = 0;
+static guint32  lulReceiveSampleCount     = 0;
+static guint32  lulReceiveSecondLines     = 0;
+static guint32  lulReceiveSecondSuppressed = 0;
+static gint64   llReceiveSecondStart_usec = 0;
+
 ////////////////////////////////////////////////////////////////////////////
 // Name:         display_main_initialize
 // Description:  Initialize Main window
@@ -207,6 +279,15 @@ display_main_initialize(void)
     lblLogfileTitle = GTK_WIDGET(gtk_builder_get_object(builder, "lblLogfileTitle"));
     swLogfileEnable = GTK_WIDGET(gtk_builder_get_object(builder, "swLogfileEnable"));
     lblLogfile      = GTK_WIDGET(gtk_builder_get_object(builder, "lblLogfile"));
+    btnReplayOpen   = GTK_WIDGET(gtk_builder_get_object(builder, "btnReplayOpen"));
+    cbtReplaySpeed  = GTK_WIDGET(gtk_builder_get_object(builder, "cbtReplaySpeed"));
+    scaleReplay     = GTK_WIDGET(gtk_builder_get_object(builder, "scaleReplay"));
+    lblReplay       = GTK_WIDGET(gtk_builder_get_object(builder, "lblReplay"));
+    btnSequence     = GTK_WIDGET(gtk_builder_get_object(builder, "btnSequence"));
+    lblSequence     = GTK_WIDGET(gtk_builder_get_object(builder, "lblSequence"));
+    expStats        = GTK_WIDGET(gtk_builder_get_object(builder, "expStats"));
+    lblStats        = GTK_WIDGET(gtk_builder_get_object(builder, "lblStats"));
+    lblPluginFields = GTK_WIDGET(gtk_builder_get_object(builder, "lblPluginFields"));
     textviewReceive = GTK_WIDGET(gtk_builder_get_object(builder, "textviewReceive"));
 		
     // Receive text buffer
@@ -304,6 +385,10 @@ display_main_initialize(void)
     gtk_widget_set_name((btnMenu),        "button");
     gtk_widget_set_name((btnRTD),         "button");
     gtk_widget_set_name((btnReboot),      "button");
+    gtk_widget_set_name((btnReplayOpen),  "button");
+    gtk_widget_set_name((btnSequence),    "button");
+    gtk_widget_set_name((lblStats),       "Stats");
+    gtk_widget_set_name((lblPluginFields), "Stats");
 		
     //
     // Initialize values
@@ -328,6 +413,17 @@ display_main_initialize(void)
     g_signal_connect(btnRTD,         "clicked", G_CALLBACK(main_RTD_clicked), NULL);
     g_signal_connect(btnMenu,        "clicked", G_CALLBACK(main_MENU_clicked), NULL);
     g_signal_connect(swLogfileEnable, "state-set", G_CALLBACK(main_LOGENABLE_state_set), NULL);
+    g_signal_connect(btnReplayOpen,  "clicked",      G_CALLBACK(main_REPLAY_clicked), NULL);
+    g_signal_connect(cbtReplaySpeed, "changed",      G_CALLBACK(main_REPLAY_SPEED_changed), NULL);
+    g_signal_connect(scaleReplay,    "change-value", G_CALLBACK(main_REPLAY_scrub), NULL);
+    g_signal_connect(btnSequence,    "clicked",      G_CALLBACK(main_SEQUENCE_clicked), NULL);
+
+    //
+    // Track whether the window can be seen
+    //
+    g_signal_connect(window, "window-state-event", G_CALLBACK(display_window_state_event), NULL);
+    g_signal_connect(window, "map-event",          G_CALLBACK(display_window_map_event),   NULL);
+    g_signal_connect(window, "unmap-event",        G_CALLBACK(display_window_map_event),   NULL);
 
 }
 // end display_main_initialize
@@ -341,37 +437,26 @@ display_main_initialize(void)
 ////////////////////////////////////////////////////////////////////////////
 void display_clear_UUT_values(void)
 {
-    gtk_label_set_text(GTK_LABEL(lblFWVer), "------");
-    gtk_label_set_text(GTK_LABEL(lblTimestamp), "0000000000");
-    gtk_label_set_text(GTK_LABEL(lblElapsedTime), "0d 0h 0m 0s");
-    gtk_label_set_text(GTK_LABEL(lblBatteryVoltage), "------");
-    gtk_label_set_text(GTK_LABEL(lblBatteryPercentage), "------");
-    gtk_label_set_text(GTK_LABEL(lblMains), "------");
-
-    gtk_label_set_text(GTK_LABEL(lblAlarmHI), "------");
-    gtk_label_set_text(GTK_LABEL(lblAlarmLO), "------");
-    gtk_label_set_text(GTK_LABEL(lblAlarm), "------");
-    gtk_label_set_text(GTK_LABEL(lblSampleRate), "-");
-    gtk_label_set_text(GTK_LABEL(lblACK), "------");
-    gtk_label_set_text(GTK_LABEL(lblHostCal), "------");
-    gtk_label_set_text(GTK_LABEL(lblBuzzer), "------");
-
-    gtk_label_set_text(GTK_LABEL(lblXBeeSN), "------");
-    gtk_label_set_text(GTK_LABEL(lblDevice), "------");
-    gtk_label_set_text(GTK_LABEL(lblPANID), "------");
-    gtk_label_set_text(GTK_LABEL(lblChannel), "------");
-    gtk_label_set_text(GTK_LABEL(lblConnection), "------");
-    gtk_widget_set_name((lblConnection),     "DiagnosticValue");
-
-    gtk_label_set_text(GTK_LABEL(lblMinimum), "XX.X");
-    gtk_label_set_text(GTK_LABEL(lblTemperature), "XX.X");
-    gtk_label_set_text(GTK_LABEL(lblMaximum), "XX.X");
-
-    //gtk_label_set_text(GTK_LABEL(lblXXXXXXXXX), "------");
+    // Reset the parsed values (and their labels), sticky error status
+    // and device start time
+    pipeline_lock();
+    parse_clear_UUT_values();
+    pipeline_unlock();
 
+    display_clear_views();
+}
+// end display_clear_UUT_values
 
-    
-    
+
+////////////////////////////////////////////////////////////////////////////
+// Name:         display_clear_views
+// Description:  Clear the Status and Receive text buffers (--pipeline: the
+//               UUT reset, the parser has already cleared the values)
+// Parameters:   None
+// Return:       None
+////////////////////////////////////////////////////////////////////////////
+void display_clear_views(void)
+{
     // Clear the Status text buffer
     gtk_text_buffer_get_start_iter(textbufStatus, &textiterStatusStart);
     gtk_text_buffer_get_end_iter  (textbufStatus, &textiterStatusEnd);
@@ -381,16 +466,68 @@ void display_clear_UUT_values(void)
     gtk_text_buffer_get_start_iter(textbufReceive, &textiterReceiveStart);
     gtk_text_buffer_get_end_iter  (textbufReceive, &textiterReceiveEnd);
     gtk_text_buffer_delete(textbufReceive, &textiterReceiveStart, &textiterReceiveEnd);
+}
+// end display_clear_views
 
-    // Clear sticky error status, prep for the next one
-    memset(gucStickyErrorStatus,    0x00, sizeof(gucStickyErrorStatus));
-    memset(gucStickyErrorStatusOLD, 0x00, sizeof(gucStickyErrorStatusOLD));
-    gtk_label_set_text(GTK_LABEL(lblStatusTitle),  "Status");
 
-    // Clear device start time
-    gulDeviceStartTimestamp   = 0;
+////////////////////////////////////////////////////////////////////////////
+// Name:         display_connection_update
+// Description:  Parser hook - network connection state transition.
+//               Connection label is green when CONNECTED
+// Parameters:   lfIsConnected - TRUE if the UUT is now connected
+// Return:       None
+////////////////////////////////////////////////////////////////////////////
+void
+display_connection_update(gboolean lfIsConnected)
+{
+    gfDisplayIsConnected = lfIsConnected;
+    if (!display_is_visible()) return;
+    gtk_widget_set_name((lblConnection), lfIsConnected ? "ConnectionOK" : "DiagnosticValue");
 }
-// end display_clear_UUT_values
+// end display_connection_update
+
+
+////////////////////////////////////////////////////////////////////////////
+// Name:         display_field_update
+// Description:  Parser hook - write a new parsed value to its label
+//               (or text entry). Skipped while the window is hidden,
+//               noting the field; display_window_restore() catches it up
+//               from gucParseField.
+//               Parser plugin fields share one label, refreshed once a
+//               second by display_update_plugin_fields()
+// Parameters:   lucField  - PARSE_FIELD_xxx, or a plugin field
+//               paucValue - pointer to NULL-terminated value
+// Return:       None
+////////////////////////////////////////////////////////////////////////////
+void
+display_field_update(guint8 lucField, char *paucValue)
+{
+    GtkWidget *pwWidget;
+
+    if (lucField >= PARSE_FIELD_COUNT)
+    {
+        gfDisplayPluginFieldsChanged = TRUE;
+        return;
+    }
+    if (NULL == gpwDisplayFieldWidgets[lucField]) return;
+    pwWidget = *gpwDisplayFieldWidgets[lucField];
+    if (NULL == pwWidget) return;
+    if (!display_is_visible())
+    {
+        gfDisplayFieldChangedWhileHidden[lucField] = TRUE;
+        return;
+    }
+
+    if (GTK_IS_ENTRY(pwWidget))
+    {
+        gtk_entry_set_text(GTK_ENTRY(pwWidget), paucValue);
+    }
+    else
+    {
+        gtk_label_set_text(GTK_LABEL(pwWidget), paucValue);
+    }
+}
+// end display_field_update
 
 
 ////////////////////////////////////////////////////////////////////////////
@@ -414,7 +551,286 @@ display_receive_write(char * paucWriteBuf)
     adjReceive = gtk_scrolled_window_get_vadjustment(scrolledwindowReceive);
     gtk_adjustment_set_value( adjReceive, gtk_adjustment_get_upper(adjReceive) );
 }
-// end display_status_write
+// end display_receive_write
+
+
+////////////////////////////////////////////////////////////////////////////
+// Name:         display_receive_line
+// Description:  Write a received line (plus CRLF) to Receive, subject to
+//               the render budget.
+//               Normally every line is displayed. In firehose mode only
+//               every RECEIVE_RENDER_SAMPLE_EVERY-th line is displayed;
+//               the others are counted and summarized once per second.
+//               Time spent inside GTK is measured for display_receive_frame_end()
+// Parameters:   paucLine - pointer to received NULL-terminated string
+// Return:       None
+////////////////////////////////////////////////////////////////////////////
+void
+display_receive_line(char * paucLine)
+{
+    guint64 lullStart_ns;
+    guint64 lullInsert_ns;
+
+    if (!display_is_visible())
+    {
+        // Nobody's watching: just keep the tail for when the window is restored
+        display_receive_hidden_append(paucLine);
+        return;
+    }
+
+    ++lulReceiveFrameLines;
+    ++lulReceiveSecondLines;
+
+    if (lfIsReceiveFirehose && (++lulReceiveSampleCount % RECEIVE_RENDER_SAMPLE_EVERY))
+    {
+        // Line suppressed from the display (it's still parsed and logged)
+        ++lulReceiveSecondSuppressed;
+        return;
+    }
+
+    ++lulReceiveFrameDisplayed;
+    lullStart_ns = metrics_now_ns();
+    display_receive_write(paucLine);
+    display_receive_write("\r\n");
+    lullInsert_ns = metrics_now_ns() - lullStart_ns;
+    metrics_record(METRICS_RENDER_NS, lullInsert_ns);
+    llReceiveFrameInsert_usec += lullInsert_ns / 1000;
+}
+// end display_receive_line
+
+
+////////////////////////////////////////////////////////////////////////////
+// Name:         display_receive_frame_end
+// Description:  End of a periodic tick's worth of received lines.
+//               Estimates what it would have cost to display every line
+//               received this tick; enters firehose mode if that's over
+//               the render-usec budget, and returns to normal mode
+//               after RECEIVE_RENDER_RECOVER_TICKS ticks comfortably under
+//               budget. While in firehose mode, writes a "lines/s,
+//               suppressed" summary to Receive once per second
+// Parameters:   None
+// Return:       None
+////////////////////////////////////////////////////////////////////////////
+void
+display_receive_frame_end(void)
+{
+    static char lcSummary[100];
+    gint64  llProjected_usec;
+    gint64  llNow_usec = g_get_monotonic_time();
+
+    if (!display_is_visible()) return;
+
+    // Update the average per-line insert cost from the lines actually displayed
+    if (lulReceiveFrameDisplayed > 0)
+    {
+        gint64 llLineCost_usec16 = (llReceiveFrameInsert_usec * 16) / lulReceiveFrameDisplayed;
+        if (0 == llReceiveLineCost_usec16) llReceiveLineCost_usec16 = llLineCost_usec16;
+        else llReceiveLineCost_usec16 += (llLineCost_usec16 - llReceiveLineCost_usec16) / 8;
+    }
+
+    // Projected cost of displaying every line received this tick
+    llProjected_usec = (llReceiveLineCost_usec16 * lulReceiveFrameLines) / 16;
+
+    if (!lfIsReceiveFirehose)
+    {
+        if (llProjected_usec > gulBudgetRender_usec)
+        {
+            lfIsReceiveFirehose        = TRUE;
+            lucReceiveRecoverTicks     = 0;
+            lulReceiveSampleCount      = 0;
+            lulReceiveSecondSuppressed = 0;
+            sprintf(lcSummary, "Receive display over budget (%d ms/tick), showing 1 of every %d lines\r\n",
+                    (int)(llProjected_usec/1000), RECEIVE_RENDER_SAMPLE_EVERY);
+            display_status_write(lcSummary);
+        }
+    }
+    else
+    {
+        if (llProjected_usec < gulBudgetRender_usec/2)
+        {
+            if (++lucReceiveRecoverTicks >= RECEIVE_RENDER_RECOVER_TICKS)
+            {
+                lfIsReceiveFirehose = FALSE;
+                display_status_write("Receive display back under budget, showing every line\r\n");
+            }
+        }
+        else
+        {
+            lucReceiveRecoverTicks = 0;
+        }
+    }
+
+    // Once a second, summarize the lines that weren't displayed
+    if (llNow_usec - llReceiveSecondStart_usec >= G_USEC_PER_SEC)
+    {
+        if (lulReceiveSecondSuppressed > 0)
+        {
+            sprintf(lcSummary, "----- %u lines/s, %u suppressed -----\r\n",
+                    (guint32)(((gint64)lulReceiveSecondLines * G_USEC_PER_SEC) / (llNow_usec - llReceiveSecondStart_usec)),
+                    lulReceiveSecondSuppressed);
+            display_receive_write(lcSummary);
+        }
+        llReceiveSecondStart_usec  = llNow_usec;
+        lulReceiveSecondLines      = 0;
+        lulReceiveSecondSuppressed = 0;
+    }
+
+    lulReceiveFrameLines      = 0;
+    lulReceiveFrameDisplayed  = 0;
+    llReceiveFrameInsert_usec = 0;
+}
+// end display_receive_frame_end
+
+
+////////////////////////////////////////////////////////////////////////////
+// Name:         display_receive_hidden_append
+// Description:  Save a received line while the window is hidden.
+//               Only the last RECEIVE_HIDDEN_TAIL_BYTES or so are kept,
+//               starting at a line boundary
+// Parameters:   paucLine - pointer to received NULL-terminated string
+// Return:       None
+////////////////////////////////////////////////////////////////////////////
+static void
+display_receive_hidden_append(char * paucLine)
+{
+    gsize lsizeLine = MIN(strlen(paucLine), RECEIVE_HIDDEN_TAIL_BYTES-3);
+    char *plcNewline;
+
+    ++gulReceiveHiddenLines;
+    ++gulReceiveHiddenLinesInTail;
+
+    if (gsizeReceiveHiddenTail + lsizeLine + 2 >= sizeof(gucReceiveHiddenTail))
+    {
+        // Full: keep the newest half, from the first complete line
+        plcNewline = memchr(&gucReceiveHiddenTail[gsizeReceiveHiddenTail - RECEIVE_HIDDEN_TAIL_BYTES],
+                            '\n', RECEIVE_HIDDEN_TAIL_BYTES);
+        if (plcNewline)
+        {
+            gsize lsizeKept = &gucReceiveHiddenTail[gsizeReceiveHiddenTail] - (plcNewline+1);
+            guint32 lulDroppedLines = 0;
+            char *plcChar;
+            for (plcChar = gucReceiveHiddenTail; plcChar <= plcNewline; ++plcChar)
+            {
+                if ('\n' == *plcChar) ++lulDroppedLines;
+            }
+            memmove(gucReceiveHiddenTail, plcNewline+1, lsizeKept);
+            gsizeReceiveHiddenTail = lsizeKept;
+            gulReceiveHiddenLinesInTail -= lulDroppedLines;
+        }
+        else
+        {
+            gsizeReceiveHiddenTail      = 0;
+            gulReceiveHiddenLinesInTail = 1;
+        }
+    }
+
+    memcpy(&gucReceiveHiddenTail[gsizeReceiveHiddenTail], paucLine, lsizeLine);
+    gsizeReceiveHiddenTail += lsizeLine;
+    gucReceiveHiddenTail[gsizeReceiveHiddenTail++] = '\r';
+    gucReceiveHiddenTail[gsizeReceiveHiddenTail++] = '\n';
+}
+// end display_receive_hidden_append
+
+
+////////////////////////////////////////////////////////////////////////////
+// Name:         display_is_visible
+// Description:  Can the Main window be seen? (mapped and not minimized)
+// Parameters:   None
+// Return:       TRUE if the window is visible
+////////////////////////////////////////////////////////////////////////////
+gboolean
+display_is_visible(void)
+{
+    return gfDisplayIsMapped && !gfDisplayIsIconified;
+}
+// end display_is_visible
+
+
+////////////////////////////////////////////////////////////////////////////
+// Name:         display_window_restore
+// Description:  The window has become visible again: catch up the labels
+//               from the parsed values, then write the Receive lines saved
+//               while hidden in one insert. A text entry (serial number,
+//               cal date, ...) is only written if the UUT sent it while
+//               the window was hidden, so an entry the operator is editing
+//               is otherwise left alone
+// Parameters:   None
+// Return:       None
+////////////////////////////////////////////////////////////////////////////
+static void
+display_window_restore(void)
+{
+    char lcHiddenString[100];
+    gboolean lfChanged;
+    guint8 i;
+
+    pipeline_lock();
+    for (i = 0; i < PARSE_FIELD_COUNT; ++i)
+    {
+        lfChanged = gfDisplayFieldChangedWhileHidden[i];
+        gfDisplayFieldChangedWhileHidden[i] = FALSE;
+        if (NULL == gpwDisplayFieldWidgets[i] || NULL == *gpwDisplayFieldWidgets[i]) continue;
+        if (GTK_IS_ENTRY(*gpwDisplayFieldWidgets[i]) && !lfChanged) continue;
+        if (gucParseField[i][0]) display_field_update(i, gucParseField[i]);
+    }
+    pipeline_unlock();
+    gfDisplayPluginFieldsChanged = TRUE;
+    display_connection_update(gfDisplayIsConnected);
+
+    if (gulReceiveHiddenLines > gulReceiveHiddenLinesInTail)
+    {
+        sprintf(lcHiddenString, "----- %u lines received while hidden, last %u shown -----\r\n",
+                gulReceiveHiddenLines, gulReceiveHiddenLinesInTail);
+        display_receive_write(lcHiddenString);
+    }
+    if (gsizeReceiveHiddenTail)
+    {
+        gucReceiveHiddenTail[gsizeReceiveHiddenTail] = '\0';
+        display_receive_write(gucReceiveHiddenTail);
+    }
+    gsizeReceiveHiddenTail      = 0;
+    gulReceiveHiddenLines       = 0;
+    gulReceiveHiddenLinesInTail = 0;
+}
+// end display_window_restore
+
+
+////////////////////////////////////////////////////////////////////////////
+// Name:         display_window_map_event
+// Description:  Callback routine - Main window mapped or unmapped
+//               (e.g. moved to/from another workspace)
+// Parameters:   Standard "map-event"/"unmap-event" signal parameters
+// Return:       FALSE, so other handlers also see the event
+////////////////////////////////////////////////////////////////////////////
+gboolean
+display_window_map_event(GtkWidget *widget, GdkEvent *event, gpointer data)
+{
+    gboolean lfWasVisible = display_is_visible();
+
+    gfDisplayIsMapped = (GDK_MAP == event->type);
+    if (!lfWasVisible && display_is_visible()) display_window_restore();
+    return FALSE;
+}
+// end display_window_map_event
+
+
+////////////////////////////////////////////////////////////////////////////
+// Name:         display_window_state_event
+// Description:  Callback routine - Main window state changed
+//               (minimized/restored)
+// Parameters:   Standard "window-state-event" signal parameters
+// Return:       FALSE, so other handlers also see the event
+////////////////////////////////////////////////////////////////////////////
+gboolean
+display_window_state_event(GtkWidget *widget, GdkEventWindowState *event, gpointer data)
+{
+    gboolean lfWasVisible = display_is_visible();
+
+    gfDisplayIsIconified = (event->new_window_state & (GDK_WINDOW_STATE_ICONIFIED | GDK_WINDOW_STATE_WITHDRAWN)) != 0;
+    if (!lfWasVisible && display_is_visible()) display_window_restore();
+    return FALSE;
+}
+// end display_window_state_event
 
 
 ////////////////////////////////////////////////////////////////////////////
@@ -427,6 +843,8 @@ display_receive_write(char * paucWriteBuf)
 void
 display_status_write(char * paucWriteBuf)
 {
+    flightrec_write(FLIGHTREC_STATUS, paucWriteBuf);
+
     // Move cursor to end of text buffer
     gtk_text_iter_forward_to_end(&textiterStatusEnd);
     gtk_text_buffer_place_cursor(textbufStatus, &textiterStatusEnd);
@@ -439,12 +857,63 @@ display_status_write(char * paucWriteBuf)
     gtk_adjustment_set_value( adjStatus, gtk_adjustment_get_upper(adjStatus) );
 
     // Reset Status timestamp timer
-    guiStatusTimestampCountdownIndex = 0;
-    guiStatusTimestampCountdown_minutes = 1;
+    main_status_timestamp_restart();
 }
 // end display_status_write
 
 
+////////////////////////////////////////////////////////////////////////////
+// Name:         display_update_stats
+// Description:  Refresh the Statistics panel (only if it's open and
+//               anyone can see it)
+// Parameters:   None
+// Return:       None
+////////////////////////////////////////////////////////////////////////////
+void
+display_update_stats(void)
+{
+    static char lcStats[1024];
+
+    if (!display_is_visible() || !gtk_expander_get_expanded(GTK_EXPANDER(expStats))) return;
+
+    metrics_format(lcStats, sizeof(lcStats));
+    gtk_label_set_text(GTK_LABEL(lblStats), lcStats);
+}
+// end display_update_stats
+
+
+////////////////////////////////////////////////////////////////////////////
+// Name:         display_update_plugin_fields
+// Description:  Housekeeping, once a second: show the parser plugin
+//               fields' latest values, "Name: value", under Statistics,
+//               if any has changed (and anyone can see it)
+//               Called with the pipeline lock held (timer handler)
+// Parameters:   None
+// Return:       None
+////////////////////////////////////////////////////////////////////////////
+void
+display_update_plugin_fields(void)
+{
+    static char lcFields[PARSE_FIELD_PLUGIN_MAX * (2 * PARSE_FIELD_LENGTH_MAX)];
+    guint32 lulLength = 0;
+    guint8  lucField;
+
+    if (!gfDisplayPluginFieldsChanged || !display_is_visible()) return;
+    gfDisplayPluginFieldsChanged = FALSE;
+
+    lcFields[0] = '\0';
+    for (lucField = PARSE_FIELD_COUNT; lucField < parse_field_count(); ++lucField)
+    {
+        if (!gucParseField[lucField][0]) continue;
+        lulLength += snprintf(lcFields + lulLength, sizeof(lcFields) - lulLength, "%s%s: %s",
+                              lulLength ? "    " : "", parse_field_name(lucField), gucParseField[lucField]);
+    }
+    gtk_label_set_text(GTK_LABEL(lblPluginFields), lcFields);
+    gtk_widget_set_visible(lblPluginFields, lulLength > 0);
+}
+// end display_update_plugin_fields
+
+
 ////////////////////////////////////////////////////////////////////////////
 // Name:         display_update_data_age
 // Description:  Update data age if data hasn't updated "in a while"
@@ -454,11 +923,13 @@ display_status_write(char * paucWriteBuf)
 void
 display_update_data_age(void)
 {
-    if (gulElapsedTimeSinceDataUpdate_sec < DATA_TIMEOUT_MIN_MINUTES)
+    guint32 lulDataAge_sec = (g_get_monotonic_time() - gllDataUpdate_usec) / G_USEC_PER_SEC;
+
+    if (lulDataAge_sec < DATA_TIMEOUT_MIN_MINUTES)
     {
         // Data has been updated recently, so connection is OK
     }
-    else if (gulElapsedTimeSinceDataUpdate_sec < DATA_TIMEOUT_MIN_DAYS)
+    else if (lulDataAge_sec < DATA_TIMEOUT_MIN_DAYS)
     {
         // Data was at least updated within the minimum number of days,
         // so issue a connection warning
@@ -469,43 +940,43 @@ display_update_data_age(void)
         // so issue a connection error
     }
 
-    if (gulElapsedTimeSinceDataUpdate_sec >= DATA_TIMEOUT_MIN_MINUTES &&
-        gulElapsedTimeSinceDataUpdate_sec <  DATA_TIMEOUT_MAX_MINUTES    )
+    if (lulDataAge_sec >= DATA_TIMEOUT_MIN_MINUTES &&
+        lulDataAge_sec <  DATA_TIMEOUT_MAX_MINUTES    )
     {
         // Data is less than an hour old, report data age in minutes
         sprintf(lcTempString, "Data %d minutes old\r\n", 
-                gulElapsedTimeSinceDataUpdate_sec/60);
+                lulDataAge_sec/60);
         display_status_write(lcTempString);
     }
-    else if (gulElapsedTimeSinceDataUpdate_sec >= DATA_TIMEOUT_MIN_HOURS &&
-             gulElapsedTimeSinceDataUpdate_sec <  DATA_TIMEOUT_MAX_HOURS    )
+    else if (lulDataAge_sec >= DATA_TIMEOUT_MIN_HOURS &&
+             lulDataAge_sec <  DATA_TIMEOUT_MAX_HOURS    )
     {
         // Data is less than a day old, report data age in hours
         sprintf(lcTempString, "Data %d hours old\r\n", 
-                gulElapsedTimeSinceDataUpdate_sec/(60*60));
+                lulDataAge_sec/(60*60));
         display_status_write(lcTempString);
     }
-    else if (gulElapsedTimeSinceDataUpdate_sec >= DATA_TIMEOUT_MIN_DAYS &&
-             gulElapsedTimeSinceDataUpdate_sec <  DATA_TIMEOUT_MAX_DAYS    )
+    else if (lulDataAge_sec >= DATA_TIMEOUT_MIN_DAYS &&
+             lulDataAge_sec <  DATA_TIMEOUT_MAX_DAYS    )
     {
         // Data is less than a month old, report data age in days
         sprintf(lcTempString, "Data %d days old\r\n", 
-                gulElapsedTimeSinceDataUpdate_sec/(60*60*24));
+                lulDataAge_sec/(60*60*24));
         display_status_write(lcTempString);
     }
-    else if (gulElapsedTimeSinceDataUpdate_sec >= DATA_TIMEOUT_MIN_MONTHS &&
-             gulElapsedTimeSinceDataUpdate_sec <  DATA_TIMEOUT_MAX_MONTHS    )
+    else if (lulDataAge_sec >= DATA_TIMEOUT_MIN_MONTHS &&
+             lulDataAge_sec <  DATA_TIMEOUT_MAX_MONTHS    )
     {
         // Data is less than a year old, report data age in months
         sprintf(lcTempString, "Data %.01f months old\r\n", 
-                (float)gulElapsedTimeSinceDataUpdate_sec/(60*60*24*30));
+                (float)lulDataAge_sec/(60*60*24*30));
         display_status_write(lcTempString);
     }
-    else if (gulElapsedTimeSinceDataUpdate_sec >= DATA_TIMEOUT_MIN_YEARS)
+    else if (lulDataAge_sec >= DATA_TIMEOUT_MIN_YEARS)
     {
         // Report data age in years
         sprintf(lcTempString, "Data %.01f years old\r\n", 
-                (float)gulElapsedTimeSinceDataUpdate_sec/(60*60*24*365));
+                (float)lulDataAge_sec/(60*60*24*365));
         display_status_write(lcTempString);
     }
 }
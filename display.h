@@ -52,10 +52,15 @@ extern GtkWidget *lblHostCalTitle, *lblBuzzerTitle;
 extern GtkWidget *lblHostCal, *lblBuzzer;
 
 extern GtkWidget *swLogfileEnable, *lblLogfile;
+extern GtkWidget *btnReplayOpen, *cbtReplaySpeed, *scaleReplay, *lblReplay;
+extern GtkWidget *btnSequence, *lblSequence;
+extern GtkWidget *expStats, *lblStats;
 
 extern GtkWidget *lblStatusTitle;
 extern GtkTextBuffer *textbufStatus;
 extern GtkTextBuffer *textbufReceive;
+extern GtkWidget *textviewReceive;
+extern GtkScrolledWindow *scrolledwindowReceive;
 extern GtkTextIter textiterReceiveStart;
 extern GtkTextIter textiterReceiveEnd;
 extern GtkTextIter textiterStatusStart;
@@ -75,14 +80,24 @@ extern char* pucMenuCMD[];
 ///////////////////////////////////////////////////////////////////////////////
 
 void display_clear_UUT_values(void);
+void display_clear_views(void);
+void display_connection_update(gboolean lfIsConnected);
+void display_field_update(guint8 lucField, char *paucValue);
+gboolean display_is_visible(void);
 void display_diagnostics_enter(GtkWindow *parent);
 void display_diagnostics_exit(void);
 void display_main_initialize(void);
+void display_receive_frame_end(void);
+void display_receive_line(char * paucLine);
 void display_receive_write(char * paucWriteBuf);
 void display_status_write(char * paucWriteBuf);
 void display_update_zones(void);
 void display_update_display_connection(void);
 void display_update_data_age(void);
+void display_update_stats(void);
+void display_update_plugin_fields(void);
+gboolean display_window_map_event(GtkWidget *widget, GdkEvent *event, gpointer data);
+gboolean display_window_state_event(GtkWidget *widget, GdkEventWindowState *event, gpointer data);
 
 
 
@@ -0,0 +1,586 @@
+/*
+ * File:   export.c
+ * Author: Mark Bersalona
+ *
+ * Created on 2024.07.15
+ * Sensaphone WSG30 Temperature Display Diagnostic telemetry export
+ *
+ * Writes one row per STATUS record (temperature, min/max, alarm limits,
+ * battery, device timestamp, XBee channel, ...) as CSV and/or as a
+ * column-oriented file: rows are batched into row groups, each column is
+ * stored contiguously and string columns are dictionary-encoded per row
+ * group, so weeks of burn-in data load without re-parsing text logs.
+ * See export.h for the columnar file layout.
+ *
+ * The column, header and dictionary buffers are kept from one row group to
+ * the next, and so is each string column's dictionary: a value is copied
+ * the first time it's seen and only given a new index per row group, so
+ * a running export doesn't allocate once it has seen its values.
+ */
+
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Includes
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include <glib.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "gconfig.h"
+#include "parse.h"
+#include "export.h"
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Definitions
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#define EXPORT_MAGIC_FILE       ("WSG30COL")
+#define EXPORT_MAGIC_ROWGROUP   (0x50524752)    // "RGRP"
+#define EXPORT_MAGIC_INDEX      (0x58444943)    // "CIDX"
+#define EXPORT_MAGIC_END        (0x444E4543)    // "CEND"
+
+// Column sources other than a parsed field
+#define EXPORT_SOURCE_HOST_TIME    (-1)
+#define EXPORT_SOURCE_DEVICE_TIME  (-2)
+
+typedef struct
+{
+    char   *pucName;
+    guint8  lucType;        // EXPORT_TYPE_xxx
+    gint8   lcSource;       // PARSE_FIELD_xxx or EXPORT_SOURCE_xxx
+} ExportColumn;
+
+// Most distinct values a string column's dictionary keeps from one row
+// group to the next; past this it starts again
+#define EXPORT_DICTIONARY_KEEP_MAX  (4096)
+
+// String column dictionary entry, kept across row groups
+typedef struct
+{
+    guint32 ulRowGroup;     // gulExportRowGroupNumber when last indexed
+    guint32 ulIndex;        // index+1 in that row group's dictionary
+    char    cString[];
+} ExportDictionaryEntry;
+
+// Row group index entry, for the footer
+typedef struct
+{
+    guint64 lullOffset;
+    guint32 lulRows;
+    gint64  llFirst_usec;
+    gint64  llLast_usec;
+} ExportRowGroup;
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Variables and tables
+//
+///////////////////////////////////////////////////////////////////////////////
+
+static const ExportColumn gsExportColumns[] =
+{
+    { "host_time_usec",     EXPORT_TYPE_I64,  EXPORT_SOURCE_HOST_TIME },
+    { "device_timestamp",   EXPORT_TYPE_I64,  EXPORT_SOURCE_DEVICE_TIME },
+    { "temperature",        EXPORT_TYPE_F32,  PARSE_FIELD_TEMPERATURE },
+    { "minimum",            EXPORT_TYPE_F32,  PARSE_FIELD_MINIMUM },
+    { "maximum",            EXPORT_TYPE_F32,  PARSE_FIELD_MAXIMUM },
+    { "alarm_hi",           EXPORT_TYPE_F32,  PARSE_FIELD_ALARM_HI },
+    { "alarm_lo",           EXPORT_TYPE_F32,  PARSE_FIELD_ALARM_LO },
+    { "battery_voltage",    EXPORT_TYPE_F32,  PARSE_FIELD_BATTERY_VOLTAGE },
+    { "battery_percentage", EXPORT_TYPE_F32,  PARSE_FIELD_BATTERY_PERCENTAGE },
+    { "scale",              EXPORT_TYPE_DICT, PARSE_FIELD_SCALE },
+    { "alarm",              EXPORT_TYPE_DICT, PARSE_FIELD_ALARM },
+    { "mains",              EXPORT_TYPE_DICT, PARSE_FIELD_MAINS },
+    { "channel",            EXPORT_TYPE_DICT, PARSE_FIELD_CHANNEL },
+    { "connection",         EXPORT_TYPE_DICT, PARSE_FIELD_CONNECTION },
+    { "xbee_sn",            EXPORT_TYPE_DICT, PARSE_FIELD_XBEE_SN },
+};
+#define EXPORT_COLUMN_COUNT (G_N_ELEMENTS(gsExportColumns))
+
+static guint8   gucExportFormat = EXPORT_FORMAT_COLUMNAR;
+static gboolean gfExportEnabled = FALSE;
+
+// CSV
+static FILE *gpExportCSV = NULL;
+
+// Columnar: the row group being filled, one buffer per column (already
+// encoded), plus a dictionary per string column
+static FILE       *gpExportColumnar = NULL;
+static GByteArray *gExportColumn[EXPORT_COLUMN_COUNT];
+static GHashTable *gExportDictionary[EXPORT_COLUMN_COUNT];      // string -> ExportDictionaryEntry
+static GPtrArray  *gExportDictionaryStrings[EXPORT_COLUMN_COUNT];   // this row group's, in index order
+static GByteArray *gExportRowGroupHeader = NULL;
+static GByteArray *gExportDictionaryBytes = NULL;
+static guint32     gulExportRowGroupNumber = 1;     // row groups started, all exports
+static guint32     gulExportRows;
+static gint64      gllExportFirst_usec;
+static gint64      gllExportLast_usec;
+static gint64      gllExportRowGroupStarted_usec;   // monotonic, for export_tick()
+static guint64     gullExportOffset;
+static GArray     *gExportRowGroups = NULL;          // ExportRowGroup
+
+
+////////////////////////////////////////////////////////////////////////////
+// Name:         export_put32
+// Description:  Append a 32-bit value, little-endian
+// Parameters:   lgBuf    - where to append it
+//               lulValue - value
+// Return:       None
+////////////////////////////////////////////////////////////////////////////
+static void
+export_put32(GByteArray *lgBuf, guint32 lulValue)
+{
+    guint8 lucBytes[4] = { lulValue, lulValue >> 8, lulValue >> 16, lulValue >> 24 };
+    g_byte_array_append(lgBuf, lucBytes, 4);
+}
+// end export_put32
+
+
+////////////////////////////////////////////////////////////////////////////
+// Name:         export_put64
+// Description:  Append a 64-bit value, little-endian
+// Parameters:   lgBuf     - where to append it
+//               lullValue - value
+// Return:       None
+////////////////////////////////////////////////////////////////////////////
+static void
+export_put64(GByteArray *lgBuf, guint64 lullValue)
+{
+    export_put32(lgBuf, (guint32)lullValue);
+    export_put32(lgBuf, (guint32)(lullValue >> 32));
+}
+// end export_put64
+
+
+////////////////////////////////////////////////////////////////////////////
+// Name:         export_put16
+// Description:  Append a 16-bit value, little-endian
+// Parameters:   lgBuf    - where to append it
+//               luiValue - value
+// Return:       None
+////////////////////////////////////////////////////////////////////////////
+static void
+export_put16(GByteArray *lgBuf, guint16 luiValue)
+{
+    guint8 lucBytes[2] = { luiValue, luiValue >> 8 };
+    g_byte_array_append(lgBuf, lucBytes, 2);
+}
+// end export_put16
+
+
+////////////////////////////////////////////////////////////////////////////
+// Name:         export_number
+// Description:  Numeric value of a parsed field ("3.01 V" -> 3.01)
+// Parameters:   paucValue - parsed field
+// Return:       Value, NaN if the field has no number
+////////////////////////////////////////////////////////////////////////////
+static gfloat
+export_number(char *paucValue)
+{
+    char *plcEnd;
+    gdouble ldValue = strtod(paucValue, &plcEnd);
+
+    return (plcEnd == paucValue) ? NAN : (gfloat)ldValue;
+}
+// end export_number
+
+
+////////////////////////////////////////////////////////////////////////////
+// Name:         export_rowgroup_write
+// Description:  Write the row group being filled to the columnar file and
+//               start a new one
+// Parameters:   None
+// Return:       None
+////////////////////////////////////////////////////////////////////////////
+static void
+export_rowgroup_write(void)
+{
+    GByteArray *lgHeader = gExportRowGroupHeader;
+    GByteArray *lgDictionary = gExportDictionaryBytes;
+    ExportRowGroup lsRowGroup;
+    guint32 lulDictionary;
+    guint8  i;
+    guint32 j;
+
+    if (!gpExportColumnar || 0 == gulExportRows) return;
+
+    lsRowGroup.lullOffset   = gullExportOffset;
+    lsRowGroup.lulRows      = gulExportRows;
+    lsRowGroup.llFirst_usec = gllExportFirst_usec;
+    lsRowGroup.llLast_usec  = gllExportLast_usec;
+    g_array_append_val(gExportRowGroups, lsRowGroup);
+
+    g_byte_array_set_size(lgHeader, 0);
+    export_put32(lgHeader, EXPORT_MAGIC_ROWGROUP);
+    export_put32(lgHeader, gulExportRows);
+    fwrite(lgHeader->data, 1, lgHeader->len, gpExportColumnar);
+    gullExportOffset += lgHeader->len;
+
+    for (i = 0; i < EXPORT_COLUMN_COUNT; ++i)
+    {
+        g_byte_array_set_size(lgHeader, 0);
+        if (EXPORT_TYPE_DICT == gsExportColumns[i].lucType)
+        {
+            // Chunk length, then the dictionary ahead of the indices
+            g_byte_array_set_size(lgDictionary, 0);
+            lulDictionary = gExportDictionaryStrings[i]->len;
+            export_put32(lgDictionary, lulDictionary);
+            for (j = 0; j < lulDictionary; ++j)
+            {
+                char *plcString = g_ptr_array_index(gExportDictionaryStrings[i], j);
+                export_put16(lgDictionary, strlen(plcString));
+                g_byte_array_append(lgDictionary, (guint8 *)plcString, strlen(plcString));
+            }
+            export_put32(lgHeader, lgDictionary->len + gExportColumn[i]->len);
+            g_byte_array_append(lgHeader, lgDictionary->data, lgDictionary->len);
+
+            // The values are kept for the next row group (unless there
+            // are too many); only their indices start again
+            g_ptr_array_set_size(gExportDictionaryStrings[i], 0);
+            if (g_hash_table_size(gExportDictionary[i]) > EXPORT_DICTIONARY_KEEP_MAX)
+            {
+                g_hash_table_remove_all(gExportDictionary[i]);
+            }
+        }
+        else
+        {
+            export_put32(lgHeader, gExportColumn[i]->len);
+        }
+        fwrite(lgHeader->data, 1, lgHeader->len, gpExportColumnar);
+        fwrite(gExportColumn[i]->data, 1, gExportColumn[i]->len, gpExportColumnar);
+        gullExportOffset += lgHeader->len + gExportColumn[i]->len;
+
+        // Keep the buffer's allocation for the next row group
+        g_byte_array_set_size(gExportColumn[i], 0);
+    }
+    fflush(gpExportColumnar);
+
+    gulExportRows = 0;
+    ++gulExportRowGroupNumber;
+}
+// end export_rowgroup_write
+
+
+////////////////////////////////////////////////////////////////////////////
+// Name:         export_set_format
+// Description:  Choose the export format(s): "csv", "columnar" or "both"
+//               Takes effect the next time the export is opened
+// Parameters:   paucSpec - format string
+// Return:       TRUE if the string was understood
+////////////////////////////////////////////////////////////////////////////
+gboolean
+export_set_format(char *paucSpec)
+{
+    if      (0 == strcmp(paucSpec, "csv"))      gucExportFormat = EXPORT_FORMAT_CSV;
+    else if (0 == strcmp(paucSpec, "columnar")) gucExportFormat = EXPORT_FORMAT_COLUMNAR;
+    else if (0 == strcmp(paucSpec, "both"))     gucExportFormat = EXPORT_FORMAT_CSV | EXPORT_FORMAT_COLUMNAR;
+    else return FALSE;
+
+    return TRUE;
+}
+// end export_set_format
+
+
+////////////////////////////////////////////////////////////////////////////
+// Name:         export_open
+// Description:  Create the export file(s), "<base>.csv" and/or
+//               "<base>.wsc", and write their headers
+// Parameters:   paucBaseName - file name without extension
+// Return:       TRUE if the export is open
+////////////////////////////////////////////////////////////////////////////
+gboolean
+export_open(char *paucBaseName)
+{
+    gchar *plcName;
+    GByteArray *lgHeader;
+    guint8 i;
+
+    if (gfExportEnabled) export_close();
+
+    if (gucExportFormat & EXPORT_FORMAT_CSV)
+    {
+        plcName = g_strdup_printf("%s.csv", paucBaseName);
+        gpExportCSV = fopen(plcName, "w");
+        g_free(plcName);
+        if (!gpExportCSV) return FALSE;
+
+        for (i = 0; i < EXPORT_COLUMN_COUNT; ++i)
+        {
+            fprintf(gpExportCSV, "%s%s", i ? "," : "", gsExportColumns[i].pucName);
+        }
+        fputs("\r\n", gpExportCSV);
+    }
+
+    if (gucExportFormat & EXPORT_FORMAT_COLUMNAR)
+    {
+        plcName = g_strdup_printf("%s.wsc", paucBaseName);
+        gpExportColumnar = fopen(plcName, "wb");
+        g_free(plcName);
+        if (!gpExportColumnar)
+        {
+            if (gpExportCSV) fclose(gpExportCSV);
+            gpExportCSV = NULL;
+            return FALSE;
+        }
+
+        lgHeader = g_byte_array_new();
+        g_byte_array_append(lgHeader, (guint8 *)EXPORT_MAGIC_FILE, 8);
+        export_put32(lgHeader, EXPORT_VERSION);
+        export_put32(lgHeader, EXPORT_COLUMN_COUNT);
+        for (i = 0; i < EXPORT_COLUMN_COUNT; ++i)
+        {
+            guint8 lucType   = gsExportColumns[i].lucType;
+            guint8 lucLength = strlen(gsExportColumns[i].pucName);
+
+            g_byte_array_append(lgHeader, &lucType, 1);
+            g_byte_array_append(lgHeader, &lucLength, 1);
+            g_byte_array_append(lgHeader, (guint8 *)gsExportColumns[i].pucName, lucLength);
+
+            // Column buffers are sized for a full row group up front
+            if (!gExportColumn[i])
+            {
+                gExportColumn[i] = g_byte_array_sized_new(EXPORT_ROW_GROUP_ROWS * 8);
+                gExportDictionary[i] = g_hash_table_new_full(g_str_hash, g_str_equal, NULL, g_free);
+                gExportDictionaryStrings[i] = g_ptr_array_new();
+            }
+        }
+        if (!gExportRowGroupHeader)
+        {
+            gExportRowGroupHeader  = g_byte_array_sized_new(256);
+            gExportDictionaryBytes = g_byte_array_sized_new(4096);
+        }
+        fwrite(lgHeader->data, 1, lgHeader->len, gpExportColumnar);
+        gullExportOffset = lgHeader->len;
+        g_byte_array_free(lgHeader, TRUE);
+
+        gulExportRows = 0;
+        gExportRowGroups = g_array_new(FALSE, FALSE, sizeof(ExportRowGroup));
+    }
+
+    gfExportEnabled = TRUE;
+    return TRUE;
+}
+// end export_open
+
+
+////////////////////////////////////////////////////////////////////////////
+// Name:         export_close
+// Description:  Write the last row group and the row group index, then
+//               close the export file(s)
+// Parameters:   None
+// Return:       None
+////////////////////////////////////////////////////////////////////////////
+void
+export_close(void)
+{
+    GByteArray *lgFooter;
+    guint32 i;
+
+    if (!gfExportEnabled) return;
+
+    if (gpExportCSV)
+    {
+        fclose(gpExportCSV);
+        gpExportCSV = NULL;
+    }
+
+    if (gpExportColumnar)
+    {
+        export_rowgroup_write();
+
+        lgFooter = g_byte_array_new();
+        export_put32(lgFooter, EXPORT_MAGIC_INDEX);
+        export_put32(lgFooter, gExportRowGroups->len);
+        for (i = 0; i < gExportRowGroups->len; ++i)
+        {
+            ExportRowGroup *lpsRowGroup = &g_array_index(gExportRowGroups, ExportRowGroup, i);
+            export_put64(lgFooter, lpsRowGroup->lullOffset);
+            export_put32(lgFooter, lpsRowGroup->lulRows);
+            export_put64(lgFooter, lpsRowGroup->llFirst_usec);
+            export_put64(lgFooter, lpsRowGroup->llLast_usec);
+        }
+        export_put64(lgFooter, gullExportOffset);
+        export_put32(lgFooter, EXPORT_MAGIC_END);
+        fwrite(lgFooter->data, 1, lgFooter->len, gpExportColumnar);
+        g_byte_array_free(lgFooter, TRUE);
+
+        fclose(gpExportColumnar);
+        gpExportColumnar = NULL;
+        g_array_free(gExportRowGroups, TRUE);
+        gExportRowGroups = NULL;
+    }
+
+    gfExportEnabled = FALSE;
+}
+// end export_close
+
+
+////////////////////////////////////////////////////////////////////////////
+// Name:         export_is_enabled
+// Description:  Is telemetry being exported?
+// Parameters:   None
+// Return:       TRUE if the export is open
+////////////////////////////////////////////////////////////////////////////
+gboolean
+export_is_enabled(void)
+{
+    return gfExportEnabled;
+}
+// end export_is_enabled
+
+
+////////////////////////////////////////////////////////////////////////////
+// Name:         export_record
+// Description:  Call after each parsed line - adds a row when the line
+//               reported a temperature, from the current parsed values
+//               Does nothing if the export isn't open
+// Parameters:   llTimestamp_usec - host time the line was received,
+//                                  -1 if unknown (replayed text logfile)
+//               lulFieldMask     - fields found by parse_msg()
+// Return:       None
+////////////////////////////////////////////////////////////////////////////
+void
+export_record(gint64 llTimestamp_usec, guint32 lulFieldMask)
+{
+    const ExportColumn *lpsColumn;
+    ExportDictionaryEntry *lpsEntry;
+    char *plcValue;
+    gfloat lfValue;
+    guint32 lulBits;
+    guint8 i;
+
+    if (!gfExportEnabled || !(lulFieldMask & (1UL << PARSE_FIELD_TEMPERATURE))) return;
+    if (llTimestamp_usec < 0) llTimestamp_usec = 0;
+
+    //
+    // CSV row
+    //
+    if (gpExportCSV)
+    {
+        for (i = 0; i < EXPORT_COLUMN_COUNT; ++i)
+        {
+            lpsColumn = &gsExportColumns[i];
+            if (i) fputc(',', gpExportCSV);
+            switch (lpsColumn->lcSource)
+            {
+            case EXPORT_SOURCE_HOST_TIME:
+                if (llTimestamp_usec) fprintf(gpExportCSV, "%" G_GINT64_FORMAT, llTimestamp_usec);
+                break;
+            case EXPORT_SOURCE_DEVICE_TIME:
+                if (gulDeviceCurrentTimestamp) fprintf(gpExportCSV, "%u", gulDeviceCurrentTimestamp);
+                break;
+            default:
+                plcValue = gucParseField[lpsColumn->lcSource];
+                if (EXPORT_TYPE_F32 == lpsColumn->lucType)
+                {
+                    lfValue = export_number(plcValue);
+                    if (!isnan(lfValue)) fprintf(gpExportCSV, "%g", lfValue);
+                }
+                else if (strpbrk(plcValue, ",\""))
+                {
+                    // Quote, doubling any quotes
+                    fputc('"', gpExportCSV);
+                    for (; *plcValue; ++plcValue)
+                    {
+                        if ('"' == *plcValue) fputc('"', gpExportCSV);
+                        fputc(*plcValue, gpExportCSV);
+                    }
+                    fputc('"', gpExportCSV);
+                }
+                else
+                {
+                    fputs(plcValue, gpExportCSV);
+                }
+                break;
+            }
+        }
+        fputs("\r\n", gpExportCSV);
+    }
+
+    //
+    // Columnar row
+    //
+    if (gpExportColumnar)
+    {
+        if (0 == gulExportRows)
+        {
+            gllExportFirst_usec = llTimestamp_usec;
+            gllExportRowGroupStarted_usec = g_get_monotonic_time();
+        }
+        gllExportLast_usec = llTimestamp_usec;
+
+        for (i = 0; i < EXPORT_COLUMN_COUNT; ++i)
+        {
+            lpsColumn = &gsExportColumns[i];
+            switch (lpsColumn->lucType)
+            {
+            case EXPORT_TYPE_I64:
+                export_put64(gExportColumn[i], (EXPORT_SOURCE_HOST_TIME == lpsColumn->lcSource) ?
+                                               (guint64)llTimestamp_usec : (guint64)gulDeviceCurrentTimestamp);
+                break;
+            case EXPORT_TYPE_F32:
+                lfValue = export_number(gucParseField[lpsColumn->lcSource]);
+                memcpy(&lulBits, &lfValue, 4);
+                export_put32(gExportColumn[i], lulBits);
+                break;
+            default:
+                plcValue = gucParseField[lpsColumn->lcSource];
+                lpsEntry = g_hash_table_lookup(gExportDictionary[i], plcValue);
+                if (!lpsEntry)
+                {
+                    // First time this value has been seen: keep a copy
+                    lpsEntry = g_malloc(sizeof(ExportDictionaryEntry) + strlen(plcValue) + 1);
+                    strcpy(lpsEntry->cString, plcValue);
+                    lpsEntry->ulRowGroup = 0;
+                    g_hash_table_insert(gExportDictionary[i], lpsEntry->cString, lpsEntry);
+                }
+                if (lpsEntry->ulRowGroup != gulExportRowGroupNumber)
+                {
+                    // First time in this row group: give it the next index
+                    g_ptr_array_add(gExportDictionaryStrings[i], lpsEntry->cString);
+                    lpsEntry->ulRowGroup = gulExportRowGroupNumber;
+                    lpsEntry->ulIndex    = gExportDictionaryStrings[i]->len;
+                }
+                export_put16(gExportColumn[i], lpsEntry->ulIndex - 1);
+                break;
+            }
+        }
+
+        // Row group full (or a dictionary about to overflow its u16 index)?
+        ++gulExportRows;
+        for (i = 0; i < EXPORT_COLUMN_COUNT; ++i)
+        {
+            if (gExportDictionaryStrings[i] && gExportDictionaryStrings[i]->len >= G_MAXUINT16) break;
+        }
+        if (gulExportRows >= EXPORT_ROW_GROUP_ROWS || i < EXPORT_COLUMN_COUNT) export_rowgroup_write();
+    }
+}
+// end export_record
+
+
+////////////////////////////////////////////////////////////////////////////
+// Name:         export_tick
+// Description:  Call periodically - writes out a partly filled row group
+//               once it is EXPORT_FLUSH_SEC old, so a crash or power loss
+//               costs at most that much of the columnar export
+// Parameters:   None
+// Return:       None
+////////////////////////////////////////////////////////////////////////////
+void
+export_tick(void)
+{
+    if (gpExportColumnar && gulExportRows &&
+        g_get_monotonic_time() - gllExportRowGroupStarted_usec >= (gint64)EXPORT_FLUSH_SEC*G_USEC_PER_SEC)
+    {
+        export_rowgroup_write();
+    }
+    if (gpExportCSV) fflush(gpExportCSV);
+}
+// end export_tick
+
@@ -0,0 +1,67 @@
+/*
+ * File:   export.h
+ * Author: Mark Bersalona
+ *
+ * Created on 2024.07.15
+ */
+
+#ifndef EXPORT_H
+#define EXPORT_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Definitions
+//
+///////////////////////////////////////////////////////////////////////////////
+
+// export_set_format() formats, may be combined
+#define EXPORT_FORMAT_CSV       (0x01)
+#define EXPORT_FORMAT_COLUMNAR  (0x02)
+
+// Columnar file layout (".wsc", all integers little-endian)
+//
+//   File header  "WSG30COL", u32 version, u32 column count, then per
+//                column u8 type, u8 name length, name
+//   Row groups   u32 "RGRP", u32 row count, then per column u32 chunk
+//                length and the chunk:
+//                  EXPORT_TYPE_I64   row count x i64
+//                  EXPORT_TYPE_F32   row count x IEEE float (NaN = no value)
+//                  EXPORT_TYPE_DICT  u32 dictionary size, per entry u16
+//                                    length and string, then row count x
+//                                    u16 dictionary index
+//   Footer       u32 "CIDX", u32 row group count, per row group u64 file
+//                offset, u32 row count, i64 first and i64 last host time,
+//                then u64 footer offset, u32 "CEND"
+//
+// Each row is one STATUS record: the values in effect when a temperature
+// was reported. Host time is usec since 1970, 0 if it wasn't recorded (a
+// replayed text logfile); device time is the UUT timestamp, 0 if none yet.
+#define EXPORT_VERSION     (1)
+#define EXPORT_TYPE_I64    (0)
+#define EXPORT_TYPE_F32    (1)
+#define EXPORT_TYPE_DICT   (2)
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Public routines
+//
+///////////////////////////////////////////////////////////////////////////////
+
+void export_close(void);
+gboolean export_is_enabled(void);
+gboolean export_open(char *paucBaseName);
+void export_record(gint64 llTimestamp_usec, guint32 lulFieldMask);
+gboolean export_set_format(char *paucSpec);
+void export_tick(void);
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* EXPORT_H */
+
@@ -0,0 +1,566 @@
+/*
+ * File:   fanout.c
+ * Author: Mark Bersalona
+ *
+ * Created on 2024.07.15
+ * Sensaphone WSG30 Temperature Display Diagnostic local socket fan-out
+ * (--fanout)
+ *
+ * The app holds the port exclusively, so other tools on the bench PC
+ * (a data logger, a dashboard) subscribe to a Unix-domain socket instead.
+ * Each received line, and the telemetry parsed from it, is written once
+ * into a shared byte ring; every subscriber has its own cursor into the
+ * ring, and the publisher thread sends straight from the ring to each
+ * socket, so there is no per-subscriber copy or queue.
+ *
+ *   producer  - fanout_line(), on whichever thread parses (the main
+ *               loop, or the --pipeline parser): formats the record,
+ *               copies it in and moves the head. Never waits: the ring
+ *               is overwritten regardless of the subscribers
+ *   publisher - one thread, poll() on the listening socket and all the
+ *               subscribers; non-blocking sends, a subscriber whose
+ *               socket is full is only polled for room
+ *
+ * A subscriber that falls more than half the ring behind is skipped
+ * ahead to the newest line with a "# lagged" notice, or disconnected with
+ * --fanout-slow=drop. Either way the producer never sees it.
+ */
+
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Includes
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#define _GNU_SOURCE
+#include <glib.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <sys/un.h>
+#include "gconfig.h"
+#include "metrics.h"
+#include "parse.h"
+#include "fanout.h"
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Definitions
+//
+///////////////////////////////////////////////////////////////////////////////
+
+// Longest record: time, type, the raw line or every field
+#define FANOUT_RECORD_MAX   (RECEIVE_FIFO_MSG_LENGTH_MAX + PARSE_FIELD_TOTAL * (PARSE_FIELD_LENGTH_MAX + 24) + 32)
+
+// Records are only overwritten a full ring after they're written, and a
+// subscriber is caught up with at half, so the ring must hold a few
+#if (FANOUT_RING_BYTES & (FANOUT_RING_BYTES - 1)) || FANOUT_RING_BYTES < 8 * FANOUT_RECORD_MAX
+#error "FANOUT_RING_BYTES must be a power of 2 of at least 8 records"
+#endif
+
+typedef struct
+{
+    int      iFd;                       // -1 = slot free
+    guint64  ullCursor;                 // next ring position to send
+    gboolean fIsBlocked;                // socket full, wait for POLLOUT
+    gboolean fIsMidRecord;              // last byte sent wasn't the LF
+    char     cNotice[64];               // greeting or lag notice, sent first
+    guint32  ulNoticeBytes;
+    guint32  ulNoticeSent;
+} FanoutSubscriber;
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Variables and tables
+//
+///////////////////////////////////////////////////////////////////////////////
+
+static gboolean gfFanoutRunning = FALSE;
+static guint8   gucFanoutSlow = FANOUT_SLOW_LAG;
+static char     gucFanoutPath[sizeof(((struct sockaddr_un *)0)->sun_path)];
+static int      giFanoutListenFd = -1;
+static int      giFanoutWakeFd[2] = { -1, -1 };
+static GThread *gpFanoutThread = NULL;
+static gint     giFanoutStop = 0;
+
+// Ring: written by the producer only; ullHead (bytes ever written) is
+// published after the record is in
+static char    *gpcFanoutRing = NULL;
+static guint64  gullFanoutHead = 0;
+static gint     giFanoutSleeping = 0;   // publisher is in poll(), wake it
+static char     gucFanoutRecord[FANOUT_RECORD_MAX];
+
+// Publisher thread only
+static FanoutSubscriber gsFanoutSubscriber[FANOUT_SUBSCRIBERS_MAX];
+static struct pollfd    gsFanoutPoll[FANOUT_SUBSCRIBERS_MAX + 2];
+static guint8           gucFanoutPollSlot[FANOUT_SUBSCRIBERS_MAX + 2];
+
+// Statistics, read by fanout_report()
+static guint32 gulFanoutSubscribers = 0;
+static guint32 gulFanoutSubscribersMost = 0;
+static guint64 gullFanoutConnected = 0;
+static guint64 gullFanoutRefused = 0;
+static guint64 gullFanoutLagged = 0;
+static guint64 gullFanoutDropped = 0;
+
+
+////////////////////////////////////////////////////////////////////////////
+// Name:         fanout_wake
+// Description:  Producer: wake the publisher if it's sleeping in poll()
+//               (one byte per sleep, so a busy stream costs no syscalls)
+// Parameters:   None
+// Return:       None
+////////////////////////////////////////////////////////////////////////////
+static void
+fanout_wake(void)
+{
+    if (__atomic_exchange_n(&giFanoutSleeping, 0, __ATOMIC_SEQ_CST))
+    {
+        if (write(giFanoutWakeFd[1], "", 1) < 0) { /* pipe full: it's awake */ }
+    }
+}
+// end fanout_wake
+
+
+////////////////////////////////////////////////////////////////////////////
+// Name:         fanout_subscriber_close
+// Description:  Disconnect a subscriber and free its slot
+// Parameters:   pasSubscriber - subscriber
+//               lfIsDropped   - TRUE if it's dropped for being slow
+// Return:       None
+////////////////////////////////////////////////////////////////////////////
+static void
+fanout_subscriber_close(FanoutSubscriber *pasSubscriber, gboolean lfIsDropped)
+{
+    close(pasSubscriber->iFd);
+    pasSubscriber->iFd = -1;
+    __atomic_sub_fetch(&gulFanoutSubscribers, 1, __ATOMIC_RELAXED);
+    metrics_gauge(METRICS_FANOUT_SUBSCRIBERS, __atomic_load_n(&gulFanoutSubscribers, __ATOMIC_RELAXED));
+    if (lfIsDropped)
+    {
+        __atomic_add_fetch(&gullFanoutDropped, 1, __ATOMIC_RELAXED);
+        metrics_add(METRICS_FANOUT_DROPPED, 1);
+    }
+}
+// end fanout_subscriber_close
+
+
+////////////////////////////////////////////////////////////////////////////
+// Name:         fanout_accept
+// Description:  Take the waiting connections; each starts at the newest
+//               line, with the greeting
+// Parameters:   lullHead - current ring head
+// Return:       None
+////////////////////////////////////////////////////////////////////////////
+static void
+fanout_accept(guint64 lullHead)
+{
+    FanoutSubscriber *plsSubscriber;
+    guint32 lulSlot;
+    guint32 lulCount;
+    int liFd;
+
+    while ((liFd = accept4(giFanoutListenFd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC)) >= 0)
+    {
+        for (lulSlot = 0; lulSlot < FANOUT_SUBSCRIBERS_MAX && gsFanoutSubscriber[lulSlot].iFd >= 0; ++lulSlot) ;
+        if (lulSlot == FANOUT_SUBSCRIBERS_MAX)
+        {
+            close(liFd);
+            __atomic_add_fetch(&gullFanoutRefused, 1, __ATOMIC_RELAXED);
+            continue;
+        }
+        plsSubscriber = &gsFanoutSubscriber[lulSlot];
+        plsSubscriber->iFd          = liFd;
+        plsSubscriber->ullCursor    = lullHead;
+        plsSubscriber->fIsBlocked   = FALSE;
+        plsSubscriber->fIsMidRecord = FALSE;
+        plsSubscriber->ulNoticeBytes = snprintf(plsSubscriber->cNotice, sizeof(plsSubscriber->cNotice),
+                                                "# WSG30 fan-out %d\n", FANOUT_VERSION);
+        plsSubscriber->ulNoticeSent = 0;
+        __atomic_add_fetch(&gullFanoutConnected, 1, __ATOMIC_RELAXED);
+        lulCount = __atomic_add_fetch(&gulFanoutSubscribers, 1, __ATOMIC_RELAXED);
+        if (lulCount > __atomic_load_n(&gulFanoutSubscribersMost, __ATOMIC_RELAXED))
+        {
+            __atomic_store_n(&gulFanoutSubscribersMost, lulCount, __ATOMIC_RELAXED);
+        }
+        metrics_gauge(METRICS_FANOUT_SUBSCRIBERS, lulCount);
+    }
+}
+// end fanout_accept
+
+
+////////////////////////////////////////////////////////////////////////////
+// Name:         fanout_send
+// Description:  Send a subscriber what it hasn't had, straight from the
+//               ring, until it's caught up or its socket is full
+// Parameters:   pasSubscriber - subscriber
+//               lullHead      - ring head
+// Return:       None
+////////////////////////////////////////////////////////////////////////////
+static void
+fanout_send(FanoutSubscriber *pasSubscriber, guint64 lullHead)
+{
+    struct iovec lsIov[2];
+    struct msghdr lsMsg;
+    guint32 lulOffset;
+    guint64 lullLength;
+    ssize_t llSent;
+    char lcLast;
+
+    // Too far behind: catch up, or give up on it
+    if (lullHead - pasSubscriber->ullCursor > FANOUT_RING_BYTES / 2)
+    {
+        if (FANOUT_SLOW_DROP == gucFanoutSlow)
+        {
+            fanout_subscriber_close(pasSubscriber, TRUE);
+            return;
+        }
+        pasSubscriber->ulNoticeBytes = snprintf(pasSubscriber->cNotice, sizeof(pasSubscriber->cNotice),
+                                                "%s# lagged, %" G_GUINT64_FORMAT " bytes skipped\n",
+                                                pasSubscriber->fIsMidRecord ? "\n" : "",
+                                                (guint64)(lullHead - pasSubscriber->ullCursor));
+        pasSubscriber->ulNoticeSent = 0;
+        pasSubscriber->ullCursor    = lullHead;
+        pasSubscriber->fIsMidRecord = FALSE;
+        __atomic_add_fetch(&gullFanoutLagged, 1, __ATOMIC_RELAXED);
+        metrics_add(METRICS_FANOUT_LAGGED, 1);
+    }
+
+    while (pasSubscriber->ulNoticeSent < pasSubscriber->ulNoticeBytes)
+    {
+        llSent = send(pasSubscriber->iFd, pasSubscriber->cNotice + pasSubscriber->ulNoticeSent,
+                      pasSubscriber->ulNoticeBytes - pasSubscriber->ulNoticeSent, MSG_DONTWAIT | MSG_NOSIGNAL);
+        if (llSent < 0 && EINTR == errno) continue;
+        if (llSent < 0 && (EAGAIN == errno || EWOULDBLOCK == errno))
+        {
+            pasSubscriber->fIsBlocked = TRUE;
+            return;
+        }
+        if (llSent <= 0)
+        {
+            fanout_subscriber_close(pasSubscriber, FALSE);
+            return;
+        }
+        pasSubscriber->ulNoticeSent += llSent;
+    }
+
+    while (pasSubscriber->ullCursor != lullHead)
+    {
+        lulOffset  = pasSubscriber->ullCursor & (FANOUT_RING_BYTES - 1);
+        lullLength = lullHead - pasSubscriber->ullCursor;
+        lsIov[0].iov_base = gpcFanoutRing + lulOffset;
+        lsIov[0].iov_len  = MIN(lullLength, FANOUT_RING_BYTES - lulOffset);
+        lsIov[1].iov_base = gpcFanoutRing;
+        lsIov[1].iov_len  = lullLength - lsIov[0].iov_len;
+        memset(&lsMsg, 0, sizeof(lsMsg));
+        lsMsg.msg_iov    = lsIov;
+        lsMsg.msg_iovlen = lsIov[1].iov_len ? 2 : 1;
+        llSent = sendmsg(pasSubscriber->iFd, &lsMsg, MSG_DONTWAIT | MSG_NOSIGNAL);
+        if (llSent < 0 && EINTR == errno) continue;
+        if (llSent < 0 && (EAGAIN == errno || EWOULDBLOCK == errno))
+        {
+            pasSubscriber->fIsBlocked = TRUE;
+            return;
+        }
+        if (llSent <= 0)
+        {
+            fanout_subscriber_close(pasSubscriber, FALSE);
+            return;
+        }
+
+        // The producer may be writing up to a record past the head it
+        // published; if that reached what was just sent, the subscriber
+        // got a torn record and can't be trusted to resync
+        lcLast = gpcFanoutRing[(pasSubscriber->ullCursor + llSent - 1) & (FANOUT_RING_BYTES - 1)];
+        __atomic_thread_fence(__ATOMIC_SEQ_CST);
+        if (__atomic_load_n(&gullFanoutHead, __ATOMIC_ACQUIRE) + FANOUT_RECORD_MAX - pasSubscriber->ullCursor > FANOUT_RING_BYTES)
+        {
+            fanout_subscriber_close(pasSubscriber, TRUE);
+            return;
+        }
+        pasSubscriber->ullCursor   += llSent;
+        pasSubscriber->fIsMidRecord = ('\n' != lcLast);
+    }
+}
+// end fanout_send
+
+
+////////////////////////////////////////////////////////////////////////////
+// Name:         fanout_thread
+// Description:  Publisher thread - accept subscribers and keep each one
+//               sent up to the head, until fanout_close()
+// Parameters:   data - unused
+// Return:       NULL
+////////////////////////////////////////////////////////////////////////////
+static gpointer
+fanout_thread(gpointer data)
+{
+    FanoutSubscriber *plsSubscriber;
+    guint64 lullHead;
+    guint32 lulSlot;
+    guint32 lulPolled;
+    guint32 lulIndex;
+    char lcDiscard[256];
+    ssize_t llBytes;
+    int liTimeout_msec;
+
+    while (!__atomic_load_n(&giFanoutStop, __ATOMIC_ACQUIRE))
+    {
+        lullHead = __atomic_load_n(&gullFanoutHead, __ATOMIC_ACQUIRE);
+        for (lulSlot = 0; lulSlot < FANOUT_SUBSCRIBERS_MAX; ++lulSlot)
+        {
+            plsSubscriber = &gsFanoutSubscriber[lulSlot];
+            if (plsSubscriber->iFd >= 0 && !plsSubscriber->fIsBlocked) fanout_send(plsSubscriber, lullHead);
+        }
+
+        // Poll the wake pipe, the listener, and every subscriber for
+        // hang-ups (and, if its socket was full, for room)
+        gsFanoutPoll[0].fd     = giFanoutWakeFd[0];
+        gsFanoutPoll[0].events = POLLIN;
+        gsFanoutPoll[1].fd     = giFanoutListenFd;
+        gsFanoutPoll[1].events = POLLIN;
+        lulPolled = 2;
+        for (lulSlot = 0; lulSlot < FANOUT_SUBSCRIBERS_MAX; ++lulSlot)
+        {
+            plsSubscriber = &gsFanoutSubscriber[lulSlot];
+            if (plsSubscriber->iFd < 0) continue;
+            gsFanoutPoll[lulPolled].fd     = plsSubscriber->iFd;
+            gsFanoutPoll[lulPolled].events = POLLIN | (plsSubscriber->fIsBlocked ? POLLOUT : 0);
+            gucFanoutPollSlot[lulPolled]   = lulSlot;
+            ++lulPolled;
+        }
+
+        // Announce the sleep, then look again, so a line published in
+        // between isn't left until the timeout
+        __atomic_store_n(&giFanoutSleeping, 1, __ATOMIC_SEQ_CST);
+        liTimeout_msec = (lullHead == __atomic_load_n(&gullFanoutHead, __ATOMIC_SEQ_CST)) ? FANOUT_WAIT_MSEC : 0;
+        if (poll(gsFanoutPoll, lulPolled, liTimeout_msec) < 0 && EINTR != errno) break;
+        __atomic_store_n(&giFanoutSleeping, 0, __ATOMIC_SEQ_CST);
+
+        if (gsFanoutPoll[0].revents & POLLIN)
+        {
+            while (read(giFanoutWakeFd[0], lcDiscard, sizeof(lcDiscard)) > 0) ;
+        }
+        if (gsFanoutPoll[1].revents & POLLIN)
+        {
+            fanout_accept(__atomic_load_n(&gullFanoutHead, __ATOMIC_ACQUIRE));
+        }
+        for (lulIndex = 2; lulIndex < lulPolled; ++lulIndex)
+        {
+            plsSubscriber = &gsFanoutSubscriber[gucFanoutPollSlot[lulIndex]];
+            if (gsFanoutPoll[lulIndex].revents & POLLIN)
+            {
+                llBytes = recv(plsSubscriber->iFd, lcDiscard, sizeof(lcDiscard), MSG_DONTWAIT);
+                if (0 == llBytes || (llBytes < 0 && EAGAIN != errno && EWOULDBLOCK != errno && EINTR != errno))
+                {
+                    fanout_subscriber_close(plsSubscriber, FALSE);
+                    continue;
+                }
+            }
+            if (gsFanoutPoll[lulIndex].revents & (POLLERR | POLLHUP | POLLNVAL))
+            {
+                fanout_subscriber_close(plsSubscriber, FALSE);
+                continue;
+            }
+            if (gsFanoutPoll[lulIndex].revents & POLLOUT) plsSubscriber->fIsBlocked = FALSE;
+        }
+    }
+
+    for (lulSlot = 0; lulSlot < FANOUT_SUBSCRIBERS_MAX; ++lulSlot)
+    {
+        if (gsFanoutSubscriber[lulSlot].iFd >= 0) fanout_subscriber_close(&gsFanoutSubscriber[lulSlot], FALSE);
+    }
+    return NULL;
+}
+// end fanout_thread
+
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Public routines
+//
+///////////////////////////////////////////////////////////////////////////////
+
+////////////////////////////////////////////////////////////////////////////
+// Name:         fanout_set_slow
+// Description:  Set what happens to a subscriber that falls too far
+//               behind (--fanout-slow)
+// Parameters:   paucPolicy - "lag" (skip it ahead to the newest line) or
+//                            "drop" (disconnect it)
+// Return:       TRUE if the policy was recognized
+////////////////////////////////////////////////////////////////////////////
+gboolean
+fanout_set_slow(char *paucPolicy)
+{
+    if (0 == strcmp(paucPolicy, "lag"))       gucFanoutSlow = FANOUT_SLOW_LAG;
+    else if (0 == strcmp(paucPolicy, "drop")) gucFanoutSlow = FANOUT_SLOW_DROP;
+    else return FALSE;
+    return TRUE;
+}
+// end fanout_set_slow
+
+
+////////////////////////////////////////////////////////////////////////////
+// Name:         fanout_open
+// Description:  Listen on a Unix-domain socket and start the publisher
+//               thread; a socket left behind by an earlier run is removed
+// Parameters:   paucPath - socket path
+// Return:       TRUE if listening
+////////////////////////////////////////////////////////////////////////////
+gboolean
+fanout_open(char *paucPath)
+{
+    struct sockaddr_un lsAddress;
+    struct stat lsStat;
+    guint32 lulSlot;
+
+    if (gfFanoutRunning) return TRUE;
+    if (strlen(paucPath) >= sizeof(lsAddress.sun_path)) return FALSE;
+    if (0 == lstat(paucPath, &lsStat) && S_ISSOCK(lsStat.st_mode)) unlink(paucPath);
+
+    giFanoutListenFd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (giFanoutListenFd < 0) return FALSE;
+    memset(&lsAddress, 0, sizeof(lsAddress));
+    lsAddress.sun_family = AF_UNIX;
+    g_strlcpy(lsAddress.sun_path, paucPath, sizeof(lsAddress.sun_path));
+    if (bind(giFanoutListenFd, (struct sockaddr *)&lsAddress, sizeof(lsAddress)) < 0 ||
+        listen(giFanoutListenFd, FANOUT_SUBSCRIBERS_MAX) < 0 ||
+        pipe2(giFanoutWakeFd, O_NONBLOCK | O_CLOEXEC) < 0)
+    {
+        close(giFanoutListenFd);
+        giFanoutListenFd = -1;
+        return FALSE;
+    }
+    g_strlcpy(gucFanoutPath, paucPath, sizeof(gucFanoutPath));
+
+    gpcFanoutRing = g_malloc(FANOUT_RING_BYTES);
+    for (lulSlot = 0; lulSlot < FANOUT_SUBSCRIBERS_MAX; ++lulSlot) gsFanoutSubscriber[lulSlot].iFd = -1;
+    metrics_gauge_capacity(METRICS_FANOUT_SUBSCRIBERS, FANOUT_SUBSCRIBERS_MAX);
+    __atomic_store_n(&giFanoutStop, 0, __ATOMIC_RELEASE);
+    gpFanoutThread = g_thread_new("fanout", fanout_thread, NULL);
+    __atomic_store_n(&gfFanoutRunning, TRUE, __ATOMIC_RELEASE);
+    return TRUE;
+}
+// end fanout_open
+
+
+////////////////////////////////////////////////////////////////////////////
+// Name:         fanout_close
+// Description:  Disconnect the subscribers, stop the publisher thread and
+//               remove the socket
+// Parameters:   None
+// Return:       None
+////////////////////////////////////////////////////////////////////////////
+void
+fanout_close(void)
+{
+    if (!gfFanoutRunning) return;
+    __atomic_store_n(&gfFanoutRunning, FALSE, __ATOMIC_RELEASE);
+    __atomic_store_n(&giFanoutStop, 1, __ATOMIC_RELEASE);
+    __atomic_store_n(&giFanoutSleeping, 1, __ATOMIC_SEQ_CST);
+    fanout_wake();
+    g_thread_join(gpFanoutThread);
+    gpFanoutThread = NULL;
+
+    close(giFanoutListenFd);
+    close(giFanoutWakeFd[0]);
+    close(giFanoutWakeFd[1]);
+    giFanoutListenFd = giFanoutWakeFd[0] = giFanoutWakeFd[1] = -1;
+    unlink(gucFanoutPath);
+    g_free(gpcFanoutRing);
+    gpcFanoutRing = NULL;
+}
+// end fanout_close
+
+
+////////////////////////////////////////////////////////////////////////////
+// Name:         fanout_is_enabled
+// Description:  Is the fan-out socket open?
+// Parameters:   None
+// Return:       TRUE if --fanout is running
+////////////////////////////////////////////////////////////////////////////
+gboolean
+fanout_is_enabled(void)
+{
+    return __atomic_load_n(&gfFanoutRunning, __ATOMIC_ACQUIRE);
+}
+// end fanout_is_enabled
+
+
+////////////////////////////////////////////////////////////////////////////
+// Name:         fanout_line
+// Description:  Publish a received line, and the fields parsed from it,
+//               to the subscribers (call from the thread that parses,
+//               after parse_msg())
+// Parameters:   llReceived_usec - host time the line was received
+//               paucLine        - NULL-terminated line
+//               lulFieldMask    - parse_msg() result, fields the line set
+// Return:       None
+////////////////////////////////////////////////////////////////////////////
+void
+fanout_line(gint64 llReceived_usec, char *paucLine, guint32 lulFieldMask)
+{
+    guint64 lullHead;
+    guint32 lulUsed;
+    guint32 lulOffset;
+    guint32 lulFirst;
+    guint8  lucField;
+
+    if (!__atomic_load_n(&gfFanoutRunning, __ATOMIC_ACQUIRE)) return;
+
+    // Raw line, cut at any CR/LF so it stays one record
+    lulUsed = snprintf(gucFanoutRecord, sizeof(gucFanoutRecord), "%" G_GINT64_FORMAT "\tL\t%.*s\n", llReceived_usec,
+                       (int)MIN(strcspn(paucLine, "\r\n"), RECEIVE_FIFO_MSG_LENGTH_MAX), paucLine);
+    if (lulFieldMask)
+    {
+        lulUsed += snprintf(gucFanoutRecord + lulUsed, sizeof(gucFanoutRecord) - lulUsed, "%" G_GINT64_FORMAT "\tT", llReceived_usec);
+        for (lucField = 0; lucField < PARSE_FIELD_TOTAL; ++lucField)
+        {
+            if (!(lulFieldMask & (1UL << lucField))) continue;
+            lulUsed += snprintf(gucFanoutRecord + lulUsed, sizeof(gucFanoutRecord) - lulUsed, "\t%s=%s",
+                                parse_field_name(lucField), gucParseField[lucField]);
+        }
+        lulUsed += snprintf(gucFanoutRecord + lulUsed, sizeof(gucFanoutRecord) - lulUsed, "\n");
+    }
+
+    lullHead  = gullFanoutHead;
+    lulOffset = lullHead & (FANOUT_RING_BYTES - 1);
+    lulFirst  = MIN(lulUsed, FANOUT_RING_BYTES - lulOffset);
+    memcpy(gpcFanoutRing + lulOffset, gucFanoutRecord, lulFirst);
+    memcpy(gpcFanoutRing, gucFanoutRecord + lulFirst, lulUsed - lulFirst);
+    __atomic_store_n(&gullFanoutHead, lullHead + lulUsed, __ATOMIC_SEQ_CST);
+    fanout_wake();
+}
+// end fanout_line
+
+
+////////////////////////////////////////////////////////////////////////////
+// Name:         fanout_report
+// Description:  Format the fan-out statistics for Status
+// Parameters:   paucReport - buffer for the report, CRLF terminated
+//               lulSize    - size of buffer
+// Return:       None
+////////////////////////////////////////////////////////////////////////////
+void
+fanout_report(char *paucReport, guint32 lulSize)
+{
+    snprintf(paucReport, lulSize,
+             "Fan-out %s: %u subscribers (most %u of %d), %lu connected, %lu refused, "
+             "%lu lagged, %lu dropped, %.1f MB published\r\n",
+             gucFanoutPath,
+             __atomic_load_n(&gulFanoutSubscribers, __ATOMIC_RELAXED),
+             __atomic_load_n(&gulFanoutSubscribersMost, __ATOMIC_RELAXED), FANOUT_SUBSCRIBERS_MAX,
+             (unsigned long)__atomic_load_n(&gullFanoutConnected, __ATOMIC_RELAXED),
+             (unsigned long)__atomic_load_n(&gullFanoutRefused, __ATOMIC_RELAXED),
+             (unsigned long)__atomic_load_n(&gullFanoutLagged, __ATOMIC_RELAXED),
+             (unsigned long)__atomic_load_n(&gullFanoutDropped, __ATOMIC_RELAXED),
+             __atomic_load_n(&gullFanoutHead, __ATOMIC_RELAXED) / (1024.0*1024.0));
+}
+// end fanout_report
@@ -0,0 +1,58 @@
+/*
+ * File:   fanout.h
+ * Author: Mark Bersalona
+ *
+ * Created on 2024.07.15
+ */
+
+#ifndef FANOUT_H
+#define FANOUT_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Definitions
+//
+///////////////////////////////////////////////////////////////////////////////
+
+// What a subscriber reads from the socket: text lines, LF terminated,
+// fields separated by tabs
+//
+//   Greeting   "# WSG30 fan-out 1", sent once on connect
+//   Raw line   host time (usec since 1970), "L", the line as received
+//   Telemetry  host time, "T", then "Name=value" for each field the line
+//              set (names as parse_field_name()), only if it set any
+//   Lag        "# lagged, N bytes skipped": the subscriber fell too far
+//              behind and resumes at the newest line (--fanout-slow=lag)
+//
+// A subscriber starts at the newest line; nothing is replayed. What it
+// writes to the socket is read and ignored.
+#define FANOUT_VERSION       (1)
+
+// --fanout-slow policies
+#define FANOUT_SLOW_LAG      (0)
+#define FANOUT_SLOW_DROP     (1)
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Public routines
+//
+///////////////////////////////////////////////////////////////////////////////
+
+void fanout_close(void);
+gboolean fanout_is_enabled(void);
+void fanout_line(gint64 llReceived_usec, char *paucLine, guint32 lulFieldMask);
+gboolean fanout_open(char *paucPath);
+void fanout_report(char *paucReport, guint32 lulSize);
+gboolean fanout_set_slow(char *paucPolicy);
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* FANOUT_H */
+
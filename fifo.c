@@ -0,0 +1,388 @@
+/*
+ * File:   fifo.c
+ * Author: Mark Bersalona
+ *
+ * Created on 2024.07.15
+ * Sensaphone WSG30 Temperature Display Diagnostic receive message FIFO
+ *
+ * The FIFO sizes itself to the bursts it sees, between the fifo-lines-min
+ * and fifo-lines-max budgets. A write that leaves an eighth or less of it
+ * free doubles it (up to the most), waiting lines and all, so a long menu
+ * dump isn't lost. Each burst - lines queued from empty until the FIFO is
+ * next empty - is counted in a histogram by its peak depth; once the
+ * high-water has stayed under a quarter of the size for
+ * RECEIVE_FIFO_SHRINK_SEC, fifo_tick() shrinks it to four times that
+ * high-water (at least the least), and the memory is freed.
+ */
+
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Includes
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include <glib.h>
+#include <stdio.h>
+#include <string.h>
+#include "gconfig.h"
+#include "fifo.h"
+#include "metrics.h"
+#include "trace.h"
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Definitions
+//
+///////////////////////////////////////////////////////////////////////////////
+
+// Burst histogram buckets: bucket N counts bursts peaking at 2^(N-1)..2^N-1
+// lines deep
+#define FIFO_BURST_BUCKETS  (17)
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Variables and tables
+//
+///////////////////////////////////////////////////////////////////////////////
+
+// Receive message FIFO, allocated by fifo_initialize()
+// gulReceiveFIFOCount entries of gulReceiveFIFOLength bytes each
+char    *gpcReceiveFIFO = NULL;
+guint32  gulReceiveFIFOCount;
+guint32  gulReceiveFIFOLength;
+guint16  guiReceiveFIFOWriteIndex;
+guint16  guiReceiveFIFOReadIndex;
+guint64 *gpullReceiveFIFOWrite_ns = NULL;   // trace_start() when written
+guint32  gulReceiveFIFOLongest;             // longest message written, bytes
+
+// Size bounds, fifo_set_bounds()
+static guint32 gulFifoCountMin = RECEIVE_FIFO_LINES_MIN;
+static guint32 gulFifoCountMax = RECEIVE_FIFO_LINES_MAX;
+
+// Burst statistics
+static guint16 guiFifoBurstPeak;            // deepest in the current burst
+static guint16 guiFifoTickHighWater;        // deepest since the last fifo_tick()
+static guint16 guiFifoQuietHighWater;       // deepest while quiet
+static guint32 gulFifoQuiet_sec;            // seconds under a quarter full
+static guint16 guiFifoHighWater;            // deepest ever
+static guint32 gulFifoBurstCount[FIFO_BURST_BUCKETS];
+static guint32 gulFifoGrown;
+static guint32 gulFifoShrunk;
+static guint32 gulFifoDropped;              // lines lost to a full FIFO
+
+
+////////////////////////////////////////////////////////////////////////////
+// Name:         fifo_resize
+// Description:  Reallocate the receive FIFO, keeping the waiting lines in
+//               order; the old FIFO is freed
+// Parameters:   lulCount - number of entries, more than are waiting
+// Return:       None
+////////////////////////////////////////////////////////////////////////////
+static void
+fifo_resize(guint32 lulCount)
+{
+    guint16  luiWaiting = fifo_count();
+    guint16  luiEntry;
+    guint16  luiFrom = guiReceiveFIFOReadIndex;
+    char    *plcFIFO;
+    guint64 *pllWrite_ns;
+
+    plcFIFO     = g_malloc((gsize)lulCount * gulReceiveFIFOLength);
+    pllWrite_ns = g_malloc(lulCount * sizeof(guint64));
+    for (luiEntry = 0; luiEntry < luiWaiting; ++luiEntry)
+    {
+        strcpy(&plcFIFO[(gsize)luiEntry * gulReceiveFIFOLength],
+               &gpcReceiveFIFO[(gsize)luiFrom * gulReceiveFIFOLength]);
+        pllWrite_ns[luiEntry] = gpullReceiveFIFOWrite_ns[luiFrom];
+        if (++luiFrom >= gulReceiveFIFOCount) luiFrom = 0;
+    }
+    g_free(gpcReceiveFIFO);
+    g_free(gpullReceiveFIFOWrite_ns);
+    gpcReceiveFIFO           = plcFIFO;
+    gpullReceiveFIFOWrite_ns = pllWrite_ns;
+    gulReceiveFIFOCount      = lulCount;
+    guiReceiveFIFOReadIndex  = 0;
+    guiReceiveFIFOWriteIndex = luiWaiting;
+    metrics_gauge_capacity(METRICS_FIFO_DEPTH, gulReceiveFIFOCount);
+}
+// end fifo_resize
+
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Public routines
+//
+///////////////////////////////////////////////////////////////////////////////
+
+////////////////////////////////////////////////////////////////////////////
+// Name:         fifo_initialize
+// Description:  Allocate the receive FIFO (empty); any previous FIFO and
+//               its contents are freed. The size bounds are widened to
+//               take in lulCount if need be
+//               Call before the first fifo_write()
+// Parameters:   lulCount  - number of entries, 2..65535
+//               lulLength - bytes per entry, including the NULL
+// Return:       None
+////////////////////////////////////////////////////////////////////////////
+void
+fifo_initialize(guint32 lulCount, guint32 lulLength)
+{
+    g_free(gpcReceiveFIFO);
+    g_free(gpullReceiveFIFOWrite_ns);
+    gulReceiveFIFOCount      = CLAMP(lulCount, 2, G_MAXUINT16);
+    gulReceiveFIFOLength     = MAX(lulLength, 2);
+    gpcReceiveFIFO           = g_malloc0((gsize)gulReceiveFIFOCount * gulReceiveFIFOLength);
+    gpullReceiveFIFOWrite_ns = g_malloc0(gulReceiveFIFOCount * sizeof(guint64));
+    guiReceiveFIFOWriteIndex = 0;
+    guiReceiveFIFOReadIndex  = 0;
+    gulReceiveFIFOLongest    = 0;
+    gulFifoCountMin          = MIN(gulFifoCountMin, gulReceiveFIFOCount);
+    gulFifoCountMax          = MAX(gulFifoCountMax, gulReceiveFIFOCount);
+    metrics_gauge_capacity(METRICS_FIFO_DEPTH, gulReceiveFIFOCount);
+}
+// end fifo_initialize
+
+
+////////////////////////////////////////////////////////////////////////////
+// Name:         fifo_set_bounds
+// Description:  Set the least and most entries the FIFO is resized to;
+//               the same for both fixes its size. Call before
+//               fifo_initialize()
+// Parameters:   lulMin - least entries, 2..65535
+//               lulMax - most entries, lulMin..65535
+// Return:       None
+////////////////////////////////////////////////////////////////////////////
+void
+fifo_set_bounds(guint32 lulMin, guint32 lulMax)
+{
+    gulFifoCountMin = CLAMP(lulMin, 2, G_MAXUINT16);
+    gulFifoCountMax = CLAMP(lulMax, gulFifoCountMin, G_MAXUINT16);
+}
+// end fifo_set_bounds
+
+
+////////////////////////////////////////////////////////////////////////////
+// Name:         fifo_memory
+// Description:  Memory footprint of the receive FIFO
+// Parameters:   palReserved - set to bytes allocated
+//               palUsed     - set to bytes holding waiting messages,
+//                             counting each as the longest message seen
+// Return:       None
+////////////////////////////////////////////////////////////////////////////
+void
+fifo_memory(guint32 *palReserved, guint32 *palUsed)
+{
+    *palReserved = gulReceiveFIFOCount * (gulReceiveFIFOLength + sizeof(guint64));
+    *palUsed     = fifo_count() * (gulReceiveFIFOLongest + sizeof(guint64));
+}
+// end fifo_memory
+
+
+////////////////////////////////////////////////////////////////////////////
+// Name:         fifo_size
+// Description:  Current size of the receive FIFO
+// Parameters:   None
+// Return:       Number of entries
+////////////////////////////////////////////////////////////////////////////
+guint32
+fifo_size(void)
+{
+    return gulReceiveFIFOCount;
+}
+// end fifo_size
+
+
+////////////////////////////////////////////////////////////////////////////
+// Name:         fifo_count
+// Description:  Number of received strings waiting in the FIFO
+// Parameters:   None
+// Return:       Count of FIFO entries in use
+////////////////////////////////////////////////////////////////////////////
+guint16
+fifo_count(void)
+{
+    int liFIFOCount = guiReceiveFIFOWriteIndex - guiReceiveFIFOReadIndex;
+    if (liFIFOCount < 0) liFIFOCount += gulReceiveFIFOCount;
+    return (guint16)liFIFOCount;
+}
+// end fifo_count
+
+
+////////////////////////////////////////////////////////////////////////////
+// Name:         fifo_read
+// Description:  Read a received string from the receive FIFO
+// Parameters:   None
+// Return:       Pointer to received string, or NULL if no more strings
+//               are available from the FIFO; valid until the next
+//               fifo_write() or fifo_tick()
+////////////////////////////////////////////////////////////////////////////
+char *
+fifo_read(void)
+{
+    char *plcReturnPointer;
+    guint16 luiFIFOCount;
+
+    if (guiReceiveFIFOReadIndex == guiReceiveFIFOWriteIndex)
+    {
+        // Read and write FIFO pointers are the same, no more receive strings available
+        plcReturnPointer = NULL;
+    }
+    else
+    {
+        // Return the next available received string off the FIFO,
+        // then point to the next received string
+        plcReturnPointer = &gpcReceiveFIFO[(gsize)guiReceiveFIFOReadIndex * gulReceiveFIFOLength];
+        trace_line_dequeued();
+        trace_end(TRACE_FIFO_WAIT, gpullReceiveFIFOWrite_ns[guiReceiveFIFOReadIndex]);
+        if (++guiReceiveFIFOReadIndex >= gulReceiveFIFOCount) guiReceiveFIFOReadIndex = 0;
+        luiFIFOCount = fifo_count();
+        metrics_gauge(METRICS_FIFO_DEPTH, luiFIFOCount);
+
+        // Emptied: that's the end of a burst
+        if (0 == luiFIFOCount)
+        {
+            ++gulFifoBurstCount[g_bit_storage(guiFifoBurstPeak)];
+            guiFifoBurstPeak = 0;
+        }
+    }
+    return plcReturnPointer;
+}
+// end fifo_read
+
+
+////////////////////////////////////////////////////////////////////////////
+// Name:         fifo_report
+// Description:  Format the receive FIFO's size and burst statistics for
+//               Status: current size and bounds, high-water, times grown
+//               and shrunk, lines dropped, and bursts by peak depth
+// Parameters:   paucReport - buffer for the report, CRLF terminated
+//               lulSize    - size of buffer
+// Return:       None
+////////////////////////////////////////////////////////////////////////////
+void
+fifo_report(char *paucReport, guint32 lulSize)
+{
+    guint32 lulLength;
+    guint8  lucBucket;
+
+    lulLength = snprintf(paucReport, lulSize,
+                         "Receive FIFO: %u lines (%u..%u), high-water %u, grown %u, shrunk %u, dropped %u; bursts by peak depth:",
+                         gulReceiveFIFOCount, gulFifoCountMin, gulFifoCountMax, guiFifoHighWater,
+                         gulFifoGrown, gulFifoShrunk, gulFifoDropped);
+    for (lucBucket = 1; lucBucket < FIFO_BURST_BUCKETS && lulLength < lulSize; ++lucBucket)
+    {
+        if (gulFifoBurstCount[lucBucket])
+        {
+            lulLength += snprintf(paucReport + lulLength, lulSize - lulLength, " <=%u %u",
+                                  (1u << lucBucket) - 1, gulFifoBurstCount[lucBucket]);
+        }
+    }
+    if (lulLength < lulSize) snprintf(paucReport + lulLength, lulSize - lulLength, "\r\n");
+}
+// end fifo_report
+
+
+////////////////////////////////////////////////////////////////////////////
+// Name:         fifo_tick
+// Description:  Every second: shrink the FIFO once its high-water has
+//               stayed under a quarter of its size for
+//               RECEIVE_FIFO_SHRINK_SEC
+// Parameters:   None
+// Return:       TRUE if the FIFO was shrunk (see fifo_size())
+////////////////////////////////////////////////////////////////////////////
+gboolean
+fifo_tick(void)
+{
+    guint32 lulCount;
+
+    if (!gpcReceiveFIFO) return FALSE;
+
+    if (4u * guiFifoTickHighWater >= gulReceiveFIFOCount)
+    {
+        gulFifoQuiet_sec = 0;
+        guiFifoQuietHighWater = 0;
+    }
+    else
+    {
+        ++gulFifoQuiet_sec;
+        guiFifoQuietHighWater = MAX(guiFifoQuietHighWater, guiFifoTickHighWater);
+    }
+    guiFifoTickHighWater = fifo_count();
+    if (gulFifoQuiet_sec < RECEIVE_FIFO_SHRINK_SEC) return FALSE;
+
+    // Only a worthwhile shrink; the quiet period starts again either way
+    lulCount = MAX(gulFifoCountMin, 4u * guiFifoQuietHighWater);
+    gulFifoQuiet_sec = 0;
+    guiFifoQuietHighWater = 0;
+    if (lulCount > gulReceiveFIFOCount/2 || lulCount <= fifo_count()) return FALSE;
+
+    fifo_resize(lulCount);
+    ++gulFifoShrunk;
+    return TRUE;
+}
+// end fifo_tick
+
+
+////////////////////////////////////////////////////////////////////////////
+// Name:         fifo_write
+// Description:  Write a received string to the FIFO; the FIFO is grown
+//               if this leaves an eighth or less of it free
+// Parameters:   paucReceiveMsg - pointer to received NULL-terminated string
+// Return:       FIFO_OK, FIFO_GROWN (see fifo_size()), or
+//               FIFO_HALF_FULL/FIFO_ALMOST_FULL as a warning once it's
+//               as big as it's allowed to get, or FIFO_FULL if the string
+//               was dropped
+////////////////////////////////////////////////////////////////////////////
+guint8
+fifo_write(char *paucReceiveMsg)
+{
+    guint16 luiFIFOCount;
+    guint32 lulLength;
+    char   *plcEntry;
+
+    if (!gpcReceiveFIFO) fifo_initialize(RECEIVE_FIFO_MSG_COUNT, RECEIVE_FIFO_MSG_LENGTH_MAX);
+
+    // Full (one entry is always left free): drop the message rather than
+    // overwrite the ones waiting
+    if (fifo_count() >= gulReceiveFIFOCount - 1)
+    {
+        ++gulFifoDropped;
+        return FIFO_FULL;
+    }
+
+    // Copy the received message string (truncated if need be) into the FIFO entry,
+    // then point to the next FIFO entry to receive the next received message string
+    plcEntry  = &gpcReceiveFIFO[(gsize)guiReceiveFIFOWriteIndex * gulReceiveFIFOLength];
+    lulLength = MIN(strlen(paucReceiveMsg), gulReceiveFIFOLength-1);
+    memcpy(plcEntry, paucReceiveMsg, lulLength);
+    plcEntry[lulLength] = '\0';
+    if (lulLength >= gulReceiveFIFOLongest) gulReceiveFIFOLongest = lulLength + 1;
+    gpullReceiveFIFOWrite_ns[guiReceiveFIFOWriteIndex] = trace_start();
+    if (++guiReceiveFIFOWriteIndex >= gulReceiveFIFOCount) guiReceiveFIFOWriteIndex = 0;
+
+    luiFIFOCount = fifo_count();
+    metrics_gauge(METRICS_FIFO_DEPTH, luiFIFOCount);
+    if (luiFIFOCount > guiFifoBurstPeak)     guiFifoBurstPeak     = luiFIFOCount;
+    if (luiFIFOCount > guiFifoTickHighWater) guiFifoTickHighWater = luiFIFOCount;
+    if (luiFIFOCount > guiFifoHighWater)     guiFifoHighWater     = luiFIFOCount;
+
+    // Within an eighth of full: grow while it's allowed to, else warn
+    if (gulReceiveFIFOCount - 1 - luiFIFOCount <= gulReceiveFIFOCount/8)
+    {
+        if (gulReceiveFIFOCount < gulFifoCountMax)
+        {
+            fifo_resize(MIN(2 * gulReceiveFIFOCount, gulFifoCountMax));
+            ++gulFifoGrown;
+            return FIFO_GROWN;
+        }
+        return FIFO_ALMOST_FULL;
+    }
+    else if (luiFIFOCount == gulFifoCountMax/2)
+    {
+        return FIFO_HALF_FULL;
+    }
+    return FIFO_OK;
+}
+// end fifo_write
+
@@ -0,0 +1,50 @@
+/*
+ * File:   fifo.h
+ * Author: Mark Bersalona
+ *
+ * Created on 2024.07.15
+ */
+
+#ifndef FIFO_H
+#define FIFO_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Definitions
+//
+///////////////////////////////////////////////////////////////////////////////
+
+// fifo_write() return values
+#define FIFO_OK           (0)
+#define FIFO_HALF_FULL    (1)
+#define FIFO_ALMOST_FULL  (2)
+#define FIFO_GROWN        (3)
+#define FIFO_FULL         (4)
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Public routines
+//
+///////////////////////////////////////////////////////////////////////////////
+
+guint16 fifo_count(void);
+void fifo_initialize(guint32 lulCount, guint32 lulLength);
+void fifo_memory(guint32 *palReserved, guint32 *palUsed);
+char *fifo_read(void);
+void fifo_report(char *paucReport, guint32 lulSize);
+void fifo_set_bounds(guint32 lulMin, guint32 lulMax);
+guint32 fifo_size(void);
+gboolean fifo_tick(void);
+guint8 fifo_write(char *paucReceiveMsg);
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* FIFO_H */
+
@@ -0,0 +1,399 @@
+/*
+ * File:   flightrec.c
+ * Author: Mark Bersalona
+ *
+ * Created on 2024.07.15
+ * Sensaphone WSG30 Temperature Display Diagnostic flight recorder
+ *
+ * Always-on ring of the most recent raw lines and Status text, kept in a
+ * memory-mapped file. The mapping is shared with the page cache, so the
+ * ring survives the process crashing (though not the machine losing
+ * power); WSG30TempDisplay_flightrec_dump prints it afterwards.
+ * Writers reserve space with a single atomic add and never block, so
+ * recording costs a memcpy per line. See flightrec.h for the layout.
+ */
+
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Includes
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#define _GNU_SOURCE
+#include <glib.h>
+#include <glib/gstdio.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include "gconfig.h"
+#include "flightrec.h"
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Definitions
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#define FLIGHTREC_MAGIC        ("WSG30FR")
+#define FLIGHTREC_RECORD_SIZE  (24)
+
+// File header, FLIGHTREC_HEADER_SIZE bytes
+typedef struct
+{
+    char    ucMagic[8];
+    guint32 lulVersion;
+    guint32 lulRingBytes;
+    guint64 lullPosition;           // reserved with an atomic add
+    gint64  llStarted_usec;
+    guint32 lulPid;
+    guint32 lulExitedNormally;
+    guint8  ucPad[24];
+} FlightrecHeader;
+
+// Record header; the text follows
+typedef struct
+{
+    guint64 lullStamp;              // position ^ FLIGHTREC_STAMP_KEY, written last
+    guint32 lulLength;
+    guint16 luiType;
+    guint16 luiZero;
+    gint64  llTime_usec;
+} FlightrecRecord;
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Variables and tables
+//
+///////////////////////////////////////////////////////////////////////////////
+
+static FlightrecHeader *gpsFlightrecHeader = NULL;
+static guint8          *gpucFlightrecRing;
+static int              giFlightrecFd = -1;
+
+// Signals that end the process with the ring still mapped
+static const int giFlightrecFatalSignals[] = { SIGSEGV, SIGBUS, SIGABRT, SIGFPE, SIGILL };
+
+
+////////////////////////////////////////////////////////////////////////////
+// Name:         flightrec_copy_in
+// Description:  Copy into the ring at an absolute position, wrapping
+// Parameters:   pasRing   - the ring
+//               lullPosition - absolute position
+//               pavSource - data
+//               lulLength - bytes
+// Return:       None
+////////////////////////////////////////////////////////////////////////////
+static void
+flightrec_copy_in(guint8 *pasRing, guint64 lullPosition, const void *pavSource, guint32 lulLength)
+{
+    guint32 lulOffset = lullPosition & (FLIGHTREC_RING_BYTES - 1);
+    guint32 lulFirst  = MIN(lulLength, FLIGHTREC_RING_BYTES - lulOffset);
+
+    memcpy(pasRing + lulOffset, pavSource, lulFirst);
+    memcpy(pasRing, (const guint8 *)pavSource + lulFirst, lulLength - lulFirst);
+}
+// end flightrec_copy_in
+
+
+////////////////////////////////////////////////////////////////////////////
+// Name:         flightrec_copy_out
+// Description:  Copy out of a ring at an absolute position, wrapping
+// Parameters:   pasRing      - the ring
+//               lulRingBytes - ring size, a power of 2
+//               lullPosition - absolute position
+//               pavDest      - where to copy to
+//               lulLength    - bytes
+// Return:       None
+////////////////////////////////////////////////////////////////////////////
+static void
+flightrec_copy_out(const guint8 *pasRing, guint32 lulRingBytes, guint64 lullPosition, void *pavDest, guint32 lulLength)
+{
+    guint32 lulOffset = lullPosition & (lulRingBytes - 1);
+    guint32 lulFirst  = MIN(lulLength, lulRingBytes - lulOffset);
+
+    memcpy(pavDest, pasRing + lulOffset, lulFirst);
+    memcpy((guint8 *)pavDest + lulFirst, pasRing, lulLength - lulFirst);
+}
+// end flightrec_copy_out
+
+
+////////////////////////////////////////////////////////////////////////////
+// Name:         flightrec_fatal
+// Description:  Fatal signal handler - note the signal in the ring, then
+//               let the default action (core dump) happen
+//               Only async-signal-safe calls: flightrec_write() uses
+//               memcpy, clock_gettime and atomics
+// Parameters:   liSignal - signal number
+// Return:       None
+////////////////////////////////////////////////////////////////////////////
+static void
+flightrec_fatal(int liSignal)
+{
+    char lcText[] = "Fatal signal 00";
+
+    lcText[sizeof(lcText) - 3] = '0' + (liSignal / 10) % 10;
+    lcText[sizeof(lcText) - 2] = '0' + liSignal % 10;
+    flightrec_write(FLIGHTREC_EVENT, lcText);
+
+    // SA_RESETHAND has restored the default action
+    raise(liSignal);
+}
+// end flightrec_fatal
+
+
+////////////////////////////////////////////////////////////////////////////
+// Name:         flightrec_write
+// Description:  Add a record to the flight recorder ring
+//               Lock-free and safe from any thread or a signal handler;
+//               does nothing if the recorder isn't open
+// Parameters:   luiType   - FLIGHTREC_xxx
+//               paucText  - NULL-terminated text
+// Return:       None
+////////////////////////////////////////////////////////////////////////////
+void
+flightrec_write(guint16 luiType, char *paucText)
+{
+    FlightrecRecord lsRecord;
+    struct timespec lsNow;
+    guint64 lullPosition;
+    guint32 lulRecordBytes;
+
+    if (!gpsFlightrecHeader) return;
+
+    lsRecord.lulLength = MIN(strlen(paucText), RECEIVE_FIFO_MSG_LENGTH_MAX);
+    lsRecord.luiType   = luiType;
+    lsRecord.luiZero   = 0;
+    clock_gettime(CLOCK_REALTIME, &lsNow);
+    lsRecord.llTime_usec = (gint64)lsNow.tv_sec * G_USEC_PER_SEC + lsNow.tv_nsec / 1000;
+
+    // Reserve space, 8-byte aligned so the stamp never wraps
+    lulRecordBytes = (FLIGHTREC_RECORD_SIZE + lsRecord.lulLength + 7) & ~7U;
+    lullPosition = __atomic_fetch_add(&gpsFlightrecHeader->lullPosition, lulRecordBytes, __ATOMIC_RELAXED);
+
+    flightrec_copy_in(gpucFlightrecRing, lullPosition + sizeof(lsRecord.lullStamp),
+                      &lsRecord.lulLength, FLIGHTREC_RECORD_SIZE - sizeof(lsRecord.lullStamp));
+    flightrec_copy_in(gpucFlightrecRing, lullPosition + FLIGHTREC_RECORD_SIZE, paucText, lsRecord.lulLength);
+
+    // Publish: the record is valid once its stamp matches its position
+    __atomic_store_n((guint64 *)(gpucFlightrecRing + (lullPosition & (FLIGHTREC_RING_BYTES - 1))),
+                     lullPosition ^ FLIGHTREC_STAMP_KEY, __ATOMIC_RELEASE);
+}
+// end flightrec_write
+
+
+////////////////////////////////////////////////////////////////////////////
+// Name:         flightrec_open
+// Description:  Map the flight recorder file and start recording
+//               If the last process to use the file didn't exit normally,
+//               its ring is kept as "<name>.prev" first
+// Parameters:   paucName         - file name
+//               pafPreviousSaved - set TRUE if a ring was kept
+// Return:       TRUE if recording
+////////////////////////////////////////////////////////////////////////////
+gboolean
+flightrec_open(char *paucName, gboolean *pafPreviousSaved)
+{
+    FlightrecHeader lsPrevious;
+    struct sigaction lsAction;
+    gchar *plcName;
+    char lcText[80];
+    int liFd;
+    guint8 i;
+
+    *pafPreviousSaved = FALSE;
+    if (gpsFlightrecHeader) return TRUE;
+
+    // Keep the ring of a run that crashed
+    liFd = open(paucName, O_RDONLY);
+    if (liFd >= 0)
+    {
+        if (sizeof(lsPrevious) == read(liFd, &lsPrevious, sizeof(lsPrevious)) &&
+            0 == memcmp(lsPrevious.ucMagic, FLIGHTREC_MAGIC, sizeof(FLIGHTREC_MAGIC)) &&
+            !lsPrevious.lulExitedNormally && lsPrevious.lullPosition)
+        {
+            plcName = g_strdup_printf("%s.prev", paucName);
+            *pafPreviousSaved = (0 == g_rename(paucName, plcName));
+            g_free(plcName);
+        }
+        close(liFd);
+    }
+
+    // Allocate the whole file now: a write to a mapped page the file
+    // system can't back would be SIGBUS
+    giFlightrecFd = open(paucName, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (giFlightrecFd < 0) return FALSE;
+    if (0 != posix_fallocate(giFlightrecFd, 0, FLIGHTREC_HEADER_SIZE + FLIGHTREC_RING_BYTES))
+    {
+        close(giFlightrecFd);
+        giFlightrecFd = -1;
+        return FALSE;
+    }
+    gpsFlightrecHeader = mmap(NULL, FLIGHTREC_HEADER_SIZE + FLIGHTREC_RING_BYTES, PROT_READ | PROT_WRITE,
+                              MAP_SHARED, giFlightrecFd, 0);
+    if (MAP_FAILED == gpsFlightrecHeader)
+    {
+        gpsFlightrecHeader = NULL;
+        close(giFlightrecFd);
+        giFlightrecFd = -1;
+        return FALSE;
+    }
+    gpucFlightrecRing = (guint8 *)gpsFlightrecHeader + FLIGHTREC_HEADER_SIZE;
+
+    memcpy(gpsFlightrecHeader->ucMagic, FLIGHTREC_MAGIC, sizeof(FLIGHTREC_MAGIC));
+    gpsFlightrecHeader->lulVersion        = FLIGHTREC_VERSION;
+    gpsFlightrecHeader->lulRingBytes      = FLIGHTREC_RING_BYTES;
+    gpsFlightrecHeader->lullPosition      = 0;
+    gpsFlightrecHeader->llStarted_usec    = g_get_real_time();
+    gpsFlightrecHeader->lulPid            = getpid();
+    gpsFlightrecHeader->lulExitedNormally = 0;
+
+    // Note fatal signals in the ring before the process goes
+    memset(&lsAction, 0, sizeof(lsAction));
+    lsAction.sa_handler = flightrec_fatal;
+    lsAction.sa_flags   = SA_RESETHAND;
+    sigemptyset(&lsAction.sa_mask);
+    for (i = 0; i < G_N_ELEMENTS(giFlightrecFatalSignals); ++i)
+    {
+        sigaction(giFlightrecFatalSignals[i], &lsAction, NULL);
+    }
+
+    sprintf(lcText, "Flight recorder started, pid %u", gpsFlightrecHeader->lulPid);
+    flightrec_write(FLIGHTREC_EVENT, lcText);
+    return TRUE;
+}
+// end flightrec_open
+
+
+////////////////////////////////////////////////////////////////////////////
+// Name:         flightrec_close
+// Description:  Stop recording, marking the ring as from a normal exit
+//               Call once nothing else will write to the recorder
+// Parameters:   None
+// Return:       None
+////////////////////////////////////////////////////////////////////////////
+void
+flightrec_close(void)
+{
+    FlightrecHeader *lpsHeader = gpsFlightrecHeader;
+
+    if (!lpsHeader) return;
+
+    flightrec_write(FLIGHTREC_EVENT, "Exited normally");
+    gpsFlightrecHeader = NULL;
+    lpsHeader->lulExitedNormally = 1;
+    munmap(lpsHeader, FLIGHTREC_HEADER_SIZE + FLIGHTREC_RING_BYTES);
+    close(giFlightrecFd);
+    giFlightrecFd = -1;
+}
+// end flightrec_close
+
+
+////////////////////////////////////////////////////////////////////////////
+// Name:         flightrec_memory
+// Description:  Memory footprint of the mapped ring
+// Parameters:   palReserved - set to bytes mapped (0 if not recording)
+//               palUsed     - set to bytes of the ring written so far
+// Return:       None
+////////////////////////////////////////////////////////////////////////////
+void
+flightrec_memory(guint32 *palReserved, guint32 *palUsed)
+{
+    if (!gpsFlightrecHeader)
+    {
+        *palReserved = 0;
+        *palUsed     = 0;
+        return;
+    }
+    *palReserved = FLIGHTREC_HEADER_SIZE + FLIGHTREC_RING_BYTES;
+    *palUsed     = FLIGHTREC_HEADER_SIZE +
+                   MIN(__atomic_load_n(&gpsFlightrecHeader->lullPosition, __ATOMIC_RELAXED), FLIGHTREC_RING_BYTES);
+}
+// end flightrec_memory
+
+
+////////////////////////////////////////////////////////////////////////////
+// Name:         flightrec_read
+// Description:  Read a flight recorder file, oldest record first
+//               The file may still be in use; records overwritten or
+//               half-written while it was copied are skipped
+// Parameters:   paucName  - file name
+//               pasInfo   - filled in from the file header
+//               pafRecord - called with each record
+//               error     - set if the file can't be read
+// Return:       TRUE if the file was read
+////////////////////////////////////////////////////////////////////////////
+gboolean
+flightrec_read(char *paucName, FlightrecInfo *pasInfo,
+               void (*pafRecord)(gint64 llTime_usec, guint16 luiType, char *paucText, guint32 lulLength),
+               GError **error)
+{
+    GMappedFile *lgMapped;
+    const FlightrecHeader *lpsHeader;
+    FlightrecRecord lsRecord;
+    guint8 *plcRing;
+    char *plcText;
+    guint64 lullEnd;
+    guint64 lullStart;
+    guint64 lullPosition;
+    guint32 lulRecordBytes;
+
+    lgMapped = g_mapped_file_new(paucName, FALSE, error);
+    if (!lgMapped) return FALSE;
+
+    lpsHeader = (const FlightrecHeader *)g_mapped_file_get_contents(lgMapped);
+    if (g_mapped_file_get_length(lgMapped) < FLIGHTREC_HEADER_SIZE ||
+        0 != memcmp(lpsHeader->ucMagic, FLIGHTREC_MAGIC, sizeof(FLIGHTREC_MAGIC)) ||
+        FLIGHTREC_VERSION != lpsHeader->lulVersion ||
+        (lpsHeader->lulRingBytes & (lpsHeader->lulRingBytes - 1)) ||
+        g_mapped_file_get_length(lgMapped) < FLIGHTREC_HEADER_SIZE + (gsize)lpsHeader->lulRingBytes)
+    {
+        g_set_error(error, G_FILE_ERROR, G_FILE_ERROR_INVAL, "%s is not a flight recorder file", paucName);
+        g_mapped_file_unref(lgMapped);
+        return FALSE;
+    }
+    pasInfo->lulRingBytes     = lpsHeader->lulRingBytes;
+    pasInfo->llStarted_usec   = lpsHeader->llStarted_usec;
+    pasInfo->lulPid           = lpsHeader->lulPid;
+    pasInfo->fExitedNormally  = (0 != lpsHeader->lulExitedNormally);
+
+    // Snapshot the ring; anything reserved after the copy started may
+    // have overwritten the oldest records
+    lullEnd = __atomic_load_n(&lpsHeader->lullPosition, __ATOMIC_ACQUIRE);
+    plcRing = g_malloc(lpsHeader->lulRingBytes);
+    memcpy(plcRing, (const guint8 *)lpsHeader + FLIGHTREC_HEADER_SIZE, lpsHeader->lulRingBytes);
+    pasInfo->lullPosition = __atomic_load_n(&lpsHeader->lullPosition, __ATOMIC_ACQUIRE);
+    lullStart = (pasInfo->lullPosition > pasInfo->lulRingBytes) ? pasInfo->lullPosition - pasInfo->lulRingBytes : 0;
+    lullStart = (lullStart + 7) & ~(guint64)7;
+
+    plcText = g_malloc(RECEIVE_FIFO_MSG_LENGTH_MAX + 1);
+    for (lullPosition = lullStart; lullPosition + FLIGHTREC_RECORD_SIZE <= lullEnd; )
+    {
+        flightrec_copy_out(plcRing, pasInfo->lulRingBytes, lullPosition, &lsRecord, FLIGHTREC_RECORD_SIZE);
+        lulRecordBytes = (FLIGHTREC_RECORD_SIZE + lsRecord.lulLength + 7) & ~7U;
+        if ((lullPosition ^ FLIGHTREC_STAMP_KEY) != lsRecord.lullStamp ||
+            lsRecord.lulLength > RECEIVE_FIFO_MSG_LENGTH_MAX ||
+            lullPosition + lulRecordBytes > lullEnd)
+        {
+            // Not the start of a complete record, resynchronize
+            lullPosition += 8;
+            continue;
+        }
+        flightrec_copy_out(plcRing, pasInfo->lulRingBytes, lullPosition + FLIGHTREC_RECORD_SIZE, plcText, lsRecord.lulLength);
+        plcText[lsRecord.lulLength] = 0;
+        pafRecord(lsRecord.llTime_usec, lsRecord.luiType, plcText, lsRecord.lulLength);
+        lullPosition += lulRecordBytes;
+    }
+
+    g_free(plcText);
+    g_free(plcRing);
+    g_mapped_file_unref(lgMapped);
+    return TRUE;
+}
+// end flightrec_read
+
@@ -0,0 +1,75 @@
+/*
+ * File:   flightrec.h
+ * Author: Mark Bersalona
+ *
+ * Created on 2024.07.15
+ */
+
+#ifndef FLIGHTREC_H
+#define FLIGHTREC_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Definitions
+//
+///////////////////////////////////////////////////////////////////////////////
+
+// Record types
+#define FLIGHTREC_LINE    (1)   // raw line received from the device
+#define FLIGHTREC_STATUS  (2)   // text written to Status
+#define FLIGHTREC_EVENT   (3)   // recorder start/stop, fatal signal
+
+// File layout (host byte order: it is the process's memory image)
+//
+//   Header  "WSG30FR\0", u32 version, u32 ring bytes, u64 write position
+//           (bytes ever reserved), i64 start time (usec since 1970),
+//           u32 pid, u32 1 if the process exited normally, padding to 64
+//   Ring    records at 8-byte aligned offsets, wrapping at the end:
+//             u64 stamp (absolute position ^ FLIGHTREC_STAMP_KEY, written
+//             last), u32 length, u16 type, u16 0, i64 time (usec since
+//             1970), then the text, padded to 8 bytes
+//
+// A record is valid only if its stamp matches its own position, so a
+// reader can find the oldest complete record by scanning, and a record
+// cut short by a crash is simply skipped.
+#define FLIGHTREC_VERSION      (1)
+#define FLIGHTREC_HEADER_SIZE  (64)
+#define FLIGHTREC_STAMP_KEY    (0x5753473330465200ULL)
+
+typedef struct
+{
+    guint32 lulRingBytes;
+    guint64 lullPosition;       // total bytes ever written
+    gint64  llStarted_usec;
+    guint32 lulPid;
+    gboolean fExitedNormally;
+} FlightrecInfo;
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Public routines
+//
+///////////////////////////////////////////////////////////////////////////////
+
+// Recorder
+void flightrec_close(void);
+void flightrec_memory(guint32 *palReserved, guint32 *palUsed);
+gboolean flightrec_open(char *paucName, gboolean *pafPreviousSaved);
+void flightrec_write(guint16 luiType, char *paucText);
+
+// Reader
+gboolean flightrec_read(char *paucName, FlightrecInfo *pasInfo,
+                        void (*pafRecord)(gint64 llTime_usec, guint16 luiType, char *paucText, guint32 lulLength),
+                        GError **error);
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* FLIGHTREC_H */
+
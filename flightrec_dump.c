@@ -0,0 +1,137 @@
+/*
+ * File:   flightrec_dump.c
+ * Author: Mark Bersalona
+ *
+ * Created on 2024.07.15
+ * Print a WSG30 Temperature Display Diagnostic flight recorder file
+ *
+ * Prints each record as "<local date/time>  <type>  <text>", oldest
+ * first, after a summary of the run that wrote it. Works on the ring of
+ * a crashed run ("<name>.prev") or on one still being written.
+ */
+
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Includes
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include <glib.h>
+#include <stdio.h>
+#include <string.h>
+#include "gconfig.h"
+#include "flightrec.h"
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Variables and tables
+//
+///////////////////////////////////////////////////////////////////////////////
+
+// Command line options
+static gboolean gfDumpLinesOnly  = FALSE;
+static gboolean gfDumpStatusOnly = FALSE;
+
+static GOptionEntry gsDumpOptions[] =
+{
+    { "lines",  'l', 0, G_OPTION_ARG_NONE, &gfDumpLinesOnly,  "Only print received lines", NULL },
+    { "status", 's', 0, G_OPTION_ARG_NONE, &gfDumpStatusOnly, "Only print Status text and events", NULL },
+    { NULL }
+};
+
+static guint32 gulDumpRecords;
+
+
+////////////////////////////////////////////////////////////////////////////
+// Name:         flightrec_dump_time
+// Description:  Format a real time, local time with msec
+// Parameters:   paucTime    - buffer for the time, at least 24 chars
+//               llTime_usec - usec since 1970
+// Return:       None
+////////////////////////////////////////////////////////////////////////////
+static void
+flightrec_dump_time(char *paucTime, gint64 llTime_usec)
+{
+    GDateTime *lgDateTime = g_date_time_new_from_unix_local(llTime_usec / G_USEC_PER_SEC);
+    gchar *plcTime = g_date_time_format(lgDateTime, "%Y.%m.%d %H:%M:%S");
+
+    sprintf(paucTime, "%.19s.%03u", plcTime, (guint32)(llTime_usec % G_USEC_PER_SEC)/1000);
+    g_free(plcTime);
+    g_date_time_unref(lgDateTime);
+}
+// end flightrec_dump_time
+
+
+////////////////////////////////////////////////////////////////////////////
+// Name:         flightrec_dump_record
+// Description:  flightrec_read() record handler - print a record
+// Parameters:   llTime_usec - when it was recorded
+//               luiType     - FLIGHTREC_xxx
+//               paucText    - NULL-terminated text
+//               lulLength   - text length
+// Return:       None
+////////////////////////////////////////////////////////////////////////////
+static void
+flightrec_dump_record(gint64 llTime_usec, guint16 luiType, char *paucText, guint32 lulLength)
+{
+    char lcTime[32];
+
+    if (gfDumpLinesOnly  && FLIGHTREC_LINE != luiType) return;
+    if (gfDumpStatusOnly && FLIGHTREC_LINE == luiType) return;
+
+    // Status text already ends in CRLF
+    while (lulLength && ('\r' == paucText[lulLength-1] || '\n' == paucText[lulLength-1]))
+    {
+        paucText[--lulLength] = 0;
+    }
+    flightrec_dump_time(lcTime, llTime_usec);
+    printf("%s  %s  %s\r\n", lcTime,
+           (FLIGHTREC_LINE == luiType) ? "RX    " : (FLIGHTREC_STATUS == luiType) ? "STATUS" : "EVENT ",
+           paucText);
+    ++gulDumpRecords;
+}
+// end flightrec_dump_record
+
+
+////////////////////////////////////////////////////////////////////////////
+// Name:         main
+// Description:  Main routine for the flight recorder dump tool
+// Parameters:   Standard main arguments, see gsDumpOptions
+// Return:       0 on conventional exit; error otherwise
+////////////////////////////////////////////////////////////////////////////
+int main(int argc, char** argv)
+{
+    GError *error = NULL;
+    GOptionContext *lgOptionContext;
+    FlightrecInfo lsInfo;
+    char lcTime[32];
+    char *plcName;
+
+    lgOptionContext = g_option_context_new("[FILE] - print a WSG30 flight recorder file (default " FLIGHTREC_FILE ")");
+    g_option_context_add_main_entries(lgOptionContext, gsDumpOptions, NULL);
+    if (!g_option_context_parse(lgOptionContext, &argc, &argv, &error) || argc > 2)
+    {
+        g_printerr("%s\r\n", error ? error->message : "Expected at most one flight recorder file name");
+        g_clear_error(&error);
+        return 1;
+    }
+    g_option_context_free(lgOptionContext);
+    plcName = (2 == argc) ? argv[1] : FLIGHTREC_FILE;
+
+    memset(&lsInfo, 0, sizeof(lsInfo));
+    if (!flightrec_read(plcName, &lsInfo, flightrec_dump_record, &error))
+    {
+        g_printerr("%s\r\n", error->message);
+        g_clear_error(&error);
+        return 1;
+    }
+
+    flightrec_dump_time(lcTime, lsInfo.llStarted_usec);
+    g_printerr("%s: pid %u started %s, %s, %u records (%" G_GUINT64_FORMAT " bytes written, %u byte ring)\r\n",
+               plcName, lsInfo.lulPid, lcTime, lsInfo.fExitedNormally ? "exited normally" : "DID NOT EXIT NORMALLY",
+               gulDumpRecords, lsInfo.lullPosition, lsInfo.lulRingBytes);
+    return (0);
+}
+// end main
+
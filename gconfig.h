@@ -25,12 +25,135 @@ extern "C" {
 #define VERSION_C     "5"
 #define VERSION_DATE  "2024.07.11"
     
-// Period of the periodic callback
+// Default period of the periodic callback (--budget=periodic-msec:N)
 #define MAIN_PERIODIC_INTERVAL_MSEC (250)
 
-// Receive message FIFO
+// Housekeeping timer wheel resolution; timers are run from the periodic
+// callback, so a tick finer than the default period buys nothing (with a
+// longer period the wheel catches up, a tick at a time, when it runs)
+#define TIMERWHEEL_TICK_MSEC        (250)
+
+// Receive message FIFO, default entries to start with (--budget=fifo-lines:N)
+// and longest message; the length is also the most --budget=fifo-line-bytes:N
+// and serial-line-bytes:N can be set to
 #define RECEIVE_FIFO_MSG_COUNT (200)
 #define RECEIVE_FIFO_MSG_LENGTH_MAX (10000)
+// The FIFO grows with bursts and shrinks when they subside, between these
+// (--budget=fifo-lines-min:N,fifo-lines-max:N); it's shrunk once its
+// high-water has been under a quarter of its size for RECEIVE_FIFO_SHRINK_SEC
+#define RECEIVE_FIFO_LINES_MIN      (32)
+#define RECEIVE_FIFO_LINES_MAX      (2048)
+#define RECEIVE_FIFO_SHRINK_SEC     (60)
+
+// Buffer budgets: read from the [budget] group of BUDGET_KEYFILE (if it's
+// there) or --config=FILE, then --budget=...; see budget_set()
+#define BUDGET_KEYFILE               "WSG30TempDisplay.conf"
+#define BUDGET_FIFO_LINES_MIN        (8)
+#define BUDGET_FIFO_LINES_MAX        (32768)
+#define BUDGET_LINE_BYTES_MIN        (64)
+#define BUDGET_PERIODIC_MSEC_MIN     (10)
+#define BUDGET_PERIODIC_MSEC_MAX     (1000)
+#define BUDGET_RENDER_USEC_MIN       (1000)
+#define BUDGET_RENDER_USEC_MAX       (1000000)
+
+// Receive view render budget ("firehose" mode), default (--budget=render-usec:N)
+// If inserting received lines into the Receive view would take longer than
+// the budget in one periodic tick, only every Nth line is displayed and the
+// rest are summarized; parsing and logging still see every line
+#define RECEIVE_RENDER_BUDGET_USEC   (40000)
+#define RECEIVE_RENDER_SAMPLE_EVERY  (20)
+#define RECEIVE_RENDER_RECOVER_TICKS (8)
+
+// Receive lines kept while the window is minimized/hidden,
+// displayed all at once when the window is restored
+#define RECEIVE_HIDDEN_TAIL_BYTES    (32768)
+
+// Logfile writer thread
+// Queue of received messages waiting to be written; if the disk stalls
+// long enough to fill it, messages are dropped (and counted) rather than
+// stalling the display
+#define LOGFILE_QUEUE_BYTES          (1024*1024)
+// Default durability: LOGFILE_SYNC_NONE, LOGFILE_SYNC_MSEC or LOGFILE_SYNC_LINES
+// (change at runtime with --log-sync=none|msec:N|lines:N)
+#define LOGFILE_SYNC_DEFAULT         LOGFILE_SYNC_MSEC
+#define LOGFILE_SYNC_DEFAULT_EVERY   (1000)
+// Default rotation, 0 = no limit; no rotation unless one is set
+// (change at runtime with --log-rotate=none|mb:N|hours:N|mb:N,hours:N)
+#define LOGFILE_ROTATE_DEFAULT_MB    (0)
+#define LOGFILE_ROTATE_DEFAULT_HOURS (0)
+
+// Binary session log (--log-binary)
+// Records are written in blocks of up to SESSIONLOG_BLOCK_BYTES, one time
+// index entry per block; a partly filled block is written out after
+// SESSIONLOG_FLUSH_SEC
+#define SESSIONLOG_BLOCK_BYTES       (65536)
+#define SESSIONLOG_FLUSH_SEC         (5)
+
+// Capture replay
+// Time per periodic tick spent replaying lines (at max speed this is
+// most of the tick); gaps in a capture longer than REPLAY_GAP_MAX_SEC
+// are skipped instead of waited out at 1x/10x
+#define REPLAY_TICK_BUDGET_USEC      (150000)
+#define REPLAY_GAP_MAX_SEC           (60)
+
+// Telemetry export (--export)
+// Columnar rows are written in row groups of up to EXPORT_ROW_GROUP_ROWS;
+// a partly filled row group is written out after EXPORT_FLUSH_SEC
+#define EXPORT_ROW_GROUP_ROWS        (16384)
+#define EXPORT_FLUSH_SEC             (600)
+
+// Flight recorder: ring of the latest raw lines and Status text, always
+// on, kept in a memory-mapped file that survives a crash
+// FLIGHTREC_RING_BYTES must be a power of 2
+#define FLIGHTREC_RING_BYTES         (4*1024*1024)
+#define FLIGHTREC_FILE               "WSG30TempDisplay.flightrec"
+#define FLIGHTREC_FILE_HEADLESS      "WSG30TempDisplay_headless.flightrec"
+
+// Runtime metrics (stats panel, Prometheus text file for e.g.
+// node_exporter's textfile collector), rewritten every METRICS_PROM_SEC
+#define METRICS_PROM_FILE            "WSG30TempDisplay.prom"
+#define METRICS_PROM_FILE_HEADLESS   "WSG30TempDisplay_headless.prom"
+#define METRICS_PROM_SEC             (10)
+
+// Pipeline tracing (--trace): ring of the latest spans, dumped as Chrome
+// trace JSON on SIGUSR1 and at exit
+// TRACE_RING_EVENTS must be a power of 2
+#define TRACE_RING_EVENTS            (65536)
+#define TRACE_FILE                   "WSG30TempDisplay_trace.json"
+#define TRACE_FILE_HEADLESS          "WSG30TempDisplay_headless_trace.json"
+
+// Staged pipeline (--pipeline): reader thread -> ingest queue -> parser
+// thread -> UI queue -> main loop; queue sizes are powers of 2, and a
+// stage that finds the next queue full waits (backpressure)
+#define PIPELINE_INGEST_QUEUE_BYTES  (1024*1024)
+#define PIPELINE_UI_QUEUE_BYTES      (1024*1024)
+#define PIPELINE_READ_BYTES          (4096)
+#define PIPELINE_WAIT_MSEC           (100)
+
+// Test sequences (--sequence, Run sequence): most steps in a script, most
+// "fail" texts in force at once, and longest send/expect/fail text;
+// expect and wait times are kept to TIMERWHEEL_TICK_MSEC
+#define SEQUENCE_STEPS_MAX           (2000)
+#define SEQUENCE_FAILS_MAX           (8)
+#define SEQUENCE_TEXT_MAX            (200)
+
+// Command/response correlation: how long a command's reply may take,
+// and most commands of one kind waiting for replies at once (sending
+// another then gives up on the oldest)
+#define CORRELATE_TIMEOUT_MSEC       (5000)
+#define CORRELATE_REBOOT_TIMEOUT_MSEC (30000)
+#define CORRELATE_PENDING_MAX        (4)
+
+// Local socket fan-out (--fanout): ring the received lines and telemetry
+// are published in (a power of 2), most subscribers at once, and longest
+// the publisher thread sleeps with nothing to do. A subscriber more than
+// half the ring behind is lagged or dropped (--fanout-slow)
+#define FANOUT_RING_BYTES            (1024*1024)
+#define FANOUT_SUBSCRIBERS_MAX       (64)
+#define FANOUT_WAIT_MSEC             (1000)
+
+// Headless --soak: allocations are only counted after the warm-up
+#define SOAK_WARMUP_SEC              (30)
     
 
 #ifdef __cplusplus
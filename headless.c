@@ -0,0 +1,951 @@
+/*
+ * File:   headless.c
+ * Author: Mark Bersalona
+ *
+ * Created on 2024.07.15
+ * Headless (no GTK) Sensaphone WSG30 Temperature Display Diagnostic logger
+ *
+ * Runs the same serial ingest, parser, sticky error status and logfile as
+ * the GTK Diagnostic tool, but prints Status and parsed values to stdout
+ * instead of displaying them. For monitoring stations without a display.
+ * With --replay it instead runs a saved capture through the parser as fast
+ * as possible and writes its telemetry export, e.g. to convert old logs.
+ * With --soak, run under the mallocount.c shim, it checks that the steady
+ * state (serial ingest, parse, Status, logfile) doesn't allocate.
+ * With --trace, SIGUSR1 dumps a Chrome trace of the latest lines' path
+ * through the pipeline.
+ * With --sequence, it runs a test sequence once the port is open and exits
+ * when it's done, with status 0 only if it passed.
+ */
+
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Includes
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#define _GNU_SOURCE         // RTLD_DEFAULT
+#include <glib.h>
+#include <glib-unix.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <dlfcn.h>
+#include "gconfig.h"
+#include "serial.h"
+#include "fifo.h"
+#include "logfile.h"
+#include "parse.h"
+#include "sessionlog.h"
+#include "replay.h"
+#include "export.h"
+#include "fanout.h"
+#include "flightrec.h"
+#include "timefmt.h"
+#include "timerwheel.h"
+#include "metrics.h"
+#include "trace.h"
+#include "budget.h"
+#include "pipeline.h"
+#include "plugin.h"
+#include "sequence.h"
+#include "correlate.h"
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Variables and tables
+//
+///////////////////////////////////////////////////////////////////////////////
+
+// Command line options
+static gchar    *gpcHeadlessPort  = "/dev/ttyUSB0";
+static gint      giHeadlessBaud   = 115200;
+static gboolean  gfHeadlessLog    = FALSE;
+static gboolean  gfHeadlessRaw    = FALSE;
+static gchar    *gpcHeadlessSync  = NULL;
+static gchar    *gpcHeadlessRotate = NULL;
+static gboolean  gfHeadlessBinary = FALSE;
+static gchar    *gpcHeadlessExport = NULL;
+static gchar    *gpcHeadlessFanout = NULL;
+static gchar    *gpcHeadlessFanoutSlow = NULL;
+static gchar   **gpcHeadlessPlugins = NULL;
+static gchar    *gpcHeadlessReplay = NULL;
+static gint      giHeadlessSoak_sec = 0;
+static gboolean  gfHeadlessTrace  = FALSE;
+static gchar    *gpcHeadlessConfig = NULL;
+static gchar    *gpcHeadlessBudget = NULL;
+static gboolean  gfHeadlessPipeline = FALSE;
+static gchar    *gpcHeadlessPin = NULL;
+static gchar    *gpcHeadlessSequence = NULL;
+
+static GOptionEntry gsHeadlessOptions[] =
+{
+    { "port", 'p', 0, G_OPTION_ARG_FILENAME, &gpcHeadlessPort, "Serial port (default /dev/ttyUSB0)", "DEVICE" },
+    { "baud", 'b', 0, G_OPTION_ARG_INT,      &giHeadlessBaud,  "Baud rate (default 115200)", "BAUD" },
+    { "log",  'l', 0, G_OPTION_ARG_NONE,     &gfHeadlessLog,   "Save received messages to \"<date> WSG30TempDisplay.txt\"", NULL },
+    { "raw",  'r', 0, G_OPTION_ARG_NONE,     &gfHeadlessRaw,   "Also print every received message", NULL },
+    { "log-sync", 0, 0, G_OPTION_ARG_STRING, &gpcHeadlessSync, "Logfile durability: none, msec:N or lines:N", "POLICY" },
+    { "log-rotate", 0, 0, G_OPTION_ARG_STRING, &gpcHeadlessRotate, "Logfile rotation: none, mb:N, hours:N or mb:N,hours:N", "LIMITS" },
+    { "log-binary", 0, 0, G_OPTION_ARG_NONE, &gfHeadlessBinary, "Also save an indexed binary session log (.wsl)", NULL },
+    { "export", 0, 0, G_OPTION_ARG_STRING, &gpcHeadlessExport, "Also export STATUS telemetry: csv, columnar or both", "FORMAT" },
+    { "replay", 0, 0, G_OPTION_ARG_FILENAME, &gpcHeadlessReplay, "Export the telemetry in a saved capture (.txt, .txt.gz or .wsl) and exit", "CAPTURE" },
+    { "soak", 0, 0, G_OPTION_ARG_INT, &giHeadlessSoak_sec, "Fail if anything allocates during SECONDS of steady state (needs LD_PRELOAD mallocount shim)", "SECONDS" },
+    { "trace", 0, 0, G_OPTION_ARG_NONE, &gfHeadlessTrace, "Trace each line through the pipeline; dumped to " TRACE_FILE_HEADLESS " on SIGUSR1 and at exit", NULL },
+    { "config", 0, 0, G_OPTION_ARG_FILENAME, &gpcHeadlessConfig, "Read buffer budgets from FILE (default " BUDGET_KEYFILE ", if there)", "FILE" },
+    { "budget", 0, 0, G_OPTION_ARG_STRING, &gpcHeadlessBudget, "Buffer budgets: fifo-lines:N,fifo-lines-min:N,fifo-lines-max:N,fifo-line-bytes:N,periodic-msec:N,render-usec:N,serial-line-bytes:N", "BUDGETS" },
+    { "pipeline", 0, 0, G_OPTION_ARG_NONE, &gfHeadlessPipeline, "Read, parse and print on separate threads", NULL },
+    { "pin", 0, 0, G_OPTION_ARG_STRING, &gpcHeadlessPin, "Pin --pipeline stages to CPUs: reader:N,parser:N,logger:N,ui:N", "CPUS" },
+    { "fanout", 0, 0, G_OPTION_ARG_FILENAME, &gpcHeadlessFanout, "Publish received lines and telemetry to subscribers on a Unix-domain socket", "SOCKET" },
+    { "fanout-slow", 0, 0, G_OPTION_ARG_STRING, &gpcHeadlessFanoutSlow, "Fan-out subscriber that falls behind: lag (skip it ahead, default) or drop", "POLICY" },
+    { "parser-plugin", 0, 0, G_OPTION_ARG_FILENAME_ARRAY, &gpcHeadlessPlugins, "Load parser plugin FILE (.so) for more line handlers; may be repeated", "FILE" },
+    { "sequence", 0, 0, G_OPTION_ARG_FILENAME, &gpcHeadlessSequence, "Run the send/expect test sequence in FILE once the port is open, then exit", "FILE" },
+    { NULL }
+};
+
+static char lcTempHeadlessString[250];
+
+// Housekeeping timers, and seconds since start
+static TimerwheelTimer gsHeadlessSecondTimer;
+static TimerwheelTimer gsHeadlessNoDataTimer;
+static TimerwheelTimer gsHeadlessHourlyTimer;
+static TimerwheelTimer gsHeadlessMetricsTimer;
+static guint32 gulHeadlessElapsed_sec;
+
+// Monotonic time of the last received message; no data is reported
+// every HEADLESS_NO_DATA_MINUTES
+#define HEADLESS_NO_DATA_MINUTES (10)
+static gint64 gllHeadlessDataUpdate_usec;
+
+// Session log source port
+static guint8 gucHeadlessSessionlogPort;
+
+// --soak: the shim's allocation counter, and seconds that allocated
+static unsigned long (*gpfHeadlessMallocount)(void) = NULL;
+static guint32    gulHeadlessSoakFailed_sec;
+static GMainLoop *gHeadlessMainLoop;
+
+// --sequence: waiting for the port to open, and its result
+static gboolean   gfHeadlessSequencePending = FALSE;
+static gboolean   gfHeadlessSequencePassed  = FALSE;
+
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Parser hooks
+//
+///////////////////////////////////////////////////////////////////////////////
+
+////////////////////////////////////////////////////////////////////////////
+// Name:         headless_status_write
+// Description:  Parser hook - write to Status, i.e. stdout
+//               Status strings arrive in pieces ending with CRLF, so the
+//               local time is printed at the start of each line
+// Parameters:   paucWriteBuf - pointer to NULL-terminated string
+// Return:       None
+////////////////////////////////////////////////////////////////////////////
+static void
+headless_status_write(char *paucWriteBuf)
+{
+    static gboolean lfIsStartOfLine = TRUE;
+    char *plcChar;
+
+    flightrec_write(FLIGHTREC_STATUS, paucWriteBuf);
+
+    for (plcChar = paucWriteBuf; *plcChar; ++plcChar)
+    {
+        if ('\r' == *plcChar) continue;
+        if (lfIsStartOfLine)
+        {
+            fputs(timefmt_clock(), stdout);
+            fputs("  ", stdout);
+            lfIsStartOfLine = FALSE;
+        }
+        fputc(*plcChar, stdout);
+        if ('\n' == *plcChar) lfIsStartOfLine = TRUE;
+    }
+    fflush(stdout);
+}
+// end headless_status_write
+
+
+////////////////////////////////////////////////////////////////////////////
+// Name:         headless_field_update
+// Description:  Parser hook - print a parsed field as "Name = value"
+// Parameters:   lucField  - PARSE_FIELD_xxx
+//               paucValue - pointer to NULL-terminated value
+// Return:       None
+////////////////////////////////////////////////////////////////////////////
+static void
+headless_field_update(guint8 lucField, char *paucValue)
+{
+    sprintf(lcTempHeadlessString, "%s = %.200s\r\n", parse_field_name(lucField), paucValue);
+    headless_status_write(lcTempHeadlessString);
+}
+// end headless_field_update
+
+
+////////////////////////////////////////////////////////////////////////////
+// Name:         headless_uut_starting
+// Description:  Report a UUT startup/reboot (--pipeline: the parser has
+//               already cleared the values)
+// Parameters:   None
+// Return:       None
+////////////////////////////////////////////////////////////////////////////
+static void
+headless_uut_starting(void)
+{
+    headless_status_write("UUT starting, clearing values\r\n");
+}
+// end headless_uut_starting
+
+
+////////////////////////////////////////////////////////////////////////////
+// Name:         headless_uut_reset
+// Description:  Parser hook - UUT startup/reboot detected
+// Parameters:   None
+// Return:       None
+////////////////////////////////////////////////////////////////////////////
+static void
+headless_uut_reset(void)
+{
+    headless_uut_starting();
+    parse_clear_UUT_values();
+}
+// end headless_uut_reset
+
+
+////////////////////////////////////////////////////////////////////////////
+// Name:         headless_receive_msg_write
+// Description:  Serial receive handler - write a received string to the FIFO
+// Parameters:   paucReceiveMsg - pointer to received NULL-terminated string
+// Return:       None
+////////////////////////////////////////////////////////////////////////////
+static void
+headless_receive_msg_write(char *paucReceiveMsg)
+{
+    gllHeadlessDataUpdate_usec = g_get_monotonic_time();
+    switch (fifo_write(paucReceiveMsg))
+    {
+    case FIFO_GROWN:
+        sprintf(lcTempHeadlessString, "Receive FIFO grown to %u lines\r\n", fifo_size());
+        headless_status_write(lcTempHeadlessString);
+        break;
+    case FIFO_FULL:
+        headless_status_write("WARNING - receive FIFO is full, line dropped\r\n");
+        break;
+    case FIFO_ALMOST_FULL:
+        headless_status_write("WARNING - receive FIFO is almost full\r\n");
+        break;
+    case FIFO_HALF_FULL:
+        headless_status_write("WARNING - receive FIFO is half-full\r\n");
+        break;
+    default:
+        break;
+    }
+}
+// end headless_receive_msg_write
+
+
+////////////////////////////////////////////////////////////////////////////
+// Name:         headless_soak_tick
+// Description:  --soak, every second: report any allocations made in the
+//               last second (after the warm-up), and stop when done
+// Parameters:   lulElapsed_sec - seconds since start
+// Return:       None
+////////////////////////////////////////////////////////////////////////////
+static void
+headless_soak_tick(guint32 lulElapsed_sec)
+{
+    static unsigned long lulLastCount = 0;
+    unsigned long lulCount = gpfHeadlessMallocount();
+    unsigned long lulAllocations = lulCount - lulLastCount;
+
+    lulLastCount = lulCount;
+    if (lulElapsed_sec <= SOAK_WARMUP_SEC) return;
+
+    if (lulAllocations)
+    {
+        ++gulHeadlessSoakFailed_sec;
+        sprintf(lcTempHeadlessString, "Soak: %lu allocations in the last second\r\n", lulAllocations);
+        headless_status_write(lcTempHeadlessString);
+    }
+    if (lulElapsed_sec >= SOAK_WARMUP_SEC + (guint32)giHeadlessSoak_sec) g_main_loop_quit(gHeadlessMainLoop);
+}
+// end headless_soak_tick
+
+
+////////////////////////////////////////////////////////////////////////////
+// Name:         headless_second_tick
+// Description:  Housekeeping timer - every second
+// Parameters:   pasTimer - gsHeadlessSecondTimer
+// Return:       None
+////////////////////////////////////////////////////////////////////////////
+static void
+headless_second_tick(TimerwheelTimer *pasTimer)
+{
+    ++gulHeadlessElapsed_sec;
+    metrics_tick();
+    sessionlog_tick();
+    export_tick();
+    correlate_tick();
+    if (fifo_tick())
+    {
+        sprintf(lcTempHeadlessString, "Receive FIFO shrunk to %u lines\r\n", fifo_size());
+        headless_status_write(lcTempHeadlessString);
+    }
+    if (gpfHeadlessMallocount) headless_soak_tick(gulHeadlessElapsed_sec);
+}
+// end headless_second_tick
+
+
+////////////////////////////////////////////////////////////////////////////
+// Name:         headless_no_data
+// Description:  Housekeeping timer - report every HEADLESS_NO_DATA_MINUTES
+//               without data (restarted by each received message)
+//               The next report is timed from the last data, not from
+//               this one, so a stalled loop reports once, not once per
+//               period missed
+// Parameters:   pasTimer - gsHeadlessNoDataTimer
+// Return:       None
+////////////////////////////////////////////////////////////////////////////
+static void
+headless_no_data(TimerwheelTimer *pasTimer)
+{
+    gint64 llAge_msec = (g_get_monotonic_time() - gllHeadlessDataUpdate_usec) / 1000;
+    gint64 llPeriod_msec = HEADLESS_NO_DATA_MINUTES*60*1000;
+
+    sprintf(lcTempHeadlessString, "No data for %u minutes\r\n", (guint32)(llAge_msec / (60*1000)));
+    headless_status_write(lcTempHeadlessString);
+    timerwheel_start(&gsHeadlessNoDataTimer, (guint32)(llPeriod_msec - llAge_msec % llPeriod_msec), 0,
+                     headless_no_data, NULL);
+}
+// end headless_no_data
+
+
+////////////////////////////////////////////////////////////////////////////
+// Name:         headless_no_data_restart
+// Description:  Data received: restart the no-data reports
+// Parameters:   None
+// Return:       None
+////////////////////////////////////////////////////////////////////////////
+static void
+headless_no_data_restart(void)
+{
+    timerwheel_start(&gsHeadlessNoDataTimer, HEADLESS_NO_DATA_MINUTES*60*1000, 0, headless_no_data, NULL);
+}
+// end headless_no_data_restart
+
+
+////////////////////////////////////////////////////////////////////////////
+// Name:         headless_hourly_report
+// Description:  Housekeeping timer - every hour, report the timer jitter,
+//               the memory footprint, the logfile writer queue depth
+//               and write latency, the pipeline queues (or the receive
+//               FIFO's bursts), the command round trips and the fan-out
+//               subscribers
+// Parameters:   pasTimer - gsHeadlessHourlyTimer
+// Return:       None
+////////////////////////////////////////////////////////////////////////////
+static void
+headless_hourly_report(TimerwheelTimer *pasTimer)
+{
+    timerwheel_report(lcTempHeadlessString, sizeof(lcTempHeadlessString));
+    headless_status_write(lcTempHeadlessString);
+    budget_report(lcTempHeadlessString, sizeof(lcTempHeadlessString));
+    headless_status_write(lcTempHeadlessString);
+    if (logfile_is_enabled())
+    {
+        logfile_report(lcTempHeadlessString, sizeof(lcTempHeadlessString));
+        headless_status_write(lcTempHeadlessString);
+    }
+    if (pipeline_is_running())
+    {
+        pipeline_report(lcTempHeadlessString, sizeof(lcTempHeadlessString));
+        headless_status_write(lcTempHeadlessString);
+    }
+    else
+    {
+        fifo_report(lcTempHeadlessString, sizeof(lcTempHeadlessString));
+        headless_status_write(lcTempHeadlessString);
+    }
+    correlate_report(lcTempHeadlessString, sizeof(lcTempHeadlessString));
+    headless_status_write(lcTempHeadlessString);
+    if (fanout_is_enabled())
+    {
+        fanout_report(lcTempHeadlessString, sizeof(lcTempHeadlessString));
+        headless_status_write(lcTempHeadlessString);
+    }
+}
+// end headless_hourly_report
+
+
+////////////////////////////////////////////////////////////////////////////
+// Name:         headless_metrics_write
+// Description:  Housekeeping timer - every METRICS_PROM_SEC, rewrite the
+//               Prometheus metrics file
+// Parameters:   pasTimer - gsHeadlessMetricsTimer
+// Return:       None
+////////////////////////////////////////////////////////////////////////////
+static void
+headless_metrics_write(TimerwheelTimer *pasTimer)
+{
+    metrics_write_prometheus(METRICS_PROM_FILE_HEADLESS);
+}
+// end headless_metrics_write
+
+
+////////////////////////////////////////////////////////////////////////////
+// Name:         headless_display_line
+// Description:  Data received: restart the no-data reports, and with
+//               --raw print the line
+// Parameters:   paucLine - pointer to NULL-terminated line
+// Return:       None
+////////////////////////////////////////////////////////////////////////////
+static void
+headless_display_line(char *paucLine)
+{
+    guint64 lullTraceStart_ns;
+
+    headless_no_data_restart();
+    sequence_line(paucLine);
+    if (gfHeadlessRaw)
+    {
+        lullTraceStart_ns = trace_start();
+        headless_status_write(paucLine);
+        headless_status_write("\r\n");
+        trace_end(TRACE_DISPLAY, lullTraceStart_ns);
+    }
+}
+// end headless_display_line
+
+
+////////////////////////////////////////////////////////////////////////////
+// Name:         headless_pipeline_display
+// Description:  --pipeline UI stage - a line was received
+// Parameters:   paucLine - pointer to NULL-terminated line
+// Return:       None
+////////////////////////////////////////////////////////////////////////////
+static void
+headless_pipeline_display(char *paucLine)
+{
+    gllHeadlessDataUpdate_usec = g_get_monotonic_time();
+    headless_display_line(paucLine);
+}
+// end headless_pipeline_display
+
+
+////////////////////////////////////////////////////////////////////////////
+// Name:         headless_receive_line
+// Description:  Log, print, parse and record a received line
+//               (--pipeline: on the parser thread, the printing queued
+//                for the main loop)
+// Parameters:   paucLine - pointer to NULL-terminated line
+// Return:       None
+////////////////////////////////////////////////////////////////////////////
+static void
+headless_receive_line(char *paucLine)
+{
+    guint32 lulFieldMask;
+    gint64 llReceived_usec;
+    guint64 lullTraceStart_ns;
+
+    flightrec_write(FLIGHTREC_LINE, paucLine);
+    lullTraceStart_ns = trace_start();
+    logfile_write(paucLine);
+    trace_end(TRACE_LOGFILE_WRITE, lullTraceStart_ns);
+    if (pipeline_is_running()) pipeline_ui_line(paucLine);
+    else headless_display_line(paucLine);
+    lullTraceStart_ns = trace_start();
+    lulFieldMask = parse_msg(paucLine);
+    trace_end(TRACE_PARSE, lullTraceStart_ns);
+    lullTraceStart_ns = trace_start();
+    llReceived_usec = g_get_real_time();
+    sessionlog_write(llReceived_usec, gucHeadlessSessionlogPort, paucLine, lulFieldMask);
+    export_record(llReceived_usec, lulFieldMask);
+    fanout_line(llReceived_usec, paucLine, lulFieldMask);
+    trace_end(TRACE_RECORD, lullTraceStart_ns);
+}
+// end headless_receive_line
+
+
+////////////////////////////////////////////////////////////////////////////
+// Name:         headless_sequence_finished
+// Description:  Sequence hook - --sequence is done: note the result and
+//               leave the main loop
+// Parameters:   lfIsPassed - TRUE if every step passed
+// Return:       None
+////////////////////////////////////////////////////////////////////////////
+static void
+headless_sequence_finished(gboolean lfIsPassed)
+{
+    gfHeadlessSequencePassed = lfIsPassed;
+    g_main_loop_quit(gHeadlessMainLoop);
+}
+// end headless_sequence_finished
+
+
+////////////////////////////////////////////////////////////////////////////
+// Name:         headless_periodic
+// Description:  Headless periodic code: housekeeping timers, serial
+//               reconnect, then log and parse received messages
+// Parameters:   None
+// Return:       TRUE
+////////////////////////////////////////////////////////////////////////////
+static gboolean
+headless_periodic(gpointer data)
+{
+    char *plcReceivedMsgAvailable;
+    guint64 lullTickStart_ns = trace_start();
+
+    //
+    // Housekeeping timers that are due
+    // (sticky error status, session log/export flush, no-data reports;
+    //  --pipeline: between the parser's lines, as those are its state)
+    //
+    pipeline_lock();
+    timerwheel_run();
+    pipeline_unlock();
+
+    //
+    // USB reconnect
+    //
+    if (!isUSBConnectionOK)
+    {
+        if (serial_connect(gpcHeadlessPort, giHeadlessBaud) < 0)
+        {
+            if (isFirstSerialFail)
+            {
+                isFirstSerialFail = FALSE;
+                sprintf(lcTempHeadlessString, "***ERROR*** problem opening %.100s\r\n", gpcHeadlessPort);
+                headless_status_write(lcTempHeadlessString);
+            }
+        }
+        else
+        {
+            sprintf(lcTempHeadlessString, "%.100s opened successfully!\r\n", gpcHeadlessPort);
+            headless_status_write(lcTempHeadlessString);
+        }
+    }
+
+    //
+    // --sequence: start it once there's a port to send to
+    //
+    if (gfHeadlessSequencePending && isUSBConnectionOK)
+    {
+        SequenceHooks lsSequenceHooks = { headless_status_write, headless_sequence_finished };
+
+        gfHeadlessSequencePending = FALSE;
+        sequence_start(&lsSequenceHooks);
+    }
+
+    //
+    // Log and parse received messages
+    // (--pipeline: the parser thread has; print what it's queued)
+    //
+    if (pipeline_is_running())
+    {
+        pipeline_ui_run();
+    }
+    else
+    {
+        while ((plcReceivedMsgAvailable = fifo_read()))
+        {
+            headless_receive_line(plcReceivedMsgAvailable);
+        }
+    }
+
+    trace_end(TRACE_TICK, lullTickStart_ns);
+    return TRUE;
+}
+// end headless_periodic
+
+
+////////////////////////////////////////////////////////////////////////////
+// Name:         headless_replay_line
+// Description:  Replay line handler - parse a replayed line and export it
+// Parameters:   paucLine - pointer to NULL-terminated line
+// Return:       Fields found by the parser
+////////////////////////////////////////////////////////////////////////////
+static guint32
+headless_replay_line(char *paucLine)
+{
+    guint32 lulFieldMask = parse_msg_replay(paucLine);
+
+    export_record(replay_line_time(), lulFieldMask);
+    return lulFieldMask;
+}
+// end headless_replay_line
+
+
+////////////////////////////////////////////////////////////////////////////
+// Name:         headless_replay
+// Description:  --replay: run a saved capture through the parser at full
+//               speed, exporting its telemetry next to it
+//               ("x.txt.gz" -> "x.csv"/"x.wsc")
+// Parameters:   paucName - capture file name
+// Return:       0 on success; error otherwise
+////////////////////////////////////////////////////////////////////////////
+static int
+headless_replay(char *paucName)
+{
+    GError *error = NULL;
+    gchar *plcBaseName;
+    char *plcExtension;
+
+    if (!replay_open(paucName, &error))
+    {
+        g_printerr("%s\r\n", error->message);
+        g_clear_error(&error);
+        return 1;
+    }
+
+    plcBaseName = g_strdup(paucName);
+    if (g_str_has_suffix(plcBaseName, ".gz")) plcBaseName[strlen(plcBaseName) - 3] = 0;
+    plcExtension = strrchr(plcBaseName, '.');
+    if (plcExtension && !strchr(plcExtension, G_DIR_SEPARATOR)) *plcExtension = 0;
+    if (!export_open(plcBaseName))
+    {
+        g_printerr("Couldn't open telemetry export %s\r\n", plcBaseName);
+        g_free(plcBaseName);
+        replay_close();
+        return 1;
+    }
+
+    replay_set_speed(REPLAY_SPEED_MAX);
+    while (!replay_is_finished())
+    {
+        replay_run(headless_replay_line);
+    }
+    export_close();
+
+    sprintf(lcTempHeadlessString, "%u lines exported to %.200s\r\n", replay_line_count(), plcBaseName);
+    headless_status_write(lcTempHeadlessString);
+    g_free(plcBaseName);
+    replay_close();
+    return 0;
+}
+// end headless_replay
+
+
+////////////////////////////////////////////////////////////////////////////
+// Name:         headless_quit
+// Description:  SIGINT/SIGTERM handler - leave the main loop so the
+//               logfile is flushed and closed
+// Parameters:   data - the main loop
+// Return:       G_SOURCE_REMOVE
+////////////////////////////////////////////////////////////////////////////
+static gboolean
+headless_quit(gpointer data)
+{
+    g_main_loop_quit((GMainLoop *)data);
+    return G_SOURCE_REMOVE;
+}
+// end headless_quit
+
+
+////////////////////////////////////////////////////////////////////////////
+// Name:         headless_trace_dump
+// Description:  SIGUSR1 handler - with --trace, write the pipeline trace
+//               ring to TRACE_FILE_HEADLESS
+// Parameters:   data - unused
+// Return:       G_SOURCE_CONTINUE
+////////////////////////////////////////////////////////////////////////////
+static gboolean
+headless_trace_dump(gpointer data)
+{
+    guint32 lulEvents;
+
+    if (!trace_is_enabled())
+    {
+        headless_status_write("Trace not dumped - start with --trace to record one\r\n");
+    }
+    else if (trace_dump(TRACE_FILE_HEADLESS, &lulEvents))
+    {
+        sprintf(lcTempHeadlessString, "Trace of the last %u spans written to %s\r\n", lulEvents, TRACE_FILE_HEADLESS);
+        headless_status_write(lcTempHeadlessString);
+    }
+    else
+    {
+        headless_status_write("***ERROR*** couldn't write trace " TRACE_FILE_HEADLESS "\r\n");
+    }
+    return G_SOURCE_CONTINUE;
+}
+// end headless_trace_dump
+
+
+////////////////////////////////////////////////////////////////////////////
+// Name:         main
+// Description:  Main routine for the headless WSG30 Temperature Display
+//               Diagnostic logger
+// Parameters:   Standard main arguments, see gsHeadlessOptions
+// Return:       0 on conventional exit; error otherwise
+////////////////////////////////////////////////////////////////////////////
+int main(int argc, char** argv)
+{
+    GError *error = NULL;
+    GOptionContext *lgOptionContext;
+    GMainLoop *lgMainLoop;
+    gboolean lfFlightrecSaved;
+    ParseHooks lsHooks =
+    {
+        headless_status_write,
+        headless_field_update,
+        NULL,
+        headless_uut_reset,
+    };
+    PipelineStages lsPipelineStages =
+    {
+        headless_receive_line,
+        headless_pipeline_display,
+        { headless_status_write, headless_field_update, NULL, headless_uut_starting },
+    };
+
+    lgOptionContext = g_option_context_new("- headless WSG30 Temperature Display Diagnostic logger");
+    g_option_context_add_main_entries(lgOptionContext, gsHeadlessOptions, NULL);
+    if (!g_option_context_parse(lgOptionContext, &argc, &argv, &error))
+    {
+        g_printerr("%s\r\n", error->message);
+        g_clear_error(&error);
+        return 1;
+    }
+    g_option_context_free(lgOptionContext);
+    if (gpcHeadlessSync && !logfile_set_sync(gpcHeadlessSync))
+    {
+        g_printerr("Unknown --log-sync policy \"%s\"\r\n", gpcHeadlessSync);
+        return 1;
+    }
+    if (gpcHeadlessRotate && !logfile_set_rotate(gpcHeadlessRotate))
+    {
+        g_printerr("Unknown --log-rotate limits \"%s\"\r\n", gpcHeadlessRotate);
+        return 1;
+    }
+    if (gpcHeadlessExport && !export_set_format(gpcHeadlessExport))
+    {
+        g_printerr("Unknown --export format \"%s\"\r\n", gpcHeadlessExport);
+        return 1;
+    }
+    if (gpcHeadlessFanoutSlow && !fanout_set_slow(gpcHeadlessFanoutSlow))
+    {
+        g_printerr("Unknown --fanout-slow policy \"%s\"\r\n", gpcHeadlessFanoutSlow);
+        return 1;
+    }
+    if (!plugin_load(gpcHeadlessPlugins, &error))
+    {
+        g_printerr("%s\r\n", error->message);
+        g_clear_error(&error);
+        return 1;
+    }
+    if (!budget_load(gpcHeadlessConfig, &error))
+    {
+        g_printerr("%s\r\n", error->message);
+        g_clear_error(&error);
+        return 1;
+    }
+    if (gpcHeadlessBudget && !budget_set(gpcHeadlessBudget))
+    {
+        g_printerr("Unknown or out of range --budget \"%s\"\r\n", gpcHeadlessBudget);
+        return 1;
+    }
+    if (gpcHeadlessPin && !pipeline_set_cpus(gpcHeadlessPin))
+    {
+        g_printerr("Unknown --pin stages \"%s\"\r\n", gpcHeadlessPin);
+        return 1;
+    }
+    if (gpcHeadlessSequence)
+    {
+        if (!sequence_load(gpcHeadlessSequence, &error))
+        {
+            g_printerr("%s\r\n", error->message);
+            g_clear_error(&error);
+            return 1;
+        }
+        gfHeadlessSequencePending = TRUE;
+    }
+    if (giHeadlessSoak_sec > 0)
+    {
+        gpfHeadlessMallocount = (unsigned long (*)(void))dlsym(RTLD_DEFAULT, "mallocount_total");
+        if (!gpfHeadlessMallocount)
+        {
+            g_printerr("--soak needs LD_PRELOAD=./WSG30TempDisplay_mallocount.so\r\n");
+            return 1;
+        }
+    }
+
+    // Converting a capture: don't print every parsed value
+    if (gpcHeadlessReplay)
+    {
+        lsHooks.field_update = NULL;
+        parse_initialize(&lsHooks);
+        return headless_replay(gpcHeadlessReplay);
+    }
+
+    parse_initialize(&lsHooks);
+    // --soak checks the steady state doesn't allocate; a FIFO resize would
+    if (gpfHeadlessMallocount) gulBudgetFifoLinesMin = gulBudgetFifoLinesMax = gulBudgetFifoLines;
+    budget_apply();
+    serial_set_receive_handler(headless_receive_msg_write);
+    correlate_initialize(headless_status_write);
+    serial_set_write_handler(correlate_sent);
+    serial_set_reply_handler(correlate_line);
+    if (gfHeadlessPipeline)
+    {
+        logfile_set_cpu(pipeline_cpu(PIPELINE_LOGGER));
+        pipeline_pin(PIPELINE_UI);
+        pipeline_start(&lsPipelineStages);
+    }
+    trace_enable(gfHeadlessTrace);
+    if (!flightrec_open(FLIGHTREC_FILE_HEADLESS, &lfFlightrecSaved))
+    {
+        g_printerr("Couldn't open flight recorder %s\r\n", FLIGHTREC_FILE_HEADLESS);
+    }
+
+    sprintf(lcTempHeadlessString, "Sensaphone WSG30 Temp Sensor Diagnostic (headless) v%s.%s.%s %s\r\n",
+            VERSION_A, VERSION_B, VERSION_C, VERSION_DATE);
+    headless_status_write(lcTempHeadlessString);
+    if (lfFlightrecSaved)
+    {
+        headless_status_write("WARNING - last run did not exit normally, its flight recorder is in " FLIGHTREC_FILE_HEADLESS ".prev\r\n");
+    }
+    budget_report(lcTempHeadlessString, sizeof(lcTempHeadlessString));
+    headless_status_write(lcTempHeadlessString);
+    if (gpcHeadlessPlugins)
+    {
+        plugin_report(lcTempHeadlessString, sizeof(lcTempHeadlessString));
+        headless_status_write(lcTempHeadlessString);
+    }
+    if (gpcHeadlessFanout)
+    {
+        if (fanout_open(gpcHeadlessFanout))
+        {
+            sprintf(lcTempHeadlessString, "Fan-out socket %s opened\r\n", gpcHeadlessFanout);
+        }
+        else
+        {
+            sprintf(lcTempHeadlessString, "***ERROR*** couldn't open fan-out socket %s\r\n", gpcHeadlessFanout);
+        }
+        headless_status_write(lcTempHeadlessString);
+    }
+
+    if (gfHeadlessLog)
+    {
+        GDateTime *lgDateTime = g_date_time_new_now_local();
+        gchar *plcDate = g_date_time_format(lgDateTime, "%Y%m%d %H%M");
+        gchar *plcIntro;
+        char lcLogfileName[100];
+
+        sprintf(lcLogfileName, "%s WSG30TempDisplay.txt", plcDate);
+        g_free(plcDate);
+        plcDate  = g_date_time_format(lgDateTime, "%Y.%m.%d %H:%M");
+        plcIntro = g_strdup_printf("---------- Sensaphone WSG30 Temperature Display logfile, opened %s local time -----------", plcDate);
+        if (logfile_open(lcLogfileName, plcIntro))
+        {
+            sprintf(lcTempHeadlessString, "Logfile %s opened\r\n", gucLogfileName);
+        }
+        else
+        {
+            sprintf(lcTempHeadlessString, "***ERROR*** couldn't open logfile %s\r\n", lcLogfileName);
+        }
+        headless_status_write(lcTempHeadlessString);
+
+        // Binary session log, same name with .wsl
+        if (gfHeadlessBinary)
+        {
+            g_strlcpy(lcLogfileName + strlen(lcLogfileName) - 4, ".wsl", 5);
+            if (sessionlog_open(lcLogfileName))
+            {
+                gucHeadlessSessionlogPort = sessionlog_port(gpcHeadlessPort);
+                sprintf(lcTempHeadlessString, "Session log %s opened\r\n", lcLogfileName);
+            }
+            else
+            {
+                sprintf(lcTempHeadlessString, "***ERROR*** couldn't open session log %s\r\n", lcLogfileName);
+            }
+            headless_status_write(lcTempHeadlessString);
+        }
+
+        // Telemetry export, same name with .csv/.wsc
+        if (gpcHeadlessExport)
+        {
+            lcLogfileName[strlen(lcLogfileName) - 4] = 0;
+            if (export_open(lcLogfileName))
+            {
+                sprintf(lcTempHeadlessString, "Telemetry export %s opened\r\n", lcLogfileName);
+            }
+            else
+            {
+                sprintf(lcTempHeadlessString, "***ERROR*** couldn't open telemetry export %s\r\n", lcLogfileName);
+            }
+            headless_status_write(lcTempHeadlessString);
+        }
+        g_free(plcIntro);
+        g_free(plcDate);
+        g_date_time_unref(lgDateTime);
+    }
+
+    //
+    // Start the housekeeping timers and the periodic function,
+    // and kick off the main loop
+    //
+    timerwheel_start(&gsHeadlessSecondTimer,    1000,       1000,       headless_second_tick, NULL);
+    timerwheel_start(&gsHeadlessHourlyTimer,    60*60*1000, 60*60*1000, headless_hourly_report, NULL);
+    timerwheel_start(&gsHeadlessMetricsTimer,   METRICS_PROM_SEC*1000, METRICS_PROM_SEC*1000, headless_metrics_write, NULL);
+    gllHeadlessDataUpdate_usec = g_get_monotonic_time();
+    headless_no_data_restart();
+    g_timeout_add(gulBudgetPeriodic_msec, headless_periodic, NULL);
+    lgMainLoop = g_main_loop_new(NULL, FALSE);
+    gHeadlessMainLoop = lgMainLoop;
+    g_unix_signal_add(SIGINT,  headless_quit, lgMainLoop);
+    g_unix_signal_add(SIGTERM, headless_quit, lgMainLoop);
+    g_unix_signal_add(SIGUSR1, headless_trace_dump, NULL);
+    g_main_loop_run(lgMainLoop);
+
+    if (pipeline_is_running())
+    {
+        pipeline_stop();
+        pipeline_ui_run();
+        pipeline_report(lcTempHeadlessString, sizeof(lcTempHeadlessString));
+        headless_status_write(lcTempHeadlessString);
+    }
+    else
+    {
+        fifo_report(lcTempHeadlessString, sizeof(lcTempHeadlessString));
+        headless_status_write(lcTempHeadlessString);
+    }
+    timerwheel_report(lcTempHeadlessString, sizeof(lcTempHeadlessString));
+    headless_status_write(lcTempHeadlessString);
+    correlate_report(lcTempHeadlessString, sizeof(lcTempHeadlessString));
+    headless_status_write(lcTempHeadlessString);
+    if (fanout_is_enabled())
+    {
+        fanout_report(lcTempHeadlessString, sizeof(lcTempHeadlessString));
+        headless_status_write(lcTempHeadlessString);
+        fanout_close();
+    }
+    if (logfile_is_enabled())
+    {
+        logfile_close();
+        logfile_report(lcTempHeadlessString, sizeof(lcTempHeadlessString));
+        headless_status_write(lcTempHeadlessString);
+    }
+    logfile_finish();
+    sessionlog_close();
+    export_close();
+    flightrec_close();
+    if (trace_is_enabled()) headless_trace_dump(NULL);
+
+    if (gpfHeadlessMallocount)
+    {
+        if (gulHeadlessSoakFailed_sec)
+        {
+            g_printerr("Soak FAILED: allocations in %u of %d seconds\r\n", gulHeadlessSoakFailed_sec, giHeadlessSoak_sec);
+            return 1;
+        }
+        g_printerr("Soak passed: no allocations in %d seconds\r\n", giHeadlessSoak_sec);
+    }
+    if (gpcHeadlessSequence && !gfHeadlessSequencePassed) return 1;
+    return (0);
+}
+// end main
+
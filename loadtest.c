@@ -0,0 +1,602 @@
+/*
+ * File:   loadtest.c
+ * Author: Mark Bersalona
+ *
+ * Created on 2024.07.15
+ * End-to-end saturation load test of the headless logger
+ *
+ * Runs WSG30TempDisplay_headless --raw --log on one end of a pseudo-
+ * terminal and writes a realistic WSG30 line mix (STATUS, XBEE, battery,
+ * WARNING, ERROR, connection transitions) into the other, in steps of
+ * increasing lines/s. Each line starts with "[load <seq> <usec>] ", its
+ * scheduled send time on the monotonic clock, so its latency can be
+ * measured when it shows up on the logger's stdout (the headless display)
+ * and in its logfile; timing from the schedule rather than the actual
+ * write means a blocked pty counts as lag too. A step fails when any line
+ * is lost or the p99 latency exceeds --lag; the knee point is the last
+ * rate that didn't fail:
+ *
+ *   ./WSG30TempDisplay_loadtest --start=100 --growth=50 --step=5
+ */
+
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Includes
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#define _GNU_SOURCE         // posix_openpt, ptsname, cfmakeraw, realpath
+#include <glib.h>
+#include <glib/gstdio.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <termios.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Definitions
+//
+///////////////////////////////////////////////////////////////////////////////
+
+// How long to wait for the logger to open the pty and its logfile, and
+// how often to send it a probe line meanwhile
+#define LOADTEST_STARTUP_MSEC     (5000)
+#define LOADTEST_PROBE_MSEC       (100)
+
+// Longest poll() while a step is running, msec (also how often the
+// logfile is checked for new lines)
+#define LOADTEST_POLL_MSEC        (5)
+
+// Extra time after a step's last line, on top of --lag, for stragglers
+#define LOADTEST_DRAIN_MSEC       (1000)
+
+// Where each line was seen
+#define LOADTEST_DISPLAY          (0)
+#define LOADTEST_LOG              (1)
+#define LOADTEST_OUTPUTS          (2)
+
+// A line sent: its scheduled time, and when it was seen on each output
+// (0 = not yet)
+typedef struct
+{
+    gint64 llScheduled_usec;
+    gint64 llSeen_usec[LOADTEST_OUTPUTS];
+} LoadtestLine;
+
+// One output's results for a step
+typedef struct
+{
+    guint32 ulLost;
+    gint64  llP50_usec;
+    gint64  llP99_usec;
+    gint64  llMax_usec;
+} LoadtestResult;
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Variables and tables
+//
+///////////////////////////////////////////////////////////////////////////////
+
+// Command line options
+static gchar *gpcLoadtestHeadless = "./WSG30TempDisplay_headless";
+static gint   giLoadtestStart     = 100;
+static gint   giLoadtestGrowth    = 50;
+static gint   giLoadtestMax       = 20000;
+static gint   giLoadtestStep_sec  = 5;
+static gint   giLoadtestLag_msec  = 1000;
+
+static GOptionEntry gsLoadtestOptions[] =
+{
+    { "headless", 0, 0, G_OPTION_ARG_FILENAME, &gpcLoadtestHeadless, "Headless logger to test (default ./WSG30TempDisplay_headless)", "PATH" },
+    { "start",    0, 0, G_OPTION_ARG_INT, &giLoadtestStart,    "First step, lines/s (default 100)", "RATE" },
+    { "growth",   0, 0, G_OPTION_ARG_INT, &giLoadtestGrowth,   "Each step this many percent faster than the last (default 50)", "PERCENT" },
+    { "max",      0, 0, G_OPTION_ARG_INT, &giLoadtestMax,      "Stop after this rate, lines/s (default 20000)", "RATE" },
+    { "step",     0, 0, G_OPTION_ARG_INT, &giLoadtestStep_sec, "Seconds per step (default 5)", "SECONDS" },
+    { "lag",      0, 0, G_OPTION_ARG_INT, &giLoadtestLag_msec, "Fail a step if its p99 latency is over MSEC (default 1000)", "MSEC" },
+    { NULL }
+};
+
+// Line mix, in the proportions a busy WSG30 sends them; each template
+// takes the line's sequence number once, so values keep changing
+static char *pucLoadtestMix[] =
+{
+    "STATUS >> Timestamp %u UTC TEMP:72.5 MIN:68.0 MAX:75.1 AlHI:90 AlLO:40 Alarm:0 Scale:F SampleRateSeconds:60 ACK:1 HostCal:0 Buzzer:0 Mains:ON",
+    "XBEE >> SerialNumber:0013A200%08X Device:WSG30 PAN_ID:1234 Channel:15 Connection:CONNECTED",
+    "STATUS >> Timestamp %u UTC TEMP:72.6 MIN:68.0 MAX:75.1 AlHI:90 AlLO:40 Alarm:0 Scale:F SampleRateSeconds:60 ACK:1 HostCal:0 Buzzer:0 Mains:ON",
+    "InputTask: Battery reading: %u mV, Battery voltage 3.01 V Percentage 87",
+    "STATUS >> Timestamp %u UTC TEMP:72.7 MIN:68.0 MAX:75.1 AlHI:90 AlLO:40 Alarm:0 Scale:F SampleRateSeconds:60 ACK:1 HostCal:0 Buzzer:0 Mains:ON",
+    "*** WARNING *** Sensor read retry %u, attempt 2 of 3",
+    "STATUS >> Timestamp %u UTC TEMP:72.6 MIN:68.0 MAX:75.1 AlHI:90 AlLO:40 Alarm:0 Scale:F SampleRateSeconds:60 ACK:1 HostCal:0 Buzzer:0 Mains:ON",
+    "XBEE >> SerialNumber:0013A200%08X Device:WSG30 PAN_ID:1234 Channel:15 Connection:CONNECTED",
+    "STATUS >> Timestamp %u UTC TEMP:72.5 MIN:68.0 MAX:75.1 AlHI:90 AlLO:40 Alarm:0 Scale:F SampleRateSeconds:60 ACK:1 HostCal:0 Buzzer:0 Mains:ON",
+    "InputTask: Battery reading: %u mV, Battery voltage 3.00 V Percentage 86",
+    "Network_Connection_StateMachine: Transitioning from CONNECTED to SEARCHING (%u)",
+    "*** ERROR *** Sensor %u not responding",
+    "Network_Connection_StateMachine: Transitioning from SEARCHING to CONNECTED (%u)",
+    "STATUS >> Timestamp %u UTC TEMP:72.4 MIN:68.0 MAX:75.1 AlHI:90 AlLO:40 Alarm:0 Scale:F SampleRateSeconds:60 ACK:1 HostCal:0 Buzzer:0 Mains:ON",
+    "*** WARNING *** Sensor read retry %u, attempt 3 of 3",
+    "InputTask: Battery reading: %u mV, Battery voltage 3.01 V Percentage 87",
+};
+
+// Lines sent so far, indexed by sequence number
+static GArray *gLoadtestLines;
+
+// Unprocessed output (partial lines) from the logger's stdout and logfile
+static GString *gLoadtestPartial[LOADTEST_OUTPUTS];
+
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Routines
+//
+///////////////////////////////////////////////////////////////////////////////
+
+////////////////////////////////////////////////////////////////////////////
+// Name:         loadtest_line_seen
+// Description:  Look for a "[load <seq> <usec>]" marker in a line from the
+//               logger, and note when its line was first seen
+// Parameters:   paucLine - NULL-terminated line
+//               lucOutput - LOADTEST_DISPLAY or LOADTEST_LOG
+//               llNow_usec - when it was read
+// Return:       None
+////////////////////////////////////////////////////////////////////////////
+static void
+loadtest_line_seen(char *paucLine, guint8 lucOutput, gint64 llNow_usec)
+{
+    LoadtestLine *plsLine;
+    char *plcMarker = strstr(paucLine, "[load ");
+    guint32 lulSeq;
+
+    if (!plcMarker || 1 != sscanf(plcMarker + 6, "%u", &lulSeq) || lulSeq >= gLoadtestLines->len) return;
+
+    plsLine = &g_array_index(gLoadtestLines, LoadtestLine, lulSeq);
+    if (0 == plsLine->llSeen_usec[lucOutput]) plsLine->llSeen_usec[lucOutput] = llNow_usec;
+}
+// end loadtest_line_seen
+
+
+////////////////////////////////////////////////////////////////////////////
+// Name:         loadtest_read
+// Description:  Read whatever the logger has written to an output since
+//               the last call, and process each complete line
+// Parameters:   liFd      - stdout pipe or logfile, non-blocking
+//               lucOutput - LOADTEST_DISPLAY or LOADTEST_LOG
+// Return:       FALSE at end of file on the stdout pipe (logger exited)
+////////////////////////////////////////////////////////////////////////////
+static gboolean
+loadtest_read(int liFd, guint8 lucOutput)
+{
+    static char lcBuffer[65536];
+    GString *plsPartial = gLoadtestPartial[lucOutput];
+    gint64 llNow_usec = g_get_monotonic_time();
+    ssize_t liRead;
+    char *plcLine;
+    char *plcNewline;
+
+    if (liFd < 0) return TRUE;
+    while ((liRead = read(liFd, lcBuffer, sizeof(lcBuffer))) > 0)
+    {
+        g_string_append_len(plsPartial, lcBuffer, liRead);
+    }
+
+    plcLine = plsPartial->str;
+    while ((plcNewline = strchr(plcLine, '\n')))
+    {
+        *plcNewline = 0;
+        loadtest_line_seen(plcLine, lucOutput, llNow_usec);
+        plcLine = plcNewline + 1;
+    }
+    g_string_erase(plsPartial, 0, plcLine - plsPartial->str);
+
+    return !(0 == liRead && LOADTEST_DISPLAY == lucOutput);
+}
+// end loadtest_read
+
+
+////////////////////////////////////////////////////////////////////////////
+// Name:         loadtest_open_logfile
+// Description:  Find and open the logger's logfile in its working directory
+// Parameters:   paucDir - the logger's working directory
+// Return:       Non-blocking file descriptor, or -1 if there's none yet
+////////////////////////////////////////////////////////////////////////////
+static int
+loadtest_open_logfile(char *paucDir)
+{
+    GDir *plsDir = g_dir_open(paucDir, 0, NULL);
+    const gchar *plcName;
+    gchar *plcPath;
+    int liFd = -1;
+
+    if (!plsDir) return -1;
+    while (liFd < 0 && (plcName = g_dir_read_name(plsDir)))
+    {
+        if (!g_str_has_suffix(plcName, "WSG30TempDisplay.txt")) continue;
+        plcPath = g_build_filename(paucDir, plcName, NULL);
+        liFd = open(plcPath, O_RDONLY | O_NONBLOCK);
+        g_free(plcPath);
+    }
+    g_dir_close(plsDir);
+    return liFd;
+}
+// end loadtest_open_logfile
+
+
+////////////////////////////////////////////////////////////////////////////
+// Name:         loadtest_remove_dir
+// Description:  Delete the logger's working directory and its files
+// Parameters:   paucDir - directory
+// Return:       None
+////////////////////////////////////////////////////////////////////////////
+static void
+loadtest_remove_dir(char *paucDir)
+{
+    GDir *plsDir = g_dir_open(paucDir, 0, NULL);
+    const gchar *plcName;
+    gchar *plcPath;
+
+    if (plsDir)
+    {
+        while ((plcName = g_dir_read_name(plsDir)))
+        {
+            plcPath = g_build_filename(paucDir, plcName, NULL);
+            g_unlink(plcPath);
+            g_free(plcPath);
+        }
+        g_dir_close(plsDir);
+    }
+    g_rmdir(paucDir);
+}
+// end loadtest_remove_dir
+
+
+////////////////////////////////////////////////////////////////////////////
+// Name:         loadtest_probe
+// Description:  Startup - send a probe line, and check whether any probe
+//               has come out on both the logger's stdout and its logfile
+// Parameters:   liPty    - pty master, non-blocking
+//               liStdout - logger's stdout pipe, non-blocking
+//               pliLog   - logger's logfile (opened here once it exists)
+//               paucDir  - logger's working directory
+// Return:       TRUE if the logger is up
+////////////////////////////////////////////////////////////////////////////
+static gboolean
+loadtest_probe(int liPty, int liStdout, int *pliLog, char *paucDir)
+{
+    char lcLine[100];
+    LoadtestLine lsLine;
+    LoadtestLine *plsLine;
+    guint32 lulSeq;
+
+    loadtest_read(liStdout, LOADTEST_DISPLAY);
+    if (*pliLog < 0) *pliLog = loadtest_open_logfile(paucDir);
+    loadtest_read(*pliLog, LOADTEST_LOG);
+    for (lulSeq = 0; lulSeq < gLoadtestLines->len; ++lulSeq)
+    {
+        plsLine = &g_array_index(gLoadtestLines, LoadtestLine, lulSeq);
+        if (plsLine->llSeen_usec[LOADTEST_DISPLAY] && plsLine->llSeen_usec[LOADTEST_LOG]) return TRUE;
+    }
+
+    memset(&lsLine, 0, sizeof(lsLine));
+    lsLine.llScheduled_usec = g_get_monotonic_time();
+    g_snprintf(lcLine, sizeof(lcLine), "[load %u %" G_GINT64_FORMAT "] Load test probe\r\n",
+               gLoadtestLines->len, lsLine.llScheduled_usec);
+    g_array_append_val(gLoadtestLines, lsLine);
+    if (write(liPty, lcLine, strlen(lcLine)) < 0)
+    {
+        // pty full or not open yet: the next probe is a retry
+    }
+    return FALSE;
+}
+// end loadtest_probe
+
+
+////////////////////////////////////////////////////////////////////////////
+// Name:         loadtest_compare_usec
+// Description:  qsort() comparison of two latencies
+// Parameters:   pavA, pavB - gint64 values
+// Return:       <0, 0, >0
+////////////////////////////////////////////////////////////////////////////
+static int
+loadtest_compare_usec(const void *pavA, const void *pavB)
+{
+    gint64 llA = *(const gint64 *)pavA;
+    gint64 llB = *(const gint64 *)pavB;
+
+    return (llA > llB) - (llA < llB);
+}
+// end loadtest_compare_usec
+
+
+////////////////////////////////////////////////////////////////////////////
+// Name:         loadtest_result
+// Description:  Lost lines and latency percentiles of one output, for the
+//               lines of a step
+// Parameters:   lulFirst  - step's first sequence number
+//               lulCount  - lines in the step
+//               lucOutput - LOADTEST_DISPLAY or LOADTEST_LOG
+//               pasResult - results
+// Return:       None
+////////////////////////////////////////////////////////////////////////////
+static void
+loadtest_result(guint32 lulFirst, guint32 lulCount, guint8 lucOutput, LoadtestResult *pasResult)
+{
+    gint64 *pllLatency_usec = g_new(gint64, lulCount);
+    LoadtestLine *plsLine;
+    guint32 lulSeen = 0;
+    guint32 lulSeq;
+
+    for (lulSeq = lulFirst; lulSeq < lulFirst + lulCount; ++lulSeq)
+    {
+        plsLine = &g_array_index(gLoadtestLines, LoadtestLine, lulSeq);
+        if (plsLine->llSeen_usec[lucOutput])
+        {
+            pllLatency_usec[lulSeen++] = MAX(0, plsLine->llSeen_usec[lucOutput] - plsLine->llScheduled_usec);
+        }
+    }
+    qsort(pllLatency_usec, lulSeen, sizeof(gint64), loadtest_compare_usec);
+
+    memset(pasResult, 0, sizeof(*pasResult));
+    pasResult->ulLost = lulCount - lulSeen;
+    if (lulSeen)
+    {
+        pasResult->llP50_usec = pllLatency_usec[(lulSeen - 1) * 50 / 100];
+        pasResult->llP99_usec = pllLatency_usec[(lulSeen - 1) * 99 / 100];
+        pasResult->llMax_usec = pllLatency_usec[lulSeen - 1];
+    }
+    g_free(pllLatency_usec);
+}
+// end loadtest_result
+
+
+////////////////////////////////////////////////////////////////////////////
+// Name:         loadtest_step
+// Description:  Send lines at a rate for --step seconds, wait for them to
+//               come out of the logger, and report the step
+// Parameters:   lulRate   - lines/s
+//               liPty     - pty master, non-blocking
+//               liStdout  - logger's stdout pipe, non-blocking
+//               pliLog    - logger's logfile (opened here if need be)
+//               paucDir   - logger's working directory
+// Return:       TRUE if the step passed (no loss, p99 latency within --lag)
+////////////////////////////////////////////////////////////////////////////
+static gboolean
+loadtest_step(guint32 lulRate, int liPty, int liStdout, int *pliLog, char *paucDir)
+{
+    static char lcLine[300];
+    GString *plsOut = g_string_sized_new(65536);
+    LoadtestLine lsLine;
+    LoadtestResult lsResult[LOADTEST_OUTPUTS];
+    struct pollfd lsPoll[2];
+    guint32 lulFirst = gLoadtestLines->len;
+    guint32 lulCount = lulRate * giLoadtestStep_sec;
+    guint32 lulSent = 0;
+    guint32 lulSeenUpTo = lulFirst;     // every line before this one has been seen on both
+    guint32 lulSeq;
+    guint8 lucOutput;
+    gint64 llStart_usec = g_get_monotonic_time();
+    gint64 llDrainEnd_usec = llStart_usec + (gint64)giLoadtestStep_sec * G_USEC_PER_SEC
+                             + (gint64)(giLoadtestLag_msec + LOADTEST_DRAIN_MSEC) * 1000;
+    gint64 llNow_usec;
+    gint64 llDue_usec;
+    gboolean lfIsPassed;
+    ssize_t liWritten;
+    int liTimeout_msec;
+    int liLength;
+
+    memset(&lsLine, 0, sizeof(lsLine));
+    while (lulSeenUpTo < lulFirst + lulCount && (llNow_usec = g_get_monotonic_time()) < llDrainEnd_usec)
+    {
+        // Generate the lines that are due, stamped with when they were due
+        while (lulSent < lulCount &&
+               (llDue_usec = llStart_usec + (gint64)lulSent * G_USEC_PER_SEC / lulRate) <= llNow_usec)
+        {
+            lulSeq = lulFirst + lulSent++;
+            lsLine.llScheduled_usec = llDue_usec;
+            g_array_append_val(gLoadtestLines, lsLine);
+            liLength = g_snprintf(lcLine, sizeof(lcLine), "[load %u %" G_GINT64_FORMAT "] ", lulSeq, llDue_usec);
+            g_snprintf(lcLine + liLength, sizeof(lcLine) - liLength, pucLoadtestMix[lulSeq % G_N_ELEMENTS(pucLoadtestMix)], lulSeq);
+            g_string_append(plsOut, lcLine);
+            g_string_append(plsOut, "\r\n");
+        }
+
+        // Send what the pty will take
+        if (plsOut->len)
+        {
+            liWritten = write(liPty, plsOut->str, plsOut->len);
+            if (liWritten > 0) g_string_erase(plsOut, 0, liWritten);
+        }
+
+        // Collect what came out
+        if (!loadtest_read(liStdout, LOADTEST_DISPLAY))
+        {
+            g_printerr("Logger exited\r\n");
+            break;
+        }
+        if (*pliLog < 0) *pliLog = loadtest_open_logfile(paucDir);
+        loadtest_read(*pliLog, LOADTEST_LOG);
+
+        // Done when every line of the step has been seen on both
+        while (lulSeenUpTo < gLoadtestLines->len &&
+               g_array_index(gLoadtestLines, LoadtestLine, lulSeenUpTo).llSeen_usec[LOADTEST_DISPLAY] &&
+               g_array_index(gLoadtestLines, LoadtestLine, lulSeenUpTo).llSeen_usec[LOADTEST_LOG])
+        {
+            ++lulSeenUpTo;
+        }
+
+        // Wait for output, room in the pty or the next line
+        liTimeout_msec = LOADTEST_POLL_MSEC;
+        if (lulSent < lulCount)
+        {
+            llDue_usec = llStart_usec + (gint64)lulSent * G_USEC_PER_SEC / lulRate;
+            liTimeout_msec = (int)CLAMP((llDue_usec - g_get_monotonic_time()) / 1000, 0, LOADTEST_POLL_MSEC);
+        }
+        lsPoll[0].fd = liStdout;
+        lsPoll[0].events = POLLIN;
+        lsPoll[1].fd = plsOut->len ? liPty : -1;
+        lsPoll[1].events = POLLOUT;
+        poll(lsPoll, 2, liTimeout_msec);
+    }
+    g_string_free(plsOut, TRUE);
+
+    loadtest_result(lulFirst, lulCount, LOADTEST_DISPLAY, &lsResult[LOADTEST_DISPLAY]);
+    loadtest_result(lulFirst, lulCount, LOADTEST_LOG,     &lsResult[LOADTEST_LOG]);
+    lfIsPassed = (lulSent == lulCount);
+    for (lucOutput = 0; lucOutput < LOADTEST_OUTPUTS; ++lucOutput)
+    {
+        if (lsResult[lucOutput].ulLost || lsResult[lucOutput].llP99_usec > (gint64)giLoadtestLag_msec * 1000) lfIsPassed = FALSE;
+    }
+
+    printf("%7u %8u   %7.1f %7.1f %7.1f %7u   %7.1f %7.1f %7.1f %7u   %s\n", lulRate, lulCount,
+           lsResult[LOADTEST_DISPLAY].llP50_usec / 1000.0, lsResult[LOADTEST_DISPLAY].llP99_usec / 1000.0,
+           lsResult[LOADTEST_DISPLAY].llMax_usec / 1000.0, lsResult[LOADTEST_DISPLAY].ulLost,
+           lsResult[LOADTEST_LOG].llP50_usec / 1000.0, lsResult[LOADTEST_LOG].llP99_usec / 1000.0,
+           lsResult[LOADTEST_LOG].llMax_usec / 1000.0, lsResult[LOADTEST_LOG].ulLost,
+           lfIsPassed ? "ok" : "FAIL");
+    fflush(stdout);
+    return lfIsPassed;
+}
+// end loadtest_step
+
+
+////////////////////////////////////////////////////////////////////////////
+// Name:         main
+// Description:  Start the logger on a pty, step up the line rate until a
+//               step fails, and report the knee point
+// Parameters:   Standard main arguments, see gsLoadtestOptions
+// Return:       0 if a knee point was found; error otherwise
+////////////////////////////////////////////////////////////////////////////
+int main(int argc, char** argv)
+{
+    GError *error = NULL;
+    GOptionContext *lgOptionContext;
+    struct termios lsTermios;
+    char lcHeadless[4096];
+    gchar *plcDir;
+    gchar *plcPortOption;
+    gchar *lpcArgv[5];
+    GPid liPid;
+    int liPty;
+    int liPtySlave;
+    int liStdout;
+    int liLog = -1;
+    gint64 llStartupEnd_usec;
+    guint32 lulRate;
+    guint32 lulKnee = 0;
+
+    lgOptionContext = g_option_context_new("- find the line rate the headless logger can sustain");
+    g_option_context_add_main_entries(lgOptionContext, gsLoadtestOptions, NULL);
+    if (!g_option_context_parse(lgOptionContext, &argc, &argv, &error) ||
+        giLoadtestStart < 1 || giLoadtestGrowth < 1 || giLoadtestStep_sec < 1)
+    {
+        g_printerr("%s\r\n", error ? error->message : "--start, --growth and --step must be at least 1");
+        g_clear_error(&error);
+        return 1;
+    }
+    g_option_context_free(lgOptionContext);
+    if (!realpath(gpcLoadtestHeadless, lcHeadless))
+    {
+        g_printerr("Can't find %s (make headless)\r\n", gpcLoadtestHeadless);
+        return 1;
+    }
+
+    // The device end of the pty stays open (raw, like a serial port), so
+    // the logger never sees a hang-up
+    liPty = posix_openpt(O_RDWR | O_NOCTTY);
+    if (liPty < 0 || grantpt(liPty) || unlockpt(liPty) || (liPtySlave = open(ptsname(liPty), O_RDWR | O_NOCTTY)) < 0)
+    {
+        g_printerr("Couldn't open a pty: %s\r\n", g_strerror(errno));
+        return 1;
+    }
+    tcgetattr(liPtySlave, &lsTermios);
+    cfmakeraw(&lsTermios);
+    tcsetattr(liPtySlave, TCSANOW, &lsTermios);
+    fcntl(liPty, F_SETFL, fcntl(liPty, F_GETFL) | O_NONBLOCK);
+
+    // Logger, with its logfile, flight recorder and metrics in a scratch directory
+    plcDir = g_dir_make_tmp("WSG30TempDisplay_loadtest_XXXXXX", &error);
+    if (!plcDir)
+    {
+        g_printerr("%s\r\n", error->message);
+        g_clear_error(&error);
+        return 1;
+    }
+    plcPortOption = g_strdup_printf("--port=%s", ptsname(liPty));
+    lpcArgv[0] = lcHeadless;
+    lpcArgv[1] = plcPortOption;
+    lpcArgv[2] = "--raw";
+    lpcArgv[3] = "--log";
+    lpcArgv[4] = NULL;
+    if (!g_spawn_async_with_pipes(plcDir, lpcArgv, NULL, G_SPAWN_DO_NOT_REAP_CHILD, NULL, NULL,
+                                  &liPid, NULL, &liStdout, NULL, &error))
+    {
+        g_printerr("%s\r\n", error->message);
+        g_clear_error(&error);
+        loadtest_remove_dir(plcDir);
+        return 1;
+    }
+    fcntl(liStdout, F_SETFL, fcntl(liStdout, F_GETFL) | O_NONBLOCK);
+
+    gLoadtestLines = g_array_new(FALSE, FALSE, sizeof(LoadtestLine));
+    gLoadtestPartial[LOADTEST_DISPLAY] = g_string_new(NULL);
+    gLoadtestPartial[LOADTEST_LOG]     = g_string_new(NULL);
+
+    // Wait until the logger has the pty open: lines sent before then are
+    // lost, so probe until one comes out on both outputs
+    llStartupEnd_usec = g_get_monotonic_time() + LOADTEST_STARTUP_MSEC * 1000;
+    while (!loadtest_probe(liPty, liStdout, &liLog, plcDir) && g_get_monotonic_time() < llStartupEnd_usec)
+    {
+        g_usleep(LOADTEST_PROBE_MSEC * 1000);
+    }
+    if (g_get_monotonic_time() >= llStartupEnd_usec)
+    {
+        g_printerr("Logger didn't start (no probe line on its stdout and logfile after %d ms)\r\n", LOADTEST_STARTUP_MSEC);
+    }
+    else
+    {
+        printf("Headless logger %s on %s, %d s steps, lag limit %d ms\n", lcHeadless, ptsname(liPty),
+               giLoadtestStep_sec, giLoadtestLag_msec);
+        printf("                   ------ display (stdout), ms ------   ------------ logfile, ms ------------\n");
+        printf("lines/s    lines       p50     p99     max    lost       p50     p99     max    lost\n");
+        for (lulRate = giLoadtestStart; lulRate <= (guint32)giLoadtestMax;
+             lulRate = MAX(lulRate + 1, lulRate * (100 + giLoadtestGrowth) / 100))
+        {
+            if (!loadtest_step(lulRate, liPty, liStdout, &liLog, plcDir)) break;
+            lulKnee = lulRate;
+        }
+    }
+
+    kill(liPid, SIGTERM);
+    while (0 == waitpid(liPid, NULL, WNOHANG))
+    {
+        loadtest_read(liStdout, LOADTEST_DISPLAY);
+        g_usleep(10000);
+    }
+    g_spawn_close_pid(liPid);
+    if (liLog >= 0) close(liLog);
+    close(liStdout);
+    close(liPtySlave);
+    close(liPty);
+    loadtest_remove_dir(plcDir);
+    g_free(plcDir);
+    g_free(plcPortOption);
+
+    if (lulKnee)
+    {
+        printf("Knee point: %u lines/s (highest step with no lost lines and p99 latency under %d ms)\n",
+               lulKnee, giLoadtestLag_msec);
+        return 0;
+    }
+    printf("No knee point: the first step (%d lines/s) already failed\n", giLoadtestStart);
+    return 1;
+}
+// end main
+
@@ -0,0 +1,895 @@
+/*
+ * File:   logfile.c
+ * Author: Mark Bersalona
+ *
+ * Created on 2024.07.15
+ * Sensaphone WSG30 Temperature Display Diagnostic logfile
+ *
+ * logfile_write() only copies the message into a queue; a writer thread
+ * empties the queue with as few write() calls as possible and applies the
+ * durability policy (fdatasync never, every N msec or every N lines), so a
+ * slow disk or USB stick never holds up the GTK main loop.
+ *
+ * With rotation enabled (--log-rotate) the logfile is split into numbered
+ * segments by size and/or age. Each closed segment is gzipped on a
+ * background thread while the next one is written, and listed with its
+ * time range in a manifest next to the segments.
+ */
+
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Includes
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#define _GNU_SOURCE         // fdatasync
+#include <glib.h>
+#include <gio/gio.h>
+#include <glib/gstdio.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sched.h>
+#include <unistd.h>
+#include "gconfig.h"
+#include "logfile.h"
+#include "metrics.h"
+#include "trace.h"
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Definitions
+//
+///////////////////////////////////////////////////////////////////////////////
+
+// Write latency histogram, one bucket per power of 2 microseconds
+#define LOGFILE_LATENCY_BUCKETS (32)
+
+#define LOGFILE_SEGMENT_NAME_MAX (120)
+
+// A closed segment, handed to the compression thread
+typedef struct
+{
+    char    ucName[LOGFILE_SEGMENT_NAME_MAX];       // segment file
+    char    ucManifest[LOGFILE_SEGMENT_NAME_MAX];   // manifest to list it in
+    gint64  llFirst_usec;                           // real time of first and
+    gint64  llLast_usec;                            //   last write
+    guint32 lulLines;
+    guint64 lullBytes;
+} LogfileSegment;
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Variables and tables
+//
+///////////////////////////////////////////////////////////////////////////////
+
+static int      giLogfileFd = -1;
+static gboolean lfIsLogfileEnabled = FALSE;
+char gucLogfileName[100];
+
+// A write has failed and been reported; cleared by the next good write
+static gboolean gfLogfileWriteFailed = FALSE;
+
+// Durability policy
+static guint8  gucLogfileSyncPolicy = LOGFILE_SYNC_DEFAULT;
+static guint32 gulLogfileSyncEvery  = LOGFILE_SYNC_DEFAULT_EVERY;
+
+// Rotation, 0 = no limit (no rotation if both are 0)
+static guint64 gullLogfileRotateBytes = (guint64)LOGFILE_ROTATE_DEFAULT_MB*1024*1024;
+static guint32 gulLogfileRotate_sec   = LOGFILE_ROTATE_DEFAULT_HOURS*60*60;
+
+// Current segment, owned by the writer thread while the logfile is open
+static char    gucLogfileBase[LOGFILE_SEGMENT_NAME_MAX];
+static guint16 guiLogfileSegmentNumber;
+static LogfileSegment gsLogfileSegment;
+static gint64  gllLogfileSegmentOpened_usec;
+static gboolean gfLogfileSegmentLineEnd;            // last byte written ended a line
+
+// Compresses closed segments, one at a time
+static GThreadPool *gLogfileCompressPool = NULL;
+
+// CPU the writer thread is pinned to, -1 = any
+static int giLogfileCpu = -1;
+
+// Queue, written by logfile_write() and emptied by the writer thread.
+// Everything below is protected by gLogfileMutex.
+static GMutex   gLogfileMutex;
+static GCond    gLogfileCond;
+static GThread *gLogfileThread = NULL;
+static gboolean gfLogfileThreadRun = FALSE;
+static char     gucLogfileQueue[LOGFILE_QUEUE_BYTES];
+static guint32  gulLogfileQueueHead = 0;        // next byte to fill
+static guint32  gulLogfileQueueTail = 0;        // next byte to write
+static guint32  gulLogfileQueueUsed = 0;        // bytes waiting to be written
+
+// Statistics since the logfile was opened
+static guint32  gulLogfileQueueHighWater = 0;
+static guint32  gulLogfileLinesQueued    = 0;
+static guint32  gulLogfileLinesDropped   = 0;
+static guint32  gulLogfileWrites         = 0;
+static guint32  gulLogfileSyncs          = 0;
+static guint64  gullLogfileWriteMax_usec = 0;
+static guint32  gulLogfileLatency[LOGFILE_LATENCY_BUCKETS];
+
+
+////////////////////////////////////////////////////////////////////////////
+// Name:         logfile_latency_record
+// Description:  Add a write()/fdatasync() time to the latency histogram
+//               Call with gLogfileMutex held
+// Parameters:   lullElapsed_usec - time taken
+// Return:       None
+////////////////////////////////////////////////////////////////////////////
+static void
+logfile_latency_record(guint64 lullElapsed_usec)
+{
+    guint8 lucBucket = 0;
+
+    while (lucBucket < LOGFILE_LATENCY_BUCKETS-1 && (1ULL << (lucBucket+1)) <= lullElapsed_usec) ++lucBucket;
+    ++gulLogfileLatency[lucBucket];
+    if (lullElapsed_usec > gullLogfileWriteMax_usec) gullLogfileWriteMax_usec = lullElapsed_usec;
+    metrics_record(METRICS_LOGWRITE_NS, lullElapsed_usec * 1000);
+}
+// end logfile_latency_record
+
+
+////////////////////////////////////////////////////////////////////////////
+// Name:         logfile_latency_percentile
+// Description:  Estimate a write latency percentile from the histogram
+//               Call with gLogfileMutex held
+// Parameters:   luiPercent - 0..100
+// Return:       Upper bound of the bucket holding the percentile, usec
+////////////////////////////////////////////////////////////////////////////
+static guint64
+logfile_latency_percentile(guint16 luiPercent)
+{
+    guint64 lullTotal = 0;
+    guint64 lullCount = 0;
+    guint8  lucBucket;
+
+    for (lucBucket = 0; lucBucket < LOGFILE_LATENCY_BUCKETS; ++lucBucket) lullTotal += gulLogfileLatency[lucBucket];
+    if (0 == lullTotal) return 0;
+
+    for (lucBucket = 0; lucBucket < LOGFILE_LATENCY_BUCKETS; ++lucBucket)
+    {
+        lullCount += gulLogfileLatency[lucBucket];
+        if (lullCount*100 >= lullTotal*luiPercent) break;
+    }
+    return 1ULL << (lucBucket+1);
+}
+// end logfile_latency_percentile
+
+
+////////////////////////////////////////////////////////////////////////////
+// Name:         logfile_write_all
+// Description:  write() a whole buffer to the logfile, retrying on EINTR
+//               and partial writes
+//               A failure is reported once, not once per write, until a
+//               write succeeds again
+// Parameters:   lpucBuf  - bytes to write
+//               lulCount - number of bytes
+// Return:       None
+////////////////////////////////////////////////////////////////////////////
+static void
+logfile_write_all(char *lpucBuf, guint32 lulCount)
+{
+    ssize_t liWritten;
+
+    while (lulCount)
+    {
+        liWritten = write(giLogfileFd, lpucBuf, lulCount);
+        if (liWritten < 0)
+        {
+            if (EINTR == errno) continue;
+            if (!gfLogfileWriteFailed) g_printerr("Logfile write error: %s\r\n", g_strerror(errno));
+            gfLogfileWriteFailed = TRUE;
+            return;
+        }
+        lpucBuf  += liWritten;
+        lulCount -= (guint32)liWritten;
+    }
+    gfLogfileWriteFailed = FALSE;
+}
+// end logfile_write_all
+
+
+////////////////////////////////////////////////////////////////////////////
+// Name:         logfile_is_rotating
+// Description:  Is the logfile split into segments?
+// Parameters:   None
+// Return:       TRUE if a size or age limit is set
+////////////////////////////////////////////////////////////////////////////
+static gboolean
+logfile_is_rotating(void)
+{
+    return (gullLogfileRotateBytes || gulLogfileRotate_sec);
+}
+// end logfile_is_rotating
+
+
+////////////////////////////////////////////////////////////////////////////
+// Name:         logfile_manifest_time
+// Description:  Format a real time for the manifest, local time
+// Parameters:   paucTime - buffer for the time, at least 20 chars
+//               llTime_usec - real time, usec
+// Return:       None
+////////////////////////////////////////////////////////////////////////////
+static void
+logfile_manifest_time(char *paucTime, gint64 llTime_usec)
+{
+    GDateTime *lgDateTime = g_date_time_new_from_unix_local(llTime_usec/G_USEC_PER_SEC);
+    gchar *plcTime = g_date_time_format(lgDateTime, "%Y.%m.%d %H:%M:%S");
+
+    g_strlcpy(paucTime, plcTime, 20);
+    g_free(plcTime);
+    g_date_time_unref(lgDateTime);
+}
+// end logfile_manifest_time
+
+
+////////////////////////////////////////////////////////////////////////////
+// Name:         logfile_compress
+// Description:  Compression thread - gzip a closed segment to
+//               "<segment>.gz", remove the uncompressed segment and list
+//               it in the manifest
+//               If compression fails the uncompressed segment is kept
+//               (and listed instead)
+// Parameters:   data      - LogfileSegment, freed here
+//               user_data - unused
+// Return:       None
+////////////////////////////////////////////////////////////////////////////
+static void
+logfile_compress(gpointer data, gpointer user_data)
+{
+    LogfileSegment *lpsSegment = (LogfileSegment *)data;
+    GError *error = NULL;
+    gchar *plcGzName  = g_strdup_printf("%s.gz", lpsSegment->ucName);
+    gchar *plcTmpName = g_strdup_printf("%s.gz.tmp", lpsSegment->ucName);
+    GFile *lgInFile  = g_file_new_for_path(lpsSegment->ucName);
+    GFile *lgOutFile = g_file_new_for_path(plcTmpName);
+    GFileInputStream  *lgIn  = g_file_read(lgInFile, NULL, &error);
+    GFileOutputStream *lgOut = lgIn ? g_file_replace(lgOutFile, NULL, FALSE, G_FILE_CREATE_NONE, NULL, &error) : NULL;
+    gboolean lfIsCompressed = FALSE;
+    char lcFirst[20], lcLast[20];
+    FILE *lpManifest;
+
+    if (lgIn && lgOut)
+    {
+        GZlibCompressor *lgCompressor = g_zlib_compressor_new(G_ZLIB_COMPRESSOR_FORMAT_GZIP, -1);
+        GOutputStream *lgZip = g_converter_output_stream_new(G_OUTPUT_STREAM(lgOut), G_CONVERTER(lgCompressor));
+
+        if (g_output_stream_splice(lgZip, G_INPUT_STREAM(lgIn),
+                                   G_OUTPUT_STREAM_SPLICE_CLOSE_SOURCE | G_OUTPUT_STREAM_SPLICE_CLOSE_TARGET,
+                                   NULL, &error) >= 0 &&
+            0 == g_rename(plcTmpName, plcGzName))
+        {
+            g_unlink(lpsSegment->ucName);
+            lfIsCompressed = TRUE;
+        }
+        g_object_unref(lgZip);
+        g_object_unref(lgCompressor);
+    }
+    if (!lfIsCompressed)
+    {
+        g_printerr("Logfile: couldn't compress %s: %s\r\n", lpsSegment->ucName, error ? error->message : g_strerror(errno));
+        g_unlink(plcTmpName);
+    }
+    g_clear_error(&error);
+    if (lgOut) g_object_unref(lgOut);
+    if (lgIn)  g_object_unref(lgIn);
+    g_object_unref(lgOutFile);
+    g_object_unref(lgInFile);
+
+    // List the segment in the manifest
+    lpManifest = fopen(lpsSegment->ucManifest, "a");
+    if (lpManifest)
+    {
+        if (0 == ftell(lpManifest)) fputs("# segment\tfirst\tlast\tlines\tbytes\r\n", lpManifest);
+        logfile_manifest_time(lcFirst, lpsSegment->llFirst_usec);
+        logfile_manifest_time(lcLast,  lpsSegment->llLast_usec);
+        fprintf(lpManifest, "%s\t%s\t%s\t%u\t%llu\r\n",
+                lfIsCompressed ? plcGzName : lpsSegment->ucName, lcFirst, lcLast,
+                lpsSegment->lulLines, (unsigned long long)lpsSegment->lullBytes);
+        fclose(lpManifest);
+    }
+
+    g_free(plcGzName);
+    g_free(plcTmpName);
+    g_free(lpsSegment);
+}
+// end logfile_compress
+
+
+////////////////////////////////////////////////////////////////////////////
+// Name:         logfile_segment_open
+// Description:  Open the logfile, or the next numbered segment
+//               "<base>.NNN.txt" if rotating
+// Parameters:   None
+// Return:       File descriptor, negative on error
+////////////////////////////////////////////////////////////////////////////
+static int
+logfile_segment_open(void)
+{
+    int liFd;
+
+    memset(&gsLogfileSegment, 0, sizeof(gsLogfileSegment));
+    if (logfile_is_rotating())
+    {
+        ++guiLogfileSegmentNumber;
+        snprintf(gsLogfileSegment.ucName, sizeof(gsLogfileSegment.ucName), "%s.%03u.txt", gucLogfileBase, guiLogfileSegmentNumber);
+        snprintf(gsLogfileSegment.ucManifest, sizeof(gsLogfileSegment.ucManifest), "%s.manifest", gucLogfileBase);
+    }
+    else
+    {
+        g_strlcpy(gsLogfileSegment.ucName, gucLogfileName, sizeof(gsLogfileSegment.ucName));
+    }
+
+    // (Open file for append, which creates new file if file doesn't exist yet)
+    liFd = open(gsLogfileSegment.ucName, O_WRONLY | O_CREAT | O_APPEND, 0644);
+    gllLogfileSegmentOpened_usec = g_get_monotonic_time();
+
+    return liFd;
+}
+// end logfile_segment_open
+
+
+////////////////////////////////////////////////////////////////////////////
+// Name:         logfile_segment_close
+// Description:  Close the current segment and queue it for compression
+//               Does nothing to the logfile itself when not rotating
+// Parameters:   None
+// Return:       None
+////////////////////////////////////////////////////////////////////////////
+static void
+logfile_segment_close(void)
+{
+    if (LOGFILE_SYNC_NONE != gucLogfileSyncPolicy) fdatasync(giLogfileFd);
+    close(giLogfileFd);
+    giLogfileFd = -1;
+
+    if (logfile_is_rotating() && gsLogfileSegment.lullBytes)
+    {
+        LogfileSegment *lpsSegment = g_new(LogfileSegment, 1);
+
+        *lpsSegment = gsLogfileSegment;
+        if (!gLogfileCompressPool) gLogfileCompressPool = g_thread_pool_new(logfile_compress, NULL, 1, FALSE, NULL);
+        g_thread_pool_push(gLogfileCompressPool, lpsSegment, NULL);
+    }
+}
+// end logfile_segment_close
+
+
+////////////////////////////////////////////////////////////////////////////
+// Name:         logfile_segment_due
+// Description:  Writer thread - when the current segment reaches its age
+//               limit
+//               Never for an empty segment, or one that doesn't end a
+//               line (a line is never split across segments)
+// Parameters:   None
+// Return:       Monotonic time, usec, G_MAXINT64 if never
+////////////////////////////////////////////////////////////////////////////
+static gint64
+logfile_segment_due(void)
+{
+    if (!gulLogfileRotate_sec || 0 == gsLogfileSegment.lullBytes || !gfLogfileSegmentLineEnd) return G_MAXINT64;
+    return gllLogfileSegmentOpened_usec + (gint64)gulLogfileRotate_sec*G_USEC_PER_SEC;
+}
+// end logfile_segment_due
+
+
+////////////////////////////////////////////////////////////////////////////
+// Name:         logfile_segment_next
+// Description:  Writer thread - close the current segment and start the
+//               next one
+// Parameters:   None
+// Return:       None
+////////////////////////////////////////////////////////////////////////////
+static void
+logfile_segment_next(void)
+{
+    int liFd;
+
+    logfile_segment_close();
+    liFd = logfile_segment_open();
+    if (liFd < 0) g_printerr("Logfile: couldn't open %s: %s\r\n", gsLogfileSegment.ucName, g_strerror(errno));
+    giLogfileFd = liFd;
+}
+// end logfile_segment_next
+
+
+////////////////////////////////////////////////////////////////////////////
+// Name:         logfile_segment_account
+// Description:  Writer thread - account for bytes written to the current
+//               segment, then start a new segment if it is over its size
+//               or age limit
+//               Only rotates when the bytes written end a line, so a
+//               line is never split across segments. A segment that
+//               reaches its age limit while nothing is written is rotated
+//               by logfile_thread() instead
+// Parameters:   lpucBuf  - bytes just written
+//               lulCount - number of bytes
+// Return:       None
+////////////////////////////////////////////////////////////////////////////
+static void
+logfile_segment_account(char *lpucBuf, guint32 lulCount)
+{
+    char *plcChar = lpucBuf;
+    char *plcEnd  = lpucBuf + lulCount;
+
+    if (0 == lulCount) return;
+    if (0 == gsLogfileSegment.lullBytes) gsLogfileSegment.llFirst_usec = g_get_real_time();
+    gsLogfileSegment.llLast_usec = g_get_real_time();
+    gsLogfileSegment.lullBytes += lulCount;
+    while ((plcChar = memchr(plcChar, '\n', plcEnd - plcChar)))
+    {
+        ++gsLogfileSegment.lulLines;
+        ++plcChar;
+    }
+    gfLogfileSegmentLineEnd = ('\n' == lpucBuf[lulCount-1]);
+
+    if (!logfile_is_rotating() || !gfLogfileSegmentLineEnd) return;
+    if ((gullLogfileRotateBytes && gsLogfileSegment.lullBytes >= gullLogfileRotateBytes) ||
+        g_get_monotonic_time() >= logfile_segment_due())
+    {
+        logfile_segment_next();
+    }
+}
+// end logfile_segment_account
+
+
+////////////////////////////////////////////////////////////////////////////
+// Name:         logfile_thread
+// Description:  Writer thread - write everything queued in one go (two
+//               writes if the queue has wrapped), then fdatasync when the
+//               durability policy says so
+//               While idle, also wakes up to fdatasync (every N msec
+//               policy) and to close a segment at its age limit
+// Parameters:   data - unused
+// Return:       NULL
+////////////////////////////////////////////////////////////////////////////
+static gpointer
+logfile_thread(gpointer data)
+{
+    gint64   llNextSync_usec = g_get_monotonic_time() + (gint64)gulLogfileSyncEvery*1000;
+    guint32  lulLinesAtSync  = 0;
+    guint32  lulLinesWritten;
+    guint32  lulChunk;
+    gboolean lfIsDirty = FALSE;
+    gboolean lfSyncNow;
+    gint64   llWake_usec;
+    gint64   llStart_usec;
+    guint64  lullElapsed_usec;
+    guint64  lullTraceStart_ns;
+    cpu_set_t lsCpus;
+
+    if (giLogfileCpu >= 0)
+    {
+        CPU_ZERO(&lsCpus);
+        CPU_SET(giLogfileCpu, &lsCpus);
+        if (0 != sched_setaffinity(0, sizeof(lsCpus), &lsCpus))
+        {
+            g_printerr("Couldn't pin the logfile writer to CPU %d\r\n", giLogfileCpu);
+        }
+    }
+
+    g_mutex_lock(&gLogfileMutex);
+    while (gfLogfileThreadRun || gulLogfileQueueUsed)
+    {
+        // Sleep until there is something to write (or a timed sync, or
+        // the segment's age limit, is due)
+        if (0 == gulLogfileQueueUsed && gfLogfileThreadRun)
+        {
+            llWake_usec = logfile_segment_due();
+            if (LOGFILE_SYNC_MSEC == gucLogfileSyncPolicy && lfIsDirty) llWake_usec = MIN(llWake_usec, llNextSync_usec);
+            if (G_MAXINT64 == llWake_usec)
+            {
+                g_cond_wait(&gLogfileCond, &gLogfileMutex);
+            }
+            else if (!g_cond_wait_until(&gLogfileCond, &gLogfileMutex, llWake_usec) &&
+                     0 == gulLogfileQueueUsed)
+            {
+                // Nothing new arrived in time: fdatasync, if due
+                if (LOGFILE_SYNC_MSEC == gucLogfileSyncPolicy && lfIsDirty && g_get_monotonic_time() >= llNextSync_usec)
+                {
+                    g_mutex_unlock(&gLogfileMutex);
+                    llStart_usec = g_get_monotonic_time();
+                    lullTraceStart_ns = trace_start();
+                    fdatasync(giLogfileFd);
+                    lullElapsed_usec = g_get_monotonic_time() - llStart_usec;
+                    trace_end(TRACE_LOGFILE_DISK, lullTraceStart_ns);
+                    g_mutex_lock(&gLogfileMutex);
+                    logfile_latency_record(lullElapsed_usec);
+                    ++gulLogfileSyncs;
+                    lfIsDirty = FALSE;
+                    llNextSync_usec = g_get_monotonic_time() + (gint64)gulLogfileSyncEvery*1000;
+                }
+
+                // and close the segment, if at its age limit
+                if (g_get_monotonic_time() >= logfile_segment_due())
+                {
+                    g_mutex_unlock(&gLogfileMutex);
+                    logfile_segment_next();
+                    g_mutex_lock(&gLogfileMutex);
+                    lfIsDirty = FALSE;
+                }
+            }
+            continue;
+        }
+
+        // Take everything up to the end of the queue storage
+        lulChunk = MIN(gulLogfileQueueUsed, LOGFILE_QUEUE_BYTES - gulLogfileQueueTail);
+        lulLinesWritten = (lulChunk == gulLogfileQueueUsed) ? gulLogfileLinesQueued : lulLinesAtSync;
+        g_mutex_unlock(&gLogfileMutex);
+
+        llStart_usec = g_get_monotonic_time();
+        lullTraceStart_ns = trace_start();
+        logfile_write_all(&gucLogfileQueue[gulLogfileQueueTail], lulChunk);
+        lfIsDirty = TRUE;
+
+        // Durability policy
+        switch (gucLogfileSyncPolicy)
+        {
+        case LOGFILE_SYNC_MSEC:
+            lfSyncNow = (g_get_monotonic_time() >= llNextSync_usec);
+            break;
+        case LOGFILE_SYNC_LINES:
+            lfSyncNow = (lulLinesWritten - lulLinesAtSync >= gulLogfileSyncEvery);
+            break;
+        default:
+            lfSyncNow = FALSE;
+            break;
+        }
+        if (lfSyncNow)
+        {
+            fdatasync(giLogfileFd);
+            lfIsDirty = FALSE;
+            lulLinesAtSync = lulLinesWritten;
+            llNextSync_usec = g_get_monotonic_time() + (gint64)gulLogfileSyncEvery*1000;
+        }
+        lullElapsed_usec = g_get_monotonic_time() - llStart_usec;
+        trace_end(TRACE_LOGFILE_DISK, lullTraceStart_ns);
+
+        // Next segment?
+        logfile_segment_account(&gucLogfileQueue[gulLogfileQueueTail], lulChunk);
+
+        g_mutex_lock(&gLogfileMutex);
+        gulLogfileQueueTail  = (gulLogfileQueueTail + lulChunk) % LOGFILE_QUEUE_BYTES;
+        gulLogfileQueueUsed -= lulChunk;
+        metrics_gauge(METRICS_LOGFILE_QUEUE, gulLogfileQueueUsed);
+        ++gulLogfileWrites;
+        if (lfSyncNow) ++gulLogfileSyncs;
+        logfile_latency_record(lullElapsed_usec);
+    }
+    g_mutex_unlock(&gLogfileMutex);
+
+    return NULL;
+}
+// end logfile_thread
+
+
+////////////////////////////////////////////////////////////////////////////
+// Name:         logfile_open
+// Description:  Open (for append) the logfile, start its writer thread
+//               and write its intro line
+// Parameters:   paucLogfileName - logfile name
+//               paucIntro       - first line to write to the logfile
+// Return:       TRUE if the logfile is open
+////////////////////////////////////////////////////////////////////////////
+gboolean
+logfile_open(char *paucLogfileName, char *paucIntro)
+{
+    if (lfIsLogfileEnabled) logfile_close();
+
+    memset(gucLogfileName, 0, sizeof(gucLogfileName));
+    g_strlcpy(gucLogfileName, paucLogfileName, sizeof(gucLogfileName));
+
+    // Segments are "<name without .txt>.NNN.txt"
+    g_strlcpy(gucLogfileBase, gucLogfileName, sizeof(gucLogfileBase));
+    if (g_str_has_suffix(gucLogfileBase, ".txt")) gucLogfileBase[strlen(gucLogfileBase)-4] = 0;
+    guiLogfileSegmentNumber = 0;
+    gfLogfileWriteFailed = FALSE;
+
+    giLogfileFd = logfile_segment_open();
+    if (giLogfileFd < 0) return FALSE;
+
+    // Fresh queue and statistics
+    gulLogfileQueueHead = gulLogfileQueueTail = gulLogfileQueueUsed = 0;
+    gulLogfileQueueHighWater = 0;
+    gulLogfileLinesQueued = gulLogfileLinesDropped = 0;
+    gulLogfileWrites = gulLogfileSyncs = 0;
+    gullLogfileWriteMax_usec = 0;
+    memset(gulLogfileLatency, 0, sizeof(gulLogfileLatency));
+
+    gfLogfileThreadRun = TRUE;
+    gLogfileThread = g_thread_new("logfile", logfile_thread, NULL);
+    lfIsLogfileEnabled = TRUE;
+
+    // Write intro text to logfile
+    if (paucIntro) logfile_write(paucIntro);
+
+    return lfIsLogfileEnabled;
+}
+// end logfile_open
+
+
+////////////////////////////////////////////////////////////////////////////
+// Name:         logfile_close
+// Description:  Write out whatever is still queued, stop the writer thread
+//               and close the logfile
+//               The last segment is compressed in the background, see
+//               logfile_finish()
+// Parameters:   None
+// Return:       None
+////////////////////////////////////////////////////////////////////////////
+void
+logfile_close(void)
+{
+    if (gLogfileThread)
+    {
+        g_mutex_lock(&gLogfileMutex);
+        gfLogfileThreadRun = FALSE;
+        g_cond_signal(&gLogfileCond);
+        g_mutex_unlock(&gLogfileMutex);
+        g_thread_join(gLogfileThread);
+        gLogfileThread = NULL;
+    }
+    if (giLogfileFd >= 0) logfile_segment_close();
+    lfIsLogfileEnabled = FALSE;
+}
+// end logfile_close
+
+
+////////////////////////////////////////////////////////////////////////////
+// Name:         logfile_finish
+// Description:  Close the logfile and wait for segment compression to
+//               finish; call before exiting
+// Parameters:   None
+// Return:       None
+////////////////////////////////////////////////////////////////////////////
+void
+logfile_finish(void)
+{
+    logfile_close();
+    if (gLogfileCompressPool)
+    {
+        g_thread_pool_free(gLogfileCompressPool, FALSE, TRUE);
+        gLogfileCompressPool = NULL;
+    }
+}
+// end logfile_finish
+
+
+////////////////////////////////////////////////////////////////////////////
+// Name:         logfile_is_enabled
+// Description:  Is the logfile open?
+// Parameters:   None
+// Return:       TRUE if received messages are being logged
+////////////////////////////////////////////////////////////////////////////
+gboolean
+logfile_is_enabled(void)
+{
+    return lfIsLogfileEnabled;
+}
+// end logfile_is_enabled
+
+
+////////////////////////////////////////////////////////////////////////////
+// Name:         logfile_write
+// Description:  Queue NULL-terminated string for the logfile, with CRLF
+//               Does nothing if the logfile isn't open; the message is
+//               dropped (and counted) if the queue is full
+// Parameters:   paucMessage - pointer to NULL-terminated string
+// Return:       Size of message queued
+////////////////////////////////////////////////////////////////////////////
+int
+logfile_write(char *paucMessage)
+{
+    guint32 lulLength;
+    guint32 lulFirst;
+    guint32 lulNeeded;
+
+    if (!lfIsLogfileEnabled) return 0;
+
+    lulLength = strlen(paucMessage);
+    lulNeeded = lulLength + 2;
+
+    g_mutex_lock(&gLogfileMutex);
+    if (lulNeeded > LOGFILE_QUEUE_BYTES - gulLogfileQueueUsed)
+    {
+        ++gulLogfileLinesDropped;
+        g_mutex_unlock(&gLogfileMutex);
+        return 0;
+    }
+
+    // Copy message, wrapping at the end of the queue storage
+    lulFirst = MIN(lulLength, LOGFILE_QUEUE_BYTES - gulLogfileQueueHead);
+    memcpy(&gucLogfileQueue[gulLogfileQueueHead], paucMessage, lulFirst);
+    memcpy(gucLogfileQueue, paucMessage + lulFirst, lulLength - lulFirst);
+    gulLogfileQueueHead = (gulLogfileQueueHead + lulLength) % LOGFILE_QUEUE_BYTES;
+    gucLogfileQueue[gulLogfileQueueHead] = '\r';
+    gulLogfileQueueHead = (gulLogfileQueueHead + 1) % LOGFILE_QUEUE_BYTES;
+    gucLogfileQueue[gulLogfileQueueHead] = '\n';
+    gulLogfileQueueHead = (gulLogfileQueueHead + 1) % LOGFILE_QUEUE_BYTES;
+
+    gulLogfileQueueUsed += lulNeeded;
+    if (gulLogfileQueueUsed > gulLogfileQueueHighWater) gulLogfileQueueHighWater = gulLogfileQueueUsed;
+    metrics_gauge(METRICS_LOGFILE_QUEUE, gulLogfileQueueUsed);
+    ++gulLogfileLinesQueued;
+
+    // Wake the writer if it was idle; otherwise this line joins its next write
+    if (gulLogfileQueueUsed == lulNeeded) g_cond_signal(&gLogfileCond);
+    g_mutex_unlock(&gLogfileMutex);
+
+    return (int)lulLength;
+}
+// end logfile_write
+
+
+////////////////////////////////////////////////////////////////////////////
+// Name:         logfile_set_sync
+// Description:  Set the durability policy from a string:
+//                 "none"     - leave it to the OS
+//                 "msec:N"   - fdatasync at most N msec after a write
+//                 "lines:N"  - fdatasync every N lines
+//               Takes effect the next time the logfile is opened
+// Parameters:   paucSpec - policy string
+// Return:       TRUE if the string was understood
+////////////////////////////////////////////////////////////////////////////
+gboolean
+logfile_set_sync(char *paucSpec)
+{
+    char *plcEnd;
+    unsigned long lulEvery;
+
+    if (0 == strcmp(paucSpec, "none"))
+    {
+        gucLogfileSyncPolicy = LOGFILE_SYNC_NONE;
+        return TRUE;
+    }
+
+    if (0 == strncmp(paucSpec, "msec:", 5))
+    {
+        lulEvery = strtoul(paucSpec+5, &plcEnd, 10);
+        if (*plcEnd || 0 == lulEvery) return FALSE;
+        gucLogfileSyncPolicy = LOGFILE_SYNC_MSEC;
+    }
+    else if (0 == strncmp(paucSpec, "lines:", 6))
+    {
+        lulEvery = strtoul(paucSpec+6, &plcEnd, 10);
+        if (*plcEnd || 0 == lulEvery) return FALSE;
+        gucLogfileSyncPolicy = LOGFILE_SYNC_LINES;
+    }
+    else
+    {
+        return FALSE;
+    }
+    gulLogfileSyncEvery = (guint32)lulEvery;
+
+    return TRUE;
+}
+// end logfile_set_sync
+
+
+////////////////////////////////////////////////////////////////////////////
+// Name:         logfile_set_rotate
+// Description:  Set the rotation limits from a comma-separated string:
+//                 "none"     - one logfile, no rotation
+//                 "mb:N"     - new segment after N MB
+//                 "hours:N"  - new segment after N hours
+//               e.g. "mb:100,hours:24"
+//               Takes effect the next time the logfile is opened
+// Parameters:   paucSpec - rotation string
+// Return:       TRUE if the string was understood
+////////////////////////////////////////////////////////////////////////////
+gboolean
+logfile_set_rotate(char *paucSpec)
+{
+    gchar **pplcItems;
+    gchar **pplcItem;
+    char *plcEnd;
+    unsigned long lulValue;
+    guint64 lullBytes = 0;
+    guint32 lulSeconds = 0;
+    gboolean lfIsOK = TRUE;
+
+    if (0 == strcmp(paucSpec, "none"))
+    {
+        gullLogfileRotateBytes = 0;
+        gulLogfileRotate_sec   = 0;
+        return TRUE;
+    }
+
+    pplcItems = g_strsplit(paucSpec, ",", -1);
+    for (pplcItem = pplcItems; *pplcItem && lfIsOK; ++pplcItem)
+    {
+        if (0 == strncmp(*pplcItem, "mb:", 3))
+        {
+            lulValue = strtoul(*pplcItem+3, &plcEnd, 10);
+            lullBytes = (guint64)lulValue*1024*1024;
+        }
+        else if (0 == strncmp(*pplcItem, "hours:", 6))
+        {
+            lulValue = strtoul(*pplcItem+6, &plcEnd, 10);
+            lulSeconds = (guint32)lulValue*60*60;
+        }
+        else
+        {
+            lfIsOK = FALSE;
+            break;
+        }
+        if (*plcEnd || 0 == lulValue) lfIsOK = FALSE;
+    }
+    g_strfreev(pplcItems);
+
+    if (lfIsOK)
+    {
+        gullLogfileRotateBytes = lullBytes;
+        gulLogfileRotate_sec   = lulSeconds;
+    }
+    return lfIsOK;
+}
+// end logfile_set_rotate
+
+
+////////////////////////////////////////////////////////////////////////////
+// Name:         logfile_set_cpu
+// Description:  Pin the writer thread to a CPU (--pin=logger:N)
+//               Takes effect the next time the logfile is opened
+// Parameters:   liCpu - CPU number, -1 for any
+// Return:       None
+////////////////////////////////////////////////////////////////////////////
+void
+logfile_set_cpu(int liCpu)
+{
+    giLogfileCpu = liCpu;
+}
+// end logfile_set_cpu
+
+
+////////////////////////////////////////////////////////////////////////////
+// Name:         logfile_report
+// Description:  Format the logfile writer statistics for Status:
+//               queue depth and high-water, lines dropped, number of
+//               writes/syncs and write latency percentiles
+// Parameters:   paucReport - buffer for the report, CRLF terminated
+//               lulSize    - size of buffer
+// Return:       None
+////////////////////////////////////////////////////////////////////////////
+void
+logfile_report(char *paucReport, guint32 lulSize)
+{
+    g_mutex_lock(&gLogfileMutex);
+    snprintf(paucReport, lulSize,
+             "Logfile: %u lines, %u dropped, queue %u bytes (high-water %u of %u), "
+             "%u writes, %u syncs, latency p50 <%luus p99 <%luus max %luus\r\n",
+             gulLogfileLinesQueued, gulLogfileLinesDropped,
+             gulLogfileQueueUsed, gulLogfileQueueHighWater, (guint32)LOGFILE_QUEUE_BYTES,
+             gulLogfileWrites, gulLogfileSyncs,
+             (unsigned long)logfile_latency_percentile(50),
+             (unsigned long)logfile_latency_percentile(99),
+             (unsigned long)gullLogfileWriteMax_usec);
+    g_mutex_unlock(&gLogfileMutex);
+}
+// end logfile_report
+
+
+////////////////////////////////////////////////////////////////////////////
+// Name:         logfile_memory
+// Description:  Memory footprint of the writer queue
+// Parameters:   palReserved - set to bytes reserved
+//               palUsed     - set to bytes waiting to be written
+// Return:       None
+////////////////////////////////////////////////////////////////////////////
+void
+logfile_memory(guint32 *palReserved, guint32 *palUsed)
+{
+    g_mutex_lock(&gLogfileMutex);
+    *palReserved = LOGFILE_QUEUE_BYTES;
+    *palUsed     = gulLogfileQueueUsed;
+    g_mutex_unlock(&gLogfileMutex);
+}
+// end logfile_memory
+
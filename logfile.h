@@ -0,0 +1,57 @@
+/*
+ * File:   logfile.h
+ * Author: Mark Bersalona
+ *
+ * Created on 2024.07.15
+ */
+
+#ifndef LOGFILE_H
+#define LOGFILE_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Definitions
+//
+///////////////////////////////////////////////////////////////////////////////
+
+// Durability policy, see logfile_set_sync()
+#define LOGFILE_SYNC_NONE   (0)
+#define LOGFILE_SYNC_MSEC   (1)
+#define LOGFILE_SYNC_LINES  (2)
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Public routines
+//
+///////////////////////////////////////////////////////////////////////////////
+
+void logfile_close(void);
+void logfile_finish(void);
+gboolean logfile_is_enabled(void);
+void logfile_memory(guint32 *palReserved, guint32 *palUsed);
+gboolean logfile_open(char *paucLogfileName, char *paucIntro);
+void logfile_report(char *paucReport, guint32 lulSize);
+void logfile_set_cpu(int liCpu);
+gboolean logfile_set_rotate(char *paucSpec);
+gboolean logfile_set_sync(char *paucSpec);
+int logfile_write(char *paucMessage);
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Public variables
+//
+///////////////////////////////////////////////////////////////////////////////
+
+extern char gucLogfileName[100];
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* LOGFILE_H */
+
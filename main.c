@@ -12,7 +12,9 @@
 //
 ///////////////////////////////////////////////////////////////////////////////
 
+#define _GNU_SOURCE         // clock_gettime(CLOCK_BOOTTIME), sysconf
 #include <gtk/gtk.h>
+#include <glib-unix.h>
 //#include <json-glib/json-glib.h>
 //#include <glib-object.h>
 //#include <gobject/gvaluecollector.h>
@@ -23,10 +25,29 @@
 #include <string.h>
 #include <time.h>
 #include <ctype.h>
+#include <unistd.h>
+#include <signal.h>
 #include "main.h"
 #include "gconfig.h"
 #include "serial.h"
 #include "display.h"
+#include "fifo.h"
+#include "logfile.h"
+#include "parse.h"
+#include "sessionlog.h"
+#include "replay.h"
+#include "export.h"
+#include "fanout.h"
+#include "flightrec.h"
+#include "timefmt.h"
+#include "timerwheel.h"
+#include "metrics.h"
+#include "trace.h"
+#include "budget.h"
+#include "pipeline.h"
+#include "plugin.h"
+#include "sequence.h"
+#include "correlate.h"
 
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -35,7 +56,12 @@
 //
 ///////////////////////////////////////////////////////////////////////////////
 
-#define GLADE_LAYOUT ("WSG30TemperatureDisplayDiagnostic.glade")
+// Glade layout and CSS theme, compiled into the executable
+// (see WSG30TempDisplayDiagnostic.gresource.xml)
+#define GLADE_LAYOUT ("/com/sensaphone/wsg30tempdisplay/WSG30TemperatureDisplayDiagnostic.glade")
+#define CSS_THEME    ("/com/sensaphone/wsg30tempdisplay/theme.css")
+
+#define SERIAL_PORT  ("/dev/ttyUSB0")
 
 
 
@@ -53,46 +79,59 @@ GtkBuilder *builder;
 
 char lcTempMainString[250];
 
-// Receive message FIFO
-char gucReceiveFIFO[RECEIVE_FIFO_MSG_COUNT][RECEIVE_FIFO_MSG_LENGTH_MAX];
-guint16 guiReceiveFIFOWriteIndex;
-guint16 guiReceiveFIFOReadIndex;
+// Binary session log alongside the text logfile (--log-binary)
+static gboolean gfMainLogBinary = FALSE;
+static guint8   gucMainSessionlogPort;
+
+// Telemetry export alongside the text logfile (--export)
+static gboolean gfMainExport = FALSE;
+
+// Pipeline tracing (--trace)
+static gboolean gfMainTrace = FALSE;
+
+// Staged reader/parser/UI threads (--pipeline)
+static gboolean gfMainPipeline = FALSE;
+
+// Capture replay speeds, in cbtReplaySpeed order
+static guint16 guiMainReplaySpeeds[] = { 1, 10, REPLAY_SPEED_MAX };
+
+// Test sequence being run (Run sequence)
+static char gcMainSequenceName[200];
 
 // UNIX timestamp
 guint32 gulUNIXTimestamp;
-// Elapsed time since last data update
-guint32 gulElapsedTimeSinceDataUpdate_sec;
-// Glib date/time
-GDateTime *gDateTime;
-// Countdown minutes to Status timestamp
+// Monotonic time of last data update (data age is measured from it,
+// so it's right however late the periodic callback runs)
+gint64 gllDataUpdate_usec;
+// Minutes to Status timestamp: 1 after the last Status write,
+// then backing off through the table while Status stays quiet
 #define TIMESTAMP_DELAY_TABLE_COUNT (13)
-guint16 guiStatusTimestampCountdown_minutes = 0;
-guint8  guiStatusTimestampCountdownIndex    = 0;
-guint8  uiStatusTimestampCountdownIndex_OLD = 0;
-guint16 uiStatusTimestampCountdownTable[TIMESTAMP_DELAY_TABLE_COUNT] = 
+static guint8  gucStatusTimestampDelayIndex = 0;
+static guint16 uiStatusTimestampDelayTable[TIMESTAMP_DELAY_TABLE_COUNT] = 
 {
     5, 6, 6, 7, 8, 10, 13, 18, 28, 39, 60, 120, 240
 };
-// Device initial and current timestamps
-guint32 gulDeviceStartTimestamp   = 0;
-guint32 gulDeviceCurrentTimestamp = 0;
-guint32 gulDeviceRuntime_seconds;
-
-// Logfile
-GIOChannel *gioChannelLogfile;
-char lcLogfileName[100];
-gboolean lfIsLogfileEnabled;
-
-// I/O channel for serial-to-USB port
-GIOChannel *gIOChannelSerialUSB;
-
-// Sticky error status
-char gucStickyErrorStatus[200];
-char gucStickyErrorStatusOLD[200];
-
-// Sticky Status
-#define STICKY_ERROR_COUNT_PERIOD_SECONDS 600
-static guint16 guiStickyErrorCountdown_sec = STICKY_ERROR_COUNT_PERIOD_SECONDS;
+// Housekeeping timers
+static TimerwheelTimer gsMainSecondTimer;
+static TimerwheelTimer gsMainReceiveClearTimer;
+static TimerwheelTimer gsMainStatusClearTimer;
+static TimerwheelTimer gsMainHourlyTimer;
+static TimerwheelTimer gsMainStatusTimestampTimer;
+static TimerwheelTimer gsMainMetricsTimer;
+// Startup timing: process start time (monotonic usec),
+// and whether the first frame and first received line have been seen
+static gint64   gllStartupProcessStart_usec;
+static gboolean gfStartupFirstFrame = TRUE;
+static gboolean gfStartupFirstLine  = TRUE;
+
+// Parser hooks for the GTK display
+static ParseHooks gsMainParseHooks =
+{
+    display_status_write,
+    display_field_update,
+    display_connection_update,
+    display_clear_UUT_values,
+};
 
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -103,23 +142,65 @@ static guint16 guiStickyErrorCountdown_sec = STICKY_ERROR_COUNT_PERIOD_SECONDS;
 
 
 ////////////////////////////////////////////////////////////////////////////
-// Name:         trim
-// Description:  Trims the given string of leading and trailing spaces
-//               Uses isspace() to determine what's a "space"
-//               By Johannes Schaub, 2008.12.09
-//               stackoverflow.com/questions/352055/
-//                 best-algorithm-to-strip-leading-and-trailing-spaces-in-c
-// Parameters:   Pointer to start of string to trim
-// Return:       Pointer to null-terminated trimmed string
+// Name:         main_startup_process_start
+// Description:  When this process started, on the g_get_monotonic_time()
+//               clock. Uses the process start time from /proc/self/stat
+//               so the time spent loading libraries before main() counts;
+//               falls back to "now" if that isn't available
+// Parameters:   None
+// Return:       Process start time, monotonic usec
 ////////////////////////////////////////////////////////////////////////////
-char* trim(char* paucInputString)
+static gint64
+main_startup_process_start(void)
 {
-    char* e = paucInputString + strlen(paucInputString) - 1;
-    while (*paucInputString && isspace(*paucInputString)) paucInputString++;
-    while (e > paucInputString && isspace(*e)) *e-- = '\0';
-    return paucInputString;
+    gint64 llNow_usec = g_get_monotonic_time();
+    gchar *plcStat = NULL;
+    gchar *plcField;
+    unsigned long long lullStartTicks;
+    struct timespec lsBootTime;
+    gint64 llProcessAge_usec;
+    int i;
+
+    if (!g_file_get_contents("/proc/self/stat", &plcStat, NULL, NULL)) return llNow_usec;
+
+    // Field 22 is starttime, clock ticks after boot; count fields after
+    // the ")" that ends the command name (field 2)
+    plcField = strrchr(plcStat, ')');
+    for (i = 2; plcField && i < 22; ++i) plcField = strchr(plcField+1, ' ');
+    if (plcField && 1 == sscanf(plcField, " %llu", &lullStartTicks) &&
+        0 == clock_gettime(CLOCK_BOOTTIME, &lsBootTime))
+    {
+        llProcessAge_usec = (gint64)lsBootTime.tv_sec*G_USEC_PER_SEC + lsBootTime.tv_nsec/1000 -
+                            (gint64)(lullStartTicks * G_USEC_PER_SEC / sysconf(_SC_CLK_TCK));
+        if (llProcessAge_usec > 0 && llProcessAge_usec < 60*G_USEC_PER_SEC) llNow_usec -= llProcessAge_usec;
+    }
+    g_free(plcStat);
+    return llNow_usec;
 }
-// end trim
+// end main_startup_process_start
+
+
+////////////////////////////////////////////////////////////////////////////
+// Name:         main_startup_report
+// Description:  Report a startup milestone, as milliseconds after
+//               process start, to Status and stdout
+// Parameters:   paucMilestone - what just happened
+// Return:       None
+////////////////////////////////////////////////////////////////////////////
+static void
+main_startup_report(char *paucMilestone)
+{
+    char lcStartupString[100];
+
+    sprintf(lcStartupString, "Startup: %s %.1f ms after process start\r\n", paucMilestone,
+            (g_get_monotonic_time() - gllStartupProcessStart_usec)/1000.0);
+    display_status_write(lcStartupString);
+    g_print("%s", lcStartupString);
+}
+// end main_startup_report
+
+
+
 
 
 
@@ -214,6 +295,26 @@ void main_CALDATE_clicked(void)
 }
 // end main_CALDATE_clicked
 
+////////////////////////////////////////////////////////////////////////////
+// Name:         main_first_frame
+// Description:  Callback routine - main window drawn
+//               Reports the first frame's startup time, then disconnects
+// Parameters:   Standard "draw" signal parameters, unused
+// Return:       FALSE, so drawing carries on
+////////////////////////////////////////////////////////////////////////////
+static gboolean
+main_first_frame(GtkWidget *widget, cairo_t *cr, gpointer data)
+{
+    if (gfStartupFirstFrame)
+    {
+        gfStartupFirstFrame = FALSE;
+        main_startup_report("first frame");
+    }
+    g_signal_handlers_disconnect_by_func(widget, G_CALLBACK(main_first_frame), data);
+    return FALSE;
+}
+// end main_first_frame
+
 ////////////////////////////////////////////////////////////////////////////
 // Name:         main_LOGENABLE_state_set
 // Description:  Callback routine - logfile enable switch clicked
@@ -222,24 +323,73 @@ void main_CALDATE_clicked(void)
 ////////////////////////////////////////////////////////////////////////////
 void main_LOGENABLE_state_set(void)
 {
-    lfIsLogfileEnabled = gtk_switch_get_active(GTK_SWITCH(swLogfileEnable));
-    if (lfIsLogfileEnabled)
+    char lcLogfileName[100];
+    char lcDate[32];
+    gboolean lfIsOpen;
+
+    if (gtk_switch_get_active(GTK_SWITCH(swLogfileEnable)))
     {
         // Logfile has just been enabled, build timestamp filename and open file
-        memset(lcLogfileName, 0, sizeof(lcLogfileName));
-        sprintf(lcLogfileName, "%s WSG30TempDisplay.txt", g_date_time_format(gDateTime, "%Y%m%d %H%M"));
-        sprintf(lcTempMainString, "Logfile %s opened\r\n", lcLogfileName);
+        strftime(lcDate, sizeof(lcDate), "%Y%m%d %H%M", timefmt_tm());
+        sprintf(lcLogfileName, "%s WSG30TempDisplay.txt", lcDate);
+        strftime(lcDate, sizeof(lcDate), "%Y.%m.%d %H:%M", timefmt_tm());
+        sprintf(lcTempMainString, "---------- Sensaphone WSG30 Temperature Display logfile, opened %s local time -----------", lcDate);
+        pipeline_lock();
+        lfIsOpen = logfile_open(lcLogfileName, lcTempMainString);
+        pipeline_unlock();
+        if (!lfIsOpen)
+        {
+            sprintf(lcTempMainString, "***ERROR*** couldn't open logfile %s\r\n", lcLogfileName);
+            display_status_write(lcTempMainString);
+
+            // Set the switch back OFF, without coming back here to close it
+            g_signal_handlers_block_by_func(swLogfileEnable, G_CALLBACK(main_LOGENABLE_state_set), NULL);
+            gtk_switch_set_active(GTK_SWITCH(swLogfileEnable), FALSE);
+            gtk_switch_set_state(GTK_SWITCH(swLogfileEnable), FALSE);
+            g_signal_handlers_unblock_by_func(swLogfileEnable, G_CALLBACK(main_LOGENABLE_state_set), NULL);
+            return;
+        }
+
+        sprintf(lcTempMainString, "Logfile %s opened\r\n", gucLogfileName);
         display_status_write(lcTempMainString);
-        gtk_label_set_text(GTK_LABEL(lblLogfile), lcLogfileName);
-        // (Open file for append, which creates new file if file doesn't exist yet)
-        gioChannelLogfile = g_io_channel_new_file(lcLogfileName, "a", NULL);
-        //g_io_channel_set_encoding(gioChannelLogfile, NULL, NULL);
+        gtk_label_set_text(GTK_LABEL(lblLogfile), gucLogfileName);
+
+        // Binary session log, same name with .wsl
+        if (gfMainLogBinary)
+        {
+            g_strlcpy(lcLogfileName + strlen(lcLogfileName) - 4, ".wsl", 5);
+            pipeline_lock();
+            lfIsOpen = sessionlog_open(lcLogfileName);
+            if (lfIsOpen) gucMainSessionlogPort = sessionlog_port(SERIAL_PORT);
+            pipeline_unlock();
+            if (lfIsOpen)
+            {
+                sprintf(lcTempMainString, "Session log %s opened\r\n", lcLogfileName);
+            }
+            else
+            {
+                sprintf(lcTempMainString, "***ERROR*** couldn't open session log %s\r\n", lcLogfileName);
+            }
+            display_status_write(lcTempMainString);
+        }
 
-        // Write intro text to logfile
-        memset(lcTempMainString, 0, sizeof(lcTempMainString));
-        sprintf(lcTempMainString, "---------- Sensaphone WSG30 Temperature Display logfile, opened %s local time -----------", 
-                                                          g_date_time_format(gDateTime, "%Y.%m.%d %H:%M") );
-        main_logfile_write(lcTempMainString);
+        // Telemetry export, same name with .csv/.wsc
+        if (gfMainExport)
+        {
+            lcLogfileName[strlen(lcLogfileName) - 4] = 0;
+            pipeline_lock();
+            lfIsOpen = export_open(lcLogfileName);
+            pipeline_unlock();
+            if (lfIsOpen)
+            {
+                sprintf(lcTempMainString, "Telemetry export %s opened\r\n", lcLogfileName);
+            }
+            else
+            {
+                sprintf(lcTempMainString, "***ERROR*** couldn't open telemetry export %s\r\n", lcLogfileName);
+            }
+            display_status_write(lcTempMainString);
+        }
 
         // Set the switch state to ON
         gtk_switch_set_state(GTK_SWITCH(swLogfileEnable), TRUE);
@@ -247,8 +397,14 @@ void main_LOGENABLE_state_set(void)
     else
     {
         // Logfile has just been disabled, close the logfile and blank the displayed log filename
-        g_io_channel_shutdown(gioChannelLogfile, TRUE, NULL);
-        sprintf(lcTempMainString, "Logfile %s is now closed\r\n", lcLogfileName);
+        pipeline_lock();
+        logfile_close();
+        sessionlog_close();
+        export_close();
+        pipeline_unlock();
+        logfile_report(lcTempMainString, sizeof(lcTempMainString));
+        display_status_write(lcTempMainString);
+        sprintf(lcTempMainString, "Logfile %s is now closed\r\n", gucLogfileName);
         display_status_write(lcTempMainString);
         gtk_label_set_text(GTK_LABEL(lblLogfile), "----------------------------------------------------");
 
@@ -402,611 +558,578 @@ void main_VREF_clicked(void)
 
 
 
-///////////////////////////////////////////////////////////////////////////////
-//
-// Main application
-//
-///////////////////////////////////////////////////////////////////////////////
-
 ////////////////////////////////////////////////////////////////////////////
-// Name:         main_parse_msg
-// Description:  Parse a string for detectable data
-// Parameters:   paucReceiveMsg - pointer to received NULL-terminated string
+// Name:         main_REPLAY_clicked
+// Description:  Callback routine - Open capture/Stop replay button clicked
+//               Choose a saved logfile, rotated segment or session log and
+//               replay it through the display, or stop the replay and go
+//               back to live data
+// Parameters:   None
 // Return:       None
 ////////////////////////////////////////////////////////////////////////////
-void 
-main_parse_msg(char *paucReceiveMsg)
+void main_REPLAY_clicked(void)
 {
-    char *plcDetected;
-    char *plcQuoteStart;
-    char *plcQuoteEnd;
-    char *plcPercentage;
-    char *plcHumidity;
-    char *plcDetectedParam;
-    char *plcSpace;
-
-    // For zone number, type and type description
-    char lcZoneNumberBuf[4];
-    uint8_t lucZoneNumber;
-    char lcZoneTypeBuf[4];
-    uint8_t lucZoneType;
-    int liZoneValue;
-    char lcZoneTypeName[20];
-
-    // For zone alarm statuses
-    char lcZoneAlarmBuf[4];
-    uint8_t lucZoneAlarm;
-    char lcZoneRangeBuf[4];
-    uint8_t lucZoneRange;
-    char lcZoneUnackBuf[4];
-    uint8_t lucZoneUnack;
-    char lcZoneAlarmColor[30];
-
-    // Look for *** WARNING ***
-    plcDetected = strstr((char*)paucReceiveMsg, "*** WARNING ***");
-    if (plcDetected)
+    GtkWidget *lgDialog;
+    GtkFileFilter *lgFilter;
+    GError *error = NULL;
+    gchar *plcName;
+    gboolean lfIsOpen;
+
+    if (replay_is_active())
     {
-        // Write the entire warning, including *** WARNING ***, to Status
-        // (but only if there's a significant string following)
-        memset (lcTempMainString, 0, sizeof(lcTempMainString));
-        memcpy (lcTempMainString, plcDetected, sizeof(lcTempMainString));
-        if (strlen(lcTempMainString) > 20)
-        {
-            display_status_write(lcTempMainString);
-            display_status_write("\r\n");
-        }
+        pipeline_lock();
+        replay_close();
+        pipeline_unlock();
+        display_status_write("Replay stopped, back to live data\r\n");
+        gtk_button_set_label(GTK_BUTTON(btnReplayOpen), "Open capture");
+        gtk_widget_set_sensitive(scaleReplay, FALSE);
+        gtk_range_set_value(GTK_RANGE(scaleReplay), 0.0);
+        gtk_label_set_text(GTK_LABEL(lblReplay), "Live");
+        display_clear_UUT_values();
+        return;
     }
-    
-    // Look for *** ERROR ***
-    plcDetected = strstr((char*)paucReceiveMsg, "*** ERROR ***");
-    if (plcDetected)
-    {
-        // Write the entire error, including *** ERROR ***, to Status
-        // (but only if there's a significant string following)
-        memset (lcTempMainString, 0, sizeof(lcTempMainString));
-        memcpy (lcTempMainString, plcDetected, sizeof(lcTempMainString));
-        if (strlen(lcTempMainString) > 20)
-        {
-            display_status_write(lcTempMainString);
-            display_status_write("\r\n");
 
-            // Save error message as a sticky one
-            strcpy(gucStickyErrorStatus, lcTempMainString);
-        }
-    }
-    
-    // Look for "Sensaphone WSG30 Temperature Sensor Display starting..."
-    plcDetected = strstr((char*)paucReceiveMsg, "Sensaphone WSG30 Temperature Sensor Display starting...");
-    if (plcDetected)
+    // A running sequence is waiting on live lines, which a replay hides
+    if (sequence_is_running())
     {
-        // This is a new UUT or the old UUT restarting
-        // Either way, reset the Diagnostic tool display
-        display_clear_UUT_values();
+        display_status_write("Stop the sequence before replaying a capture\r\n");
+        return;
     }
-    
-    // Look for "Board revision = "
-    plcDetected = strstr((char*)paucReceiveMsg, "Board revision = ");
-    if (plcDetected)
+
+    lgDialog = gtk_file_chooser_dialog_new("Open capture", window, GTK_FILE_CHOOSER_ACTION_OPEN,
+                                           "_Cancel", GTK_RESPONSE_CANCEL,
+                                           "_Open",   GTK_RESPONSE_ACCEPT,
+                                           NULL);
+    lgFilter = gtk_file_filter_new();
+    gtk_file_filter_set_name(lgFilter, "Logfiles, segments and session logs");
+    gtk_file_filter_add_pattern(lgFilter, "*.txt");
+    gtk_file_filter_add_pattern(lgFilter, "*.txt.gz");
+    gtk_file_filter_add_pattern(lgFilter, "*.wsl");
+    gtk_file_chooser_add_filter(GTK_FILE_CHOOSER(lgDialog), lgFilter);
+    if (GTK_RESPONSE_ACCEPT != gtk_dialog_run(GTK_DIALOG(lgDialog)))
     {
-        // Write the board rev to Status and to the board rev label
-        memset (lcTempMainString, 0, sizeof(lcTempMainString));
-        memcpy (lcTempMainString, plcDetected+17, strlen(plcDetected+17));
-        display_status_write("Detected Board revision: ");
-        display_status_write(lcTempMainString);
-        display_status_write("\r\n");
-        //gtk_label_set_text(GTK_LABEL(lblBoardRev), lcTempMainString);
+        gtk_widget_destroy(lgDialog);
+        return;
     }
-    
-    // Look for "WSG30 Temperature Display firmware version is "
-    plcDetected = strstr((char*)paucReceiveMsg, "WSG30 Temperature Display firmware version is ");
-    if (plcDetected)
+    plcName = gtk_file_chooser_get_filename(GTK_FILE_CHOOSER(lgDialog));
+    gtk_widget_destroy(lgDialog);
+
+    pipeline_lock();
+    lfIsOpen = replay_open(plcName, &error);
+    pipeline_unlock();
+    if (!lfIsOpen)
     {
-        // Write the WSG30 Temperature Sensor FW version to Status
-        memset (lcTempMainString, 0, sizeof(lcTempMainString));
-        memcpy (lcTempMainString, plcDetected+46, strlen(plcDetected+46));
-        display_status_write("Detected WSG30 Temperature Display firmware version: ");
+        sprintf(lcTempMainString, "***ERROR*** couldn't open capture: %.200s\r\n", error->message);
         display_status_write(lcTempMainString);
-        display_status_write("\r\n");
-        gtk_label_set_text(GTK_LABEL(lblFWVer), lcTempMainString);
+        g_clear_error(&error);
+        g_free(plcName);
+        return;
     }
-    
-    // Look for "Network_Connection_StateMachine: Transitioning from "
-    plcDetected = strstr((char*)paucReceiveMsg, "Network_Connection_StateMachine: Transitioning from ");
-    if (plcDetected)
-    {
-        // Write the network online state transition to Status
-        display_status_write(paucReceiveMsg);
-        display_status_write("\r\n");
 
-        // Get the new connection state
-        plcDetectedParam = strstr((char*)paucReceiveMsg, " to ");
-        if (plcDetectedParam)
-        {
-            memset (lcTempMainString, 0, sizeof(lcTempMainString));
-            memcpy (lcTempMainString, plcDetectedParam+4, strlen(trim(plcDetectedParam+4)));
-            gtk_label_set_text(GTK_LABEL(lblConnection), lcTempMainString);
-            if ( strstr((char*)lcTempMainString, "CONNECTED") )
-            {
-                gtk_widget_set_name((lblConnection),     "ConnectionOK");     // green
+    // Start from a clean display
+    display_clear_UUT_values();
+    replay_set_speed(guiMainReplaySpeeds[gtk_combo_box_get_active(GTK_COMBO_BOX(cbtReplaySpeed))]);
+    sprintf(lcTempMainString, "Replaying %.200s (live data is logged but not displayed)\r\n", plcName);
+    display_status_write(lcTempMainString);
+    gtk_button_set_label(GTK_BUTTON(btnReplayOpen), "Stop replay");
+    gtk_widget_set_sensitive(scaleReplay, TRUE);
+    gtk_label_set_text(GTK_LABEL(lblReplay), plcName);
+    g_free(plcName);
+}
+// end main_REPLAY_clicked
 
-                // Clear sticky error status, prep for the next one
-                memset(gucStickyErrorStatus, 0x00, sizeof(gucStickyErrorStatus));
-                guiStickyErrorCountdown_sec = STICKY_ERROR_COUNT_PERIOD_SECONDS;
-                gtk_label_set_text(GTK_LABEL(lblStatusTitle),  "Status");
-            }
-            else
-            {
-                gtk_widget_set_name((lblConnection),     "DiagnosticValue");  // white
-            }
-        }
-    }
-    
-    // Look for " seconds to Diagnostic mode disable..."
-    plcDetected = strstr((char*)paucReceiveMsg, " seconds to Diagnostic mode disable...");
-    if (plcDetected)
+
+////////////////////////////////////////////////////////////////////////////
+// Name:         main_sequence_finished
+// Description:  Sequence hook - the sequence passed, failed or was stopped
+// Parameters:   lfIsPassed - TRUE if every step passed
+// Return:       None
+////////////////////////////////////////////////////////////////////////////
+static void
+main_sequence_finished(gboolean lfIsPassed)
+{
+    gtk_button_set_label(GTK_BUTTON(btnSequence), "Run sequence");
+    sprintf(lcTempMainString, "%s %s", gcMainSequenceName, lfIsPassed ? "PASSED" : "FAILED");
+    gtk_label_set_text(GTK_LABEL(lblSequence), lcTempMainString);
+}
+// end main_sequence_finished
+
+
+////////////////////////////////////////////////////////////////////////////
+// Name:         main_SEQUENCE_clicked
+// Description:  Callback routine - Run sequence/Stop sequence button
+//               clicked
+//               Choose a send/expect script and run it against the live
+//               received lines, or stop the one running
+// Parameters:   None
+// Return:       None
+////////////////////////////////////////////////////////////////////////////
+void main_SEQUENCE_clicked(void)
+{
+    GtkWidget *lgDialog;
+    GtkFileFilter *lgFilter;
+    GError *error = NULL;
+    gchar *plcName;
+    SequenceHooks lsSequenceHooks = { display_status_write, main_sequence_finished };
+
+    if (sequence_is_running())
     {
-        // UUT has started up, waiting for keypress to go into Diagnostic mode
-        // Send a sacrificial dummy string to enable Diagnostic mode
-        serial_write("+++ 1  2  3  Sensaphone WSG30 Temperature Display Diagnostic tool reporting...\r\n");
+        sequence_stop();
+        return;
     }
-    
-    // Look for "+++ Start DIAGNOSTIC MODE +++"
-    plcDetected = strstr((char*)paucReceiveMsg, "+++ Start DIAGNOSTIC MODE +++");
-    if (plcDetected)
+    if (replay_is_active())
     {
-        // Diagnostic mode is enabled on the UUT
-        // Send a sacrificial dummy string to "initialize" serial_write()
-        // and UUT Diagnostic receive
-        //serial_write("+++");
-        //serial_write("+++ 1  2  3  Sensaphone WSG30 Temperature Display Diagnostic tool reporting...\r\n");
+        display_status_write("Stop the replay before running a sequence, it needs live data\r\n");
+        return;
     }
-    
-    // Look for "InputTask: Battery reading: " then "Percentage "
-    plcDetected = strstr((char*)paucReceiveMsg, "InputTask: Battery reading: ");
-    if (plcDetected)
+
+    lgDialog = gtk_file_chooser_dialog_new("Run sequence", window, GTK_FILE_CHOOSER_ACTION_OPEN,
+                                           "_Cancel", GTK_RESPONSE_CANCEL,
+                                           "_Run",    GTK_RESPONSE_ACCEPT,
+                                           NULL);
+    lgFilter = gtk_file_filter_new();
+    gtk_file_filter_set_name(lgFilter, "Sequences");
+    gtk_file_filter_add_pattern(lgFilter, "*.seq");
+    gtk_file_chooser_add_filter(GTK_FILE_CHOOSER(lgDialog), lgFilter);
+    if (GTK_RESPONSE_ACCEPT != gtk_dialog_run(GTK_DIALOG(lgDialog)))
     {
-        plcPercentage = strstr((char*)plcDetected, "Percentage ");
-        if (plcPercentage)
-        {
-            // Write the battery percentage to the Battery Value label
-            memset (lcTempMainString, 0, sizeof(lcTempMainString));
-            memcpy (lcTempMainString, plcPercentage+11, strlen(trim(plcPercentage+11)));
-            gtk_label_set_text(GTK_LABEL(lblBatteryPercentage), lcTempMainString);
-        }
+        gtk_widget_destroy(lgDialog);
+        return;
     }
-    
-    // Look for "InputTask: Battery reading: " then "Battery voltage "
-    plcDetected = strstr((char*)paucReceiveMsg, "InputTask: Battery reading: ");
-    if (plcDetected)
+    plcName = gtk_file_chooser_get_filename(GTK_FILE_CHOOSER(lgDialog));
+    gtk_widget_destroy(lgDialog);
+
+    if (!sequence_load(plcName, &error))
     {
-        plcDetectedParam = strstr((char*)plcDetected, "Battery voltage ");
-        plcSpace = strchr(plcDetectedParam+16, 0x20); // search for 1st space character
-        if (plcDetectedParam && plcSpace)
-        {
-            // Write the battery percentage to the Battery Value label
-            memset (lcTempMainString, 0, sizeof(lcTempMainString));
-            memcpy (lcTempMainString, plcDetectedParam+16, plcSpace - (plcDetectedParam+16));
-            strcat (lcTempMainString, " V");
-            gtk_label_set_text(GTK_LABEL(lblBatteryVoltage), lcTempMainString);
-        }
+        sprintf(lcTempMainString, "***ERROR*** couldn't load sequence: %.200s\r\n", error->message);
+        display_status_write(lcTempMainString);
+        g_clear_error(&error);
+        g_free(plcName);
+        return;
     }
-    
-    // Look for "Timestamp "
-    plcDetected = strstr((char*)paucReceiveMsg, "Timestamp ");
-    if (plcDetected)
-    {
-        plcSpace = strchr(plcDetected+10, 0x20); // search for 1st space character
-        if (plcSpace)
-        {
-            // Get date and time, excluding the seconds and UTC
-            memset(lcTempMainString, 0, sizeof(lcTempMainString));
-            memcpy(lcTempMainString, plcDetected+10, plcSpace-(plcDetected+10));
+    g_snprintf(gcMainSequenceName, sizeof(gcMainSequenceName), "%s", plcName);
+    g_free(plcName);
 
-            // Write device time to Timestamp label
-            gtk_label_set_text(GTK_LABEL(lblTimestamp),  lcTempMainString);
+    gtk_button_set_label(GTK_BUTTON(btnSequence), "Stop sequence");
+    sprintf(lcTempMainString, "%s running", gcMainSequenceName);
+    gtk_label_set_text(GTK_LABEL(lblSequence), lcTempMainString);
+    sequence_start(&lsSequenceHooks);
+}
+// end main_SEQUENCE_clicked
 
-            // Calculate elapsed time
-            gulDeviceCurrentTimestamp = (guint32)atoi(trim(lcTempMainString));
-            if (0 == gulDeviceStartTimestamp || gulDeviceStartTimestamp > gulDeviceCurrentTimestamp) 
-            {
-                gulDeviceStartTimestamp = gulDeviceCurrentTimestamp;
-            }
-            gulDeviceRuntime_seconds = gulDeviceCurrentTimestamp - gulDeviceStartTimestamp;
-            guint16 luiRuntime_Days     = gulDeviceRuntime_seconds / (60*60*24);
-            guint8  lucRuntime_Hours    = (gulDeviceRuntime_seconds % (60*60*24))/(60*60);
-            guint8  lucRuntime_Minutes  = (gulDeviceRuntime_seconds % (60*60))/60;
-            guint8  lucRuntime_Seconds  = (gulDeviceRuntime_seconds % (60*60))%60;
-            memset(lcTempMainString, 0, sizeof(lcTempMainString));
-            sprintf(lcTempMainString, "%dd %dh %dm %ds", luiRuntime_Days, lucRuntime_Hours, lucRuntime_Minutes, lucRuntime_Seconds);
-            gtk_label_set_text(GTK_LABEL(lblElapsedTime),  lcTempMainString);
-        }
-    }
 
-    // Look for "STATUS >> " 
-    plcDetected = strstr((char*)paucReceiveMsg, "STATUS >> ");
-    if (plcDetected)
+////////////////////////////////////////////////////////////////////////////
+// Name:         main_REPLAY_SPEED_changed
+// Description:  Callback routine - replay speed (1x, 10x, max) selected
+// Parameters:   None
+// Return:       None
+////////////////////////////////////////////////////////////////////////////
+void main_REPLAY_SPEED_changed(void)
+{
+    gint liSpeed = gtk_combo_box_get_active(GTK_COMBO_BOX(cbtReplaySpeed));
+
+    if (liSpeed >= 0 && liSpeed < (gint)G_N_ELEMENTS(guiMainReplaySpeeds))
     {
-        // look for "Scale:"
-        plcDetectedParam = strstr((char*)plcDetected, "Scale:");
-        plcSpace = strchr(plcDetectedParam+6, 0x20); // search for 1st space character
-        if (plcDetectedParam && plcSpace)
-        {
-            // Write the MINIMUM to the minimum label
-            memset (lcTempMainString, 0, sizeof(lcTempMainString));
-            memcpy (lcTempMainString, plcDetectedParam+6, plcSpace - (plcDetectedParam+6));
+        replay_set_speed(guiMainReplaySpeeds[liSpeed]);
+    }
+}
+// end main_REPLAY_SPEED_changed
 
-            // Write "Fahrenheit" or "Celsius"
-            if (strstr((char*)lcTempMainString, "F"))
-            {
-                gtk_label_set_text(GTK_LABEL(lblTemperatureTitle), "Fahrenheit");
-            }
-            else
-            {
-                gtk_label_set_text(GTK_LABEL(lblTemperatureTitle), "Celsius");
-            }
-        }
 
-        // look for "MIN:"
-        plcDetectedParam = strstr((char*)plcDetected, "MIN:");
-        plcSpace = strchr(plcDetectedParam+4, 0x20); // search for 1st space character
-        if (plcDetectedParam && plcSpace)
-        {
-            // Write the MINIMUM to the minimum label
-            memset (lcTempMainString, 0, sizeof(lcTempMainString));
-            memcpy (lcTempMainString, plcDetectedParam+4, plcSpace - (plcDetectedParam+4));
-            gtk_label_set_text(GTK_LABEL(lblMinimum), lcTempMainString);
-        }
+////////////////////////////////////////////////////////////////////////////
+// Name:         main_REPLAY_scrub
+// Description:  Callback routine - replay position slider moved by the user
+//               (not called when main_periodic() moves the slider)
+// Parameters:   lgRange  - the slider
+//               lgScroll - type of move
+//               ldValue  - new position, 0.0 to 1.0
+// Return:       FALSE, so the slider moves too
+////////////////////////////////////////////////////////////////////////////
+gboolean main_REPLAY_scrub(GtkRange *lgRange, GtkScrollType lgScroll, gdouble ldValue, gpointer data)
+{
+    replay_seek(ldValue);
+    return FALSE;
+}
+// end main_REPLAY_scrub
 
-        // look for "TEMP:"
-        plcDetectedParam = strstr((char*)plcDetected, "TEMP:");
-        plcSpace = strchr(plcDetectedParam+5, 0x20); // search for 1st space character
-        if (plcDetectedParam && plcSpace)
-        {
-            // Write the TEMPERATURE to the temperature label
-            memset (lcTempMainString, 0, sizeof(lcTempMainString));
-            memcpy (lcTempMainString, plcDetectedParam+5, plcSpace - (plcDetectedParam+5));
-            gtk_label_set_text(GTK_LABEL(lblTemperature), lcTempMainString);
-        }
 
-        // look for "MAX:"
-        plcDetectedParam = strstr((char*)plcDetected, "MAX:");
-        plcSpace = strchr(plcDetectedParam+4, 0x20); // search for 1st space character
-        if (plcDetectedParam && plcSpace)
-        {
-            // Write the MAXIMUM to the maximum label
-            memset (lcTempMainString, 0, sizeof(lcTempMainString));
-            memcpy (lcTempMainString, plcDetectedParam+4, plcSpace - (plcDetectedParam+4));
-            gtk_label_set_text(GTK_LABEL(lblMaximum), lcTempMainString);
-        }
+////////////////////////////////////////////////////////////////////////////
+// Name:         main_replay_line
+// Description:  Replay line handler - display and parse a replayed line
+//               as if it had just been received (but the parser sends
+//               nothing to the UUT)
+// Parameters:   paucLine - pointer to NULL-terminated line
+// Return:       Fields found by the parser
+////////////////////////////////////////////////////////////////////////////
+static guint32
+main_replay_line(char *paucLine)
+{
+    guint32 lulFieldMask;
 
-        // look for "AlHI:"
-        plcDetectedParam = strstr((char*)plcDetected, "AlHI:");
-        plcSpace = strchr(plcDetectedParam+5, 0x20); // search for 1st space character
-        if (plcDetectedParam && plcSpace)
-        {
-            // Write the AlarmHI to the AlarmHI label
-            memset (lcTempMainString, 0, sizeof(lcTempMainString));
-            memcpy (lcTempMainString, plcDetectedParam+5, plcSpace - (plcDetectedParam+5));
-            gtk_label_set_text(GTK_LABEL(lblAlarmHI), lcTempMainString);
-        }
+    display_receive_line(paucLine);
+    pipeline_lock();
+    lulFieldMask = parse_msg_replay(paucLine);
+    pipeline_unlock();
+    return lulFieldMask;
+}
+// end main_replay_line
 
-        // look for "AlLO:"
-        plcDetectedParam = strstr((char*)plcDetected, "AlLO:");
-        plcSpace = strchr(plcDetectedParam+5, 0x20); // search for 1st space character
-        if (plcDetectedParam && plcSpace)
-        {
-            // Write the AlarmLO to the AlarmLO label
-            memset (lcTempMainString, 0, sizeof(lcTempMainString));
-            memcpy (lcTempMainString, plcDetectedParam+5, plcSpace - (plcDetectedParam+5));
-            gtk_label_set_text(GTK_LABEL(lblAlarmLO), lcTempMainString);
-        }
 
-        // look for "Alarm:"
-        plcDetectedParam = strstr((char*)plcDetected, "Alarm:");
-        plcSpace = strchr(plcDetectedParam+6, 0x20); // search for 1st space character
-        if (plcDetectedParam && plcSpace)
-        {
-            // Write the Alarm to the Alarm label
-            memset (lcTempMainString, 0, sizeof(lcTempMainString));
-            memcpy (lcTempMainString, plcDetectedParam+6, plcSpace - (plcDetectedParam+6));
-            gtk_label_set_text(GTK_LABEL(lblAlarm), lcTempMainString);
-        }
 
-        // look for "SampleRateSeconds:"
-        plcDetectedParam = strstr((char*)plcDetected, "SampleRateSeconds:");
-        plcSpace = strchr(plcDetectedParam+18, 0x20); // search for 1st space character
-        if (plcDetectedParam && plcSpace)
-        {
-            // Write the sample rate to the sample rate label
-            memset (lcTempMainString, 0, sizeof(lcTempMainString));
-            memcpy (lcTempMainString, plcDetectedParam+18, plcSpace - (plcDetectedParam+18));
-            gtk_label_set_text(GTK_LABEL(lblSampleRate), lcTempMainString);
-        }
 
-        // look for "ACK:"
-        plcDetectedParam = strstr((char*)plcDetected, "ACK:");
-        plcSpace = strchr(plcDetectedParam+4, 0x20); // search for 1st space character
-        if (plcDetectedParam && plcSpace)
-        {
-            // Write the Alarm ACK to the label
-            memset (lcTempMainString, 0, sizeof(lcTempMainString));
-            memcpy (lcTempMainString, plcDetectedParam+4, plcSpace - (plcDetectedParam+4));
-            gtk_label_set_text(GTK_LABEL(lblACK), lcTempMainString);
-        }
 
-        // look for "HostCal:"
-        plcDetectedParam = strstr((char*)plcDetected, "HostCal:");
-        plcSpace = strchr(plcDetectedParam+8, 0x20); // search for 1st space character
-        if (plcDetectedParam && plcSpace)
-        {
-            // Write the Host Calibration to the label
-            memset (lcTempMainString, 0, sizeof(lcTempMainString));
-            memcpy (lcTempMainString, plcDetectedParam+8, plcSpace - (plcDetectedParam+8));
-            gtk_label_set_text(GTK_LABEL(lblHostCal), lcTempMainString);
-        }
 
-        // look for "Buzzer:"
-        plcDetectedParam = strstr((char*)plcDetected, "Buzzer:");
-        plcSpace = strchr(plcDetectedParam+7, 0x20); // search for 1st space character
-        if (plcDetectedParam && plcSpace)
-        {
-            // Write the Buzzer to the label
-            memset (lcTempMainString, 0, sizeof(lcTempMainString));
-            memcpy (lcTempMainString, plcDetectedParam+7, plcSpace - (plcDetectedParam+7));
-            gtk_label_set_text(GTK_LABEL(lblBuzzer), lcTempMainString);
-        }
+///////////////////////////////////////////////////////////////////////////////
+//
+// Main application
+//
+///////////////////////////////////////////////////////////////////////////////
 
-        // look for "Mains:"
-        plcDetectedParam = strstr((char*)plcDetected, "Mains:");
-        if (plcDetectedParam)
-        {
-            // Write the Mains to the label
-            memset (lcTempMainString, 0, sizeof(lcTempMainString));
-            memcpy (lcTempMainString, plcDetectedParam+6, strlen(plcDetectedParam+6));
-            gtk_label_set_text(GTK_LABEL(lblMains), lcTempMainString);
-        }
+////////////////////////////////////////////////////////////////////////////
+// Name:         main_receive_msg_read
+// Description:  Read a received string from the receive FIFO
+// Parameters:   None
+// Return:       Pointer to received string, or NULL if no more strings
+//               are available from the FIFO
+////////////////////////////////////////////////////////////////////////////
+char * 
+main_receive_msg_read(void)
+{
+    return fifo_read();
+}
+// end main_receive_msg_read
 
-    }
-    
-    // Look for "XBEE >> " 
-    plcDetected = strstr((char*)paucReceiveMsg, "XBEE >> ");
-    if (plcDetected)
+
+////////////////////////////////////////////////////////////////////////////
+// Name:         main_receive_msg_write
+// Description:  Write a received string to the FIFO
+// Parameters:   paucReceiveMsg - pointer to received NULL-terminated string
+// Return:       None
+////////////////////////////////////////////////////////////////////////////
+void 
+main_receive_msg_write(char *paucReceiveMsg)
+{
+    static char lcFIFOWarning[200];
+
+    if (gfStartupFirstLine)
     {
-        // look for "SerialNumber:"
-        plcDetectedParam = strstr((char*)plcDetected, "SerialNumber:");
-        plcSpace = strchr(plcDetectedParam+13, 0x20); // search for 1st space character
-        if (plcDetectedParam && plcSpace)
-        {
-            // Write the SERIAL NUMBER to the serial number label
-            memset (lcTempMainString, 0, sizeof(lcTempMainString));
-            memcpy (lcTempMainString, plcDetectedParam+13, plcSpace - (plcDetectedParam+13));
-            gtk_label_set_text(GTK_LABEL(lblXBeeSN), lcTempMainString);
-        }
+        gfStartupFirstLine = FALSE;
+        main_startup_report("first line received");
+    }
 
-        // look for "Device:"
-        plcDetectedParam = strstr((char*)plcDetected, "Device:");
-        plcSpace = strchr(plcDetectedParam+7, 0x20); // search for 1st space character
-        if (plcDetectedParam && plcSpace)
-        {
-            // Write the device to the device label
-            memset (lcTempMainString, 0, sizeof(lcTempMainString));
-            memcpy (lcTempMainString, plcDetectedParam+7, plcSpace - (plcDetectedParam+7));
-            gtk_label_set_text(GTK_LABEL(lblDevice), lcTempMainString);
-        }
+    // Reinitialize data age
+    gllDataUpdate_usec = g_get_monotonic_time();
 
-        // look for "PAN_ID:"
-        plcDetectedParam = strstr((char*)plcDetected, "PAN_ID:");
-        plcSpace = strchr(plcDetectedParam+5, 0x20); // search for 1st space character
-        if (plcDetectedParam && plcSpace)
-        {
-            // Write the PAN ID to the PAN ID label
-            memset (lcTempMainString, 0, sizeof(lcTempMainString));
-            memcpy (lcTempMainString, plcDetectedParam+7, plcSpace - (plcDetectedParam+7));
-            gtk_label_set_text(GTK_LABEL(lblPANID), lcTempMainString);
-        }
+    // Save the received message string to the FIFO, warn if it's filling up
+    switch (fifo_write(paucReceiveMsg))
+    {
+    case FIFO_GROWN:
+        sprintf(lcFIFOWarning, "Receive FIFO grown to %u lines\r\n", fifo_size());
+        display_status_write(lcFIFOWarning);
+        break;
+    case FIFO_FULL:
+        sprintf(lcFIFOWarning, "\r\nWARNING - receive FIFO is full, line dropped\r\n");
+        display_status_write(lcFIFOWarning);
+        break;
+    case FIFO_ALMOST_FULL:
+        sprintf(lcFIFOWarning, "\r\nWARNING - receive FIFO is almost full\r\n");
+        display_status_write(lcFIFOWarning);
+        break;
+    case FIFO_HALF_FULL:
+        sprintf(lcFIFOWarning, "\r\nWARNING - receive FIFO is half-full\r\n");
+        display_status_write(lcFIFOWarning);
+        break;
+    default:
+        break;
+    }
+}
+// end main_receive_msg_write
 
-        // look for "Channel:"
-        plcDetectedParam = strstr((char*)plcDetected, "Channel:");
-        plcSpace = strchr(plcDetectedParam+8, 0x20); // search for 1st space character
-        if (plcDetectedParam && plcSpace)
-        {
-            // Write the channel to the channel label
-            memset (lcTempMainString, 0, sizeof(lcTempMainString));
-            memcpy (lcTempMainString, plcDetectedParam+8, plcSpace - (plcDetectedParam+8));
-            gtk_label_set_text(GTK_LABEL(lblChannel), lcTempMainString);
-        }
 
-        // look for "Connection:"
-        plcDetectedParam = strstr((char*)plcDetected, "Connection:");
-        if (plcDetectedParam)
-        {
-            // Write the Mains to the label
-            memset (lcTempMainString, 0, sizeof(lcTempMainString));
-            memcpy (lcTempMainString, plcDetectedParam+11, strlen(plcDetectedParam+11));
-            gtk_label_set_text(GTK_LABEL(lblConnection), lcTempMainString);
-        }
+////////////////////////////////////////////////////////////////////////////
+// Name:         main_receive_line
+// Description:  Log, display, parse and record a received line
+//               (--pipeline: on the parser thread, the display queued
+//                for the UI thread)
+// Parameters:   paucLine - pointer to NULL-terminated line
+// Return:       None
+////////////////////////////////////////////////////////////////////////////
+static void
+main_receive_line(char *paucLine)
+{
+    guint32 lulFieldMask;
+    gint64 llReceived_usec;
+    guint64 lullTraceStart_ns;
+
+    // Flight recorder always has the latest messages; if log file
+    // is active, also save received message
+    // (save it NOW; if something unexpected is triggering the app
+    //  to crash, it'll be in the flight recorder)
+    flightrec_write(FLIGHTREC_LINE, paucLine);
+    lullTraceStart_ns = trace_start();
+    logfile_write(paucLine);
+    trace_end(TRACE_LOGFILE_WRITE, lullTraceStart_ns);
+
+    // While a capture is being replayed, it owns the display;
+    // live messages are only logged
+    if (replay_is_active())
+    {
+        llReceived_usec = g_get_real_time();
+        sessionlog_write(llReceived_usec, gucMainSessionlogPort, paucLine, 0);
+        fanout_line(llReceived_usec, paucLine, 0);
+        return;
+    }
 
+    // Display received message
+    // (subject to the Receive render budget)
+    lullTraceStart_ns = trace_start();
+    if (pipeline_is_running()) pipeline_ui_line(paucLine);
+    else
+    {
+        sequence_line(paucLine);
+        display_receive_line(paucLine);
     }
- 
-    // Look for "Network_XBee_Modem_Status: "
-    plcDetected = strstr((char*)paucReceiveMsg, "Network_XBee_Modem_Status: ");
-    if (plcDetected)
+    trace_end(TRACE_DISPLAY, lullTraceStart_ns);
+
+    // Parse received message, and record it in the session log
+    // and telemetry export with the fields found
+    lullTraceStart_ns = trace_start();
+    lulFieldMask = parse_msg(paucLine);
+    trace_end(TRACE_PARSE, lullTraceStart_ns);
+    lullTraceStart_ns = trace_start();
+    llReceived_usec = g_get_real_time();
+    sessionlog_write(llReceived_usec, gucMainSessionlogPort, paucLine, lulFieldMask);
+    export_record(llReceived_usec, lulFieldMask);
+    fanout_line(llReceived_usec, paucLine, lulFieldMask);
+    trace_end(TRACE_RECORD, lullTraceStart_ns);
+}
+// end main_receive_line
+
+
+////////////////////////////////////////////////////////////////////////////
+// Name:         main_pipeline_display
+// Description:  --pipeline UI stage - show a received line (what
+//               main_receive_msg_write() does when a line arrives, and
+//               the display)
+// Parameters:   paucLine - pointer to NULL-terminated line
+// Return:       None
+////////////////////////////////////////////////////////////////////////////
+static void
+main_pipeline_display(char *paucLine)
+{
+    if (gfStartupFirstLine)
     {
-        // Write the Modem Status to Status and to the connection label
-        memset (lcTempMainString, 0, sizeof(lcTempMainString));
-        memcpy (lcTempMainString, plcDetected+27, strlen(plcDetected+27));
-        display_status_write("Modem Status: ");
-        display_status_write(lcTempMainString);
-        display_status_write("\r\n");
-        gtk_label_set_text(GTK_LABEL(lblConnection), lcTempMainString);
+        gfStartupFirstLine = FALSE;
+        main_startup_report("first line received");
     }
-    
-    // Look for "PCB revision = "
-    plcDetected = strstr((char*)paucReceiveMsg, "PCB revision = ");
-    if (plcDetected)
+
+    // Reinitialize data age
+    gllDataUpdate_usec = g_get_monotonic_time();
+
+    sequence_line(paucLine);
+    display_receive_line(paucLine);
+}
+// end main_pipeline_display
+
+
+////////////////////////////////////////////////////////////////////////////
+// Name:         main_second_tick
+// Description:  Housekeeping timer - every second
+// Parameters:   pasTimer - gsMainSecondTimer
+// Return:       None
+////////////////////////////////////////////////////////////////////////////
+static void
+main_second_tick(TimerwheelTimer *pasTimer)
+{
+    gulUNIXTimestamp = g_get_real_time()/1000000;
+
+    // Throughput, and the Statistics panel
+    metrics_tick();
+    display_update_stats();
+    display_update_plugin_fields();
+
+    // Force Status window to bottom (if anyone can see it)
+    if (display_is_visible())
     {
-        memset (lcTempMainString, 0, sizeof(lcTempMainString));
-        memcpy (lcTempMainString, plcDetected+15, strlen(plcDetected+15));
-        display_status_write("Detected PCB revision: ");
-        display_status_write(lcTempMainString);
-        display_status_write("\r\n");
-        // Write the PCB revision to the PCB rev text entry box
-        gtk_entry_set_text(GTK_ENTRY(txtentPCBRev), lcTempMainString);
+        adjStatus = gtk_scrolled_window_get_vadjustment(scrolledwindowStatus);
+        gtk_adjustment_set_value( adjStatus, gtk_adjustment_get_upper(adjStatus) );
     }
-    
-    // Look for "Serial number = "
-    plcDetected = strstr((char*)paucReceiveMsg, "Serial number = ");
-    if (plcDetected)
+
+    // Write out a quiet session log's partly filled block
+    sessionlog_tick();
+    export_tick();
+
+    // Commands that got no reply in time
+    correlate_tick();
+
+    // Give back the receive FIFO's memory once bursts subside
+    if (fifo_tick())
     {
-        memset (lcTempMainString, 0, sizeof(lcTempMainString));
-        memcpy (lcTempMainString, plcDetected+16, strlen(plcDetected+16));
-        display_status_write("Detected serial number: ");
+        sprintf(lcTempMainString, "Receive FIFO shrunk to %u lines\r\n", fifo_size());
         display_status_write(lcTempMainString);
-        display_status_write("\r\n");
-        // Write the serial number to the serial number text entry box
-        gtk_entry_set_text(GTK_ENTRY(txtentSerialNum), lcTempMainString);
     }
-    
-    // Look for "Calibration date = "
-    plcDetected = strstr((char*)paucReceiveMsg, "Calibration date = ");
-    if (plcDetected)
+}
+// end main_second_tick
+
+
+////////////////////////////////////////////////////////////////////////////
+// Name:         main_receive_clear
+// Description:  Housekeeping timer - every 5 minutes, clear the Receive
+//               text buffer
+// Parameters:   pasTimer - gsMainReceiveClearTimer
+// Return:       None
+////////////////////////////////////////////////////////////////////////////
+static void
+main_receive_clear(TimerwheelTimer *pasTimer)
+{
+    gtk_text_buffer_get_start_iter(textbufReceive, &textiterReceiveStart);
+    gtk_text_buffer_get_end_iter  (textbufReceive, &textiterReceiveEnd);
+    gtk_text_buffer_delete(textbufReceive, &textiterReceiveStart, &textiterReceiveEnd);
+}
+// end main_receive_clear
+
+
+////////////////////////////////////////////////////////////////////////////
+// Name:         main_status_clear
+// Description:  Housekeeping timer - every 24 hours, clear the Status
+//               text buffer
+// Parameters:   pasTimer - gsMainStatusClearTimer
+// Return:       None
+////////////////////////////////////////////////////////////////////////////
+static void
+main_status_clear(TimerwheelTimer *pasTimer)
+{
+    gtk_text_buffer_get_start_iter(textbufStatus, &textiterStatusStart);
+    gtk_text_buffer_get_end_iter  (textbufStatus, &textiterStatusEnd);
+    gtk_text_buffer_delete(textbufStatus, &textiterStatusStart, &textiterStatusEnd);
+}
+// end main_status_clear
+
+
+////////////////////////////////////////////////////////////////////////////
+// Name:         main_hourly_report
+// Description:  Housekeeping timer - every hour, report the timer jitter,
+//               the memory footprint, the logfile writer queue depth
+//               and write latency, the pipeline queues (or the receive
+//               FIFO's bursts), the command round trips and the fan-out
+//               subscribers
+// Parameters:   pasTimer - gsMainHourlyTimer
+// Return:       None
+////////////////////////////////////////////////////////////////////////////
+static void
+main_hourly_report(TimerwheelTimer *pasTimer)
+{
+    timerwheel_report(lcTempMainString, sizeof(lcTempMainString));
+    display_status_write(lcTempMainString);
+    budget_report(lcTempMainString, sizeof(lcTempMainString));
+    display_status_write(lcTempMainString);
+    if (logfile_is_enabled())
     {
-        memset (lcTempMainString, 0, sizeof(lcTempMainString));
-        memcpy (lcTempMainString, plcDetected+19, strlen(plcDetected+19));
-        display_status_write("Detected calibration date (YYYYMMDD): ");
+        logfile_report(lcTempMainString, sizeof(lcTempMainString));
         display_status_write(lcTempMainString);
-        display_status_write("\r\n");
-        // Write the calibration date to the calibration date text entry box
-        gtk_entry_set_text(GTK_ENTRY(txtentCalDate), lcTempMainString);
     }
-    
-    // Look for "Voltage reference (mV) = "
-    plcDetected = strstr((char*)paucReceiveMsg, "Voltage reference (mV) = ");
-    if (plcDetected)
+    if (pipeline_is_running())
     {
-        memset (lcTempMainString, 0, sizeof(lcTempMainString));
-        memcpy (lcTempMainString, plcDetected+25, strlen(plcDetected+25));
-        display_status_write("Detected voltage reference (mV): ");
+        pipeline_report(lcTempMainString, sizeof(lcTempMainString));
         display_status_write(lcTempMainString);
-        display_status_write("\r\n");
-        // Write the voltage reference to the voltage reference text entry box
-        gtk_entry_set_text(GTK_ENTRY(txtentVref), lcTempMainString);
     }
-    
-    // Look for "PAN_ID:"
-    plcDetected = strstr((char*)paucReceiveMsg, "PAN_ID:");
-    if (plcDetected)
+    else
     {
-        plcSpace = strchr(plcDetected+7, 0x20); // search for 1st space character
-        // Write the PAN ID to the PAN ID label
-        memset (lcTempMainString, 0, sizeof(lcTempMainString));
-        memcpy (lcTempMainString, plcDetected+7, plcSpace - (plcDetected+7));
-        gtk_label_set_text(GTK_LABEL(lblPANID), lcTempMainString);
+        fifo_report(lcTempMainString, sizeof(lcTempMainString));
+        display_status_write(lcTempMainString);
     }
-    
-    // Look for "Channel:"
-    plcDetected = strstr((char*)paucReceiveMsg, "Channel:");
-    if (plcDetected)
+    correlate_report(lcTempMainString, sizeof(lcTempMainString));
+    display_status_write(lcTempMainString);
+    if (fanout_is_enabled())
     {
-        plcSpace = strchr(plcDetected+8, 0x20); // search for 1st space character
-        // Write the CHANNEL to the CHANNEL label
-        memset (lcTempMainString, 0, sizeof(lcTempMainString));
-        memcpy (lcTempMainString, plcDetected+8, plcSpace - (plcDetected+8));
-        gtk_label_set_text(GTK_LABEL(lblChannel), lcTempMainString);
+        fanout_report(lcTempMainString, sizeof(lcTempMainString));
+        display_status_write(lcTempMainString);
     }
-    
 }
-// end main_parse_msg
+// end main_hourly_report
+
 
 ////////////////////////////////////////////////////////////////////////////
-// Name:         main_receive_msg_read
-// Description:  Read a received string from the receive FIFO
-// Parameters:   None
-// Return:       Pointer to received string, or NULL if no more strings
-//               are available from the FIFO
+// Name:         main_metrics_write
+// Description:  Housekeeping timer - every METRICS_PROM_SEC, rewrite the
+//               Prometheus metrics file
+// Parameters:   pasTimer - gsMainMetricsTimer
+// Return:       None
 ////////////////////////////////////////////////////////////////////////////
-char * 
-main_receive_msg_read(void)
+static void
+main_metrics_write(TimerwheelTimer *pasTimer)
 {
-    char *plcReturnPointer;
-
-    if (guiReceiveFIFOReadIndex == guiReceiveFIFOWriteIndex)
-    {
-        // Read and write FIFO pointers are the same, no more receive strings available
-        plcReturnPointer = NULL;
-    }
-    else
-    {
-        // Return the next available received string off the FIFO,
-        // then point to the next received string
-        plcReturnPointer = &gucReceiveFIFO[guiReceiveFIFOReadIndex][0];
-        if (++guiReceiveFIFOReadIndex >= RECEIVE_FIFO_MSG_COUNT) guiReceiveFIFOReadIndex = 0;
-    }
-    return plcReturnPointer;
+    metrics_write_prometheus(METRICS_PROM_FILE);
 }
-// end main_receive_msg_read
+// end main_metrics_write
 
 
 ////////////////////////////////////////////////////////////////////////////
-// Name:         main_logfile_write
-// Description:  Write NULL-terminated string to logfile
-//               Assumes logfile already exists
-// Parameters:   paucMessage - pointer to NULL-terminated string
-// Return:       Size of message written
+// Name:         main_status_timestamp
+// Description:  Housekeeping timer - Status has been quiet: print the
+//               time and data age, and back off to the next delay
+// Parameters:   pasTimer - gsMainStatusTimestampTimer
+// Return:       None
 ////////////////////////////////////////////////////////////////////////////
-int main_logfile_write(char * paucMessage)
+static void
+main_status_timestamp(TimerwheelTimer *pasTimer)
 {
-    gssize lsizeByteWritten = 0;
+    // Writing to Status restarts the backoff, so save the table index
+    guint8 lucDelayIndex = gucStatusTimestampDelayIndex;
 
-    if (lfIsLogfileEnabled)
-    {
-        // Write message to logfile
-        g_io_channel_write_chars(gioChannelLogfile, paucMessage, -1, &lsizeByteWritten, NULL);
-        g_io_channel_write_chars(gioChannelLogfile, "\r\n",      -1, NULL, NULL);
-        // Send it out NOW!!
-        //g_io_channel_flush(gioChannelLogfile, NULL);
-    }
+    // Print timestamp in Status
+    sprintf(lcTempMainString, "%s: UNIX timestamp %d\t", __FUNCTION__, gulUNIXTimestamp);
+    display_status_write(lcTempMainString);
+    sprintf(lcTempMainString, "Local time %s\r\n", timefmt_local());
+    display_status_write(lcTempMainString);
 
-    return (int)lsizeByteWritten;
+    // Display data age
+    display_update_data_age();
+
+    // Restore table index; update if needed
+    gucStatusTimestampDelayIndex = lucDelayIndex;
+    if (gucStatusTimestampDelayIndex<(TIMESTAMP_DELAY_TABLE_COUNT-1)) ++gucStatusTimestampDelayIndex;
+    timerwheel_start(&gsMainStatusTimestampTimer,
+                     uiStatusTimestampDelayTable[gucStatusTimestampDelayIndex]*60*1000, 0,
+                     main_status_timestamp, NULL);
 }
-// end main_logfile_write
+// end main_status_timestamp
+
 
 ////////////////////////////////////////////////////////////////////////////
-// Name:         main_receive_msg_write
-// Description:  Write a received string to the FIFO
-// Parameters:   paucReceiveMsg - pointer to received NULL-terminated string
+// Name:         main_status_timestamp_restart
+// Description:  Status was written: print the next Status timestamp a
+//               minute from now, restarting the backoff
+// Parameters:   None
 // Return:       None
 ////////////////////////////////////////////////////////////////////////////
-void 
-main_receive_msg_write(char *paucReceiveMsg)
+void
+main_status_timestamp_restart(void)
 {
-    static char lcFIFOWarning[200];
-
-    // Zeroize the FIFO entry about to get the received message string
-    memset(&gucReceiveFIFO[guiReceiveFIFOWriteIndex][0], 0, RECEIVE_FIFO_MSG_LENGTH_MAX);
+    gucStatusTimestampDelayIndex = 0;
+    timerwheel_start(&gsMainStatusTimestampTimer, 60*1000, 0, main_status_timestamp, NULL);
+}
+// end main_status_timestamp_restart
 
-    // Copy the received message string into the FIFO entry,
-    // then point to the next FIFO entry to receive the next received message string
-    memcpy(&gucReceiveFIFO[guiReceiveFIFOWriteIndex][0], paucReceiveMsg, strlen(paucReceiveMsg));
-    if (++guiReceiveFIFOWriteIndex >= RECEIVE_FIFO_MSG_COUNT) guiReceiveFIFOWriteIndex = 0;
 
-    // Check if the FIFO is almost full
-    int liFIFOCount = guiReceiveFIFOWriteIndex - guiReceiveFIFOReadIndex;
-    if (liFIFOCount < 0) liFIFOCount += RECEIVE_FIFO_MSG_COUNT;
-    if (liFIFOCount > RECEIVE_FIFO_MSG_COUNT - 25)
-    {
-        sprintf(lcFIFOWarning, "\r\nWARNING - receive FIFO is almost full\r\n");
-        display_status_write(lcFIFOWarning);
-        //main_logfile_write(lcFIFOWarning);
-    }
-    else if (liFIFOCount == RECEIVE_FIFO_MSG_COUNT/2)
-    {
-        sprintf(lcFIFOWarning, "\r\nWARNING - receive FIFO is half-full\r\n");
-        display_status_write(lcFIFOWarning);
-        //main_logfile_write(lcFIFOWarning);
-    }
+////////////////////////////////////////////////////////////////////////////
+// Name:         main_timers_start
+// Description:  Start the housekeeping timers
+// Parameters:   None
+// Return:       None
+////////////////////////////////////////////////////////////////////////////
+static void
+main_timers_start(void)
+{
+    gulUNIXTimestamp = g_get_real_time()/1000000;
+    timerwheel_start(&gsMainSecondTimer,       1000,           1000,           main_second_tick,   NULL);
+    timerwheel_start(&gsMainReceiveClearTimer, 5*60*1000,      5*60*1000,      main_receive_clear, NULL);
+    timerwheel_start(&gsMainStatusClearTimer,  24*60*60*1000,  24*60*60*1000,  main_status_clear,  NULL);
+    timerwheel_start(&gsMainHourlyTimer,       60*60*1000,     60*60*1000,     main_hourly_report, NULL);
+    timerwheel_start(&gsMainMetricsTimer,      METRICS_PROM_SEC*1000, METRICS_PROM_SEC*1000, main_metrics_write, NULL);
+    main_status_timestamp_restart();
 }
-// end main_receive_msg_write
+// end main_timers_start
 
 
 ////////////////////////////////////////////////////////////////////////////
@@ -1018,149 +1141,20 @@ main_receive_msg_write(char *paucReceiveMsg)
 static gboolean
 main_periodic(gpointer data)
 {
-    static guint32 lulElapsed_sec = 0;
     char* plcReceivedMsgAvailable;
     static int fd;
-    static gint liRTCSecond;
-    static gint liRTCMinute;
-    static gint liRTCHour;
-    static gint liOLDRTCSecond = 99;
-    static gint liOLDRTCMinute = 99;
-    static gint liOLDRTCHour   = 99;
+    guint64 lullTickStart_ns = trace_start();
     
     //////////////////////////////////////////////////////////
     //
-    // Update timestamps
+    // Housekeeping timers that are due
+    // (--pipeline: between the parser's lines, as the sticky
+    //  error status and session log/export flush are its state)
     //
     //////////////////////////////////////////////////////////
-    if (gulUNIXTimestamp != g_get_real_time()/1000000)
-    {
-        //
-        // Updates every second
-        //
-        gulUNIXTimestamp = g_get_real_time()/1000000;
-        //gDateTime = g_date_time_new_now_utc();
-        gDateTime = g_date_time_new_now_local();
-        ++lulElapsed_sec;
-        ++gulElapsedTimeSinceDataUpdate_sec;
-        liRTCSecond = g_date_time_get_second(gDateTime);
-        liRTCMinute = g_date_time_get_minute(gDateTime);
-        liRTCHour   = g_date_time_get_hour(gDateTime);
-
-        // Force Status window to bottom
-        adjStatus = gtk_scrolled_window_get_vadjustment(scrolledwindowStatus);
-        gtk_adjustment_set_value( adjStatus, gtk_adjustment_get_upper(adjStatus) );
-
-        // Display sticky error status (if any) to Status for N minutes
-        // (but first check if stick error status has changed)
-        if (strcmp(gucStickyErrorStatus, gucStickyErrorStatusOLD))
-        {
-            // Want to display new sticky status immediately,
-            // so reset sticky error count and make the new
-            // sticky status the current one
-            guiStickyErrorCountdown_sec = STICKY_ERROR_COUNT_PERIOD_SECONDS;
-            memset(gucStickyErrorStatusOLD, 0x00, sizeof(gucStickyErrorStatusOLD));
-            strcpy(gucStickyErrorStatusOLD, gucStickyErrorStatus);
-        }
-        if (strlen(gucStickyErrorStatus) > 0)
-        {
-            if (guiStickyErrorCountdown_sec > 0)
-            {
-                // Display sticky error status
-                --guiStickyErrorCountdown_sec;
-                if (lulElapsed_sec%60 == 0)
-                {
-                    display_status_write(gucStickyErrorStatus);
-                    display_status_write("\r\n");
-                }
-                sprintf(lcTempMainString, "Status: %s", gucStickyErrorStatus);
-                gtk_label_set_text(GTK_LABEL(lblStatusTitle),  lcTempMainString);
-            }
-            else
-            {
-                // Clear sticky error status, prep for the next one
-                memset(gucStickyErrorStatus, 0x00, sizeof(gucStickyErrorStatus));
-                guiStickyErrorCountdown_sec = STICKY_ERROR_COUNT_PERIOD_SECONDS;
-                gtk_label_set_text(GTK_LABEL(lblStatusTitle),  "Status");
-            }
-        }
-        else
-        {
-            guiStickyErrorCountdown_sec = STICKY_ERROR_COUNT_PERIOD_SECONDS;
-        }
-
-        if (lulElapsed_sec%60 == 0)
-        {
-            //
-            // Updates every ELAPSED minute
-            //
-        }
-
-        if (lulElapsed_sec%(5*60) == 0)
-        {
-            //
-            // Updates every ELAPSED 5 minutes
-            //
-            // Periodically clear the Receive text buffer
-            gtk_text_buffer_get_start_iter(textbufReceive, &textiterReceiveStart);
-            gtk_text_buffer_get_end_iter  (textbufReceive, &textiterReceiveEnd);
-            gtk_text_buffer_delete(textbufReceive, &textiterReceiveStart, &textiterReceiveEnd);
-        }
-
-
-        if (lulElapsed_sec%(60*60) == 0)
-        {
-            //
-            // Updates every ELAPSED hour
-            //
-        }
-
-        if (lulElapsed_sec%(60*60*24) == 0)
-        {
-            //
-            // Updates every ELAPSED 24-hour day
-            //
-            // Periodically clear the Status text buffer
-            gtk_text_buffer_get_start_iter(textbufStatus, &textiterStatusStart);
-            gtk_text_buffer_get_end_iter  (textbufStatus, &textiterStatusEnd);
-            gtk_text_buffer_delete(textbufStatus, &textiterStatusStart, &textiterStatusEnd);
-        }
-
-        //
-        // Updates every minute
-        //
-        if (liOLDRTCMinute != liRTCMinute)
-        {
-            liOLDRTCMinute = liRTCMinute;
-
-            if (--guiStatusTimestampCountdown_minutes)
-            {
-                // Do nothing, not yet time to display Status timestamp
-            }
-            else
-            {
-                // Save old table index
-                uiStatusTimestampCountdownIndex_OLD = guiStatusTimestampCountdownIndex;
-
-                // Print timestamp in Status
-                sprintf(lcTempMainString, "%s: UNIX timestamp %d\t", __FUNCTION__, gulUNIXTimestamp);
-                display_status_write(lcTempMainString);
-                sprintf(lcTempMainString, "Local time %s\r\n", g_date_time_format(gDateTime, "%Y-%m-%d %H:%M:%S"));
-                display_status_write(lcTempMainString);
-
-                // Display data age
-                display_update_data_age();
-
-                // Restore table index; update if needed
-                guiStatusTimestampCountdownIndex = uiStatusTimestampCountdownIndex_OLD;
-                if (guiStatusTimestampCountdownIndex<(TIMESTAMP_DELAY_TABLE_COUNT-1)) ++guiStatusTimestampCountdownIndex;
-
-                // Reset minute countdown for Status timestamp
-                guiStatusTimestampCountdown_minutes = uiStatusTimestampCountdownTable[guiStatusTimestampCountdownIndex];
-            }
-        }
-
-    }
+    pipeline_lock();
+    timerwheel_run();
+    pipeline_unlock();
     
     //////////////////////////////////////////////////////////
     //
@@ -1177,10 +1171,9 @@ main_periodic(gpointer data)
         // Try to open the serial-to-USB port
         /* IO channel variable for file */
 
-        // g_print("\r\nlulElapsed_sec=%d   serial_open returns %d\r\n",
-        //         lulElapsed_sec, 
+        // g_print("\r\nserial_open returns %d\r\n",
         //         fd = serial_open("/dev/ttyUSB0",115200));
-        fd = serial_open("/dev/ttyUSB0",115200);
+        fd = serial_connect(SERIAL_PORT,115200);
         //g_print("  fd = %d\r\n", fd);
         if (fd<0)
         {
@@ -1189,29 +1182,10 @@ main_periodic(gpointer data)
                 isFirstSerialFail = FALSE;
                 display_status_write("***ERROR*** problem opening ttyUSB0 - connect serial-to-USB cable to USB port\r\n");
             }
-            isUSBConnectionOK = FALSE;
         }
         else
         {
             display_status_write("ttyUSB0 opened successfully!\r\n");
-            isUSBConnectionOK = TRUE;
-            isFirstSerialFail = TRUE;
-            gIOChannelSerialUSB = g_io_channel_unix_new(fd);  // creates the correct reference for callback
-            
-            // Set encoding
-            g_io_channel_set_encoding(gIOChannelSerialUSB, NULL, NULL);
-            // g_print("\r\n%s() g_io_channel_get_encoding() returned %s\r\n", __FUNCTION__,
-            //         g_io_channel_get_encoding(gIOChannelSerialUSB));
-
-            // Specify callback routines for serial read and error
-            g_io_add_watch(gIOChannelSerialUSB, 
-                           G_IO_IN, 
-                           serial_read, 
-                           NULL);
-            g_io_add_watch(gIOChannelSerialUSB, 
-                           G_IO_ERR|G_IO_HUP|G_IO_NVAL, 
-                           serial_error, 
-                           NULL);
         }
     }
     
@@ -1222,62 +1196,202 @@ main_periodic(gpointer data)
     // If a log file is active, save received messages
     //
     //////////////////////////////////////////////////////////
-    do
+    if (pipeline_is_running())
     {
-        plcReceivedMsgAvailable = main_receive_msg_read();
-        if (plcReceivedMsgAvailable)
+        // The parser thread has done the rest; show what it's queued
+        pipeline_ui_run();
+    }
+    else
+    {
+        while ((plcReceivedMsgAvailable = main_receive_msg_read()))
         {
-            // Reinitialize data age
-            gulElapsedTimeSinceDataUpdate_sec = 0;
-
-            // If log file is active, save received message
-            // (save it to the logfile NOW; if something unexpected
-            //  is triggering the app to crash, perhaps it'll be saved)
-            main_logfile_write(plcReceivedMsgAvailable);
+            main_receive_line(plcReceivedMsgAvailable);
+        }
+    }
 
-            // Display received message
-            display_receive_write(plcReceivedMsgAvailable);
-            display_receive_write("\r\n");
+    //
+    // Replay a capture through the same display and parser
+    //
+    if (replay_is_active())
+    {
+        static gboolean lfIsFinishReported = FALSE;
 
-            // Parse received message
-            main_parse_msg(plcReceivedMsgAvailable);
+        replay_run(main_replay_line);
+        if (display_is_visible()) gtk_range_set_value(GTK_RANGE(scaleReplay), replay_position());
+        if (replay_is_finished() && !lfIsFinishReported)
+        {
+            sprintf(lcTempMainString, "Replay reached end of capture, %u lines\r\n", replay_line_count());
+            display_status_write(lcTempMainString);
         }
-    } while (plcReceivedMsgAvailable);
-    
+        lfIsFinishReported = replay_is_finished();
+    }
+    display_receive_frame_end();
     
+    trace_end(TRACE_TICK, lullTickStart_ns);
     return TRUE;
 }
 // end main_periodic
 
 
+////////////////////////////////////////////////////////////////////////////
+// Name:         main_trace_dump
+// Description:  SIGUSR1 handler - with --trace, write the pipeline trace
+//               ring to TRACE_FILE
+// Parameters:   data - unused
+// Return:       G_SOURCE_CONTINUE
+////////////////////////////////////////////////////////////////////////////
+static gboolean
+main_trace_dump(gpointer data)
+{
+    guint32 lulEvents;
+
+    if (!trace_is_enabled())
+    {
+        display_status_write("Trace not dumped - start with --trace to record one\r\n");
+    }
+    else if (trace_dump(TRACE_FILE, &lulEvents))
+    {
+        sprintf(lcTempMainString, "Trace of the last %u spans written to %s\r\n", lulEvents, TRACE_FILE);
+        display_status_write(lcTempMainString);
+    }
+    else
+    {
+        display_status_write("***ERROR*** couldn't write trace " TRACE_FILE "\r\n");
+    }
+    return G_SOURCE_CONTINUE;
+}
+// end main_trace_dump
+
+
 
 ////////////////////////////////////////////////////////////////////////////
 // Name:         main
 // Description:  Main routine for WSG30 Temperature Display Diagnostic
-// Parameters:   Standard main arguments, unused
+// Parameters:   Standard main arguments, see gsMainOptions
 // Return:       0 on conventional exit; error otherwise
 ////////////////////////////////////////////////////////////////////////////
 int main(int argc, char** argv)
 {
     GError *error = NULL;
-
-    gtk_init(&argc, &argv);
+    int fd;
+    gchar *plcLogSync = NULL;
+    gchar *plcLogRotate = NULL;
+    gchar *plcExport = NULL;
+    gchar *plcConfig = NULL;
+    gchar *plcBudget = NULL;
+    gchar *plcPin = NULL;
+    gchar *plcFanout = NULL;
+    gchar *plcFanoutSlow = NULL;
+    gchar **plcPlugins = NULL;
+    gboolean lfFlightrecSaved;
+    PipelineStages lsPipelineStages =
+    {
+        main_receive_line,
+        main_pipeline_display,
+        { display_status_write, display_field_update, display_connection_update, display_clear_views },
+    };
+    GOptionEntry gsMainOptions[] =
+    {
+        { "log-sync", 0, 0, G_OPTION_ARG_STRING, &plcLogSync, "Logfile durability: none, msec:N or lines:N", "POLICY" },
+        { "log-rotate", 0, 0, G_OPTION_ARG_STRING, &plcLogRotate, "Logfile rotation: none, mb:N, hours:N or mb:N,hours:N", "LIMITS" },
+        { "log-binary", 0, 0, G_OPTION_ARG_NONE, &gfMainLogBinary, "Also save an indexed binary session log (.wsl)", NULL },
+        { "export", 0, 0, G_OPTION_ARG_STRING, &plcExport, "Also export STATUS telemetry: csv, columnar or both", "FORMAT" },
+        { "trace", 0, 0, G_OPTION_ARG_NONE, &gfMainTrace, "Trace each line through the pipeline; dumped to " TRACE_FILE " on SIGUSR1 and at exit", NULL },
+        { "config", 0, 0, G_OPTION_ARG_FILENAME, &plcConfig, "Read buffer budgets from FILE (default " BUDGET_KEYFILE ", if there)", "FILE" },
+        { "budget", 0, 0, G_OPTION_ARG_STRING, &plcBudget, "Buffer budgets: fifo-lines:N,fifo-lines-min:N,fifo-lines-max:N,fifo-line-bytes:N,periodic-msec:N,render-usec:N,serial-line-bytes:N", "BUDGETS" },
+        { "pipeline", 0, 0, G_OPTION_ARG_NONE, &gfMainPipeline, "Read, parse and display on separate threads", NULL },
+        { "pin", 0, 0, G_OPTION_ARG_STRING, &plcPin, "Pin --pipeline stages to CPUs: reader:N,parser:N,logger:N,ui:N", "CPUS" },
+        { "fanout", 0, 0, G_OPTION_ARG_FILENAME, &plcFanout, "Publish received lines and telemetry to subscribers on a Unix-domain socket", "SOCKET" },
+        { "fanout-slow", 0, 0, G_OPTION_ARG_STRING, &plcFanoutSlow, "Fan-out subscriber that falls behind: lag (skip it ahead, default) or drop", "POLICY" },
+        { "parser-plugin", 0, 0, G_OPTION_ARG_FILENAME_ARRAY, &plcPlugins, "Load parser plugin FILE (.so) for more line handlers; may be repeated", "FILE" },
+        { NULL }
+    };
+
+    gllStartupProcessStart_usec = main_startup_process_start();
+
+    // Open the serial-to-USB port while GTK starts and the UI is built
+    serial_open_start(SERIAL_PORT, 115200);
+
+    if (!gtk_init_with_args(&argc, &argv, "- Sensaphone WSG30 Temperature Display Diagnostic", gsMainOptions, NULL, &error))
+    {
+        g_printerr("%s\r\n", error ? error->message : "Cannot open display");
+        g_clear_error(&error);
+        return 1;
+    }
+    if (plcLogSync && !logfile_set_sync(plcLogSync))
+    {
+        g_printerr("Unknown --log-sync policy \"%s\"\r\n", plcLogSync);
+        return 1;
+    }
+    if (plcLogRotate && !logfile_set_rotate(plcLogRotate))
+    {
+        g_printerr("Unknown --log-rotate limits \"%s\"\r\n", plcLogRotate);
+        return 1;
+    }
+    if (plcExport && !(gfMainExport = export_set_format(plcExport)))
+    {
+        g_printerr("Unknown --export format \"%s\"\r\n", plcExport);
+        return 1;
+    }
+    if (!budget_load(plcConfig, &error))
+    {
+        g_printerr("%s\r\n", error->message);
+        g_clear_error(&error);
+        return 1;
+    }
+    if (plcBudget && !budget_set(plcBudget))
+    {
+        g_printerr("Unknown or out of range --budget \"%s\"\r\n", plcBudget);
+        return 1;
+    }
+    if (plcPin && !pipeline_set_cpus(plcPin))
+    {
+        g_printerr("Unknown --pin stages \"%s\"\r\n", plcPin);
+        return 1;
+    }
+    if (plcFanoutSlow && !fanout_set_slow(plcFanoutSlow))
+    {
+        g_printerr("Unknown --fanout-slow policy \"%s\"\r\n", plcFanoutSlow);
+        return 1;
+    }
+    if (!plugin_load(plcPlugins, &error))
+    {
+        g_printerr("%s\r\n", error->message);
+        g_clear_error(&error);
+        return 1;
+    }
+    
+    // Start the flight recorder before anything can go wrong
+    if (!flightrec_open(FLIGHTREC_FILE, &lfFlightrecSaved))
+    {
+        g_printerr("Couldn't open flight recorder %s\r\n", FLIGHTREC_FILE);
+    }
     
     //
     // Initalize any globals needed
     //
-    gulElapsedTimeSinceDataUpdate_sec = 0;
-    //gDateTime = g_date_time_new_now_utc();
-    gDateTime = g_date_time_new_now_local();
-    lfIsLogfileEnabled = FALSE;
-    guiStatusTimestampCountdown_minutes = 1;
-    memset (gucStickyErrorStatus, 0x00, sizeof(gucStickyErrorStatus));
+    gllDataUpdate_usec = g_get_monotonic_time();
+    main_timers_start();
+    trace_enable(gfMainTrace);
+    g_unix_signal_add(SIGUSR1, main_trace_dump, NULL);
+    parse_initialize(&gsMainParseHooks);
+    budget_apply();
+    serial_set_receive_handler(main_receive_msg_write);
+    correlate_initialize(display_status_write);
+    serial_set_write_handler(correlate_sent);
+    serial_set_reply_handler(correlate_line);
+    if (gfMainPipeline)
+    {
+        logfile_set_cpu(pipeline_cpu(PIPELINE_LOGGER));
+        pipeline_pin(PIPELINE_UI);
+        pipeline_start(&lsPipelineStages);
+    }
 
     //
     // Enable CSS styling (colors, fonts, text sizes)
     //
     cssProvider = gtk_css_provider_new();
-    gtk_css_provider_load_from_path(cssProvider, "theme.css", NULL);
+    gtk_css_provider_load_from_resource(cssProvider, CSS_THEME);
     gtk_style_context_add_provider_for_screen(gdk_screen_get_default(),
                                  GTK_STYLE_PROVIDER(cssProvider),
                                  GTK_STYLE_PROVIDER_PRIORITY_USER);
@@ -1286,9 +1400,9 @@ int main(int argc, char** argv)
     // Construct a GtkBuilder instance and load our UI description
     //
     builder = gtk_builder_new();
-    if (gtk_builder_add_from_file(builder, GLADE_LAYOUT, &error) == 0)
+    if (gtk_builder_add_from_resource(builder, GLADE_LAYOUT, &error) == 0)
     {
-        g_printerr ("Error loading file: %s\r\n", error->message);
+        g_printerr ("Error loading layout: %s\r\n", error->message);
         g_clear_error(&error);
         return 1;
     }
@@ -1299,6 +1413,7 @@ int main(int argc, char** argv)
     // Main window
     window = GTK_WINDOW(gtk_builder_get_object(builder, "window1"));
     g_signal_connect(window, "destroy", G_CALLBACK(gtk_main_quit), NULL);
+    g_signal_connect_after(window, "draw", G_CALLBACK(main_first_frame), NULL);
     
 
     //
@@ -1315,7 +1430,7 @@ int main(int argc, char** argv)
     //
     // Start the timeout periodic function
     //
-    g_timeout_add(MAIN_PERIODIC_INTERVAL_MSEC, main_periodic, NULL);
+    g_timeout_add(gulBudgetPeriodic_msec, main_periodic, NULL);
 
     display_status_write("=================================<=>=================================\r\n");
     display_status_write("               Sensaphone WSG30 Temp Sensor Diagnostic               \r\n");
@@ -1324,6 +1439,44 @@ int main(int argc, char** argv)
     sprintf(lcTempMainString, "                             %s     \r\n", VERSION_DATE);
     display_status_write(lcTempMainString);
     display_status_write("=================================<=>=================================\r\n");
+    if (lfFlightrecSaved)
+    {
+        display_status_write("WARNING - last run did not exit normally, its flight recorder is in " FLIGHTREC_FILE ".prev\r\n");
+    }
+    budget_report(lcTempMainString, sizeof(lcTempMainString));
+    display_status_write(lcTempMainString);
+    if (plcPlugins)
+    {
+        plugin_report(lcTempMainString, sizeof(lcTempMainString));
+        display_status_write(lcTempMainString);
+    }
+    if (plcFanout)
+    {
+        if (fanout_open(plcFanout))
+        {
+            sprintf(lcTempMainString, "Fan-out socket %s opened\r\n", plcFanout);
+        }
+        else
+        {
+            sprintf(lcTempMainString, "***ERROR*** couldn't open fan-out socket %s\r\n", plcFanout);
+        }
+        display_status_write(lcTempMainString);
+    }
+
+    //
+    // Finish opening the serial-to-USB port
+    //
+    fd = serial_open_finish();
+    if (fd<0)
+    {
+        isFirstSerialFail = FALSE;
+        display_status_write("***ERROR*** problem opening ttyUSB0 - connect serial-to-USB cable to USB port\r\n");
+    }
+    else
+    {
+        display_status_write("ttyUSB0 opened successfully!\r\n");
+    }
+    main_startup_report("UI built");
 
 
     //
@@ -1339,6 +1492,25 @@ int main(int argc, char** argv)
     // Should only get here when exiting/quitting the GTK application
     //
     ////////////////////////////////////////////////////////////////////
+    // Finish the lines the parser has, then write out the logfile queue
+    // and finish compressing segments
+    if (pipeline_is_running())
+    {
+        pipeline_stop();
+        pipeline_report(lcTempMainString, sizeof(lcTempMainString));
+        g_print("%s", lcTempMainString);
+    }
+    fanout_close();
+    logfile_finish();
+    sessionlog_close();
+    export_close();
+    flightrec_close();
+    if (trace_is_enabled())
+    {
+        guint32 lulEvents;
+
+        if (trace_dump(TRACE_FILE, &lulEvents)) g_print("Trace of the last %u spans written to %s\r\n", lulEvents, TRACE_FILE);
+    }
     return (0);
 }
 // end main
@@ -64,12 +64,15 @@ void main_VREF_clicked(void);
 
 void main_LOGENABLE_state_set(void);
 void main_MENU_clicked(void);
+void main_REPLAY_clicked(void);
+void main_REPLAY_SPEED_changed(void);
+gboolean main_REPLAY_scrub(GtkRange *lgRange, GtkScrollType lgScroll, gdouble ldValue, gpointer data);
 void main_REBOOT_clicked(void);
+void main_SEQUENCE_clicked(void);
 void main_RTD_clicked(void);
+void main_status_timestamp_restart(void);
 
 gboolean is_valid_mac(char *paucTestMAC);
-char *trim(char *paucInputString);
-int main_logfile_write(char * paucMessage);
 
 ///////////////////////////////////////////////////////////////////////////////
 //
@@ -80,24 +83,8 @@ int main_logfile_write(char * paucMessage);
 // GTK builder
 extern GtkBuilder *builder;
 
-// Elapsed time since last data update
-extern guint32 gulElapsedTimeSinceDataUpdate_sec;
-
-// I/O channel for serial-to-USB port
-extern GIOChannel *gIOChannelSerialUSB;
-
-// Status timestamp-related
-extern guint16 guiStatusTimestampCountdown_minutes;
-extern guint8  guiStatusTimestampCountdownIndex;
-
-// Sticky error status
-extern char gucStickyErrorStatus[200];
-extern char gucStickyErrorStatusOLD[200];
-
-// Device initial and current timestamps
-extern guint32 gulDeviceStartTimestamp;
-extern guint32 gulDeviceCurrentTimestamp;
-extern guint32 gulDeviceRuntime_seconds;
+// Monotonic time of last data update
+extern gint64 gllDataUpdate_usec;
 
 
 #ifdef __cplusplus
@@ -0,0 +1,111 @@
+/*
+ * File:   mallocount.c
+ * Author: Mark Bersalona
+ *
+ * Created on 2024.07.15
+ * Allocation counter for soak tests, loaded with LD_PRELOAD
+ *
+ * Counts every malloc/calloc/realloc/memalign call in the process and
+ * passes it on to glibc. The headless logger's --soak mode looks up
+ * mallocount_total() and fails if the steady state allocates at all:
+ *
+ *   LD_PRELOAD=./WSG30TempDisplay_mallocount.so ./WSG30TempDisplay_headless --soak=600
+ *
+ * No GLib here: GLib itself allocates through these calls.
+ */
+
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Includes
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#define _GNU_SOURCE
+#include <stddef.h>
+#include <errno.h>
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Definitions
+//
+///////////////////////////////////////////////////////////////////////////////
+
+// glibc's own allocator entry points
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t count, size_t size);
+extern void *__libc_realloc(void *ptr, size_t size);
+extern void *__libc_memalign(size_t alignment, size_t size);
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Variables and tables
+//
+///////////////////////////////////////////////////////////////////////////////
+
+static unsigned long gulMallocountCalls;
+
+
+////////////////////////////////////////////////////////////////////////////
+// Name:         mallocount_total
+// Description:  Number of allocation calls since the process started
+// Parameters:   None
+// Return:       Count
+////////////////////////////////////////////////////////////////////////////
+unsigned long
+mallocount_total(void)
+{
+    return __atomic_load_n(&gulMallocountCalls, __ATOMIC_RELAXED);
+}
+// end mallocount_total
+
+
+////////////////////////////////////////////////////////////////////////////
+// Name:         malloc, calloc, realloc, memalign, posix_memalign,
+//               aligned_alloc
+// Description:  Count the call, then allocate as usual
+// Parameters:   As the C library
+// Return:       As the C library
+////////////////////////////////////////////////////////////////////////////
+void *
+malloc(size_t size)
+{
+    __atomic_add_fetch(&gulMallocountCalls, 1, __ATOMIC_RELAXED);
+    return __libc_malloc(size);
+}
+
+void *
+calloc(size_t count, size_t size)
+{
+    __atomic_add_fetch(&gulMallocountCalls, 1, __ATOMIC_RELAXED);
+    return __libc_calloc(count, size);
+}
+
+void *
+realloc(void *ptr, size_t size)
+{
+    __atomic_add_fetch(&gulMallocountCalls, 1, __ATOMIC_RELAXED);
+    return __libc_realloc(ptr, size);
+}
+
+void *
+memalign(size_t alignment, size_t size)
+{
+    __atomic_add_fetch(&gulMallocountCalls, 1, __ATOMIC_RELAXED);
+    return __libc_memalign(alignment, size);
+}
+
+void *
+aligned_alloc(size_t alignment, size_t size)
+{
+    return memalign(alignment, size);
+}
+
+int
+posix_memalign(void **ptr, size_t alignment, size_t size)
+{
+    *ptr = memalign(alignment, size);
+    return *ptr ? 0 : ENOMEM;
+}
+// end malloc, calloc, realloc, memalign, posix_memalign, aligned_alloc
+
@@ -0,0 +1,520 @@
+/*
+ * File:   metrics.c
+ * Author: Mark Bersalona
+ *
+ * Created on 2024.07.15
+ * Runtime metrics: throughput, queue high-water, per-stage latency
+ *
+ * Counters, gauges and histograms are plain arrays updated with relaxed
+ * atomics, so they can be recorded from the serial/parse/display path and
+ * the logfile writer thread without locks or allocation. Histograms are
+ * log-linear (HDR-style): exact below 32 nsec, then 16 buckets per power
+ * of 2. metrics_tick() turns the counters into per-second rates;
+ * metrics_format() is the stats panel text and metrics_write_prometheus()
+ * writes the Prometheus text exposition format (e.g. for node_exporter's
+ * textfile collector).
+ */
+
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Includes
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#define _GNU_SOURCE
+#include <glib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include "gconfig.h"
+#include "metrics.h"
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Definitions
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#define METRICS_SUB_COUNT   (1 << METRICS_SUB_BITS)
+
+// Prometheus histogram buckets: powers of 2 nsec from 2^METRICS_PROM_LE_MIN
+// (256 nsec) to 2^METRICS_PROM_LE_MAX (17 s)
+#define METRICS_PROM_LE_MIN (8)
+#define METRICS_PROM_LE_MAX (34)
+
+typedef struct
+{
+    guint64 ullCount[METRICS_HISTOGRAM_BUCKETS];
+    guint64 ullTotal;
+    guint64 ullSum_ns;
+    guint64 ullMax_ns;
+} MetricsHistogram;
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Variables and tables
+//
+///////////////////////////////////////////////////////////////////////////////
+
+static guint64 gullMetricsCounter[METRICS_COUNTER_COUNT];
+static guint64 gullMetricsGauge[METRICS_GAUGE_COUNT];
+static guint64 gullMetricsGaugeHighWater[METRICS_GAUGE_COUNT];
+static guint64 gullMetricsGaugeCapacity[METRICS_GAUGE_COUNT] =
+{
+    RECEIVE_FIFO_MSG_COUNT,
+    LOGFILE_QUEUE_BYTES,
+    0,                          // set when the pipeline starts
+    0,
+    0,                          // set when the fan-out opens
+};
+static MetricsHistogram gsMetricsHistogram[METRICS_HISTOGRAM_COUNT];
+
+// Per-second rates from metrics_tick(), and their peaks
+static guint64 gullMetricsRate[METRICS_COUNTER_COUNT];
+static guint64 gullMetricsRatePeak[METRICS_COUNTER_COUNT];
+static guint64 gullMetricsRateLast[METRICS_COUNTER_COUNT];
+static gint64  gllMetricsRateLast_usec;
+
+static char *pucMetricsCounterNames[METRICS_COUNTER_COUNT][2] =
+{
+    { "wsg30_received_bytes",  "Bytes of complete lines received from the device" },
+    { "wsg30_received_lines",  "Lines received from the device" },
+    { "wsg30_pipeline_backpressure_waits", "Times a pipeline stage waited for room in the next stage's queue" },
+    { "wsg30_command_timeouts", "Commands sent to the device that got no reply in time" },
+    { "wsg30_fanout_lagged",    "Times a fan-out subscriber fell behind and was skipped ahead" },
+    { "wsg30_fanout_dropped",   "Fan-out subscribers disconnected for falling behind" },
+};
+static char *pucMetricsGaugeNames[METRICS_GAUGE_COUNT][2] =
+{
+    { "wsg30_fifo_depth",           "Receive FIFO entries waiting to be parsed" },
+    { "wsg30_logfile_queue_bytes",  "Bytes waiting in the logfile writer queue" },
+    { "wsg30_pipeline_ingest_bytes", "Bytes waiting in the pipeline reader to parser queue" },
+    { "wsg30_pipeline_ui_bytes",     "Bytes waiting in the pipeline parser to UI queue" },
+    { "wsg30_fanout_subscribers",    "Fan-out socket subscribers connected" },
+};
+static char *pucMetricsHistogramNames[METRICS_HISTOGRAM_COUNT][3] =
+{
+    { "wsg30_parse_seconds",          "Parse time per line, including field updates", "Parse" },
+    { "wsg30_receive_render_seconds", "GTK insert time per line displayed in Receive", "Receive insert" },
+    { "wsg30_logfile_write_seconds",  "Logfile write()/fdatasync() time",             "Log write" },
+    { "wsg30_command_serial_seconds",  "Round trip from a serial number command to its reply",    "RTT serial" },
+    { "wsg30_command_caldate_seconds", "Round trip from a calibration date command to its reply", "RTT cal date" },
+    { "wsg30_command_pcbrev_seconds",  "Round trip from a PCB revision command to its reply",     "RTT PCB rev" },
+    { "wsg30_command_vref_seconds",    "Round trip from a Vref command to its reply",             "RTT Vref" },
+    { "wsg30_command_reboot_seconds",  "Round trip from a reboot command to the startup banner",  "RTT reboot" },
+};
+
+// Prometheus text, built here so writing it never allocates
+static char gucMetricsText[32768];
+static char gucMetricsTempName[256];
+
+
+////////////////////////////////////////////////////////////////////////////
+// Name:         metrics_bucket
+// Description:  Histogram bucket for a value
+// Parameters:   lullValue - value
+// Return:       Bucket index
+////////////////////////////////////////////////////////////////////////////
+static guint32
+metrics_bucket(guint64 lullValue)
+{
+    guint32 lulExponent;
+
+    if (lullValue < 2*METRICS_SUB_COUNT) return (guint32)lullValue;
+    if (lullValue >> (METRICS_MAX_BITS + 1)) return METRICS_HISTOGRAM_BUCKETS - 1;
+
+    lulExponent = 63 - __builtin_clzll(lullValue);
+    return ((lulExponent - METRICS_SUB_BITS + 1) << METRICS_SUB_BITS)
+           + (guint32)(lullValue >> (lulExponent - METRICS_SUB_BITS)) - METRICS_SUB_COUNT;
+}
+// end metrics_bucket
+
+
+////////////////////////////////////////////////////////////////////////////
+// Name:         metrics_bucket_limit
+// Description:  Upper bound (exclusive) of a histogram bucket
+// Parameters:   lulBucket - bucket index
+// Return:       Smallest value above the bucket
+////////////////////////////////////////////////////////////////////////////
+static guint64
+metrics_bucket_limit(guint32 lulBucket)
+{
+    guint32 lulGroup = lulBucket >> METRICS_SUB_BITS;
+
+    if (lulBucket < 2*METRICS_SUB_COUNT) return lulBucket + 1;
+    return ((guint64)(lulBucket & (METRICS_SUB_COUNT - 1)) + METRICS_SUB_COUNT + 1) << (lulGroup - 1);
+}
+// end metrics_bucket_limit
+
+
+////////////////////////////////////////////////////////////////////////////
+// Name:         metrics_load
+// Description:  Read a metric written by other threads
+// Parameters:   pallValue - metric
+// Return:       Its value
+////////////////////////////////////////////////////////////////////////////
+static guint64
+metrics_load(guint64 *pallValue)
+{
+    return __atomic_load_n(pallValue, __ATOMIC_RELAXED);
+}
+// end metrics_load
+
+
+////////////////////////////////////////////////////////////////////////////
+// Name:         metrics_raise
+// Description:  Raise a high-water mark (lock-free)
+// Parameters:   pallMax   - high-water mark
+//               lullValue - new value
+// Return:       None
+////////////////////////////////////////////////////////////////////////////
+static void
+metrics_raise(guint64 *pallMax, guint64 lullValue)
+{
+    guint64 lullMax = metrics_load(pallMax);
+
+    while (lullValue > lullMax &&
+           !__atomic_compare_exchange_n(pallMax, &lullMax, lullValue, TRUE, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+    {
+        // lullMax now has the current value, try again
+    }
+}
+// end metrics_raise
+
+
+////////////////////////////////////////////////////////////////////////////
+// Name:         metrics_format_ns
+// Description:  Format a time for the stats panel ("850ns", "12.3us", ...)
+// Parameters:   paucText - buffer, at least 16 chars
+//               lullNs   - time, nsec
+// Return:       paucText
+////////////////////////////////////////////////////////////////////////////
+static char *
+metrics_format_ns(char *paucText, guint64 lullNs)
+{
+    if (lullNs < 1000)            sprintf(paucText, "%luns",  (unsigned long)lullNs);
+    else if (lullNs < 1000000)    sprintf(paucText, "%.1fus", lullNs / 1e3);
+    else if (lullNs < 1000000000) sprintf(paucText, "%.1fms", lullNs / 1e6);
+    else                          sprintf(paucText, "%.2fs",  lullNs / 1e9);
+    return paucText;
+}
+// end metrics_format_ns
+
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Public routines
+//
+///////////////////////////////////////////////////////////////////////////////
+
+////////////////////////////////////////////////////////////////////////////
+// Name:         metrics_now_ns
+// Description:  Monotonic time for timing a stage
+// Parameters:   None
+// Return:       nsec
+////////////////////////////////////////////////////////////////////////////
+guint64
+metrics_now_ns(void)
+{
+    struct timespec lsNow;
+
+    clock_gettime(CLOCK_MONOTONIC, &lsNow);
+    return (guint64)lsNow.tv_sec * 1000000000ULL + lsNow.tv_nsec;
+}
+// end metrics_now_ns
+
+
+////////////////////////////////////////////////////////////////////////////
+// Name:         metrics_add
+// Description:  Add to a counter
+// Parameters:   lucCounter - METRICS_xxx counter
+//               lullCount  - amount
+// Return:       None
+////////////////////////////////////////////////////////////////////////////
+void
+metrics_add(guint8 lucCounter, guint64 lullCount)
+{
+    __atomic_fetch_add(&gullMetricsCounter[lucCounter], lullCount, __ATOMIC_RELAXED);
+}
+// end metrics_add
+
+
+////////////////////////////////////////////////////////////////////////////
+// Name:         metrics_gauge
+// Description:  Set a gauge, raising its high-water mark
+// Parameters:   lucGauge  - METRICS_xxx gauge
+//               lullValue - current value
+// Return:       None
+////////////////////////////////////////////////////////////////////////////
+void
+metrics_gauge(guint8 lucGauge, guint64 lullValue)
+{
+    __atomic_store_n(&gullMetricsGauge[lucGauge], lullValue, __ATOMIC_RELAXED);
+    metrics_raise(&gullMetricsGaugeHighWater[lucGauge], lullValue);
+}
+// end metrics_gauge
+
+
+////////////////////////////////////////////////////////////////////////////
+// Name:         metrics_gauge_capacity
+// Description:  Set the most a gauge can read, for the Statistics panel
+//               (e.g. the receive FIFO size once budgets are applied)
+// Parameters:   lucGauge     - METRICS_xxx gauge
+//               lullCapacity - capacity
+// Return:       None
+////////////////////////////////////////////////////////////////////////////
+void
+metrics_gauge_capacity(guint8 lucGauge, guint64 lullCapacity)
+{
+    __atomic_store_n(&gullMetricsGaugeCapacity[lucGauge], lullCapacity, __ATOMIC_RELAXED);
+}
+// end metrics_gauge_capacity
+
+
+////////////////////////////////////////////////////////////////////////////
+// Name:         metrics_record
+// Description:  Add a time to a latency histogram
+// Parameters:   lucHistogram - METRICS_xxx_NS histogram
+//               lullValue_ns - time, nsec
+// Return:       None
+////////////////////////////////////////////////////////////////////////////
+void
+metrics_record(guint8 lucHistogram, guint64 lullValue_ns)
+{
+    MetricsHistogram *plsHistogram = &gsMetricsHistogram[lucHistogram];
+
+    __atomic_fetch_add(&plsHistogram->ullCount[metrics_bucket(lullValue_ns)], 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&plsHistogram->ullTotal, 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&plsHistogram->ullSum_ns, lullValue_ns, __ATOMIC_RELAXED);
+    metrics_raise(&plsHistogram->ullMax_ns, lullValue_ns);
+}
+// end metrics_record
+
+
+////////////////////////////////////////////////////////////////////////////
+// Name:         metrics_percentile
+// Description:  Estimate a latency percentile from a histogram
+// Parameters:   lucHistogram - METRICS_xxx_NS histogram
+//               luiPercent   - 0..100
+// Return:       Upper bound of the bucket holding the percentile (or the
+//               maximum, if less), nsec; 0 if nothing recorded
+////////////////////////////////////////////////////////////////////////////
+guint64
+metrics_percentile(guint8 lucHistogram, guint16 luiPercent)
+{
+    MetricsHistogram *plsHistogram = &gsMetricsHistogram[lucHistogram];
+    guint64 lullTotal = 0;
+    guint64 lullCount = 0;
+    guint32 lulBucket;
+
+    // Sum the buckets rather than use ullTotal, so the two agree
+    for (lulBucket = 0; lulBucket < METRICS_HISTOGRAM_BUCKETS; ++lulBucket)
+    {
+        lullTotal += metrics_load(&plsHistogram->ullCount[lulBucket]);
+    }
+    if (0 == lullTotal) return 0;
+
+    for (lulBucket = 0; lulBucket < METRICS_HISTOGRAM_BUCKETS; ++lulBucket)
+    {
+        lullCount += metrics_load(&plsHistogram->ullCount[lulBucket]);
+        if (lullCount*100 >= lullTotal*luiPercent) break;
+    }
+    return MIN(metrics_bucket_limit(lulBucket), metrics_load(&plsHistogram->ullMax_ns));
+}
+// end metrics_percentile
+
+
+////////////////////////////////////////////////////////////////////////////
+// Name:         metrics_tick
+// Description:  Once a second: update the per-second rates
+// Parameters:   None
+// Return:       None
+////////////////////////////////////////////////////////////////////////////
+void
+metrics_tick(void)
+{
+    gint64  llNow_usec = g_get_monotonic_time();
+    guint64 lullCount;
+    guint8  lucCounter;
+
+    for (lucCounter = 0; lucCounter < METRICS_COUNTER_COUNT; ++lucCounter)
+    {
+        lullCount = metrics_load(&gullMetricsCounter[lucCounter]);
+        if (gllMetricsRateLast_usec && llNow_usec > gllMetricsRateLast_usec)
+        {
+            gullMetricsRate[lucCounter] = (lullCount - gullMetricsRateLast[lucCounter]) * G_USEC_PER_SEC
+                                          / (guint64)(llNow_usec - gllMetricsRateLast_usec);
+            gullMetricsRatePeak[lucCounter] = MAX(gullMetricsRatePeak[lucCounter], gullMetricsRate[lucCounter]);
+        }
+        gullMetricsRateLast[lucCounter] = lullCount;
+    }
+    gllMetricsRateLast_usec = llNow_usec;
+}
+// end metrics_tick
+
+
+////////////////////////////////////////////////////////////////////////////
+// Name:         metrics_format
+// Description:  Format the metrics for the stats panel, one line each
+// Parameters:   paucText - buffer for the text
+//               lulSize  - size of buffer
+// Return:       None
+////////////////////////////////////////////////////////////////////////////
+void
+metrics_format(char *paucText, guint32 lulSize)
+{
+    char lcP50[16], lcP99[16], lcMax[16];
+    guint32 lulUsed;
+    guint8  lucHistogram;
+
+    lulUsed = snprintf(paucText, lulSize,
+                       "Received        %lu lines/s (peak %lu), %lu bytes/s (peak %lu), %lu lines\n"
+                       "Receive FIFO    %lu of %lu in use, high-water %lu\n"
+                       "Logfile queue   %lu bytes, high-water %lu of %lu\n",
+                       (unsigned long)gullMetricsRate[METRICS_LINES_RECEIVED],
+                       (unsigned long)gullMetricsRatePeak[METRICS_LINES_RECEIVED],
+                       (unsigned long)gullMetricsRate[METRICS_BYTES_RECEIVED],
+                       (unsigned long)gullMetricsRatePeak[METRICS_BYTES_RECEIVED],
+                       (unsigned long)metrics_load(&gullMetricsCounter[METRICS_LINES_RECEIVED]),
+                       (unsigned long)metrics_load(&gullMetricsGauge[METRICS_FIFO_DEPTH]),
+                       (unsigned long)metrics_load(&gullMetricsGaugeCapacity[METRICS_FIFO_DEPTH]),
+                       (unsigned long)metrics_load(&gullMetricsGaugeHighWater[METRICS_FIFO_DEPTH]),
+                       (unsigned long)metrics_load(&gullMetricsGauge[METRICS_LOGFILE_QUEUE]),
+                       (unsigned long)metrics_load(&gullMetricsGaugeHighWater[METRICS_LOGFILE_QUEUE]),
+                       (unsigned long)metrics_load(&gullMetricsGaugeCapacity[METRICS_LOGFILE_QUEUE]));
+    if (metrics_load(&gullMetricsGaugeCapacity[METRICS_INGEST_QUEUE]) && lulUsed < lulSize)
+    {
+        lulUsed += snprintf(paucText + lulUsed, lulSize - lulUsed,
+                            "Pipeline        ingest %lu bytes (high-water %lu of %lu), UI %lu bytes (high-water %lu of %lu), %lu waits\n",
+                            (unsigned long)metrics_load(&gullMetricsGauge[METRICS_INGEST_QUEUE]),
+                            (unsigned long)metrics_load(&gullMetricsGaugeHighWater[METRICS_INGEST_QUEUE]),
+                            (unsigned long)metrics_load(&gullMetricsGaugeCapacity[METRICS_INGEST_QUEUE]),
+                            (unsigned long)metrics_load(&gullMetricsGauge[METRICS_UI_QUEUE]),
+                            (unsigned long)metrics_load(&gullMetricsGaugeHighWater[METRICS_UI_QUEUE]),
+                            (unsigned long)metrics_load(&gullMetricsGaugeCapacity[METRICS_UI_QUEUE]),
+                            (unsigned long)metrics_load(&gullMetricsCounter[METRICS_BACKPRESSURE]));
+    }
+    if (metrics_load(&gullMetricsGaugeCapacity[METRICS_FANOUT_SUBSCRIBERS]) && lulUsed < lulSize)
+    {
+        lulUsed += snprintf(paucText + lulUsed, lulSize - lulUsed,
+                            "Fan-out         %lu subscribers (high-water %lu of %lu), %lu lagged, %lu dropped\n",
+                            (unsigned long)metrics_load(&gullMetricsGauge[METRICS_FANOUT_SUBSCRIBERS]),
+                            (unsigned long)metrics_load(&gullMetricsGaugeHighWater[METRICS_FANOUT_SUBSCRIBERS]),
+                            (unsigned long)metrics_load(&gullMetricsGaugeCapacity[METRICS_FANOUT_SUBSCRIBERS]),
+                            (unsigned long)metrics_load(&gullMetricsCounter[METRICS_FANOUT_LAGGED]),
+                            (unsigned long)metrics_load(&gullMetricsCounter[METRICS_FANOUT_DROPPED]));
+    }
+    for (lucHistogram = 0; lucHistogram < METRICS_HISTOGRAM_COUNT && lulUsed < lulSize; ++lucHistogram)
+    {
+        // Command round trips only once there are some
+        if (lucHistogram >= METRICS_RTT_FIRST_NS && 0 == metrics_load(&gsMetricsHistogram[lucHistogram].ullTotal)) continue;
+        lulUsed += snprintf(paucText + lulUsed, lulSize - lulUsed, "%-15s p50 %s  p99 %s  max %s  (%lu)\n",
+                            pucMetricsHistogramNames[lucHistogram][2],
+                            metrics_format_ns(lcP50, metrics_percentile(lucHistogram, 50)),
+                            metrics_format_ns(lcP99, metrics_percentile(lucHistogram, 99)),
+                            metrics_format_ns(lcMax, metrics_load(&gsMetricsHistogram[lucHistogram].ullMax_ns)),
+                            (unsigned long)metrics_load(&gsMetricsHistogram[lucHistogram].ullTotal));
+    }
+    // No trailing newline
+    if (lulUsed && lulUsed < lulSize && '\n' == paucText[lulUsed-1]) paucText[lulUsed-1] = 0;
+}
+// end metrics_format
+
+
+////////////////////////////////////////////////////////////////////////////
+// Name:         metrics_write_prometheus
+// Description:  Write the metrics in Prometheus text format, replacing
+//               the file atomically (written to "<name>.tmp" first)
+// Parameters:   paucName - file name
+// Return:       TRUE if written
+////////////////////////////////////////////////////////////////////////////
+gboolean
+metrics_write_prometheus(char *paucName)
+{
+    MetricsHistogram *plsHistogram;
+    guint32 lulUsed = 0;
+    guint32 lulSize = sizeof(gucMetricsText);
+    guint32 lulBucket;
+    guint64 lullCumulative;
+    guint8  lucIndex;
+    guint8  lucLe;
+    int     liFd;
+    gboolean lfIsWritten;
+
+    // (Stop appending once the text no longer fits: lulSize - lulUsed
+    //  would wrap)
+    for (lucIndex = 0; lucIndex < METRICS_COUNTER_COUNT && lulUsed < lulSize; ++lucIndex)
+    {
+        lulUsed += snprintf(gucMetricsText + lulUsed, lulSize - lulUsed,
+                            "# HELP %s_total %s\n# TYPE %s_total counter\n%s_total %lu\n"
+                            "# HELP %s_per_second %s, last second\n# TYPE %s_per_second gauge\n%s_per_second %lu\n",
+                            pucMetricsCounterNames[lucIndex][0], pucMetricsCounterNames[lucIndex][1],
+                            pucMetricsCounterNames[lucIndex][0], pucMetricsCounterNames[lucIndex][0],
+                            (unsigned long)metrics_load(&gullMetricsCounter[lucIndex]),
+                            pucMetricsCounterNames[lucIndex][0], pucMetricsCounterNames[lucIndex][1],
+                            pucMetricsCounterNames[lucIndex][0], pucMetricsCounterNames[lucIndex][0],
+                            (unsigned long)gullMetricsRate[lucIndex]);
+    }
+    for (lucIndex = 0; lucIndex < METRICS_GAUGE_COUNT && lulUsed < lulSize; ++lucIndex)
+    {
+        lulUsed += snprintf(gucMetricsText + lulUsed, lulSize - lulUsed,
+                            "# HELP %s %s\n# TYPE %s gauge\n%s %lu\n"
+                            "# HELP %s_high_water %s, highest seen\n# TYPE %s_high_water gauge\n%s_high_water %lu\n",
+                            pucMetricsGaugeNames[lucIndex][0], pucMetricsGaugeNames[lucIndex][1],
+                            pucMetricsGaugeNames[lucIndex][0], pucMetricsGaugeNames[lucIndex][0],
+                            (unsigned long)metrics_load(&gullMetricsGauge[lucIndex]),
+                            pucMetricsGaugeNames[lucIndex][0], pucMetricsGaugeNames[lucIndex][1],
+                            pucMetricsGaugeNames[lucIndex][0], pucMetricsGaugeNames[lucIndex][0],
+                            (unsigned long)metrics_load(&gullMetricsGaugeHighWater[lucIndex]));
+    }
+    for (lucIndex = 0; lucIndex < METRICS_HISTOGRAM_COUNT && lulUsed < lulSize; ++lucIndex)
+    {
+        plsHistogram = &gsMetricsHistogram[lucIndex];
+        lulUsed += snprintf(gucMetricsText + lulUsed, lulSize - lulUsed, "# HELP %s %s\n# TYPE %s histogram\n",
+                            pucMetricsHistogramNames[lucIndex][0], pucMetricsHistogramNames[lucIndex][1],
+                            pucMetricsHistogramNames[lucIndex][0]);
+
+        // Every power of 2 is a bucket boundary, so the cumulative counts
+        // are exact
+        lulBucket = 0;
+        lullCumulative = 0;
+        for (lucLe = METRICS_PROM_LE_MIN; lucLe <= METRICS_PROM_LE_MAX && lulUsed < lulSize; ++lucLe)
+        {
+            while (lulBucket < METRICS_HISTOGRAM_BUCKETS && metrics_bucket_limit(lulBucket) <= (1ULL << lucLe))
+            {
+                lullCumulative += metrics_load(&plsHistogram->ullCount[lulBucket++]);
+            }
+            lulUsed += snprintf(gucMetricsText + lulUsed, lulSize - lulUsed, "%s_bucket{le=\"%.12g\"} %lu\n",
+                                pucMetricsHistogramNames[lucIndex][0], (1ULL << lucLe) / 1e9,
+                                (unsigned long)lullCumulative);
+        }
+        while (lulBucket < METRICS_HISTOGRAM_BUCKETS)
+        {
+            lullCumulative += metrics_load(&plsHistogram->ullCount[lulBucket++]);
+        }
+        if (lulUsed >= lulSize) break;
+        lulUsed += snprintf(gucMetricsText + lulUsed, lulSize - lulUsed,
+                            "%s_bucket{le=\"+Inf\"} %lu\n%s_sum %.9f\n%s_count %lu\n",
+                            pucMetricsHistogramNames[lucIndex][0], (unsigned long)lullCumulative,
+                            pucMetricsHistogramNames[lucIndex][0], metrics_load(&plsHistogram->ullSum_ns) / 1e9,
+                            pucMetricsHistogramNames[lucIndex][0], (unsigned long)lullCumulative);
+    }
+    if (lulUsed >= lulSize) return FALSE;
+
+    snprintf(gucMetricsTempName, sizeof(gucMetricsTempName), "%s.tmp", paucName);
+    liFd = open(gucMetricsTempName, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (liFd < 0) return FALSE;
+    lfIsWritten = (write(liFd, gucMetricsText, lulUsed) == (ssize_t)lulUsed);
+    close(liFd);
+    if (!lfIsWritten || rename(gucMetricsTempName, paucName))
+    {
+        unlink(gucMetricsTempName);
+        return FALSE;
+    }
+    return TRUE;
+}
+// end metrics_write_prometheus
+
@@ -0,0 +1,82 @@
+/*
+ * File:   metrics.h
+ * Author: Mark Bersalona
+ *
+ * Created on 2024.07.15
+ */
+
+#ifndef METRICS_H
+#define METRICS_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Definitions
+//
+///////////////////////////////////////////////////////////////////////////////
+
+// Counters (metrics_add)
+#define METRICS_BYTES_RECEIVED    (0)   // bytes of complete lines from the device
+#define METRICS_LINES_RECEIVED    (1)
+#define METRICS_BACKPRESSURE      (2)   // --pipeline: waits for room in a stage queue
+#define METRICS_COMMAND_TIMEOUTS  (3)   // commands sent that got no reply in time
+#define METRICS_FANOUT_LAGGED     (4)   // --fanout: subscribers skipped ahead for falling behind
+#define METRICS_FANOUT_DROPPED    (5)   // --fanout: subscribers disconnected for falling behind
+#define METRICS_COUNTER_COUNT     (6)
+
+// Gauges, with high-water (metrics_gauge)
+#define METRICS_FIFO_DEPTH        (0)   // receive FIFO entries in use
+#define METRICS_LOGFILE_QUEUE     (1)   // logfile writer queue bytes
+#define METRICS_INGEST_QUEUE      (2)   // --pipeline: reader -> parser queue bytes
+#define METRICS_UI_QUEUE          (3)   // --pipeline: parser -> UI queue bytes
+#define METRICS_FANOUT_SUBSCRIBERS (4)  // --fanout: subscribers connected
+#define METRICS_GAUGE_COUNT       (5)
+
+// Latency histograms, nsec (metrics_record)
+#define METRICS_PARSE_NS          (0)   // parse_msg(), including field updates
+#define METRICS_RENDER_NS         (1)   // GTK insert of a line into Receive
+#define METRICS_LOGWRITE_NS       (2)   // logfile write()/fdatasync()
+#define METRICS_RTT_SERIAL_NS     (3)   // command round trip: +++MENU:N/n to its reply
+#define METRICS_RTT_CALDATE_NS    (4)   //                     +++MENU:D/d
+#define METRICS_RTT_PCBREV_NS     (5)   //                     +++MENU:P/p
+#define METRICS_RTT_VREF_NS       (6)   //                     +++MENU:V/v
+#define METRICS_RTT_REBOOT_NS     (7)   //                     +++MENU:Z to the startup banner
+#define METRICS_HISTOGRAM_COUNT   (8)
+#define METRICS_RTT_FIRST_NS      METRICS_RTT_SERIAL_NS
+
+// Histogram buckets: values below 2^(METRICS_SUB_BITS+1) exactly, then
+// 2^METRICS_SUB_BITS buckets per power of 2 (about 6% resolution) up to
+// 2^METRICS_MAX_BITS nsec (18 minutes); larger values land in the last
+#define METRICS_SUB_BITS          (4)
+#define METRICS_MAX_BITS          (40)
+#define METRICS_HISTOGRAM_BUCKETS ((METRICS_MAX_BITS - METRICS_SUB_BITS + 2) << METRICS_SUB_BITS)
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Public routines
+//
+///////////////////////////////////////////////////////////////////////////////
+
+// Recording (lock-free, any thread)
+void metrics_add(guint8 lucCounter, guint64 lullCount);
+void metrics_gauge(guint8 lucGauge, guint64 lullValue);
+void metrics_gauge_capacity(guint8 lucGauge, guint64 lullCapacity);
+guint64 metrics_now_ns(void);
+void metrics_record(guint8 lucHistogram, guint64 lullValue_ns);
+
+// Reporting
+void metrics_format(char *paucText, guint32 lulSize);
+guint64 metrics_percentile(guint8 lucHistogram, guint16 luiPercent);
+void metrics_tick(void);
+gboolean metrics_write_prometheus(char *paucName);
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* METRICS_H */
+
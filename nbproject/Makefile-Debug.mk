@@ -35,9 +35,27 @@ OBJECTDIR=${CND_BUILDDIR}/${CND_CONF}/${CND_PLATFORM}
 
 # Object Files
 OBJECTFILES= \
+	${OBJECTDIR}/budget.o \
+	${OBJECTDIR}/correlate.o \
 	${OBJECTDIR}/display.o \
+	${OBJECTDIR}/export.o \
+	${OBJECTDIR}/fanout.o \
+	${OBJECTDIR}/fifo.o \
+	${OBJECTDIR}/flightrec.o \
+	${OBJECTDIR}/logfile.o \
 	${OBJECTDIR}/main.o \
-	${OBJECTDIR}/serial.o
+	${OBJECTDIR}/metrics.o \
+	${OBJECTDIR}/parse.o \
+	${OBJECTDIR}/pipeline.o \
+	${OBJECTDIR}/plugin.o \
+	${OBJECTDIR}/replay.o \
+	${OBJECTDIR}/resources.o \
+	${OBJECTDIR}/sequence.o \
+	${OBJECTDIR}/serial.o \
+	${OBJECTDIR}/sessionlog.o \
+	${OBJECTDIR}/timefmt.o \
+	${OBJECTDIR}/timerwheel.o \
+	${OBJECTDIR}/trace.o
 
 
 # C Compiler Flags
@@ -54,7 +72,7 @@ FFLAGS=
 ASFLAGS=
 
 # Link Libraries and Options
-LDLIBSOPTIONS=
+LDLIBSOPTIONS=-ldl
 
 # Build Targets
 .build-conf: ${BUILD_SUBPROJECTS}
@@ -66,27 +84,121 @@ ${CND_DISTDIR}/${CND_CONF}/${CND_PLATFORM}/WSG30TempDisplay_diagnostic: ${OBJECT
 	${MKDIR} -p ${CND_DISTDIR}/${CND_CONF}/${CND_PLATFORM}
 	${LINK.c} -o ${CND_DISTDIR}/${CND_CONF}/${CND_PLATFORM}/WSG30TempDisplay_diagnostic ${OBJECTFILES} ${LDLIBSOPTIONS} `pkg-config --libs gtk+-3.0`
 
+${OBJECTDIR}/budget.o: budget.c
+	${MKDIR} -p ${OBJECTDIR}
+	${RM} "$@.d"
+	$(COMPILE.c) -g -std=c99 -MMD -MP -MF "$@.d" -o ${OBJECTDIR}/budget.o budget.c
+
+${OBJECTDIR}/correlate.o: correlate.c
+	${MKDIR} -p ${OBJECTDIR}
+	${RM} "$@.d"
+	$(COMPILE.c) -g -std=c99 -MMD -MP -MF "$@.d" -o ${OBJECTDIR}/correlate.o correlate.c
+
 ${OBJECTDIR}/display.o: display.c
 	${MKDIR} -p ${OBJECTDIR}
 	${RM} "$@.d"
 	$(COMPILE.c) -g -std=c99 -MMD -MP -MF "$@.d" -o ${OBJECTDIR}/display.o display.c
 
+${OBJECTDIR}/export.o: export.c
+	${MKDIR} -p ${OBJECTDIR}
+	${RM} "$@.d"
+	$(COMPILE.c) -g -std=c99 -MMD -MP -MF "$@.d" -o ${OBJECTDIR}/export.o export.c
+
+${OBJECTDIR}/fanout.o: fanout.c
+	${MKDIR} -p ${OBJECTDIR}
+	${RM} "$@.d"
+	$(COMPILE.c) -g -std=c99 -MMD -MP -MF "$@.d" -o ${OBJECTDIR}/fanout.o fanout.c
+
+${OBJECTDIR}/fifo.o: fifo.c
+	${MKDIR} -p ${OBJECTDIR}
+	${RM} "$@.d"
+	$(COMPILE.c) -g -std=c99 -MMD -MP -MF "$@.d" -o ${OBJECTDIR}/fifo.o fifo.c
+
+${OBJECTDIR}/flightrec.o: flightrec.c
+	${MKDIR} -p ${OBJECTDIR}
+	${RM} "$@.d"
+	$(COMPILE.c) -g -std=c99 -MMD -MP -MF "$@.d" -o ${OBJECTDIR}/flightrec.o flightrec.c
+
+${OBJECTDIR}/logfile.o: logfile.c
+	${MKDIR} -p ${OBJECTDIR}
+	${RM} "$@.d"
+	$(COMPILE.c) -g -std=c99 -MMD -MP -MF "$@.d" -o ${OBJECTDIR}/logfile.o logfile.c
+
 ${OBJECTDIR}/main.o: main.c
 	${MKDIR} -p ${OBJECTDIR}
 	${RM} "$@.d"
 	$(COMPILE.c) -g -std=c99 -MMD -MP -MF "$@.d" -o ${OBJECTDIR}/main.o main.c
 
+${OBJECTDIR}/metrics.o: metrics.c
+	${MKDIR} -p ${OBJECTDIR}
+	${RM} "$@.d"
+	$(COMPILE.c) -g -std=c99 -MMD -MP -MF "$@.d" -o ${OBJECTDIR}/metrics.o metrics.c
+
+${OBJECTDIR}/parse.o: parse.c
+	${MKDIR} -p ${OBJECTDIR}
+	${RM} "$@.d"
+	$(COMPILE.c) -g -std=c99 -MMD -MP -MF "$@.d" -o ${OBJECTDIR}/parse.o parse.c
+
+${OBJECTDIR}/pipeline.o: pipeline.c
+	${MKDIR} -p ${OBJECTDIR}
+	${RM} "$@.d"
+	$(COMPILE.c) -g -std=c99 -MMD -MP -MF "$@.d" -o ${OBJECTDIR}/pipeline.o pipeline.c
+
+${OBJECTDIR}/plugin.o: plugin.c
+	${MKDIR} -p ${OBJECTDIR}
+	${RM} "$@.d"
+	$(COMPILE.c) -g -std=c99 -MMD -MP -MF "$@.d" -o ${OBJECTDIR}/plugin.o plugin.c
+
+${OBJECTDIR}/replay.o: replay.c
+	${MKDIR} -p ${OBJECTDIR}
+	${RM} "$@.d"
+	$(COMPILE.c) -g -std=c99 -MMD -MP -MF "$@.d" -o ${OBJECTDIR}/replay.o replay.c
+
+${OBJECTDIR}/resources.o: resources.c
+	${MKDIR} -p ${OBJECTDIR}
+	${RM} "$@.d"
+	$(COMPILE.c) -g -std=c99 -MMD -MP -MF "$@.d" -o ${OBJECTDIR}/resources.o resources.c
+
+resources.c: WSG30TempDisplayDiagnostic.gresource.xml WSG30TemperatureDisplayDiagnostic.glade theme.css
+	glib-compile-resources --target=$@ --generate-source WSG30TempDisplayDiagnostic.gresource.xml
+
+${OBJECTDIR}/sequence.o: sequence.c
+	${MKDIR} -p ${OBJECTDIR}
+	${RM} "$@.d"
+	$(COMPILE.c) -g -std=c99 -MMD -MP -MF "$@.d" -o ${OBJECTDIR}/sequence.o sequence.c
+
 ${OBJECTDIR}/serial.o: serial.c
 	${MKDIR} -p ${OBJECTDIR}
 	${RM} "$@.d"
 	$(COMPILE.c) -g -std=c99 -MMD -MP -MF "$@.d" -o ${OBJECTDIR}/serial.o serial.c
 
+${OBJECTDIR}/sessionlog.o: sessionlog.c
+	${MKDIR} -p ${OBJECTDIR}
+	${RM} "$@.d"
+	$(COMPILE.c) -g -std=c99 -MMD -MP -MF "$@.d" -o ${OBJECTDIR}/sessionlog.o sessionlog.c
+
+${OBJECTDIR}/timefmt.o: timefmt.c
+	${MKDIR} -p ${OBJECTDIR}
+	${RM} "$@.d"
+	$(COMPILE.c) -g -std=c99 -MMD -MP -MF "$@.d" -o ${OBJECTDIR}/timefmt.o timefmt.c
+
+${OBJECTDIR}/timerwheel.o: timerwheel.c
+	${MKDIR} -p ${OBJECTDIR}
+	${RM} "$@.d"
+	$(COMPILE.c) -g -std=c99 -MMD -MP -MF "$@.d" -o ${OBJECTDIR}/timerwheel.o timerwheel.c
+
+${OBJECTDIR}/trace.o: trace.c
+	${MKDIR} -p ${OBJECTDIR}
+	${RM} "$@.d"
+	$(COMPILE.c) -g -std=c99 -MMD -MP -MF "$@.d" -o ${OBJECTDIR}/trace.o trace.c
+
 # Subprojects
 .build-subprojects:
 
 # Clean Targets
 .clean-conf: ${CLEAN_SUBPROJECTS}
 	${RM} -r ${CND_BUILDDIR}/${CND_CONF}
+	${RM} resources.c
 
 # Subprojects
 .clean-subprojects:
@@ -0,0 +1,871 @@
+/*
+ * File:   parse.c
+ * Author: Mark Bersalona
+ *
+ * Created on 2024.07.15
+ * Sensaphone WSG30 Temperature Display Diagnostic received message parser
+ *
+ * No GTK in here: the parser reports what it finds through the ParseHooks
+ * routines, so the same code runs in the GTK display and the headless logger.
+ *
+ * Parser plugins (parse_plugin.h) add fields after the built-in ones and
+ * text patterns with handlers. parse_compile() indexes the patterns by
+ * first character once every plugin is loaded, so parse_msg() finds all
+ * of them in one pass over the line, and a line costs nothing extra when
+ * no plugin is loaded.
+ */
+
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Includes
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include <glib.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include "gconfig.h"
+#include "serial.h"
+#include "parse.h"
+#include "timerwheel.h"
+#include "metrics.h"
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Definitions
+//
+///////////////////////////////////////////////////////////////////////////////
+
+// Plugin line pattern
+typedef struct
+{
+    char               cText[PARSE_PATTERN_LENGTH_MAX];
+    guint32            ulLength;
+    ParsePluginHandler pfHandler;
+    void              *pvContext;
+} ParsePattern;
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Variables and tables
+//
+///////////////////////////////////////////////////////////////////////////////
+
+static ParseHooks gsParseHooks;
+
+static char lcTempParseString[250];
+
+// Parsing a replayed line: nothing is sent to the UUT
+static gboolean gfParseIsReplay = FALSE;
+
+// Fields found in the message being parsed (bit per PARSE_FIELD_xxx)
+static guint32 gulParseFieldsFound;
+
+// Latest value of each parsed field
+char gucParseField[PARSE_FIELD_TOTAL][PARSE_FIELD_LENGTH_MAX];
+
+// Fields defined, built-in and plugin
+static guint32 gulParseFieldCount = PARSE_FIELD_COUNT;
+static char    gucParsePluginFieldNames[PARSE_FIELD_PLUGIN_MAX][PARSE_FIELD_LENGTH_MAX];
+
+// Plugin patterns; once compiled, sorted by first character, with the
+// patterns starting with character c at gulParsePatternFirst[c] up to
+// gulParsePatternFirst[c+1]
+static ParsePattern gsParsePattern[PARSE_PATTERNS_MAX];
+static guint32      gulParsePatternCount = 0;
+static guint32      gulParsePatternFirst[257];
+static gboolean     gfParseCompiled = FALSE;
+
+// Field names, for the headless front end and any other text output
+static char* pucParseFieldNames[PARSE_FIELD_COUNT] =
+{
+    "FWVer",
+    "Timestamp",
+    "ElapsedTime",
+    "BatteryVoltage",
+    "BatteryPercentage",
+    "Mains",
+    "Scale",
+    "Minimum",
+    "Temperature",
+    "Maximum",
+    "AlarmHI",
+    "AlarmLO",
+    "Alarm",
+    "SampleRate",
+    "ACK",
+    "HostCal",
+    "Buzzer",
+    "XBeeSN",
+    "Device",
+    "PANID",
+    "Channel",
+    "Connection",
+    "PCBRev",
+    "SerialNum",
+    "CalDate",
+    "Vref",
+    "Status",
+};
+
+// Field values after the UUT starts/reboots
+// (NULL: value is left alone)
+static char* pucParseFieldDefaults[PARSE_FIELD_COUNT] =
+{
+    "------",       // FWVer
+    "0000000000",   // Timestamp
+    "0d 0h 0m 0s",  // ElapsedTime
+    "------",       // BatteryVoltage
+    "------",       // BatteryPercentage
+    "------",       // Mains
+    NULL,           // Scale
+    "XX.X",         // Minimum
+    "XX.X",         // Temperature
+    "XX.X",         // Maximum
+    "------",       // AlarmHI
+    "------",       // AlarmLO
+    "------",       // Alarm
+    "-",            // SampleRate
+    "------",       // ACK
+    "------",       // HostCal
+    "------",       // Buzzer
+    "------",       // XBeeSN
+    "------",       // Device
+    "------",       // PANID
+    "------",       // Channel
+    "------",       // Connection
+    NULL,           // PCBRev
+    NULL,           // SerialNum
+    NULL,           // CalDate
+    NULL,           // Vref
+    "Status",       // Status
+};
+
+// Sticky error status, written to Status every minute until it expires
+char gucStickyErrorStatus[200];
+static TimerwheelTimer gsStickyErrorRepeatTimer;
+static TimerwheelTimer gsStickyErrorExpireTimer;
+
+// Device initial and current timestamps
+guint32 gulDeviceStartTimestamp   = 0;
+guint32 gulDeviceCurrentTimestamp = 0;
+guint32 gulDeviceRuntime_seconds;
+
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Utility functions
+//
+///////////////////////////////////////////////////////////////////////////////
+
+
+////////////////////////////////////////////////////////////////////////////
+// Name:         trim
+// Description:  Trims the given string of leading and trailing spaces
+//               Uses isspace() to determine what's a "space"
+//               By Johannes Schaub, 2008.12.09
+//               stackoverflow.com/questions/352055/
+//                 best-algorithm-to-strip-leading-and-trailing-spaces-in-c
+// Parameters:   Pointer to start of string to trim
+// Return:       Pointer to null-terminated trimmed string
+////////////////////////////////////////////////////////////////////////////
+char* trim(char* paucInputString)
+{
+    char* e = paucInputString + strlen(paucInputString) - 1;
+    while (*paucInputString && isspace(*paucInputString)) paucInputString++;
+    while (e > paucInputString && isspace(*e)) *e-- = '\0';
+    return paucInputString;
+}
+// end trim
+
+
+////////////////////////////////////////////////////////////////////////////
+// Name:         parse_status_write
+// Description:  Write a string to Status through the status hook
+// Parameters:   paucWriteBuf - pointer to NULL-terminated string
+// Return:       None
+////////////////////////////////////////////////////////////////////////////
+void
+parse_status_write(char *paucWriteBuf)
+{
+    if (gsParseHooks.status_write) gsParseHooks.status_write(paucWriteBuf);
+}
+// end parse_status_write
+
+
+////////////////////////////////////////////////////////////////////////////
+// Name:         parse_param
+// Description:  Look for "<paucKey><value> " in a string; if found,
+//               the value (up to the 1st following space) becomes the
+//               new value of the given field
+// Parameters:   paucSearch - string to search
+//               paucKey    - parameter name, including the ':'
+//               lucField   - PARSE_FIELD_xxx to update
+// Return:       None
+////////////////////////////////////////////////////////////////////////////
+static void
+parse_param(char *paucSearch, char *paucKey, guint8 lucField)
+{
+    char *plcDetectedParam;
+    char *plcSpace;
+    size_t lsizeKey = strlen(paucKey);
+
+    plcDetectedParam = strstr(paucSearch, paucKey);
+    if (plcDetectedParam)
+    {
+        plcSpace = strchr(plcDetectedParam+lsizeKey, 0x20); // search for 1st space character
+        if (plcSpace)
+        {
+            memset (lcTempParseString, 0, sizeof(lcTempParseString));
+            memcpy (lcTempParseString, plcDetectedParam+lsizeKey,
+                    MIN((size_t)(plcSpace - (plcDetectedParam+lsizeKey)), sizeof(lcTempParseString)-1));
+            parse_field_set(lucField, lcTempParseString);
+        }
+    }
+}
+// end parse_param
+
+
+////////////////////////////////////////////////////////////////////////////
+// Name:         parse_rest
+// Description:  Copy the rest of a string, starting at an offset, into
+//               the temporary parse string
+// Parameters:   paucStart - start of the rest of the string
+// Return:       Pointer to the temporary parse string
+////////////////////////////////////////////////////////////////////////////
+static char *
+parse_rest(char *paucStart)
+{
+    memset (lcTempParseString, 0, sizeof(lcTempParseString));
+    memcpy (lcTempParseString, paucStart, MIN(strlen(paucStart), sizeof(lcTempParseString)-1));
+    return lcTempParseString;
+}
+// end parse_rest
+
+
+////////////////////////////////////////////////////////////////////////////
+// Name:         parse_patterns
+// Description:  Run the plugin handlers for the patterns in a string, in
+//               one pass: at each character only the patterns starting
+//               with it are compared, and each pattern fires at most once
+// Parameters:   paucReceiveMsg - pointer to received NULL-terminated string
+// Return:       None
+////////////////////////////////////////////////////////////////////////////
+static void
+parse_patterns(char *paucReceiveMsg)
+{
+    ParsePattern *plsPattern;
+    guint64 lullFired = 0;
+    guint32 lulFiredCount = 0;
+    guint32 lulIndex;
+    guint8 *plucAt;
+
+    for (plucAt = (guint8 *)paucReceiveMsg; *plucAt && lulFiredCount < gulParsePatternCount; ++plucAt)
+    {
+        for (lulIndex = gulParsePatternFirst[*plucAt]; lulIndex < gulParsePatternFirst[*plucAt + 1]; ++lulIndex)
+        {
+            plsPattern = &gsParsePattern[lulIndex];
+            if ((lullFired & (1ULL << lulIndex)) ||
+                0 != strncmp((char *)plucAt, plsPattern->cText, plsPattern->ulLength)) continue;
+            lullFired |= (1ULL << lulIndex);
+            ++lulFiredCount;
+            plsPattern->pfHandler(paucReceiveMsg, (char *)plucAt, plsPattern->pvContext);
+        }
+    }
+}
+// end parse_patterns
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Parser
+//
+///////////////////////////////////////////////////////////////////////////////
+
+////////////////////////////////////////////////////////////////////////////
+// Name:         parse_initialize
+// Description:  Initialize the parser and set the routines it reports to
+// Parameters:   pasHooks - routines for Status, field updates, etc.
+// Return:       None
+////////////////////////////////////////////////////////////////////////////
+void
+parse_initialize(ParseHooks *pasHooks)
+{
+    gsParseHooks = *pasHooks;
+    memset(gucParseField, 0, sizeof(gucParseField));
+    memset(gucStickyErrorStatus, 0x00, sizeof(gucStickyErrorStatus));
+}
+// end parse_initialize
+
+
+////////////////////////////////////////////////////////////////////////////
+// Name:         parse_field_name
+// Description:  Name of a parsed field
+// Parameters:   lucField - PARSE_FIELD_xxx, or a plugin field
+// Return:       Pointer to NULL-terminated field name
+////////////////////////////////////////////////////////////////////////////
+char *
+parse_field_name(guint8 lucField)
+{
+    if (lucField < PARSE_FIELD_COUNT) return pucParseFieldNames[lucField];
+    return (lucField < gulParseFieldCount) ? gucParsePluginFieldNames[lucField - PARSE_FIELD_COUNT] : "?";
+}
+// end parse_field_name
+
+
+////////////////////////////////////////////////////////////////////////////
+// Name:         parse_field_set
+// Description:  Save a new value for a parsed field and report it
+//               (only reported if the value has changed)
+// Parameters:   lucField  - PARSE_FIELD_xxx, or a plugin field
+//               paucValue - pointer to NULL-terminated value
+// Return:       None
+////////////////////////////////////////////////////////////////////////////
+void
+parse_field_set(guint8 lucField, char *paucValue)
+{
+    if (lucField >= gulParseFieldCount) return;
+    gulParseFieldsFound |= (1UL << lucField);
+    if (0 == strncmp(gucParseField[lucField], paucValue, PARSE_FIELD_LENGTH_MAX-1)) return;
+
+    g_strlcpy(gucParseField[lucField], paucValue, PARSE_FIELD_LENGTH_MAX);
+    if (gsParseHooks.field_update) gsParseHooks.field_update(lucField, gucParseField[lucField]);
+}
+// end parse_field_set
+
+
+////////////////////////////////////////////////////////////////////////////
+// Name:         parse_sticky_repeat
+// Description:  Sticky error timer - once a minute, write the sticky
+//               error status to Status
+// Parameters:   pasTimer - gsStickyErrorRepeatTimer
+// Return:       None
+////////////////////////////////////////////////////////////////////////////
+static void
+parse_sticky_repeat(TimerwheelTimer *pasTimer)
+{
+    parse_status_write(gucStickyErrorStatus);
+    parse_status_write("\r\n");
+}
+// end parse_sticky_repeat
+
+
+////////////////////////////////////////////////////////////////////////////
+// Name:         parse_sticky_clear
+// Description:  Clear the sticky error status (if any), prep for the next one
+// Parameters:   None
+// Return:       None
+////////////////////////////////////////////////////////////////////////////
+static void
+parse_sticky_clear(void)
+{
+    memset(gucStickyErrorStatus, 0x00, sizeof(gucStickyErrorStatus));
+    timerwheel_cancel(&gsStickyErrorRepeatTimer);
+    timerwheel_cancel(&gsStickyErrorExpireTimer);
+    parse_field_set(PARSE_FIELD_STATUS_TITLE, "Status");
+}
+// end parse_sticky_clear
+
+
+////////////////////////////////////////////////////////////////////////////
+// Name:         parse_sticky_expire
+// Description:  Sticky error timer - STICKY_ERROR_COUNT_PERIOD_SECONDS
+//               after the last error, stop displaying it
+// Parameters:   pasTimer - gsStickyErrorExpireTimer
+// Return:       None
+////////////////////////////////////////////////////////////////////////////
+static void
+parse_sticky_expire(TimerwheelTimer *pasTimer)
+{
+    parse_sticky_clear();
+}
+// end parse_sticky_expire
+
+
+////////////////////////////////////////////////////////////////////////////
+// Name:         parse_sticky_set
+// Description:  Make an error the sticky error status: displayed in the
+//               Status title for STICKY_ERROR_COUNT_PERIOD_SECONDS, and
+//               to Status itself once a minute. A new error restarts the
+//               expiry but not the minute already under way
+// Parameters:   paucError - pointer to NULL-terminated error
+// Return:       None
+////////////////////////////////////////////////////////////////////////////
+static void
+parse_sticky_set(char *paucError)
+{
+    char lcTitle[sizeof(gucStickyErrorStatus) + 10];
+
+    g_strlcpy(gucStickyErrorStatus, paucError, sizeof(gucStickyErrorStatus));
+    sprintf(lcTitle, "Status: %s", gucStickyErrorStatus);
+    parse_field_set(PARSE_FIELD_STATUS_TITLE, lcTitle);
+
+    if (!timerwheel_is_pending(&gsStickyErrorRepeatTimer))
+    {
+        timerwheel_start(&gsStickyErrorRepeatTimer, 60*1000, 60*1000, parse_sticky_repeat, NULL);
+    }
+    timerwheel_start(&gsStickyErrorExpireTimer, STICKY_ERROR_COUNT_PERIOD_SECONDS*1000, 0, parse_sticky_expire, NULL);
+}
+// end parse_sticky_set
+
+
+////////////////////////////////////////////////////////////////////////////
+// Name:         parse_clear_UUT_values
+// Description:  Reset the parsed values of the unit under test,
+//               the sticky error status and the device start time
+// Parameters:   None
+// Return:       None
+////////////////////////////////////////////////////////////////////////////
+void
+parse_clear_UUT_values(void)
+{
+    guint8 i;
+
+    for (i = 0; i < PARSE_FIELD_COUNT; ++i)
+    {
+        if (pucParseFieldDefaults[i]) parse_field_set(i, pucParseFieldDefaults[i]);
+    }
+    if (gsParseHooks.connection_update) gsParseHooks.connection_update(FALSE);
+
+    // Clear sticky error status, prep for the next one
+    parse_sticky_clear();
+
+    // Clear device start time
+    gulDeviceStartTimestamp   = 0;
+}
+// end parse_clear_UUT_values
+
+
+
+
+////////////////////////////////////////////////////////////////////////////
+// Name:         parse_msg
+// Description:  Parse a string for detectable data
+// Parameters:   paucReceiveMsg - pointer to received NULL-terminated string
+// Return:       Fields found in the string, bit (1 << PARSE_FIELD_xxx) set
+//               for each (whether or not its value changed)
+////////////////////////////////////////////////////////////////////////////
+guint32
+parse_msg(char *paucReceiveMsg)
+{
+    char *plcDetected;
+    char *plcPercentage;
+    char *plcDetectedParam;
+    char *plcSpace;
+    guint64 lullStart_ns = metrics_now_ns();
+
+    gulParseFieldsFound = 0;
+
+    // Look for *** WARNING ***
+    plcDetected = strstr((char*)paucReceiveMsg, "*** WARNING ***");
+    if (plcDetected)
+    {
+        // Write the entire warning, including *** WARNING ***, to Status
+        // (but only if there's a significant string following)
+        parse_rest(plcDetected);
+        if (strlen(lcTempParseString) > 20)
+        {
+            parse_status_write(lcTempParseString);
+            parse_status_write("\r\n");
+        }
+    }
+
+    // Look for *** ERROR ***
+    plcDetected = strstr((char*)paucReceiveMsg, "*** ERROR ***");
+    if (plcDetected)
+    {
+        // Write the entire error, including *** ERROR ***, to Status
+        // (but only if there's a significant string following)
+        parse_rest(plcDetected);
+        if (strlen(lcTempParseString) > 20)
+        {
+            parse_status_write(lcTempParseString);
+            parse_status_write("\r\n");
+
+            // Save error message as a sticky one
+            parse_sticky_set(lcTempParseString);
+        }
+    }
+
+    // Look for "Sensaphone WSG30 Temperature Sensor Display starting..."
+    plcDetected = strstr((char*)paucReceiveMsg, "Sensaphone WSG30 Temperature Sensor Display starting...");
+    if (plcDetected)
+    {
+        // This is a new UUT or the old UUT restarting
+        // Either way, reset the Diagnostic tool display
+        if (gsParseHooks.uut_reset) gsParseHooks.uut_reset();
+    }
+
+    // Look for "Board revision = "
+    plcDetected = strstr((char*)paucReceiveMsg, "Board revision = ");
+    if (plcDetected)
+    {
+        // Write the board rev to Status
+        parse_rest(plcDetected+17);
+        parse_status_write("Detected Board revision: ");
+        parse_status_write(lcTempParseString);
+        parse_status_write("\r\n");
+    }
+
+    // Look for "WSG30 Temperature Display firmware version is "
+    plcDetected = strstr((char*)paucReceiveMsg, "WSG30 Temperature Display firmware version is ");
+    if (plcDetected)
+    {
+        // Write the WSG30 Temperature Sensor FW version to Status
+        parse_rest(plcDetected+46);
+        parse_status_write("Detected WSG30 Temperature Display firmware version: ");
+        parse_status_write(lcTempParseString);
+        parse_status_write("\r\n");
+        parse_field_set(PARSE_FIELD_FWVER, lcTempParseString);
+    }
+
+    // Look for "Network_Connection_StateMachine: Transitioning from "
+    plcDetected = strstr((char*)paucReceiveMsg, "Network_Connection_StateMachine: Transitioning from ");
+    if (plcDetected)
+    {
+        // Write the network online state transition to Status
+        parse_status_write(paucReceiveMsg);
+        parse_status_write("\r\n");
+
+        // Get the new connection state
+        plcDetectedParam = strstr((char*)paucReceiveMsg, " to ");
+        if (plcDetectedParam)
+        {
+            parse_rest(trim(plcDetectedParam+4));
+            parse_field_set(PARSE_FIELD_CONNECTION, lcTempParseString);
+            if ( strstr((char*)lcTempParseString, "CONNECTED") )
+            {
+                if (gsParseHooks.connection_update) gsParseHooks.connection_update(TRUE);
+
+                // Clear sticky error status, prep for the next one
+                parse_sticky_clear();
+            }
+            else
+            {
+                if (gsParseHooks.connection_update) gsParseHooks.connection_update(FALSE);
+            }
+        }
+    }
+
+    // Look for " seconds to Diagnostic mode disable..."
+    plcDetected = strstr((char*)paucReceiveMsg, " seconds to Diagnostic mode disable...");
+    if (plcDetected && !gfParseIsReplay)
+    {
+        // UUT has started up, waiting for keypress to go into Diagnostic mode
+        // Send a sacrificial dummy string to enable Diagnostic mode
+        serial_write("+++ 1  2  3  Sensaphone WSG30 Temperature Display Diagnostic tool reporting...\r\n");
+    }
+
+    // Look for "InputTask: Battery reading: " then "Percentage " and "Battery voltage "
+    plcDetected = strstr((char*)paucReceiveMsg, "InputTask: Battery reading: ");
+    if (plcDetected)
+    {
+        plcPercentage = strstr((char*)plcDetected, "Percentage ");
+        if (plcPercentage)
+        {
+            // Write the battery percentage to the Battery Value label
+            parse_rest(trim(plcPercentage+11));
+            parse_field_set(PARSE_FIELD_BATTERY_PERCENTAGE, lcTempParseString);
+        }
+
+        plcDetectedParam = strstr((char*)plcDetected, "Battery voltage ");
+        plcSpace = plcDetectedParam ? strchr(plcDetectedParam+16, 0x20) : NULL; // search for 1st space character
+        if (plcDetectedParam && plcSpace)
+        {
+            // Write the battery voltage to the Battery Voltage label
+            memset (lcTempParseString, 0, sizeof(lcTempParseString));
+            memcpy (lcTempParseString, plcDetectedParam+16, MIN((size_t)(plcSpace - (plcDetectedParam+16)), sizeof(lcTempParseString)-3));
+            strcat (lcTempParseString, " V");
+            parse_field_set(PARSE_FIELD_BATTERY_VOLTAGE, lcTempParseString);
+        }
+    }
+
+    // Look for "Timestamp "
+    plcDetected = strstr((char*)paucReceiveMsg, "Timestamp ");
+    if (plcDetected)
+    {
+        plcSpace = strchr(plcDetected+10, 0x20); // search for 1st space character
+        if (plcSpace)
+        {
+            // Get date and time, excluding the seconds and UTC
+            memset(lcTempParseString, 0, sizeof(lcTempParseString));
+            memcpy(lcTempParseString, plcDetected+10, MIN((size_t)(plcSpace-(plcDetected+10)), sizeof(lcTempParseString)-1));
+
+            // Write device time to Timestamp label
+            parse_field_set(PARSE_FIELD_TIMESTAMP, lcTempParseString);
+
+            // Calculate elapsed time
+            gulDeviceCurrentTimestamp = (guint32)atoi(trim(lcTempParseString));
+            if (0 == gulDeviceStartTimestamp || gulDeviceStartTimestamp > gulDeviceCurrentTimestamp)
+            {
+                gulDeviceStartTimestamp = gulDeviceCurrentTimestamp;
+            }
+            gulDeviceRuntime_seconds = gulDeviceCurrentTimestamp - gulDeviceStartTimestamp;
+            guint16 luiRuntime_Days     = gulDeviceRuntime_seconds / (60*60*24);
+            guint8  lucRuntime_Hours    = (gulDeviceRuntime_seconds % (60*60*24))/(60*60);
+            guint8  lucRuntime_Minutes  = (gulDeviceRuntime_seconds % (60*60))/60;
+            guint8  lucRuntime_Seconds  = (gulDeviceRuntime_seconds % (60*60))%60;
+            sprintf(lcTempParseString, "%dd %dh %dm %ds", luiRuntime_Days, lucRuntime_Hours, lucRuntime_Minutes, lucRuntime_Seconds);
+            parse_field_set(PARSE_FIELD_ELAPSED_TIME, lcTempParseString);
+        }
+    }
+
+    // Look for "STATUS >> "
+    plcDetected = strstr((char*)paucReceiveMsg, "STATUS >> ");
+    if (plcDetected)
+    {
+        // look for "Scale:", write "Fahrenheit" or "Celsius"
+        plcDetectedParam = strstr((char*)plcDetected, "Scale:");
+        plcSpace = plcDetectedParam ? strchr(plcDetectedParam+6, 0x20) : NULL; // search for 1st space character
+        if (plcDetectedParam && plcSpace)
+        {
+            if (memchr(plcDetectedParam+6, 'F', plcSpace - (plcDetectedParam+6)))
+            {
+                parse_field_set(PARSE_FIELD_SCALE, "Fahrenheit");
+            }
+            else
+            {
+                parse_field_set(PARSE_FIELD_SCALE, "Celsius");
+            }
+        }
+
+        parse_param(plcDetected, "MIN:",               PARSE_FIELD_MINIMUM);
+        parse_param(plcDetected, "TEMP:",              PARSE_FIELD_TEMPERATURE);
+        parse_param(plcDetected, "MAX:",               PARSE_FIELD_MAXIMUM);
+        parse_param(plcDetected, "AlHI:",              PARSE_FIELD_ALARM_HI);
+        parse_param(plcDetected, "AlLO:",              PARSE_FIELD_ALARM_LO);
+        parse_param(plcDetected, "Alarm:",             PARSE_FIELD_ALARM);
+        parse_param(plcDetected, "SampleRateSeconds:", PARSE_FIELD_SAMPLE_RATE);
+        parse_param(plcDetected, "ACK:",               PARSE_FIELD_ACK);
+        parse_param(plcDetected, "HostCal:",           PARSE_FIELD_HOSTCAL);
+        parse_param(plcDetected, "Buzzer:",            PARSE_FIELD_BUZZER);
+
+        // look for "Mains:" (last parameter, runs to the end of the string)
+        plcDetectedParam = strstr((char*)plcDetected, "Mains:");
+        if (plcDetectedParam)
+        {
+            parse_field_set(PARSE_FIELD_MAINS, parse_rest(plcDetectedParam+6));
+        }
+    }
+
+    // Look for "XBEE >> "
+    plcDetected = strstr((char*)paucReceiveMsg, "XBEE >> ");
+    if (plcDetected)
+    {
+        parse_param(plcDetected, "SerialNumber:", PARSE_FIELD_XBEE_SN);
+        parse_param(plcDetected, "Device:",       PARSE_FIELD_DEVICE);
+        parse_param(plcDetected, "PAN_ID:",       PARSE_FIELD_PANID);
+        parse_param(plcDetected, "Channel:",      PARSE_FIELD_CHANNEL);
+
+        // look for "Connection:" (last parameter, runs to the end of the string)
+        plcDetectedParam = strstr((char*)plcDetected, "Connection:");
+        if (plcDetectedParam)
+        {
+            parse_field_set(PARSE_FIELD_CONNECTION, parse_rest(plcDetectedParam+11));
+        }
+    }
+
+    // Look for "Network_XBee_Modem_Status: "
+    plcDetected = strstr((char*)paucReceiveMsg, "Network_XBee_Modem_Status: ");
+    if (plcDetected)
+    {
+        // Write the Modem Status to Status and to the connection label
+        parse_rest(plcDetected+27);
+        parse_status_write("Modem Status: ");
+        parse_status_write(lcTempParseString);
+        parse_status_write("\r\n");
+        parse_field_set(PARSE_FIELD_CONNECTION, lcTempParseString);
+    }
+
+    // Look for "PCB revision = "
+    plcDetected = strstr((char*)paucReceiveMsg, "PCB revision = ");
+    if (plcDetected)
+    {
+        parse_rest(plcDetected+15);
+        parse_status_write("Detected PCB revision: ");
+        parse_status_write(lcTempParseString);
+        parse_status_write("\r\n");
+        // Write the PCB revision to the PCB rev text entry box
+        parse_field_set(PARSE_FIELD_PCB_REV, lcTempParseString);
+    }
+
+    // Look for "Serial number = "
+    plcDetected = strstr((char*)paucReceiveMsg, "Serial number = ");
+    if (plcDetected)
+    {
+        parse_rest(plcDetected+16);
+        parse_status_write("Detected serial number: ");
+        parse_status_write(lcTempParseString);
+        parse_status_write("\r\n");
+        // Write the serial number to the serial number text entry box
+        parse_field_set(PARSE_FIELD_SERIAL_NUM, lcTempParseString);
+    }
+
+    // Look for "Calibration date = "
+    plcDetected = strstr((char*)paucReceiveMsg, "Calibration date = ");
+    if (plcDetected)
+    {
+        parse_rest(plcDetected+19);
+        parse_status_write("Detected calibration date (YYYYMMDD): ");
+        parse_status_write(lcTempParseString);
+        parse_status_write("\r\n");
+        // Write the calibration date to the calibration date text entry box
+        parse_field_set(PARSE_FIELD_CAL_DATE, lcTempParseString);
+    }
+
+    // Look for "Voltage reference (mV) = "
+    plcDetected = strstr((char*)paucReceiveMsg, "Voltage reference (mV) = ");
+    if (plcDetected)
+    {
+        parse_rest(plcDetected+25);
+        parse_status_write("Detected voltage reference (mV): ");
+        parse_status_write(lcTempParseString);
+        parse_status_write("\r\n");
+        // Write the voltage reference to the voltage reference text entry box
+        parse_field_set(PARSE_FIELD_VREF, lcTempParseString);
+    }
+
+    // Look for "PAN_ID:" and "Channel:" outside of "XBEE >> "
+    if (!strstr((char*)paucReceiveMsg, "XBEE >> "))
+    {
+        parse_param(paucReceiveMsg, "PAN_ID:",  PARSE_FIELD_PANID);
+        parse_param(paucReceiveMsg, "Channel:", PARSE_FIELD_CHANNEL);
+    }
+
+    // Plugin patterns
+    if (gulParsePatternCount) parse_patterns(paucReceiveMsg);
+
+    metrics_record(METRICS_PARSE_NS, metrics_now_ns() - lullStart_ns);
+    return gulParseFieldsFound;
+}
+// end parse_msg
+
+
+////////////////////////////////////////////////////////////////////////////
+// Name:         parse_msg_replay
+// Description:  Parse a line from a replayed capture: as parse_msg(),
+//               but nothing is written to the serial port, so a replay
+//               never talks to the UUT that may still be connected
+// Parameters:   paucReceiveMsg - pointer to replayed NULL-terminated string
+// Return:       Fields found in the string, as parse_msg()
+////////////////////////////////////////////////////////////////////////////
+guint32
+parse_msg_replay(char *paucReceiveMsg)
+{
+    guint32 lulFieldMask;
+
+    gfParseIsReplay = TRUE;
+    lulFieldMask = parse_msg(paucReceiveMsg);
+    gfParseIsReplay = FALSE;
+    return lulFieldMask;
+}
+// end parse_msg_replay
+
+
+////////////////////////////////////////////////////////////////////////////
+// Name:         parse_add_field
+// Description:  Add a plugin output field, after the built-in ones
+// Parameters:   paucName - field name (a copy is kept)
+// Return:       Field number, or -1 if there's no room or registration
+//               is closed
+////////////////////////////////////////////////////////////////////////////
+gint
+parse_add_field(const char *paucName)
+{
+    if (gfParseCompiled || gulParseFieldCount >= PARSE_FIELD_TOTAL || NULL == paucName || !*paucName) return -1;
+    g_strlcpy(gucParsePluginFieldNames[gulParseFieldCount - PARSE_FIELD_COUNT], paucName, PARSE_FIELD_LENGTH_MAX);
+    return (gint)gulParseFieldCount++;
+}
+// end parse_add_field
+
+
+////////////////////////////////////////////////////////////////////////////
+// Name:         parse_add_pattern
+// Description:  Add a plugin line pattern: the handler is called for the
+//               first place the text appears in a line
+// Parameters:   paucText   - text to look for (a copy is kept)
+//               pafHandler - handler
+//               pavContext - passed to the handler
+// Return:       TRUE if added; FALSE if there's no room, the text is empty
+//               or too long, or registration is closed
+////////////////////////////////////////////////////////////////////////////
+gboolean
+parse_add_pattern(const char *paucText, ParsePluginHandler pafHandler, void *pavContext)
+{
+    ParsePattern *plsPattern;
+
+    if (gfParseCompiled || gulParsePatternCount >= PARSE_PATTERNS_MAX || NULL == pafHandler ||
+        NULL == paucText || !*paucText || strlen(paucText) >= PARSE_PATTERN_LENGTH_MAX) return FALSE;
+    plsPattern = &gsParsePattern[gulParsePatternCount++];
+    g_strlcpy(plsPattern->cText, paucText, sizeof(plsPattern->cText));
+    plsPattern->ulLength  = strlen(paucText);
+    plsPattern->pfHandler = pafHandler;
+    plsPattern->pvContext = pavContext;
+    return TRUE;
+}
+// end parse_add_pattern
+
+
+////////////////////////////////////////////////////////////////////////////
+// Name:         parse_compile
+// Description:  Close registration and index the plugin patterns by first
+//               character (stable, so patterns with the same first
+//               character fire in the order they were added)
+// Parameters:   None
+// Return:       None
+////////////////////////////////////////////////////////////////////////////
+void
+parse_compile(void)
+{
+    ParsePattern lsSorted[PARSE_PATTERNS_MAX];
+    guint32 lulCount[257];
+    guint32 lulIndex;
+    guint32 lulChar;
+
+    if (gfParseCompiled) return;
+    gfParseCompiled = TRUE;
+
+    memset(lulCount, 0, sizeof(lulCount));
+    for (lulIndex = 0; lulIndex < gulParsePatternCount; ++lulIndex)
+    {
+        ++lulCount[(guint8)gsParsePattern[lulIndex].cText[0] + 1];
+    }
+    gulParsePatternFirst[0] = 0;
+    for (lulChar = 1; lulChar <= 256; ++lulChar)
+    {
+        gulParsePatternFirst[lulChar] = gulParsePatternFirst[lulChar-1] + lulCount[lulChar];
+    }
+    memcpy(lulCount, gulParsePatternFirst, sizeof(lulCount));
+    for (lulIndex = 0; lulIndex < gulParsePatternCount; ++lulIndex)
+    {
+        lsSorted[lulCount[(guint8)gsParsePattern[lulIndex].cText[0]]++] = gsParsePattern[lulIndex];
+    }
+    memcpy(gsParsePattern, lsSorted, gulParsePatternCount * sizeof(ParsePattern));
+}
+// end parse_compile
+
+
+////////////////////////////////////////////////////////////////////////////
+// Name:         parse_field_count
+// Name:         parse_pattern_count
+// Description:  Fields defined (built-in and plugin), plugin patterns
+// Parameters:   None
+// Return:       Count
+////////////////////////////////////////////////////////////////////////////
+guint32
+parse_field_count(void)
+{
+    return gulParseFieldCount;
+}
+// end parse_field_count
+
+guint32
+parse_pattern_count(void)
+{
+    return gulParsePatternCount;
+}
+// end parse_pattern_count
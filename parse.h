@@ -0,0 +1,122 @@
+/*
+ * File:   parse.h
+ * Author: Mark Bersalona
+ *
+ * Created on 2024.07.15
+ */
+
+#ifndef PARSE_H
+#define PARSE_H
+
+#include "parse_plugin.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Definitions
+//
+///////////////////////////////////////////////////////////////////////////////
+
+// Parsed fields (the UUT values shown in the Diagnostic display)
+#define PARSE_FIELD_FWVER              (0)
+#define PARSE_FIELD_TIMESTAMP          (1)
+#define PARSE_FIELD_ELAPSED_TIME       (2)
+#define PARSE_FIELD_BATTERY_VOLTAGE    (3)
+#define PARSE_FIELD_BATTERY_PERCENTAGE (4)
+#define PARSE_FIELD_MAINS              (5)
+#define PARSE_FIELD_SCALE              (6)
+#define PARSE_FIELD_MINIMUM            (7)
+#define PARSE_FIELD_TEMPERATURE        (8)
+#define PARSE_FIELD_MAXIMUM            (9)
+#define PARSE_FIELD_ALARM_HI           (10)
+#define PARSE_FIELD_ALARM_LO           (11)
+#define PARSE_FIELD_ALARM              (12)
+#define PARSE_FIELD_SAMPLE_RATE        (13)
+#define PARSE_FIELD_ACK                (14)
+#define PARSE_FIELD_HOSTCAL            (15)
+#define PARSE_FIELD_BUZZER             (16)
+#define PARSE_FIELD_XBEE_SN            (17)
+#define PARSE_FIELD_DEVICE             (18)
+#define PARSE_FIELD_PANID              (19)
+#define PARSE_FIELD_CHANNEL            (20)
+#define PARSE_FIELD_CONNECTION         (21)
+#define PARSE_FIELD_PCB_REV            (22)
+#define PARSE_FIELD_SERIAL_NUM         (23)
+#define PARSE_FIELD_CAL_DATE           (24)
+#define PARSE_FIELD_VREF               (25)
+#define PARSE_FIELD_STATUS_TITLE       (26)
+#define PARSE_FIELD_COUNT              (27)
+
+// Fields added by parser plugins follow the built-in ones, up to the 32
+// bits of the parse_msg() field mask
+#define PARSE_FIELD_PLUGIN_MAX         (32 - PARSE_FIELD_COUNT)
+#define PARSE_FIELD_TOTAL              (PARSE_FIELD_COUNT + PARSE_FIELD_PLUGIN_MAX)
+
+// Plugin line patterns: most, and longest text
+#define PARSE_PATTERNS_MAX             (64)
+#define PARSE_PATTERN_LENGTH_MAX       (64)
+
+#define PARSE_FIELD_LENGTH_MAX         (250)
+
+// Sticky error status
+#define STICKY_ERROR_COUNT_PERIOD_SECONDS 600
+
+// Routines the parser calls to report what it found.
+// The GTK display and the headless front end each supply their own.
+typedef struct
+{
+    void (*status_write)(char *paucWriteBuf);              // write to Status
+    void (*field_update)(guint8 lucField, char *paucValue); // a parsed field has a new value
+    void (*connection_update)(gboolean lfIsConnected);     // network connection state transition
+    void (*uut_reset)(void);                               // UUT startup/reboot detected
+} ParseHooks;
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Public routines
+//
+///////////////////////////////////////////////////////////////////////////////
+
+void parse_initialize(ParseHooks *pasHooks);
+void parse_clear_UUT_values(void);
+char *parse_field_name(guint8 lucField);
+void parse_field_set(guint8 lucField, char *paucValue);
+guint32 parse_msg(char *paucReceiveMsg);
+guint32 parse_msg_replay(char *paucReceiveMsg);
+void parse_status_write(char *paucWriteBuf);
+
+// Plugin registration, at startup; parse_compile() closes it
+gint parse_add_field(const char *paucName);
+gboolean parse_add_pattern(const char *paucText, ParsePluginHandler pafHandler, void *pavContext);
+void parse_compile(void);
+guint32 parse_field_count(void);
+guint32 parse_pattern_count(void);
+char *trim(char *paucInputString);
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Public variables
+//
+///////////////////////////////////////////////////////////////////////////////
+
+// Latest value of each parsed field
+extern char gucParseField[PARSE_FIELD_TOTAL][PARSE_FIELD_LENGTH_MAX];
+
+// Sticky error status
+extern char gucStickyErrorStatus[200];
+
+// Device initial and current timestamps
+extern guint32 gulDeviceStartTimestamp;
+extern guint32 gulDeviceCurrentTimestamp;
+extern guint32 gulDeviceRuntime_seconds;
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* PARSE_H */
+
@@ -0,0 +1,84 @@
+/*
+ * File:   parse_plugin.h
+ * Author: Mark Bersalona
+ *
+ * Created on 2024.07.15
+ * Parser plugin ABI (--parser-plugin)
+ *
+ * A parser plugin is a shared object that adds line handlers for messages
+ * the built-in parser doesn't know, e.g. from a firmware variant, without
+ * rebuilding the tool. It includes only this header (no GLib), and
+ * exports two symbols:
+ *
+ *   PARSE_PLUGIN_DECLARE;
+ *   int wsg30_parser_plugin_init(const ParsePluginHost *psHost)
+ *   {
+ *       giMyField = psHost->add_field("RSSI");
+ *       return psHost->add_pattern("RSSI: ", my_rssi_handler, NULL);
+ *   }
+ *
+ * Plugins are loaded at startup, before the first line is parsed; the
+ * init routine registers its output fields and the text patterns it
+ * handles, and returns 0 (anything else fails the load). Registration is
+ * closed once every plugin is loaded, and the patterns are indexed for a
+ * single pass over each line.
+ *
+ * A handler is called, on the thread that parses, for the first place its
+ * pattern appears in a line, after the built-in parser has seen the line.
+ * It reports through the host routines only, and must not keep pcLine or
+ * pcMatch. Field values show under Statistics (GUI, refreshed once a
+ * second), in the headless output, in the fan-out telemetry and in the
+ * field mask of the session log.
+ */
+
+#ifndef PARSE_PLUGIN_H
+#define PARSE_PLUGIN_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Definitions
+//
+///////////////////////////////////////////////////////////////////////////////
+
+// Raised whenever ParsePluginHost changes; a plugin built for another
+// version is refused
+#define PARSE_PLUGIN_ABI_VERSION  (1)
+
+// Exported by every plugin
+#define PARSE_PLUGIN_ABI_SYMBOL   "wsg30_parser_plugin_abi"
+#define PARSE_PLUGIN_INIT_SYMBOL  "wsg30_parser_plugin_init"
+#define PARSE_PLUGIN_DECLARE      const unsigned int wsg30_parser_plugin_abi = PARSE_PLUGIN_ABI_VERSION
+
+// Line handler
+// pcLine    - the whole received line, NULL-terminated
+// pcMatch   - where the pattern starts in pcLine
+// pvContext - as given to add_pattern()
+typedef void (*ParsePluginHandler)(const char *pcLine, const char *pcMatch, void *pvContext);
+
+// Host routines, valid for the life of the process
+typedef struct
+{
+    unsigned int uiAbiVersion;                                  // PARSE_PLUGIN_ABI_VERSION
+
+    // Registration, from wsg30_parser_plugin_init() only
+    int  (*add_field)(const char *pcName);                      // field number, or -1 if no room
+    int  (*add_pattern)(const char *pcText, ParsePluginHandler pfHandler, void *pvContext);  // 0, or -1 if no room
+
+    // Reporting, from a handler only
+    void (*field_set)(int iField, const char *pcValue);         // a field has a new value
+    void (*status_write)(const char *pcText);                   // write to Status (add "\r\n")
+} ParsePluginHost;
+
+typedef int (*ParsePluginInit)(const ParsePluginHost *psHost);
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* PARSE_PLUGIN_H */
+
@@ -0,0 +1,814 @@
+/*
+ * File:   pipeline.c
+ * Author: Mark Bersalona
+ *
+ * Created on 2024.07.15
+ * Staged receive pipeline (--pipeline)
+ *
+ * Without --pipeline everything a line does happens in the main loop:
+ * serial_read() a character at a time, the receive FIFO, then log, parse,
+ * record and display in the periodic callback. With it, the work is split
+ * into stages on their own threads, each of which can be pinned to a core:
+ *
+ *   reader  - reads the port in blocks, assembles lines   -> ingest queue
+ *   parser  - flight recorder, logfile queueing, parse,
+ *             session log and export                      -> UI queue
+ *   logger  - the logfile writer thread (logfile.c)
+ *   UI      - the main loop, a thin consumer that shows lines and applies
+ *             what the parser found (pipeline_ui_run() from the periodic)
+ *
+ * Each queue is a single-producer single-consumer byte ring, lock-free
+ * but for sleeping when empty or full. A stage that finds the next queue
+ * full waits for room: a slow display backs up into the parser and then
+ * the reader (and finally the tty driver), rather than dropping lines. The
+ * waits are counted per queue and in the wsg30_pipeline_backpressure_waits
+ * metric, with the queue depths, so a slow stage is easy to spot.
+ */
+
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Includes
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#define _GNU_SOURCE
+#include <glib.h>
+#include <errno.h>
+#include <poll.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "gconfig.h"
+#include "metrics.h"
+#include "parse.h"
+#include "pipeline.h"
+#include "serial.h"
+#include "trace.h"
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Definitions
+//
+///////////////////////////////////////////////////////////////////////////////
+
+// Queue record types
+#define PIPELINE_LINE         (0)   // received line
+#define PIPELINE_STATUS       (1)   // parser hooks, see ParseHooks
+#define PIPELINE_FIELD        (2)
+#define PIPELINE_CONNECTION   (3)
+#define PIPELINE_RESET        (4)
+
+// Record: header, then the NULL-terminated text padded to 8 bytes
+typedef struct
+{
+    guint32 lulLength;          // text bytes, including the NULL
+    guint8  ucType;
+    guint8  ucArg;              // field, or connection state
+    guint16 uiZero;
+    guint64 ullQueued_ns;       // trace_start() when queued
+} PipelineRecord;
+
+// Single-producer single-consumer byte ring
+// ullHead and ullTail are on their own cache lines
+typedef struct
+{
+    char    *pcRing;
+    guint32  lulBytes;          // power of 2
+    guint8   ucGauge;           // METRICS_xxx_QUEUE
+    char     cPad0[64];
+    guint64  ullHead;           // bytes ever queued, written by the producer
+    char     cPad1[64];
+    guint64  ullTail;           // bytes ever taken, written by the consumer
+    char     cPad2[64];
+    guint64  ullWaits;          // times the producer found it full
+    guint64  ullWait_ns;        // ... and how long it waited
+    guint64  ullDropped;        // records dropped while stopping
+    gint     iSleepers;         // producer/consumer sleeping on gCond
+    GMutex   gMutex;
+    GCond    gCond;
+} PipelineQueue;
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Variables and tables
+//
+///////////////////////////////////////////////////////////////////////////////
+
+static PipelineStages gsPipelineStages;
+static gboolean       gfPipelineRunning = FALSE;
+static gint           giPipelineStopping = 0;
+static int            giPipelineCpu[PIPELINE_STAGE_COUNT] = { -1, -1, -1, -1 };
+static char          *pucPipelineStageNames[PIPELINE_STAGE_COUNT] = { "reader", "parser", "logger", "ui" };
+
+static PipelineQueue  gsPipelineIngest;     // reader -> parser
+static PipelineQueue  gsPipelineUi;         // parser -> UI
+
+// Reader: one per opened port; the previous one is stopped first
+static GThread       *gpPipelineReader = NULL;
+static gint           giPipelineReaderStop = 0;
+
+// Parser, and the lock the UI thread takes to touch the parser's state
+static GThread       *gpPipelineParser = NULL;
+static GMutex         gPipelineLock;
+
+// Line buffers, one per consumer
+static char           gucPipelineParserLine[RECEIVE_FIFO_MSG_LENGTH_MAX];
+static char           gucPipelineUiText[RECEIVE_FIFO_MSG_LENGTH_MAX];
+
+
+////////////////////////////////////////////////////////////////////////////
+// Name:         pipeline_queue_init
+// Description:  Allocate an empty queue
+// Parameters:   pasQueue - queue
+//               lulBytes - size, a power of 2
+//               lucGauge - METRICS_xxx_QUEUE gauge
+// Return:       None
+////////////////////////////////////////////////////////////////////////////
+static void
+pipeline_queue_init(PipelineQueue *pasQueue, guint32 lulBytes, guint8 lucGauge)
+{
+    pasQueue->pcRing   = g_malloc(lulBytes);
+    pasQueue->lulBytes = lulBytes;
+    pasQueue->ucGauge  = lucGauge;
+    g_mutex_init(&pasQueue->gMutex);
+    g_cond_init(&pasQueue->gCond);
+    metrics_gauge_capacity(lucGauge, lulBytes);
+}
+// end pipeline_queue_init
+
+
+////////////////////////////////////////////////////////////////////////////
+// Name:         pipeline_queue_sleep
+// Description:  Sleep until the other side wakes the queue, or
+//               PIPELINE_WAIT_MSEC. The condition is checked again after
+//               announcing the sleep, so a wake can't be missed
+// Parameters:   pasQueue  - queue
+//               lullMark  - head (consumer) or tail (producer) position
+//                           read before deciding to sleep
+//               pallWatch - the position the other side moves
+// Return:       None
+////////////////////////////////////////////////////////////////////////////
+static void
+pipeline_queue_sleep(PipelineQueue *pasQueue, guint64 lullMark, guint64 *pallWatch)
+{
+    g_mutex_lock(&pasQueue->gMutex);
+    __atomic_add_fetch(&pasQueue->iSleepers, 1, __ATOMIC_SEQ_CST);
+    if (lullMark == __atomic_load_n(pallWatch, __ATOMIC_SEQ_CST) &&
+        !__atomic_load_n(&giPipelineStopping, __ATOMIC_SEQ_CST))
+    {
+        g_cond_wait_until(&pasQueue->gCond, &pasQueue->gMutex,
+                          g_get_monotonic_time() + PIPELINE_WAIT_MSEC*1000);
+    }
+    __atomic_sub_fetch(&pasQueue->iSleepers, 1, __ATOMIC_SEQ_CST);
+    g_mutex_unlock(&pasQueue->gMutex);
+}
+// end pipeline_queue_sleep
+
+
+////////////////////////////////////////////////////////////////////////////
+// Name:         pipeline_queue_wake
+// Description:  Wake the other side if it's sleeping on the queue
+// Parameters:   pasQueue - queue
+// Return:       None
+////////////////////////////////////////////////////////////////////////////
+static void
+pipeline_queue_wake(PipelineQueue *pasQueue)
+{
+    if (__atomic_load_n(&pasQueue->iSleepers, __ATOMIC_SEQ_CST))
+    {
+        g_mutex_lock(&pasQueue->gMutex);
+        g_cond_broadcast(&pasQueue->gCond);
+        g_mutex_unlock(&pasQueue->gMutex);
+    }
+}
+// end pipeline_queue_wake
+
+
+////////////////////////////////////////////////////////////////////////////
+// Name:         pipeline_queue_copy
+// Description:  Copy into or out of a ring, wrapping at the end
+// Parameters:   pasQueue     - queue
+//               lullPosition - absolute position
+//               pavData      - data
+//               lulLength    - bytes
+//               lfIsIn       - TRUE to copy into the ring
+// Return:       None
+////////////////////////////////////////////////////////////////////////////
+static void
+pipeline_queue_copy(PipelineQueue *pasQueue, guint64 lullPosition, void *pavData, guint32 lulLength, gboolean lfIsIn)
+{
+    guint32 lulOffset = lullPosition & (pasQueue->lulBytes - 1);
+    guint32 lulFirst  = MIN(lulLength, pasQueue->lulBytes - lulOffset);
+
+    if (lfIsIn)
+    {
+        memcpy(pasQueue->pcRing + lulOffset, pavData, lulFirst);
+        memcpy(pasQueue->pcRing, (char *)pavData + lulFirst, lulLength - lulFirst);
+    }
+    else
+    {
+        memcpy(pavData, pasQueue->pcRing + lulOffset, lulFirst);
+        memcpy((char *)pavData + lulFirst, pasQueue->pcRing, lulLength - lulFirst);
+    }
+}
+// end pipeline_queue_copy
+
+
+////////////////////////////////////////////////////////////////////////////
+// Name:         pipeline_queue_push
+// Description:  Producer: queue a record, waiting for room if the queue is
+//               full (while stopping, the record is dropped instead)
+// Parameters:   pasQueue     - queue
+//               lucType      - PIPELINE_xxx
+//               lucArg       - field, or connection state
+//               paucText     - NULL-terminated text (truncated if need be)
+//               lullQueued_ns - trace_start() for the wait span
+// Return:       TRUE if queued
+////////////////////////////////////////////////////////////////////////////
+static gboolean
+pipeline_queue_push(PipelineQueue *pasQueue, guint8 lucType, guint8 lucArg, const char *paucText, guint64 lullQueued_ns)
+{
+    PipelineRecord lsRecord;
+    guint64 lullHead = pasQueue->ullHead;
+    guint64 lullTail;
+    guint64 lullWaitStart_ns = 0;
+    guint32 lulRecordBytes;
+
+    lsRecord.lulLength    = MIN(strlen(paucText), RECEIVE_FIFO_MSG_LENGTH_MAX-1) + 1;
+    lsRecord.ucType       = lucType;
+    lsRecord.ucArg        = lucArg;
+    lsRecord.uiZero       = 0;
+    lsRecord.ullQueued_ns = lullQueued_ns;
+    lulRecordBytes = sizeof(lsRecord) + ((lsRecord.lulLength + 7) & ~7U);
+
+    // Backpressure: wait for the consumer to make room
+    while (lullHead + lulRecordBytes - (lullTail = __atomic_load_n(&pasQueue->ullTail, __ATOMIC_ACQUIRE)) > pasQueue->lulBytes)
+    {
+        if (__atomic_load_n(&giPipelineStopping, __ATOMIC_ACQUIRE))
+        {
+            ++pasQueue->ullDropped;
+            return FALSE;
+        }
+        if (0 == lullWaitStart_ns)
+        {
+            lullWaitStart_ns = metrics_now_ns();
+            __atomic_add_fetch(&pasQueue->ullWaits, 1, __ATOMIC_RELAXED);
+            metrics_add(METRICS_BACKPRESSURE, 1);
+        }
+        pipeline_queue_sleep(pasQueue, lullTail, &pasQueue->ullTail);
+    }
+    if (lullWaitStart_ns)
+    {
+        __atomic_add_fetch(&pasQueue->ullWait_ns, metrics_now_ns() - lullWaitStart_ns, __ATOMIC_RELAXED);
+    }
+
+    pipeline_queue_copy(pasQueue, lullHead, &lsRecord, sizeof(lsRecord), TRUE);
+    pipeline_queue_copy(pasQueue, lullHead + sizeof(lsRecord), (void *)paucText, lsRecord.lulLength - 1, TRUE);
+    pipeline_queue_copy(pasQueue, lullHead + sizeof(lsRecord) + lsRecord.lulLength - 1, "", 1, TRUE);
+    __atomic_store_n(&pasQueue->ullHead, lullHead + lulRecordBytes, __ATOMIC_SEQ_CST);
+    metrics_gauge(pasQueue->ucGauge, lullHead + lulRecordBytes - lullTail);
+    pipeline_queue_wake(pasQueue);
+    return TRUE;
+}
+// end pipeline_queue_push
+
+
+////////////////////////////////////////////////////////////////////////////
+// Name:         pipeline_queue_pop
+// Description:  Consumer: take the next record
+// Parameters:   pasQueue  - queue
+//               pasRecord - set to the record header
+//               paucText  - set to the text, RECEIVE_FIFO_MSG_LENGTH_MAX bytes
+//               lfWait    - TRUE to sleep (up to PIPELINE_WAIT_MSEC) if empty
+// Return:       TRUE if a record was taken
+////////////////////////////////////////////////////////////////////////////
+static gboolean
+pipeline_queue_pop(PipelineQueue *pasQueue, PipelineRecord *pasRecord, char *paucText, gboolean lfWait)
+{
+    guint64 lullTail = pasQueue->ullTail;
+    guint64 lullHead = __atomic_load_n(&pasQueue->ullHead, __ATOMIC_ACQUIRE);
+
+    if (lullHead == lullTail)
+    {
+        if (!lfWait) return FALSE;
+        pipeline_queue_sleep(pasQueue, lullHead, &pasQueue->ullHead);
+        lullHead = __atomic_load_n(&pasQueue->ullHead, __ATOMIC_ACQUIRE);
+        if (lullHead == lullTail) return FALSE;
+    }
+
+    pipeline_queue_copy(pasQueue, lullTail, pasRecord, sizeof(*pasRecord), FALSE);
+    pipeline_queue_copy(pasQueue, lullTail + sizeof(*pasRecord), paucText, pasRecord->lulLength, FALSE);
+    lullTail += sizeof(*pasRecord) + ((pasRecord->lulLength + 7) & ~7U);
+    __atomic_store_n(&pasQueue->ullTail, lullTail, __ATOMIC_SEQ_CST);
+    metrics_gauge(pasQueue->ucGauge, lullHead - lullTail);
+    pipeline_queue_wake(pasQueue);
+    return TRUE;
+}
+// end pipeline_queue_pop
+
+
+////////////////////////////////////////////////////////////////////////////
+// Name:         pipeline_is_parser
+// Description:  Is the caller the parser thread?
+// Parameters:   None
+// Return:       TRUE on the parser thread
+////////////////////////////////////////////////////////////////////////////
+static gboolean
+pipeline_is_parser(void)
+{
+    return gpPipelineParser && g_thread_self() == gpPipelineParser;
+}
+// end pipeline_is_parser
+
+
+////////////////////////////////////////////////////////////////////////////
+// Name:         pipeline_status_write
+// Name:         pipeline_field_update
+// Name:         pipeline_connection_update
+// Description:  Parser hooks - on the parser thread, queue what was found
+//               for the UI; on the UI thread (e.g. a replay), apply it
+// Parameters:   See ParseHooks
+// Return:       None
+////////////////////////////////////////////////////////////////////////////
+static void
+pipeline_status_write(char *paucWriteBuf)
+{
+    if (!pipeline_is_parser())
+    {
+        gsPipelineStages.sUi.status_write(paucWriteBuf);
+        return;
+    }
+    pipeline_queue_push(&gsPipelineUi, PIPELINE_STATUS, 0, paucWriteBuf, 0);
+}
+// end pipeline_status_write
+
+static void
+pipeline_field_update(guint8 lucField, char *paucValue)
+{
+    if (!pipeline_is_parser())
+    {
+        if (gsPipelineStages.sUi.field_update) gsPipelineStages.sUi.field_update(lucField, paucValue);
+        return;
+    }
+    pipeline_queue_push(&gsPipelineUi, PIPELINE_FIELD, lucField, paucValue, 0);
+}
+// end pipeline_field_update
+
+static void
+pipeline_connection_update(gboolean lfIsConnected)
+{
+    if (!pipeline_is_parser())
+    {
+        if (gsPipelineStages.sUi.connection_update) gsPipelineStages.sUi.connection_update(lfIsConnected);
+        return;
+    }
+    pipeline_queue_push(&gsPipelineUi, PIPELINE_CONNECTION, lfIsConnected ? 1 : 0, "", 0);
+}
+// end pipeline_connection_update
+
+
+////////////////////////////////////////////////////////////////////////////
+// Name:         pipeline_uut_reset
+// Description:  Parser hook - UUT startup/reboot detected: clear the
+//               parsed values now, in line order, and have the UI clear
+//               its display
+// Parameters:   None
+// Return:       None
+////////////////////////////////////////////////////////////////////////////
+static void
+pipeline_uut_reset(void)
+{
+    if (pipeline_is_parser())
+    {
+        pipeline_queue_push(&gsPipelineUi, PIPELINE_RESET, 0, "", 0);
+    }
+    else if (gsPipelineStages.sUi.uut_reset)
+    {
+        gsPipelineStages.sUi.uut_reset();
+    }
+    parse_clear_UUT_values();
+}
+// end pipeline_uut_reset
+
+static ParseHooks gsPipelineParseHooks =
+{
+    pipeline_status_write,
+    pipeline_field_update,
+    pipeline_connection_update,
+    pipeline_uut_reset,
+};
+
+
+////////////////////////////////////////////////////////////////////////////
+// Name:         pipeline_ingest
+// Description:  Serial receive handler (reader thread) - queue a line
+//               for the parser
+// Parameters:   paucReceiveMsg - pointer to received NULL-terminated string
+// Return:       None
+////////////////////////////////////////////////////////////////////////////
+static void
+pipeline_ingest(char *paucReceiveMsg)
+{
+    pipeline_queue_push(&gsPipelineIngest, PIPELINE_LINE, 0, paucReceiveMsg, trace_start());
+}
+// end pipeline_ingest
+
+
+////////////////////////////////////////////////////////////////////////////
+// Name:         pipeline_reader
+// Description:  Reader thread - read the port in blocks and assemble
+//               lines (serial_receive_bytes() -> pipeline_ingest()) until
+//               the port fails or the reader is stopped
+// Parameters:   data - port file descriptor
+// Return:       NULL
+////////////////////////////////////////////////////////////////////////////
+static gpointer
+pipeline_reader(gpointer data)
+{
+    struct pollfd lsPoll;
+    char lcBuffer[PIPELINE_READ_BYTES];
+    ssize_t llBytes;
+    int liReady;
+
+    pipeline_pin(PIPELINE_READER);
+    trace_set_thread(TRACE_THREAD_READER);
+    lsPoll.fd     = GPOINTER_TO_INT(data);
+    lsPoll.events = POLLIN;
+    while (!__atomic_load_n(&giPipelineReaderStop, __ATOMIC_ACQUIRE))
+    {
+        liReady = poll(&lsPoll, 1, PIPELINE_WAIT_MSEC);
+        if (liReady < 0 && EINTR == errno) continue;
+        if (liReady < 0) break;
+        if (0 == liReady) continue;
+        if (!(lsPoll.revents & POLLIN)) break;      // POLLERR, POLLHUP, POLLNVAL
+
+        llBytes = read(lsPoll.fd, lcBuffer, sizeof(lcBuffer));
+        if (llBytes > 0)
+        {
+            serial_receive_bytes(lcBuffer, (guint32)llBytes);
+        }
+        else if (0 == llBytes || (EINTR != errno && EAGAIN != errno))
+        {
+            break;
+        }
+    }
+
+    // Port failed: the periodic callback reconnects, as it does for serial_read()
+    if (!__atomic_load_n(&giPipelineReaderStop, __ATOMIC_ACQUIRE))
+    {
+        g_print("\r\n *** pipeline reader: port closed *** \r\n");
+        __atomic_store_n(&isUSBConnectionOK, FALSE, __ATOMIC_RELEASE);
+    }
+    return NULL;
+}
+// end pipeline_reader
+
+
+////////////////////////////////////////////////////////////////////////////
+// Name:         pipeline_reader_start
+// Description:  serial_attach() hook - stop the previous reader, then
+//               start one on the newly opened port
+// Parameters:   lfd - port file descriptor
+// Return:       None
+////////////////////////////////////////////////////////////////////////////
+static void
+pipeline_reader_start(int lfd)
+{
+    if (gpPipelineReader)
+    {
+        __atomic_store_n(&giPipelineReaderStop, 1, __ATOMIC_RELEASE);
+        g_thread_join(gpPipelineReader);
+    }
+    __atomic_store_n(&giPipelineReaderStop, 0, __ATOMIC_RELEASE);
+    gpPipelineReader = g_thread_new("pipeline reader", pipeline_reader, GINT_TO_POINTER(lfd));
+}
+// end pipeline_reader_start
+
+
+////////////////////////////////////////////////////////////////////////////
+// Name:         pipeline_parser
+// Description:  Parser thread - run each line through the front end's
+//               line routine; when stopping, finish what's queued first
+// Parameters:   data - unused
+// Return:       NULL
+////////////////////////////////////////////////////////////////////////////
+static gpointer
+pipeline_parser(gpointer data)
+{
+    PipelineRecord lsRecord;
+    gboolean lfIsStopping;
+
+    pipeline_pin(PIPELINE_PARSER);
+    trace_set_thread(TRACE_THREAD_PARSER);
+    while (TRUE)
+    {
+        lfIsStopping = __atomic_load_n(&giPipelineStopping, __ATOMIC_ACQUIRE);
+        if (!pipeline_queue_pop(&gsPipelineIngest, &lsRecord, gucPipelineParserLine, !lfIsStopping))
+        {
+            if (lfIsStopping) break;
+            continue;
+        }
+        trace_line_dequeued();
+        trace_end(TRACE_FIFO_WAIT, lsRecord.ullQueued_ns);
+
+        g_mutex_lock(&gPipelineLock);
+        gsPipelineStages.line(gucPipelineParserLine);
+        g_mutex_unlock(&gPipelineLock);
+    }
+    return NULL;
+}
+// end pipeline_parser
+
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Public routines
+//
+///////////////////////////////////////////////////////////////////////////////
+
+////////////////////////////////////////////////////////////////////////////
+// Name:         pipeline_set_cpus
+// Description:  Set the CPU each stage is pinned to from a comma-separated
+//               string of stage:N, stage being reader, parser, logger or
+//               ui, e.g. "reader:0,parser:1,logger:2"
+//               Takes effect as each stage starts
+// Parameters:   paucSpec - pinning string
+// Return:       TRUE if the string was understood
+////////////////////////////////////////////////////////////////////////////
+gboolean
+pipeline_set_cpus(char *paucSpec)
+{
+    gchar **pplcItems;
+    gchar **pplcItem;
+    char *plcColon;
+    char *plcEnd;
+    unsigned long lulValue;
+    int liCpu[PIPELINE_STAGE_COUNT];
+    guint8 lucStage;
+    gboolean lfIsOK = TRUE;
+
+    memcpy(liCpu, giPipelineCpu, sizeof(liCpu));
+    pplcItems = g_strsplit(paucSpec, ",", -1);
+    for (pplcItem = pplcItems; *pplcItem && lfIsOK; ++pplcItem)
+    {
+        plcColon = strchr(*pplcItem, ':');
+        for (lucStage = 0; plcColon && lucStage < PIPELINE_STAGE_COUNT; ++lucStage)
+        {
+            if (strlen(pucPipelineStageNames[lucStage]) == (gsize)(plcColon - *pplcItem) &&
+                0 == strncmp(pucPipelineStageNames[lucStage], *pplcItem, plcColon - *pplcItem)) break;
+        }
+        if (!plcColon || lucStage >= PIPELINE_STAGE_COUNT)
+        {
+            lfIsOK = FALSE;
+            break;
+        }
+        lulValue = strtoul(plcColon+1, &plcEnd, 10);
+        if (*plcEnd || plcEnd == plcColon+1 || lulValue >= CPU_SETSIZE)
+        {
+            lfIsOK = FALSE;
+            break;
+        }
+        liCpu[lucStage] = (int)lulValue;
+    }
+    g_strfreev(pplcItems);
+
+    if (lfIsOK) memcpy(giPipelineCpu, liCpu, sizeof(liCpu));
+    return lfIsOK;
+}
+// end pipeline_set_cpus
+
+
+////////////////////////////////////////////////////////////////////////////
+// Name:         pipeline_cpu
+// Description:  CPU a stage is pinned to
+// Parameters:   lucStage - PIPELINE_xxx stage
+// Return:       CPU number, -1 for any
+////////////////////////////////////////////////////////////////////////////
+int
+pipeline_cpu(guint8 lucStage)
+{
+    return giPipelineCpu[lucStage];
+}
+// end pipeline_cpu
+
+
+////////////////////////////////////////////////////////////////////////////
+// Name:         pipeline_pin
+// Description:  Pin the calling thread to its stage's CPU, if it has one
+// Parameters:   lucStage - PIPELINE_xxx stage
+// Return:       None
+////////////////////////////////////////////////////////////////////////////
+void
+pipeline_pin(guint8 lucStage)
+{
+    cpu_set_t lsCpus;
+
+    if (giPipelineCpu[lucStage] < 0) return;
+    CPU_ZERO(&lsCpus);
+    CPU_SET(giPipelineCpu[lucStage], &lsCpus);
+    if (0 != sched_setaffinity(0, sizeof(lsCpus), &lsCpus))
+    {
+        g_printerr("Couldn't pin the %s stage to CPU %d\r\n", pucPipelineStageNames[lucStage], giPipelineCpu[lucStage]);
+    }
+}
+// end pipeline_pin
+
+
+////////////////////////////////////////////////////////////////////////////
+// Name:         pipeline_start
+// Description:  Start the parser thread and take over the serial port:
+//               each port opened from now on gets a reader thread, and
+//               the parser hooks queue for the UI
+//               Call before the port is attached (serial_open_finish())
+// Parameters:   pasStages - the front end's stage routines (copied)
+// Return:       None
+////////////////////////////////////////////////////////////////////////////
+void
+pipeline_start(PipelineStages *pasStages)
+{
+    gsPipelineStages = *pasStages;
+    pipeline_queue_init(&gsPipelineIngest, PIPELINE_INGEST_QUEUE_BYTES, METRICS_INGEST_QUEUE);
+    pipeline_queue_init(&gsPipelineUi,     PIPELINE_UI_QUEUE_BYTES,     METRICS_UI_QUEUE);
+    g_mutex_init(&gPipelineLock);
+
+    parse_initialize(&gsPipelineParseHooks);
+    serial_set_receive_handler(pipeline_ingest);
+    serial_set_reader(pipeline_reader_start);
+    gfPipelineRunning = TRUE;
+    gpPipelineParser = g_thread_new("pipeline parser", pipeline_parser, NULL);
+}
+// end pipeline_start
+
+
+////////////////////////////////////////////////////////////////////////////
+// Name:         pipeline_stop
+// Description:  Stop the reader, let the parser finish the queued lines,
+//               and stop it (what it queues for the UI then is dropped)
+//               The parser's state is the caller's again afterwards
+// Parameters:   None
+// Return:       None
+////////////////////////////////////////////////////////////////////////////
+void
+pipeline_stop(void)
+{
+    if (!gfPipelineRunning) return;
+
+    if (gpPipelineReader)
+    {
+        __atomic_store_n(&giPipelineReaderStop, 1, __ATOMIC_RELEASE);
+        g_thread_join(gpPipelineReader);
+        gpPipelineReader = NULL;
+    }
+    __atomic_store_n(&giPipelineStopping, 1, __ATOMIC_SEQ_CST);
+    pipeline_queue_wake(&gsPipelineIngest);
+    pipeline_queue_wake(&gsPipelineUi);
+    g_thread_join(gpPipelineParser);
+    gpPipelineParser = NULL;
+    gfPipelineRunning = FALSE;
+}
+// end pipeline_stop
+
+
+////////////////////////////////////////////////////////////////////////////
+// Name:         pipeline_is_running
+// Description:  Is the pipeline running?
+// Parameters:   None
+// Return:       TRUE between pipeline_start() and pipeline_stop()
+////////////////////////////////////////////////////////////////////////////
+gboolean
+pipeline_is_running(void)
+{
+    return gfPipelineRunning;
+}
+// end pipeline_is_running
+
+
+////////////////////////////////////////////////////////////////////////////
+// Name:         pipeline_lock
+// Description:  UI thread: take the parser's state (parsed values, session
+//               log, export, replay) from the parser thread, between lines
+//               Not reentrant: don't call from the routines
+//               pipeline_ui_run() calls, or from timer handlers (the
+//               periodic callback runs those with the lock held)
+// Parameters:   None
+// Return:       None
+////////////////////////////////////////////////////////////////////////////
+void
+pipeline_lock(void)
+{
+    if (!gfPipelineRunning) return;
+
+    // The parser may hold the lock while it waits for room in the UI
+    // queue, so keep draining it until the parser finishes its line
+    while (!g_mutex_trylock(&gPipelineLock))
+    {
+        pipeline_ui_run();
+        g_thread_yield();
+    }
+}
+// end pipeline_lock
+
+
+////////////////////////////////////////////////////////////////////////////
+// Name:         pipeline_unlock
+// Description:  UI thread: give the parser's state back
+// Parameters:   None
+// Return:       None
+////////////////////////////////////////////////////////////////////////////
+void
+pipeline_unlock(void)
+{
+    if (gfPipelineRunning) g_mutex_unlock(&gPipelineLock);
+}
+// end pipeline_unlock
+
+
+////////////////////////////////////////////////////////////////////////////
+// Name:         pipeline_ui_line
+// Description:  Parser thread: queue a received line for display
+// Parameters:   paucLine - pointer to NULL-terminated line
+// Return:       None
+////////////////////////////////////////////////////////////////////////////
+void
+pipeline_ui_line(char *paucLine)
+{
+    pipeline_queue_push(&gsPipelineUi, PIPELINE_LINE, 0, paucLine, 0);
+}
+// end pipeline_ui_line
+
+
+////////////////////////////////////////////////////////////////////////////
+// Name:         pipeline_ui_run
+// Description:  UI thread, from the periodic callback: apply everything
+//               the parser has queued so far, in order
+// Parameters:   None
+// Return:       None
+////////////////////////////////////////////////////////////////////////////
+void
+pipeline_ui_run(void)
+{
+    PipelineRecord lsRecord;
+    guint64 lullEnd = __atomic_load_n(&gsPipelineUi.ullHead, __ATOMIC_ACQUIRE);
+
+    // Only what was there on entry, so a busy parser can't keep the UI here
+    while (gsPipelineUi.ullTail < lullEnd &&
+           pipeline_queue_pop(&gsPipelineUi, &lsRecord, gucPipelineUiText, FALSE))
+    {
+        switch (lsRecord.ucType)
+        {
+        case PIPELINE_LINE:
+            gsPipelineStages.display(gucPipelineUiText);
+            break;
+        case PIPELINE_STATUS:
+            gsPipelineStages.sUi.status_write(gucPipelineUiText);
+            break;
+        case PIPELINE_FIELD:
+            if (gsPipelineStages.sUi.field_update) gsPipelineStages.sUi.field_update(lsRecord.ucArg, gucPipelineUiText);
+            break;
+        case PIPELINE_CONNECTION:
+            if (gsPipelineStages.sUi.connection_update) gsPipelineStages.sUi.connection_update(lsRecord.ucArg);
+            break;
+        case PIPELINE_RESET:
+            if (gsPipelineStages.sUi.uut_reset) gsPipelineStages.sUi.uut_reset();
+            break;
+        default:
+            break;
+        }
+    }
+}
+// end pipeline_ui_run
+
+
+////////////////////////////////////////////////////////////////////////////
+// Name:         pipeline_report
+// Description:  Format the queue statistics for Status: bytes waiting,
+//               high-water, and how often and how long each producer
+//               waited for room (backpressure)
+// Parameters:   paucReport - buffer for the report, CRLF terminated
+//               lulSize    - size of buffer
+// Return:       None
+////////////////////////////////////////////////////////////////////////////
+void
+pipeline_report(char *paucReport, guint32 lulSize)
+{
+    guint64 lullIngestUsed = __atomic_load_n(&gsPipelineIngest.ullHead, __ATOMIC_ACQUIRE) -
+                             __atomic_load_n(&gsPipelineIngest.ullTail, __ATOMIC_ACQUIRE);
+    guint64 lullUiUsed     = __atomic_load_n(&gsPipelineUi.ullHead, __ATOMIC_ACQUIRE) -
+                             __atomic_load_n(&gsPipelineUi.ullTail, __ATOMIC_ACQUIRE);
+
+    snprintf(paucReport, lulSize,
+             "Pipeline: ingest %lu of %u bytes, reader waited %lu times (%lu ms); "
+             "UI %lu of %u bytes, parser waited %lu times (%lu ms), %lu dropped at exit\r\n",
+             (unsigned long)lullIngestUsed, gsPipelineIngest.lulBytes,
+             (unsigned long)__atomic_load_n(&gsPipelineIngest.ullWaits, __ATOMIC_RELAXED),
+             (unsigned long)(__atomic_load_n(&gsPipelineIngest.ullWait_ns, __ATOMIC_RELAXED) / 1000000),
+             (unsigned long)lullUiUsed, gsPipelineUi.lulBytes,
+             (unsigned long)__atomic_load_n(&gsPipelineUi.ullWaits, __ATOMIC_RELAXED),
+             (unsigned long)(__atomic_load_n(&gsPipelineUi.ullWait_ns, __ATOMIC_RELAXED) / 1000000),
+             (unsigned long)gsPipelineUi.ullDropped);
+}
+// end pipeline_report
+
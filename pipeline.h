@@ -0,0 +1,65 @@
+/*
+ * File:   pipeline.h
+ * Author: Mark Bersalona
+ *
+ * Created on 2024.07.15
+ */
+
+#ifndef PIPELINE_H
+#define PIPELINE_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Definitions
+//
+///////////////////////////////////////////////////////////////////////////////
+
+// Stages that can be pinned to a core (pipeline_set_cpus())
+#define PIPELINE_READER       (0)   // serial port reads, line assembly
+#define PIPELINE_PARSER       (1)   // flight recorder, logfile queueing, parse, session log/export
+#define PIPELINE_LOGGER       (2)   // logfile writer thread
+#define PIPELINE_UI           (3)   // main loop: display (GUI) or stdout (headless)
+#define PIPELINE_STAGE_COUNT  (4)
+
+// What each front end (GUI or headless) runs in the pipeline
+typedef struct
+{
+    void (*line)(char *paucLine);           // parser thread: everything a line does off the UI
+    void (*display)(char *paucLine);        // UI thread: show a received line
+    ParseHooks sUi;                         // UI thread: what the parser found;
+                                            // uut_reset need only clear the display
+} PipelineStages;
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Public routines
+//
+///////////////////////////////////////////////////////////////////////////////
+
+// Control (UI thread)
+int pipeline_cpu(guint8 lucStage);
+gboolean pipeline_is_running(void);
+void pipeline_pin(guint8 lucStage);
+void pipeline_report(char *paucReport, guint32 lulSize);
+gboolean pipeline_set_cpus(char *paucSpec);
+void pipeline_start(PipelineStages *pasStages);
+void pipeline_stop(void);
+void pipeline_ui_run(void);
+void pipeline_ui_line(char *paucLine);
+
+// Parser state is the parser thread's while the pipeline runs; the UI
+// thread takes the lock to touch it (no-ops without --pipeline)
+void pipeline_lock(void);
+void pipeline_unlock(void);
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* PIPELINE_H */
+
@@ -0,0 +1,222 @@
+/*
+ * File:   plugin.c
+ * Author: Mark Bersalona
+ *
+ * Created on 2024.07.15
+ * Sensaphone WSG30 Temperature Display Diagnostic parser plugin loader
+ * (--parser-plugin)
+ *
+ * Loads each plugin shared object, checks it was built for this
+ * PARSE_PLUGIN_ABI_VERSION and runs its init routine with the host
+ * routines below, which register with the parser (parse_add_field(),
+ * parse_add_pattern()). Once all are loaded, parse_compile() closes
+ * registration. Plugins stay loaded until exit. See parse_plugin.h.
+ */
+
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Includes
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include <glib.h>
+#include <dlfcn.h>
+#include <stdio.h>
+#include <string.h>
+#include "gconfig.h"
+#include "parse.h"
+#include "plugin.h"
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Definitions
+//
+///////////////////////////////////////////////////////////////////////////////
+
+typedef struct
+{
+    gchar  *pcName;             // file name, without the directory
+    guint32 ulFields;           // fields and patterns it registered
+    guint32 ulPatterns;
+} PluginInfo;
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Variables and tables
+//
+///////////////////////////////////////////////////////////////////////////////
+
+static PluginInfo gsPlugin[PLUGIN_MAX];
+static guint32    gulPluginCount = 0;
+
+
+////////////////////////////////////////////////////////////////////////////
+// Name:         plugin_add_field
+// Name:         plugin_add_pattern
+// Name:         plugin_field_set
+// Name:         plugin_status_write
+// Description:  ParsePluginHost routines, see parse_plugin.h
+// Parameters:   See ParsePluginHost
+// Return:       See ParsePluginHost
+////////////////////////////////////////////////////////////////////////////
+static int
+plugin_add_field(const char *pcName)
+{
+    return parse_add_field(pcName);
+}
+// end plugin_add_field
+
+static int
+plugin_add_pattern(const char *pcText, ParsePluginHandler pfHandler, void *pvContext)
+{
+    return parse_add_pattern(pcText, pfHandler, pvContext) ? 0 : -1;
+}
+// end plugin_add_pattern
+
+static void
+plugin_field_set(int iField, const char *pcValue)
+{
+    if (iField >= PARSE_FIELD_COUNT && iField < (int)parse_field_count() && pcValue)
+    {
+        parse_field_set((guint8)iField, (char *)pcValue);
+    }
+}
+// end plugin_field_set
+
+static void
+plugin_status_write(const char *pcText)
+{
+    if (pcText) parse_status_write((char *)pcText);
+}
+// end plugin_status_write
+
+static const ParsePluginHost gsPluginHost =
+{
+    PARSE_PLUGIN_ABI_VERSION,
+    plugin_add_field,
+    plugin_add_pattern,
+    plugin_field_set,
+    plugin_status_write,
+};
+
+
+////////////////////////////////////////////////////////////////////////////
+// Name:         plugin_load_one
+// Description:  Load a plugin and run its init routine
+// Parameters:   paucPath - shared object
+//               error    - set if it can't be loaded
+// Return:       TRUE if loaded
+////////////////////////////////////////////////////////////////////////////
+static gboolean
+plugin_load_one(char *paucPath, GError **error)
+{
+    void *plvHandle;
+    gchar *plcPath;
+    const unsigned int *plulAbi;
+    ParsePluginInit lpfInit;
+    guint32 lulFields   = parse_field_count();
+    guint32 lulPatterns = parse_pattern_count();
+    int liResult;
+
+    if (gulPluginCount >= PLUGIN_MAX)
+    {
+        g_set_error(error, G_FILE_ERROR, G_FILE_ERROR_INVAL, "%s: more than %d parser plugins", paucPath, PLUGIN_MAX);
+        return FALSE;
+    }
+
+    // A name without a '/' would be searched for like a library
+    plcPath   = strchr(paucPath, '/') ? g_strdup(paucPath) : g_strconcat("./", paucPath, NULL);
+    plvHandle = dlopen(plcPath, RTLD_NOW | RTLD_LOCAL);
+    g_free(plcPath);
+    if (NULL == plvHandle)
+    {
+        g_set_error(error, G_FILE_ERROR, G_FILE_ERROR_INVAL, "Couldn't load parser plugin %s: %s", paucPath, dlerror());
+        return FALSE;
+    }
+    plulAbi = (const unsigned int *)dlsym(plvHandle, PARSE_PLUGIN_ABI_SYMBOL);
+    lpfInit = (ParsePluginInit)dlsym(plvHandle, PARSE_PLUGIN_INIT_SYMBOL);
+    if (NULL == plulAbi || NULL == lpfInit)
+    {
+        g_set_error(error, G_FILE_ERROR, G_FILE_ERROR_INVAL, "%s is not a parser plugin (no %s or %s)",
+                    paucPath, PARSE_PLUGIN_ABI_SYMBOL, PARSE_PLUGIN_INIT_SYMBOL);
+        dlclose(plvHandle);
+        return FALSE;
+    }
+    if (PARSE_PLUGIN_ABI_VERSION != *plulAbi)
+    {
+        g_set_error(error, G_FILE_ERROR, G_FILE_ERROR_INVAL, "Parser plugin %s is for ABI version %u, not %d",
+                    paucPath, *plulAbi, PARSE_PLUGIN_ABI_VERSION);
+        dlclose(plvHandle);
+        return FALSE;
+    }
+
+    // Whatever it registered stays registered even if it fails, so it
+    // stays loaded; the caller gives up anyway
+    liResult = lpfInit(&gsPluginHost);
+    if (0 != liResult)
+    {
+        g_set_error(error, G_FILE_ERROR, G_FILE_ERROR_INVAL, "Parser plugin %s failed to start (%d)", paucPath, liResult);
+        return FALSE;
+    }
+    gsPlugin[gulPluginCount].pcName     = g_path_get_basename(paucPath);
+    gsPlugin[gulPluginCount].ulFields   = parse_field_count() - lulFields;
+    gsPlugin[gulPluginCount].ulPatterns = parse_pattern_count() - lulPatterns;
+    ++gulPluginCount;
+    return TRUE;
+}
+// end plugin_load_one
+
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Public routines
+//
+///////////////////////////////////////////////////////////////////////////////
+
+////////////////////////////////////////////////////////////////////////////
+// Name:         plugin_load
+// Description:  Load the parser plugins, then close registration; call at
+//               startup, before the first line is parsed
+// Parameters:   papcPaths - NULL-terminated list of shared objects
+//                           (--parser-plugin), or NULL for none
+//               error     - set if one can't be loaded
+// Return:       TRUE if all were loaded
+////////////////////////////////////////////////////////////////////////////
+gboolean
+plugin_load(gchar **papcPaths, GError **error)
+{
+    for ( ; papcPaths && *papcPaths; ++papcPaths)
+    {
+        if (!plugin_load_one(*papcPaths, error)) return FALSE;
+    }
+    parse_compile();
+    return TRUE;
+}
+// end plugin_load
+
+
+////////////////////////////////////////////////////////////////////////////
+// Name:         plugin_report
+// Description:  Format the loaded parser plugins for Status
+// Parameters:   paucReport - buffer for the report, CRLF terminated
+//               lulSize    - size of buffer
+// Return:       None
+////////////////////////////////////////////////////////////////////////////
+void
+plugin_report(char *paucReport, guint32 lulSize)
+{
+    guint32 lulUsed;
+    guint32 lulIndex;
+
+    lulUsed = snprintf(paucReport, lulSize, "Parser plugins:");
+    for (lulIndex = 0; lulIndex < gulPluginCount && lulUsed < lulSize; ++lulIndex)
+    {
+        lulUsed += snprintf(paucReport + lulUsed, lulSize - lulUsed, "%s %s (%u fields, %u patterns)",
+                            lulIndex ? "," : "", gsPlugin[lulIndex].pcName,
+                            gsPlugin[lulIndex].ulFields, gsPlugin[lulIndex].ulPatterns);
+    }
+    if (0 == gulPluginCount) lulUsed += snprintf(paucReport + lulUsed, lulSize - lulUsed, " none");
+    if (lulUsed < lulSize) snprintf(paucReport + lulUsed, lulSize - lulUsed, "\r\n");
+}
+// end plugin_report
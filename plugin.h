@@ -0,0 +1,39 @@
+/*
+ * File:   plugin.h
+ * Author: Mark Bersalona
+ *
+ * Created on 2024.07.15
+ */
+
+#ifndef PLUGIN_H
+#define PLUGIN_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Definitions
+//
+///////////////////////////////////////////////////////////////////////////////
+
+// Most parser plugins loaded
+#define PLUGIN_MAX  (16)
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Public routines
+//
+///////////////////////////////////////////////////////////////////////////////
+
+gboolean plugin_load(gchar **papcPaths, GError **error);
+void plugin_report(char *paucReport, guint32 lulSize);
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* PLUGIN_H */
+
@@ -0,0 +1,90 @@
+/*
+ * File:   plugin_example.c
+ * Author: Mark Bersalona
+ *
+ * Created on 2024.07.15
+ * Example parser plugin (make plugin-example, then
+ * --parser-plugin=./WSG30TempDisplay_plugin_example.so)
+ *
+ * Handles the XBee signal strength line some firmware variants print,
+ *   "Network_XBee_RSSI: -67 dBm"
+ * as an "RSSI" field, and writes a warning to Status when the signal is
+ * weak. Built on its own, against parse_plugin.h only.
+ */
+
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Includes
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "parse_plugin.h"
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Definitions
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#define EXAMPLE_RSSI_PATTERN    "Network_XBee_RSSI: "
+#define EXAMPLE_RSSI_WEAK_DBM   (-85)
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Variables and tables
+//
+///////////////////////////////////////////////////////////////////////////////
+
+PARSE_PLUGIN_DECLARE;
+
+static const ParsePluginHost *gpsExampleHost;
+static int giExampleRssiField;
+
+
+////////////////////////////////////////////////////////////////////////////
+// Name:         example_rssi
+// Description:  Line handler - "Network_XBee_RSSI: <dBm> dBm"
+// Parameters:   See ParsePluginHandler
+// Return:       None
+////////////////////////////////////////////////////////////////////////////
+static void
+example_rssi(const char *pcLine, const char *pcMatch, void *pvContext)
+{
+    char lcValue[32];
+    char lcStatus[80];
+    long llRssi;
+    char *plcEnd;
+
+    llRssi = strtol(pcMatch + strlen(EXAMPLE_RSSI_PATTERN), &plcEnd, 10);
+    if (plcEnd == pcMatch + strlen(EXAMPLE_RSSI_PATTERN)) return;
+
+    snprintf(lcValue, sizeof(lcValue), "%ld dBm", llRssi);
+    gpsExampleHost->field_set(giExampleRssiField, lcValue);
+    if (llRssi < EXAMPLE_RSSI_WEAK_DBM)
+    {
+        snprintf(lcStatus, sizeof(lcStatus), "*** WARNING *** weak XBee signal, %ld dBm\r\n", llRssi);
+        gpsExampleHost->status_write(lcStatus);
+    }
+}
+// end example_rssi
+
+
+////////////////////////////////////////////////////////////////////////////
+// Name:         wsg30_parser_plugin_init
+// Description:  Plugin entry point - register the field and the pattern
+// Parameters:   psHost - host routines
+// Return:       0 if registered
+////////////////////////////////////////////////////////////////////////////
+int
+wsg30_parser_plugin_init(const ParsePluginHost *psHost)
+{
+    gpsExampleHost = psHost;
+    giExampleRssiField = psHost->add_field("RSSI");
+    if (giExampleRssiField < 0) return -1;
+    return psHost->add_pattern(EXAMPLE_RSSI_PATTERN, example_rssi, NULL);
+}
+// end wsg30_parser_plugin_init
@@ -0,0 +1,627 @@
+/*
+ * File:   provision.c
+ * Author: Mark Bersalona
+ *
+ * Created on 2024.07.15
+ * Batch provisioning of WSG30 Temperature Displays
+ *
+ * The Serial number, Cal date, PCB rev and Vref buttons provision one unit
+ * at a time. For an end-of-line station with a fixture full of units,
+ * this reads the values for each unit from a CSV:
+ *
+ *   port,serial,caldate,pcbrev,vref
+ *   /dev/ttyUSB0,2407150042,20240715,C,2048
+ *   /dev/ttyUSB1,2407150043,20240715,C,2049
+ *
+ * and provisions every unit at once. Each unit is sent the same
+ * "+++MENU:N/D/P/V" commands as the buttons, one at a time, and each write
+ * is verified by the unit's echo ("Serial number = ", "Calibration date
+ * = ", "PCB revision = ", "Voltage reference (mV) = ") before the next is
+ * sent; a write that isn't echoed within --timeout is retried --retries
+ * times. All the ports are serviced from one poll() loop, so the batch
+ * takes about as long as its slowest unit.
+ *
+ * Without a port column, rows go to the ports matching --ports (default
+ * /dev/ttyUSB*) in name order. A column left empty, or missing, isn't
+ * written. The result for each unit is printed as it finishes, and the
+ * whole batch can be saved as a CSV report with --report; the exit status
+ * is 0 only if every unit passed.
+ */
+
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Includes
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#define _GNU_SOURCE         // glob
+#include <glib.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <errno.h>
+#include <glob.h>
+#include <poll.h>
+#include <unistd.h>
+#include "gconfig.h"
+#include "serial.h"
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Definitions
+//
+///////////////////////////////////////////////////////////////////////////////
+
+// Values written to each unit, in the order they're written
+#define PROVISION_SERIAL          (0)
+#define PROVISION_CALDATE         (1)
+#define PROVISION_PCBREV          (2)
+#define PROVISION_VREF            (3)
+#define PROVISION_FIELD_COUNT     (4)
+
+// Most units on one fixture
+#define PROVISION_UNITS_MAX       (64)
+
+// Longest received line kept, and longest value
+#define PROVISION_LINE_BYTES      (512)
+#define PROVISION_VALUE_BYTES     (64)
+
+// Longest poll() while waiting for echoes, msec
+#define PROVISION_POLL_MSEC       (100)
+
+// One value: CSV column, menu command, and the echo that confirms it
+typedef struct
+{
+    char *pcColumn;
+    char  cCommand;
+    char *pcEcho;
+    char *pcName;
+} ProvisionField;
+
+// One unit
+typedef struct
+{
+    char    cPort[PROVISION_VALUE_BYTES];
+    char    cValue[PROVISION_FIELD_COUNT][PROVISION_VALUE_BYTES];   // "" = not written
+    char    cEcho[PROVISION_FIELD_COUNT][PROVISION_VALUE_BYTES];    // last echo seen
+    int     iFd;                    // -1 when not open
+    guint8  ucField;                // being written; PROVISION_FIELD_COUNT when done
+    guint8  ucTries;                // writes of this field so far
+    gboolean fIsDone;
+    gboolean fIsPassed;
+    char    cDetail[200];
+    gint64  llStart_usec;
+    gint64  llDeadline_usec;        // for this field's echo
+    gint64  llEnd_usec;
+    char    cLine[PROVISION_LINE_BYTES];
+    guint32 ulLineCount;
+} ProvisionUnit;
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Variables and tables
+//
+///////////////////////////////////////////////////////////////////////////////
+
+// Command line options
+static gchar *gpcProvisionTargets = NULL;
+static gchar *gpcProvisionPorts   = "/dev/ttyUSB*";
+static gint   giProvisionBaud     = 115200;
+static gint   giProvisionTimeout_msec = 3000;
+static gint   giProvisionRetries  = 2;
+static gchar *gpcProvisionReport  = NULL;
+
+static GOptionEntry gsProvisionOptions[] =
+{
+    { "targets", 0, 0, G_OPTION_ARG_FILENAME, &gpcProvisionTargets, "CSV of values to write: port (optional), serial, caldate, pcbrev, vref", "CSV" },
+    { "ports",   0, 0, G_OPTION_ARG_STRING,   &gpcProvisionPorts,   "Without a port column, ports to use in name order (default /dev/ttyUSB*)", "PATTERN" },
+    { "baud",    'b', 0, G_OPTION_ARG_INT,    &giProvisionBaud,     "Baud rate (default 115200)", "BAUD" },
+    { "timeout", 0, 0, G_OPTION_ARG_INT,      &giProvisionTimeout_msec, "Wait this long for each echo (default 3000)", "MSEC" },
+    { "retries", 0, 0, G_OPTION_ARG_INT,      &giProvisionRetries,  "Write again this many times without an echo (default 2)", "N" },
+    { "report",  0, 0, G_OPTION_ARG_FILENAME, &gpcProvisionReport,  "Also save the results as a CSV report", "FILE" },
+    { NULL }
+};
+
+static ProvisionField gsProvisionFields[PROVISION_FIELD_COUNT] =
+{
+    { "serial",  'N', "Serial number = ",          "serial number" },
+    { "caldate", 'D', "Calibration date = ",       "calibration date" },
+    { "pcbrev",  'P', "PCB revision = ",           "PCB revision" },
+    { "vref",    'V', "Voltage reference (mV) = ", "Vref" },
+};
+
+static ProvisionUnit gsProvisionUnit[PROVISION_UNITS_MAX];
+static guint32 gulProvisionUnits;
+
+
+////////////////////////////////////////////////////////////////////////////
+// Name:         provision_check
+// Description:  Check a value before it's sent, as the buttons would
+//               (the PCB rev button sends a single letter)
+// Parameters:   lucField - PROVISION_xxx
+//               paucValue - value, "" if not written
+// Return:       NULL if OK, otherwise what's wrong
+////////////////////////////////////////////////////////////////////////////
+static char *
+provision_check(guint8 lucField, char *paucValue)
+{
+    char *plcChar;
+
+    if (!*paucValue) return NULL;
+
+    for (plcChar = paucValue; *plcChar; ++plcChar)
+    {
+        if (!isgraph((unsigned char)*plcChar)) return "has spaces or control characters";
+    }
+    switch (lucField)
+    {
+    case PROVISION_CALDATE:
+        if (8 != strlen(paucValue)) return "isn't YYYYMMDD";
+        for (plcChar = paucValue; *plcChar; ++plcChar)
+        {
+            if (!isdigit((unsigned char)*plcChar)) return "isn't YYYYMMDD";
+        }
+        break;
+    case PROVISION_PCBREV:
+        if (1 != strlen(paucValue) || !isalpha((unsigned char)paucValue[0])) return "isn't a single letter";
+        break;
+    case PROVISION_VREF:
+        for (plcChar = paucValue; *plcChar; ++plcChar)
+        {
+            if (!isdigit((unsigned char)*plcChar)) return "isn't a number of mV";
+        }
+        break;
+    default:
+        break;
+    }
+    return NULL;
+}
+// end provision_check
+
+
+////////////////////////////////////////////////////////////////////////////
+// Name:         provision_load
+// Description:  Read the targets CSV into gsProvisionUnit
+//               The first line names the columns
+// Parameters:   paucName - CSV file name
+// Return:       TRUE if it was read; otherwise the reason has been printed
+////////////////////////////////////////////////////////////////////////////
+static gboolean
+provision_load(char *paucName)
+{
+    GError *error = NULL;
+    gchar *plcContents;
+    gchar **pplcLines;
+    gchar **pplcCells;
+    int liColumn[PROVISION_FIELD_COUNT];
+    int liPortColumn = -1;
+    int liCell;
+    guint32 lulLine;
+    guint8 lucField;
+    glob_t lsGlob;
+    char *plcProblem;
+    gboolean lfIsOK = TRUE;
+
+    if (!g_file_get_contents(paucName, &plcContents, NULL, &error))
+    {
+        g_printerr("%s\r\n", error->message);
+        g_clear_error(&error);
+        return FALSE;
+    }
+    g_strdelimit(plcContents, "\r", '\n');
+    pplcLines = g_strsplit(plcContents, "\n", -1);
+    g_free(plcContents);
+
+    // Header
+    for (lucField = 0; lucField < PROVISION_FIELD_COUNT; ++lucField) liColumn[lucField] = -1;
+    pplcCells = g_strsplit(pplcLines[0] ? pplcLines[0] : "", ",", -1);
+    for (liCell = 0; pplcCells[liCell]; ++liCell)
+    {
+        g_strstrip(pplcCells[liCell]);
+        for (lucField = 0; lucField < PROVISION_FIELD_COUNT; ++lucField)
+        {
+            if (0 == g_ascii_strcasecmp(pplcCells[liCell], gsProvisionFields[lucField].pcColumn)) break;
+        }
+        if (lucField < PROVISION_FIELD_COUNT) liColumn[lucField] = liCell;
+        else if (0 == g_ascii_strcasecmp(pplcCells[liCell], "port")) liPortColumn = liCell;
+        else if (*pplcCells[liCell])
+        {
+            g_printerr("%s: unknown column \"%s\" (port, serial, caldate, pcbrev, vref)\r\n", paucName, pplcCells[liCell]);
+            lfIsOK = FALSE;
+        }
+    }
+    g_strfreev(pplcCells);
+
+    // Units; without a port column, the ports found in name order
+    memset(&lsGlob, 0, sizeof(lsGlob));
+    if (liPortColumn < 0) glob(gpcProvisionPorts, 0, NULL, &lsGlob);
+    for (lulLine = 1; lfIsOK && pplcLines[0] && pplcLines[lulLine]; ++lulLine)
+    {
+        ProvisionUnit *plsUnit = &gsProvisionUnit[gulProvisionUnits];
+
+        if (!*g_strstrip(pplcLines[lulLine])) continue;
+        if (gulProvisionUnits >= PROVISION_UNITS_MAX)
+        {
+            g_printerr("%s: more than %d units\r\n", paucName, PROVISION_UNITS_MAX);
+            lfIsOK = FALSE;
+            break;
+        }
+        pplcCells = g_strsplit(pplcLines[lulLine], ",", -1);
+        memset(plsUnit, 0, sizeof(*plsUnit));
+        plsUnit->iFd = -1;
+        for (liCell = 0; pplcCells[liCell]; ++liCell)
+        {
+            g_strstrip(pplcCells[liCell]);
+            if (liCell == liPortColumn) g_strlcpy(plsUnit->cPort, pplcCells[liCell], sizeof(plsUnit->cPort));
+            for (lucField = 0; lucField < PROVISION_FIELD_COUNT; ++lucField)
+            {
+                if (liCell == liColumn[lucField]) g_strlcpy(plsUnit->cValue[lucField], pplcCells[liCell], PROVISION_VALUE_BYTES);
+            }
+        }
+        g_strfreev(pplcCells);
+
+        if (liPortColumn < 0 && gulProvisionUnits < lsGlob.gl_pathc)
+        {
+            g_strlcpy(plsUnit->cPort, lsGlob.gl_pathv[gulProvisionUnits], sizeof(plsUnit->cPort));
+        }
+        for (lucField = 0; lucField < PROVISION_FIELD_COUNT; ++lucField)
+        {
+            plcProblem = provision_check(lucField, plsUnit->cValue[lucField]);
+            if (plcProblem)
+            {
+                g_printerr("%s line %u: %s \"%s\" %s\r\n", paucName, lulLine+1,
+                           gsProvisionFields[lucField].pcName, plsUnit->cValue[lucField], plcProblem);
+                lfIsOK = FALSE;
+            }
+        }
+        ++gulProvisionUnits;
+    }
+    globfree(&lsGlob);
+    g_strfreev(pplcLines);
+
+    if (lfIsOK && 0 == gulProvisionUnits)
+    {
+        g_printerr("%s: no units\r\n", paucName);
+        lfIsOK = FALSE;
+    }
+    return lfIsOK;
+}
+// end provision_load
+
+
+////////////////////////////////////////////////////////////////////////////
+// Name:         provision_finish
+// Description:  A unit is done: close its port and print its result
+// Parameters:   pasUnit    - unit
+//               lfIsPassed - TRUE if every value was echoed back
+//               paucDetail - why it failed, or "" if it passed
+// Return:       None
+////////////////////////////////////////////////////////////////////////////
+static void
+provision_finish(ProvisionUnit *pasUnit, gboolean lfIsPassed, char *paucDetail)
+{
+    pasUnit->fIsDone    = TRUE;
+    pasUnit->fIsPassed  = lfIsPassed;
+    pasUnit->llEnd_usec = g_get_monotonic_time();
+    g_strlcpy(pasUnit->cDetail, paucDetail, sizeof(pasUnit->cDetail));
+    if (pasUnit->iFd >= 0)
+    {
+        close(pasUnit->iFd);
+        pasUnit->iFd = -1;
+    }
+    g_print("%-16s %-12s %s %s(%.1f s)\r\n", pasUnit->cPort,
+            pasUnit->cValue[PROVISION_SERIAL][0] ? pasUnit->cValue[PROVISION_SERIAL] : "-",
+            lfIsPassed ? "PASS" : "FAIL", paucDetail,
+            pasUnit->llStart_usec ? (pasUnit->llEnd_usec - pasUnit->llStart_usec) / 1e6 : 0.0);
+}
+// end provision_finish
+
+
+////////////////////////////////////////////////////////////////////////////
+// Name:         provision_send
+// Description:  Write the unit's next value (skipping empty ones), or
+//               pass it if there are none left
+// Parameters:   pasUnit - unit
+// Return:       None
+////////////////////////////////////////////////////////////////////////////
+static void
+provision_send(ProvisionUnit *pasUnit)
+{
+    char lcCommand[PROVISION_VALUE_BYTES + 16];
+    char lcDetail[200];
+    int liLength;
+
+    while (pasUnit->ucField < PROVISION_FIELD_COUNT && !pasUnit->cValue[pasUnit->ucField][0]) ++pasUnit->ucField;
+    if (pasUnit->ucField >= PROVISION_FIELD_COUNT)
+    {
+        provision_finish(pasUnit, TRUE, "");
+        return;
+    }
+
+    // Same command as the button
+    liLength = snprintf(lcCommand, sizeof(lcCommand), "+++MENU:%c %s",
+                        gsProvisionFields[pasUnit->ucField].cCommand, pasUnit->cValue[pasUnit->ucField]);
+    if (write(pasUnit->iFd, lcCommand, liLength) != liLength)
+    {
+        snprintf(lcDetail, sizeof(lcDetail), "writing %s: %s ",
+                 gsProvisionFields[pasUnit->ucField].pcName, g_strerror(errno));
+        provision_finish(pasUnit, FALSE, lcDetail);
+        return;
+    }
+    ++pasUnit->ucTries;
+    pasUnit->llDeadline_usec = g_get_monotonic_time() + (gint64)giProvisionTimeout_msec * 1000;
+}
+// end provision_send
+
+
+////////////////////////////////////////////////////////////////////////////
+// Name:         provision_line
+// Description:  A line from a unit: if it's the echo of the value being
+//               written, go on to the next one
+//               Echoes of other values (e.g. a startup banner) are noted
+//               for the report, but don't fail the write
+// Parameters:   pasUnit  - unit
+//               paucLine - NULL-terminated line, without CRLF
+// Return:       None
+////////////////////////////////////////////////////////////////////////////
+static void
+provision_line(ProvisionUnit *pasUnit, char *paucLine)
+{
+    ProvisionField *plsField = &gsProvisionFields[pasUnit->ucField];
+    char *plcEcho = strstr(paucLine, plsField->pcEcho);
+
+    if (!plcEcho) return;
+
+    g_strlcpy(pasUnit->cEcho[pasUnit->ucField], plcEcho + strlen(plsField->pcEcho), PROVISION_VALUE_BYTES);
+    g_strchomp(pasUnit->cEcho[pasUnit->ucField]);
+    if (0 == g_ascii_strcasecmp(pasUnit->cEcho[pasUnit->ucField], pasUnit->cValue[pasUnit->ucField]))
+    {
+        ++pasUnit->ucField;
+        pasUnit->ucTries = 0;
+        provision_send(pasUnit);
+    }
+}
+// end provision_line
+
+
+////////////////////////////////////////////////////////////////////////////
+// Name:         provision_receive
+// Description:  Read what a unit has sent and assemble it into lines
+// Parameters:   pasUnit - unit with input waiting
+// Return:       None
+////////////////////////////////////////////////////////////////////////////
+static void
+provision_receive(ProvisionUnit *pasUnit)
+{
+    char lcBuffer[PROVISION_LINE_BYTES];
+    ssize_t llBytes;
+    ssize_t llIndex;
+    char lcChar;
+
+    llBytes = read(pasUnit->iFd, lcBuffer, sizeof(lcBuffer));
+    if (llBytes <= 0)
+    {
+        if (llBytes < 0 && (EINTR == errno || EAGAIN == errno)) return;
+        provision_finish(pasUnit, FALSE, "port closed ");
+        return;
+    }
+
+    for (llIndex = 0; llIndex < llBytes && !pasUnit->fIsDone; ++llIndex)
+    {
+        lcChar = lcBuffer[llIndex];
+        if ('\r' == lcChar) continue;
+        if ('\n' != lcChar)
+        {
+            if (pasUnit->ulLineCount < sizeof(pasUnit->cLine) - 1) pasUnit->cLine[pasUnit->ulLineCount++] = lcChar;
+            continue;
+        }
+        pasUnit->cLine[pasUnit->ulLineCount] = '\0';
+        pasUnit->ulLineCount = 0;
+        provision_line(pasUnit, pasUnit->cLine);
+    }
+}
+// end provision_receive
+
+
+////////////////////////////////////////////////////////////////////////////
+// Name:         provision_timeout
+// Description:  No echo in time: write the value again, or fail the unit
+// Parameters:   pasUnit - unit
+// Return:       None
+////////////////////////////////////////////////////////////////////////////
+static void
+provision_timeout(ProvisionUnit *pasUnit)
+{
+    char lcDetail[200];
+    guint8 lucField = pasUnit->ucField;
+
+    if (pasUnit->ucTries <= (guint8)giProvisionRetries)
+    {
+        provision_send(pasUnit);
+        return;
+    }
+    if (pasUnit->cEcho[lucField][0])
+    {
+        snprintf(lcDetail, sizeof(lcDetail), "%s echoed \"%s\", expected \"%s\" ",
+                 gsProvisionFields[lucField].pcName, pasUnit->cEcho[lucField], pasUnit->cValue[lucField]);
+    }
+    else
+    {
+        snprintf(lcDetail, sizeof(lcDetail), "no %s echo after %u writes ",
+                 gsProvisionFields[lucField].pcName, pasUnit->ucTries);
+    }
+    provision_finish(pasUnit, FALSE, lcDetail);
+}
+// end provision_timeout
+
+
+////////////////////////////////////////////////////////////////////////////
+// Name:         provision_run
+// Description:  Open every unit's port, write the first value, then
+//               service all of them until each has passed or failed
+// Parameters:   None
+// Return:       None
+////////////////////////////////////////////////////////////////////////////
+static void
+provision_run(void)
+{
+    struct pollfd lsPoll[PROVISION_UNITS_MAX];
+    ProvisionUnit *plsPolled[PROVISION_UNITS_MAX];
+    ProvisionUnit *plsUnit;
+    char lcDetail[200];
+    guint32 lulUnit;
+    guint32 lulPolled;
+    guint32 lulIndex;
+    gint64 llNow_usec;
+    gint64 llWait_usec;
+
+    for (lulUnit = 0; lulUnit < gulProvisionUnits; ++lulUnit)
+    {
+        plsUnit = &gsProvisionUnit[lulUnit];
+        plsUnit->llStart_usec = g_get_monotonic_time();
+        if (!plsUnit->cPort[0])
+        {
+            provision_finish(plsUnit, FALSE, "no port ");
+            continue;
+        }
+        for (lulIndex = 0; lulIndex < lulUnit; ++lulIndex)
+        {
+            if (0 == strcmp(gsProvisionUnit[lulIndex].cPort, plsUnit->cPort)) break;
+        }
+        if (lulIndex < lulUnit)
+        {
+            provision_finish(plsUnit, FALSE, "port is already in use by an earlier row ");
+            continue;
+        }
+        plsUnit->iFd = serial_open(plsUnit->cPort, giProvisionBaud);
+        if (plsUnit->iFd < 0)
+        {
+            plsUnit->iFd = -1;
+            snprintf(lcDetail, sizeof(lcDetail), "couldn't open the port ");
+            provision_finish(plsUnit, FALSE, lcDetail);
+            continue;
+        }
+        provision_send(plsUnit);
+    }
+
+    while (TRUE)
+    {
+        // Ports still waiting for an echo, and the next deadline
+        llNow_usec  = g_get_monotonic_time();
+        llWait_usec = PROVISION_POLL_MSEC * 1000;
+        lulPolled   = 0;
+        for (lulUnit = 0; lulUnit < gulProvisionUnits; ++lulUnit)
+        {
+            plsUnit = &gsProvisionUnit[lulUnit];
+            if (plsUnit->fIsDone) continue;
+            lsPoll[lulPolled].fd     = plsUnit->iFd;
+            lsPoll[lulPolled].events = POLLIN;
+            plsPolled[lulPolled++]   = plsUnit;
+            llWait_usec = MIN(llWait_usec, MAX(plsUnit->llDeadline_usec - llNow_usec, 0));
+        }
+        if (0 == lulPolled) break;
+
+        if (poll(lsPoll, lulPolled, (int)((llWait_usec + 999) / 1000)) < 0 && EINTR != errno) break;
+        for (lulIndex = 0; lulIndex < lulPolled; ++lulIndex)
+        {
+            if (lsPoll[lulIndex].revents & POLLIN) provision_receive(plsPolled[lulIndex]);
+            else if (lsPoll[lulIndex].revents) provision_finish(plsPolled[lulIndex], FALSE, "port closed ");
+        }
+
+        llNow_usec = g_get_monotonic_time();
+        for (lulIndex = 0; lulIndex < lulPolled; ++lulIndex)
+        {
+            plsUnit = plsPolled[lulIndex];
+            if (!plsUnit->fIsDone && llNow_usec >= plsUnit->llDeadline_usec) provision_timeout(plsUnit);
+        }
+    }
+}
+// end provision_run
+
+
+////////////////////////////////////////////////////////////////////////////
+// Name:         provision_report
+// Description:  Save the results as CSV: the targets, what each unit
+//               echoed, PASS/FAIL with the reason, and the time taken
+// Parameters:   paucName - report file name
+// Return:       TRUE if written
+////////////////////////////////////////////////////////////////////////////
+static gboolean
+provision_report(char *paucName)
+{
+    FILE *plsFile = fopen(paucName, "w");
+    ProvisionUnit *plsUnit;
+    guint32 lulUnit;
+    guint8 lucField;
+
+    if (!plsFile) return FALSE;
+
+    fprintf(plsFile, "port");
+    for (lucField = 0; lucField < PROVISION_FIELD_COUNT; ++lucField) fprintf(plsFile, ",%s", gsProvisionFields[lucField].pcColumn);
+    for (lucField = 0; lucField < PROVISION_FIELD_COUNT; ++lucField) fprintf(plsFile, ",%s_echo", gsProvisionFields[lucField].pcColumn);
+    fprintf(plsFile, ",result,detail,seconds\n");
+    for (lulUnit = 0; lulUnit < gulProvisionUnits; ++lulUnit)
+    {
+        plsUnit = &gsProvisionUnit[lulUnit];
+        fprintf(plsFile, "%s", plsUnit->cPort);
+        for (lucField = 0; lucField < PROVISION_FIELD_COUNT; ++lucField) fprintf(plsFile, ",%s", plsUnit->cValue[lucField]);
+        for (lucField = 0; lucField < PROVISION_FIELD_COUNT; ++lucField) fprintf(plsFile, ",%s", plsUnit->cEcho[lucField]);
+        g_strchomp(plsUnit->cDetail);
+        g_strdelimit(plsUnit->cDetail, ",", ';');
+        fprintf(plsFile, ",%s,%s,%.1f\n", plsUnit->fIsPassed ? "PASS" : "FAIL", plsUnit->cDetail,
+                (plsUnit->llEnd_usec - plsUnit->llStart_usec) / 1e6);
+    }
+    return 0 == fclose(plsFile);
+}
+// end provision_report
+
+
+////////////////////////////////////////////////////////////////////////////
+// Name:         main
+// Description:  Main routine for batch provisioning
+// Parameters:   Standard main arguments, see gsProvisionOptions
+// Return:       0 if every unit passed; error otherwise
+////////////////////////////////////////////////////////////////////////////
+int main(int argc, char** argv)
+{
+    GError *error = NULL;
+    GOptionContext *lgOptionContext;
+    gint64 llStart_usec;
+    gdouble ldElapsed_sec;
+    guint32 lulUnit;
+    guint32 lulPassed = 0;
+
+    lgOptionContext = g_option_context_new("- provision every WSG30 on the fixture from a CSV");
+    g_option_context_add_main_entries(lgOptionContext, gsProvisionOptions, NULL);
+    if (!g_option_context_parse(lgOptionContext, &argc, &argv, &error) ||
+        !gpcProvisionTargets || giProvisionTimeout_msec < 1 || giProvisionRetries < 0 || giProvisionRetries > 100)
+    {
+        g_printerr("%s\r\n", error ? error->message : "--targets is required, --timeout must be at least 1 and --retries 0..100");
+        g_clear_error(&error);
+        return 1;
+    }
+    g_option_context_free(lgOptionContext);
+    if (!provision_load(gpcProvisionTargets)) return 1;
+
+    llStart_usec = g_get_monotonic_time();
+    provision_run();
+    ldElapsed_sec = (g_get_monotonic_time() - llStart_usec) / 1e6;
+
+    for (lulUnit = 0; lulUnit < gulProvisionUnits; ++lulUnit)
+    {
+        if (gsProvisionUnit[lulUnit].fIsPassed) ++lulPassed;
+    }
+    g_print("%u units: %u passed, %u failed in %.1f s (%.0f units/hour)\r\n",
+            gulProvisionUnits, lulPassed, gulProvisionUnits - lulPassed, ldElapsed_sec,
+            ldElapsed_sec > 0 ? gulProvisionUnits * 3600.0 / ldElapsed_sec : 0.0);
+    if (gpcProvisionReport && !provision_report(gpcProvisionReport))
+    {
+        g_printerr("Couldn't write report %s\r\n", gpcProvisionReport);
+        return 1;
+    }
+    return (lulPassed == gulProvisionUnits) ? 0 : 1;
+}
+// end main
+
@@ -0,0 +1,451 @@
+/*
+ * File:   replay.c
+ * Author: Mark Bersalona
+ *
+ * Created on 2024.07.15
+ * Sensaphone WSG30 Temperature Display Diagnostic capture replay
+ *
+ * Plays a saved capture back through the same parse/display path as live
+ * serial data. Text logfiles (and uncompressed rotated segments) are
+ * memory-mapped; gzipped segments are decompressed into memory once;
+ * binary session logs are read through the session log reader.
+ *
+ * Text logfiles have no host timestamps, so 1x/10x pacing follows the
+ * device's own "Timestamp" in the replayed STATUS lines; session logs are
+ * paced by their recorded host time. At REPLAY_SPEED_MAX lines are handed
+ * over as fast as the handler takes them, REPLAY_TICK_BUDGET_USEC at a time.
+ */
+
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Includes
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include <glib.h>
+#include <gio/gio.h>
+#include <string.h>
+#include "gconfig.h"
+#include "parse.h"
+#include "sessionlog.h"
+#include "replay.h"
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Variables and tables
+//
+///////////////////////////////////////////////////////////////////////////////
+
+static gboolean gfReplayActive   = FALSE;
+static gboolean gfReplayFinished = FALSE;
+static guint16  guiReplaySpeed   = 1;
+static guint32  gulReplayLines;
+
+// Text capture: mapped file, or decompressed segment
+static GMappedFile  *gReplayMapped = NULL;
+static GBytes       *gReplayBytes  = NULL;
+static const char   *gpucReplayData;
+static gsize         gsizeReplaySize;
+static gsize         gsizeReplayOffset;
+
+// Binary session log capture
+static SessionlogReader *gpsReplaySessionlog = NULL;
+static SessionlogRecord  gsReplayRecord;
+static gint64            gllReplayFirst_usec;
+static gint64            gllReplayLast_usec;
+static gint64            gllReplayLine_usec = -1;     // capture time of the current line
+
+// Pacing: capture time <-> monotonic time at the anchor
+static gboolean gfReplayAnchored = FALSE;
+static gint64   gllReplayAnchorCapture_usec;
+static gint64   gllReplayAnchorMono_usec;
+static gint64   gllReplayLastCapture_usec;
+static gint64   gllReplayHoldUntil_usec;
+
+static char gucReplayLine[RECEIVE_FIFO_MSG_LENGTH_MAX];
+
+
+////////////////////////////////////////////////////////////////////////////
+// Name:         replay_gunzip
+// Description:  Decompress a gzipped segment into memory
+// Parameters:   paucName - file name
+//               error    - return location for an error, or NULL
+// Return:       Decompressed contents, NULL on error
+////////////////////////////////////////////////////////////////////////////
+static GBytes *
+replay_gunzip(char *paucName, GError **error)
+{
+    GFile *lgFile = g_file_new_for_path(paucName);
+    GFileInputStream *lgIn = g_file_read(lgFile, NULL, error);
+    GZlibDecompressor *lgDecompressor;
+    GInputStream *lgUnzip;
+    GOutputStream *lgMemory;
+    GBytes *lgBytes = NULL;
+
+    g_object_unref(lgFile);
+    if (!lgIn) return NULL;
+
+    lgDecompressor = g_zlib_decompressor_new(G_ZLIB_COMPRESSOR_FORMAT_GZIP);
+    lgUnzip  = g_converter_input_stream_new(G_INPUT_STREAM(lgIn), G_CONVERTER(lgDecompressor));
+    lgMemory = g_memory_output_stream_new_resizable();
+    if (g_output_stream_splice(lgMemory, lgUnzip,
+                               G_OUTPUT_STREAM_SPLICE_CLOSE_SOURCE | G_OUTPUT_STREAM_SPLICE_CLOSE_TARGET,
+                               NULL, error) >= 0)
+    {
+        lgBytes = g_memory_output_stream_steal_as_bytes(G_MEMORY_OUTPUT_STREAM(lgMemory));
+    }
+    g_object_unref(lgMemory);
+    g_object_unref(lgUnzip);
+    g_object_unref(lgDecompressor);
+    g_object_unref(lgIn);
+
+    return lgBytes;
+}
+// end replay_gunzip
+
+
+////////////////////////////////////////////////////////////////////////////
+// Name:         replay_open
+// Description:  Open a capture for replay, positioned at its start
+//               ".wsl" is a binary session log, ".gz" a gzipped logfile
+//               segment; anything else is a text logfile
+// Parameters:   paucName - file name
+//               error    - return location for an error, or NULL
+// Return:       TRUE if the capture is open
+////////////////////////////////////////////////////////////////////////////
+gboolean
+replay_open(char *paucName, GError **error)
+{
+    replay_close();
+
+    if (g_str_has_suffix(paucName, ".wsl"))
+    {
+        gpsReplaySessionlog = sessionlog_reader_open(paucName, error);
+        if (!gpsReplaySessionlog) return FALSE;
+        sessionlog_reader_time_range(gpsReplaySessionlog, &gllReplayFirst_usec, &gllReplayLast_usec);
+        gllReplayLastCapture_usec = gllReplayFirst_usec;
+    }
+    else if (g_str_has_suffix(paucName, ".gz"))
+    {
+        gReplayBytes = replay_gunzip(paucName, error);
+        if (!gReplayBytes) return FALSE;
+        gpucReplayData = g_bytes_get_data(gReplayBytes, &gsizeReplaySize);
+    }
+    else
+    {
+        gReplayMapped = g_mapped_file_new(paucName, FALSE, error);
+        if (!gReplayMapped) return FALSE;
+        gpucReplayData  = g_mapped_file_get_contents(gReplayMapped);
+        gsizeReplaySize = g_mapped_file_get_length(gReplayMapped);
+    }
+
+    gsizeReplayOffset = 0;
+    gulReplayLines    = 0;
+    gfReplayAnchored  = FALSE;
+    gllReplayHoldUntil_usec = 0;
+    gfReplayFinished  = FALSE;
+    gfReplayActive    = TRUE;
+
+    return TRUE;
+}
+// end replay_open
+
+
+////////////////////////////////////////////////////////////////////////////
+// Name:         replay_close
+// Description:  Stop replaying and release the capture
+// Parameters:   None
+// Return:       None
+////////////////////////////////////////////////////////////////////////////
+void
+replay_close(void)
+{
+    if (gReplayMapped)
+    {
+        g_mapped_file_unref(gReplayMapped);
+        gReplayMapped = NULL;
+    }
+    if (gReplayBytes)
+    {
+        g_bytes_unref(gReplayBytes);
+        gReplayBytes = NULL;
+    }
+    if (gpsReplaySessionlog)
+    {
+        sessionlog_reader_close(gpsReplaySessionlog);
+        gpsReplaySessionlog = NULL;
+    }
+    gpucReplayData  = NULL;
+    gsizeReplaySize = 0;
+    gfReplayActive  = FALSE;
+}
+// end replay_close
+
+
+////////////////////////////////////////////////////////////////////////////
+// Name:         replay_is_active
+// Description:  Is a capture open for replay?
+//               (live data is not displayed while replaying)
+// Parameters:   None
+// Return:       TRUE if replaying
+////////////////////////////////////////////////////////////////////////////
+gboolean
+replay_is_active(void)
+{
+    return gfReplayActive;
+}
+// end replay_is_active
+
+
+////////////////////////////////////////////////////////////////////////////
+// Name:         replay_is_finished
+// Description:  Has the replay reached the end of the capture?
+// Parameters:   None
+// Return:       TRUE at the end of the capture
+////////////////////////////////////////////////////////////////////////////
+gboolean
+replay_is_finished(void)
+{
+    return gfReplayFinished;
+}
+// end replay_is_finished
+
+
+////////////////////////////////////////////////////////////////////////////
+// Name:         replay_line_count
+// Description:  Number of lines replayed since the capture was opened
+// Parameters:   None
+// Return:       Line count
+////////////////////////////////////////////////////////////////////////////
+guint32
+replay_line_count(void)
+{
+    return gulReplayLines;
+}
+// end replay_line_count
+
+
+////////////////////////////////////////////////////////////////////////////
+// Name:         replay_line_time
+// Description:  Host time the line being replayed was received, for line
+//               handlers; only binary session logs record it
+// Parameters:   None
+// Return:       usec since 1970, or -1 if the capture doesn't record it
+////////////////////////////////////////////////////////////////////////////
+gint64
+replay_line_time(void)
+{
+    return gllReplayLine_usec;
+}
+// end replay_line_time
+
+
+////////////////////////////////////////////////////////////////////////////
+// Name:         replay_set_speed
+// Description:  Set the replay speed
+// Parameters:   luiSpeed - 1 for real time, 10 for 10x, ...
+//                          REPLAY_SPEED_MAX for as fast as possible
+// Return:       None
+////////////////////////////////////////////////////////////////////////////
+void
+replay_set_speed(guint16 luiSpeed)
+{
+    guiReplaySpeed   = luiSpeed;
+    gfReplayAnchored = FALSE;
+    gllReplayHoldUntil_usec = 0;
+}
+// end replay_set_speed
+
+
+////////////////////////////////////////////////////////////////////////////
+// Name:         replay_position
+// Description:  How far through the capture the replay is
+//               (by bytes for text captures, by time for session logs)
+// Parameters:   None
+// Return:       0.0 (start) to 1.0 (end)
+////////////////////////////////////////////////////////////////////////////
+gdouble
+replay_position(void)
+{
+    if (gpsReplaySessionlog)
+    {
+        if (gllReplayLast_usec <= gllReplayFirst_usec) return gfReplayFinished ? 1.0 : 0.0;
+        return CLAMP((gdouble)(gllReplayLastCapture_usec - gllReplayFirst_usec) /
+                     (gdouble)(gllReplayLast_usec - gllReplayFirst_usec), 0.0, 1.0);
+    }
+    if (0 == gsizeReplaySize) return 0.0;
+    return (gdouble)gsizeReplayOffset / (gdouble)gsizeReplaySize;
+}
+// end replay_position
+
+
+////////////////////////////////////////////////////////////////////////////
+// Name:         replay_seek
+// Description:  Scrub - continue the replay from a new position
+//               Text captures resume at the start of the next line
+// Parameters:   ldPosition - 0.0 (start) to 1.0 (end)
+// Return:       None
+////////////////////////////////////////////////////////////////////////////
+void
+replay_seek(gdouble ldPosition)
+{
+    const char *plcNewline;
+
+    if (!gfReplayActive) return;
+    ldPosition = CLAMP(ldPosition, 0.0, 1.0);
+
+    if (gpsReplaySessionlog)
+    {
+        gllReplayLastCapture_usec = gllReplayFirst_usec + (gint64)(ldPosition * (gllReplayLast_usec - gllReplayFirst_usec));
+        sessionlog_reader_seek(gpsReplaySessionlog, gllReplayLastCapture_usec);
+    }
+    else
+    {
+        gsizeReplayOffset = (gsize)(ldPosition * gsizeReplaySize);
+        if (gsizeReplayOffset > 0 && gsizeReplayOffset < gsizeReplaySize)
+        {
+            plcNewline = memchr(gpucReplayData + gsizeReplayOffset - 1, '\n', gsizeReplaySize - gsizeReplayOffset + 1);
+            gsizeReplayOffset = plcNewline ? (gsize)(plcNewline + 1 - gpucReplayData) : gsizeReplaySize;
+        }
+        else if (gsizeReplayOffset > gsizeReplaySize)
+        {
+            gsizeReplayOffset = gsizeReplaySize;
+        }
+    }
+
+    gfReplayAnchored = FALSE;
+    gllReplayHoldUntil_usec = 0;
+    gfReplayFinished = FALSE;
+}
+// end replay_seek
+
+
+////////////////////////////////////////////////////////////////////////////
+// Name:         replay_next_line
+// Description:  Copy the next line of the capture into gucReplayLine
+// Parameters:   pallCapture_usec - capture time of the line, or -1 if the
+//                                  capture doesn't record one
+// Return:       TRUE if there was a line, FALSE at the end of the capture
+////////////////////////////////////////////////////////////////////////////
+static gboolean
+replay_next_line(gint64 *pallCapture_usec)
+{
+    const char *plcLine;
+    const char *plcNewline;
+    gsize lsizeLength;
+
+    *pallCapture_usec = -1;
+    gllReplayLine_usec = -1;
+
+    if (gpsReplaySessionlog)
+    {
+        if (!sessionlog_reader_next(gpsReplaySessionlog, &gsReplayRecord)) return FALSE;
+        g_strlcpy(gucReplayLine, gsReplayRecord.ucLine, sizeof(gucReplayLine));
+        *pallCapture_usec = gsReplayRecord.llTimestamp_usec;
+        gllReplayLine_usec = *pallCapture_usec;
+        return TRUE;
+    }
+
+    if (gsizeReplayOffset >= gsizeReplaySize) return FALSE;
+    plcLine = gpucReplayData + gsizeReplayOffset;
+    plcNewline = memchr(plcLine, '\n', gsizeReplaySize - gsizeReplayOffset);
+    lsizeLength = plcNewline ? (gsize)(plcNewline - plcLine) : gsizeReplaySize - gsizeReplayOffset;
+    gsizeReplayOffset += lsizeLength + (plcNewline ? 1 : 0);
+
+    // Logfile lines end in CRLF
+    if (lsizeLength && '\r' == plcLine[lsizeLength-1]) --lsizeLength;
+    lsizeLength = MIN(lsizeLength, sizeof(gucReplayLine)-1);
+    memcpy(gucReplayLine, plcLine, lsizeLength);
+    gucReplayLine[lsizeLength] = 0;
+
+    return TRUE;
+}
+// end replay_next_line
+
+
+////////////////////////////////////////////////////////////////////////////
+// Name:         replay_pace
+// Description:  After a line with a known capture time, work out whether
+//               the replay has got ahead of the (sped-up) capture clock
+//               and should hold the next line back
+//               A gap longer than REPLAY_GAP_MAX_SEC (device switched off,
+//               capture paused) is skipped rather than waited out
+// Parameters:   llCapture_usec - capture time of the line just replayed
+//               llNow_usec     - monotonic time now
+// Return:       None
+////////////////////////////////////////////////////////////////////////////
+static void
+replay_pace(gint64 llCapture_usec, gint64 llNow_usec)
+{
+    gint64 llDue_usec;
+
+    if (!gfReplayAnchored ||
+        llCapture_usec < gllReplayLastCapture_usec ||
+        llCapture_usec - gllReplayLastCapture_usec > (gint64)REPLAY_GAP_MAX_SEC*G_USEC_PER_SEC)
+    {
+        gllReplayAnchorCapture_usec = llCapture_usec;
+        gllReplayAnchorMono_usec    = llNow_usec;
+        gfReplayAnchored = TRUE;
+    }
+    gllReplayLastCapture_usec = llCapture_usec;
+
+    llDue_usec = gllReplayAnchorMono_usec + (llCapture_usec - gllReplayAnchorCapture_usec)/guiReplaySpeed;
+    if (llDue_usec > llNow_usec) gllReplayHoldUntil_usec = llDue_usec;
+}
+// end replay_pace
+
+
+////////////////////////////////////////////////////////////////////////////
+// Name:         replay_run
+// Description:  Call periodically - hand the lines that are due to the
+//               line handler (the same parse/display path as live data),
+//               for at most REPLAY_TICK_BUDGET_USEC
+// Parameters:   pafLineHandler - called with each line; returns the
+//                                parsed fields found (see parse_msg())
+// Return:       Number of lines replayed
+////////////////////////////////////////////////////////////////////////////
+guint32
+replay_run(guint32 (*pafLineHandler)(char *paucLine))
+{
+    gint64  llStart_usec = g_get_monotonic_time();
+    gint64  llNow_usec   = llStart_usec;
+    gint64  llCapture_usec;
+    guint32 lulFieldMask;
+    guint32 lulLines = 0;
+
+    if (!gfReplayActive || gfReplayFinished) return 0;
+
+    while (llNow_usec - llStart_usec < REPLAY_TICK_BUDGET_USEC)
+    {
+        if (REPLAY_SPEED_MAX != guiReplaySpeed && llNow_usec < gllReplayHoldUntil_usec) break;
+
+        if (!replay_next_line(&llCapture_usec))
+        {
+            gfReplayFinished = TRUE;
+            break;
+        }
+        lulFieldMask = pafLineHandler(gucReplayLine);
+        ++lulLines;
+
+        // Text captures: pace by the device's own timestamp
+        if (llCapture_usec < 0 && (lulFieldMask & (1UL << PARSE_FIELD_TIMESTAMP)))
+        {
+            llCapture_usec = (gint64)gulDeviceCurrentTimestamp * G_USEC_PER_SEC;
+        }
+
+        // Checking the clock every line would cost more than a short
+        // line takes to parse at max speed
+        if (0 == (lulLines & 0x3F) || llCapture_usec >= 0) llNow_usec = g_get_monotonic_time();
+        if (llCapture_usec >= 0)
+        {
+            if (REPLAY_SPEED_MAX == guiReplaySpeed) gllReplayLastCapture_usec = llCapture_usec;
+            else replay_pace(llCapture_usec, llNow_usec);
+        }
+    }
+
+    gulReplayLines += lulLines;
+    return lulLines;
+}
+// end replay_run
+
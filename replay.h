@@ -0,0 +1,47 @@
+/*
+ * File:   replay.h
+ * Author: Mark Bersalona
+ *
+ * Created on 2024.07.15
+ */
+
+#ifndef REPLAY_H
+#define REPLAY_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Definitions
+//
+///////////////////////////////////////////////////////////////////////////////
+
+// replay_set_speed(): as fast as the line handler allows
+#define REPLAY_SPEED_MAX  (0)
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Public routines
+//
+///////////////////////////////////////////////////////////////////////////////
+
+void replay_close(void);
+gboolean replay_is_active(void);
+gboolean replay_is_finished(void);
+guint32 replay_line_count(void);
+gint64 replay_line_time(void);
+gboolean replay_open(char *paucName, GError **error);
+gdouble replay_position(void);
+guint32 replay_run(guint32 (*pafLineHandler)(char *paucLine));
+void replay_seek(gdouble ldPosition);
+void replay_set_speed(guint16 luiSpeed);
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* REPLAY_H */
+
@@ -0,0 +1,197 @@
+/*
+ * File:   replay_test.c
+ * Author: Mark Bersalona
+ *
+ * Created on 2024.07.15
+ * Capture replay test: a replay must not talk to the UUT
+ *
+ * Replays a capture holding the UUT's " seconds to Diagnostic mode
+ * disable..." startup line, the line the live parser answers by sending
+ * the Diagnostic mode wake-up string, with the serial port "connected" to
+ * a pipe. Passes if the replay wrote nothing to the port and told the
+ * command correlator of nothing, and the same line parsed live does both
+ * (so the test can see a write when there is one):
+ *
+ *   make replay-test
+ */
+
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Includes
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#define _GNU_SOURCE         // pipe2
+#include <glib.h>
+#include <glib/gstdio.h>
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include "gconfig.h"
+#include "parse.h"
+#include "replay.h"
+#include "serial.h"
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Definitions
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#define REPLAY_TEST_UUT_STARTUP  "Sensaphone WSG30 starting, 10 seconds to Diagnostic mode disable..."
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Variables and tables
+//
+///////////////////////////////////////////////////////////////////////////////
+
+// The capture replayed
+static char *pucReplayTestCapture[] =
+{
+    "STATUS >> Timestamp 1700000000 UTC TEMP:72.5 MIN:68.0 MAX:75.1 AlHI:90 AlLO:40 Alarm:0 Scale:F SampleRateSeconds:60 ACK:1 HostCal:0 Buzzer:0 Mains:ON",
+    REPLAY_TEST_UUT_STARTUP,
+    "STATUS >> Timestamp 1700000060 UTC TEMP:72.6 MIN:68.0 MAX:75.1 AlHI:90 AlLO:40 Alarm:0 Scale:F SampleRateSeconds:60 ACK:1 HostCal:0 Buzzer:0 Mains:ON",
+};
+
+// Messages serial_write() told the correlator of
+static guint32 gulReplayTestSent = 0;
+
+// Read end of the pipe standing in for the serial port
+static int giReplayTestPort;
+
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Routines
+//
+///////////////////////////////////////////////////////////////////////////////
+
+////////////////////////////////////////////////////////////////////////////
+// Name:         replay_test_sent
+// Description:  Serial write handler - count the messages written
+// Parameters:   paucMessage - message about to be written
+// Return:       None
+////////////////////////////////////////////////////////////////////////////
+static void
+replay_test_sent(char *paucMessage)
+{
+    ++gulReplayTestSent;
+}
+// end replay_test_sent
+
+
+////////////////////////////////////////////////////////////////////////////
+// Name:         replay_test_port_bytes
+// Description:  Read and count whatever has been written to the port
+// Parameters:   None
+// Return:       Bytes written since the last call
+////////////////////////////////////////////////////////////////////////////
+static guint32
+replay_test_port_bytes(void)
+{
+    char    lcBuffer[1024];
+    ssize_t llBytes;
+    guint32 lulTotal = 0;
+
+    while ((llBytes = read(giReplayTestPort, lcBuffer, sizeof(lcBuffer))) > 0) lulTotal += llBytes;
+    return lulTotal;
+}
+// end replay_test_port_bytes
+
+
+////////////////////////////////////////////////////////////////////////////
+// Name:         replay_test_line
+// Description:  Replay line handler - what the GUI's does, less display
+// Parameters:   paucLine - pointer to NULL-terminated line
+// Return:       Fields found by the parser
+////////////////////////////////////////////////////////////////////////////
+static guint32
+replay_test_line(char *paucLine)
+{
+    return parse_msg_replay(paucLine);
+}
+// end replay_test_line
+
+
+////////////////////////////////////////////////////////////////////////////
+// Name:         main
+// Description:  Replay the capture, then parse its startup line live
+// Parameters:   None
+// Return:       0 if the replay didn't write to the port
+////////////////////////////////////////////////////////////////////////////
+int
+main(int argc, char *argv[])
+{
+    ParseHooks lsHooks = { NULL, NULL, NULL, NULL };
+    GString *lgCapture = g_string_new(NULL);
+    GError  *error = NULL;
+    gchar   *plcCaptureName;
+    int      liCaptureFd;
+    int      liPipe[2];
+    guint8   lucLine;
+    guint32  lulReplaySent, lulReplayBytes, lulLiveSent, lulLiveBytes;
+
+    // "Connect" the serial port to a pipe
+    if (pipe2(liPipe, O_NONBLOCK) < 0)
+    {
+        g_printerr("Couldn't create pipe\r\n");
+        return 1;
+    }
+    giReplayTestPort    = liPipe[0];
+    gIOChannelSerialUSB = g_io_channel_unix_new(liPipe[1]);
+    g_io_channel_set_encoding(gIOChannelSerialUSB, NULL, NULL);
+    isUSBConnectionOK   = TRUE;
+    serial_set_write_handler(replay_test_sent);
+    parse_initialize(&lsHooks);
+
+    // Save the capture as a text logfile (CRLF lines, as logged)
+    for (lucLine = 0; lucLine < G_N_ELEMENTS(pucReplayTestCapture); ++lucLine)
+    {
+        g_string_append_printf(lgCapture, "%s\r\n", pucReplayTestCapture[lucLine]);
+    }
+    liCaptureFd = g_file_open_tmp("WSG30TempDisplay_replay_test_XXXXXX.txt", &plcCaptureName, &error);
+    if (liCaptureFd < 0 || !g_file_set_contents(plcCaptureName, lgCapture->str, lgCapture->len, &error))
+    {
+        g_printerr("%s\r\n", error->message);
+        return 1;
+    }
+    close(liCaptureFd);
+
+    // Replay it
+    if (!replay_open(plcCaptureName, &error))
+    {
+        g_printerr("%s\r\n", error->message);
+        g_unlink(plcCaptureName);
+        return 1;
+    }
+    replay_set_speed(REPLAY_SPEED_MAX);
+    while (!replay_is_finished()) replay_run(replay_test_line);
+    replay_close();
+    g_unlink(plcCaptureName);
+    lulReplaySent  = gulReplayTestSent;
+    lulReplayBytes = replay_test_port_bytes();
+
+    // The same line, live
+    parse_msg(REPLAY_TEST_UUT_STARTUP);
+    lulLiveSent  = gulReplayTestSent - lulReplaySent;
+    lulLiveBytes = replay_test_port_bytes();
+
+    printf("replay: %u messages, %u bytes to the port; live: %u messages, %u bytes\r\n",
+           lulReplaySent, lulReplayBytes, lulLiveSent, lulLiveBytes);
+    if (lulReplaySent || lulReplayBytes)
+    {
+        printf("FAILED: the replay wrote to the UUT\r\n");
+        return 1;
+    }
+    if (!lulLiveSent || !lulLiveBytes)
+    {
+        printf("FAILED: the live parser didn't answer the startup line, so the replay check proves nothing\r\n");
+        return 1;
+    }
+    printf("passed\r\n");
+    return 0;
+}
+// end main
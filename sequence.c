@@ -0,0 +1,449 @@
+/*
+ * File:   sequence.c
+ * Author: Mark Bersalona
+ *
+ * Created on 2024.07.15
+ * Sensaphone WSG30 Temperature Display Diagnostic test sequences
+ *
+ * Runs a script of send/expect/wait steps against the live received lines,
+ * so a regression the operator would drive from the MENU list and the
+ * Receive pane runs unattended:
+ *
+ *   # Buzzer, then a reboot
+ *   fail ***ERROR***
+ *   send +++MENU:B
+ *   expect 2000 Buzzer
+ *   send +++MENU:Z
+ *   expect 3x 15000 Display starting...
+ *   wait 1000
+ *
+ *   send TEXT               write TEXT to the UUT as the MENU list does (no
+ *                           CRLF; \r, \n and the other C escapes work)
+ *   expect [Nx] MSEC TEXT   wait up to MSEC for N (default 1) received lines
+ *                           containing TEXT
+ *   reply MSEC              wait up to MSEC for the reply to the last send
+ *                           (the commands correlate.c knows the reply to)
+ *   wait MSEC               pause
+ *   fail TEXT               from here on, a received line containing TEXT
+ *                           fails the sequence
+ *
+ * Nothing blocks: sends run straight away, expects are checked as each line
+ * is received, and expect/wait times run on the housekeeping timer wheel.
+ * Each line is only compared with the current expect and the fail texts.
+ * The sequence stops at the first step that fails.
+ */
+
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Includes
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include <glib.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "gconfig.h"
+#include "serial.h"
+#include "timerwheel.h"
+#include "correlate.h"
+#include "sequence.h"
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Definitions
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#define SEQUENCE_SEND    (0)
+#define SEQUENCE_EXPECT  (1)
+#define SEQUENCE_WAIT    (2)
+#define SEQUENCE_FAIL    (3)
+
+typedef struct
+{
+    guint8  ucType;                     // SEQUENCE_xxx
+    guint16 uiCount;                    // expect: lines to see
+    guint32 ulMsec;                     // expect, wait
+    guint32 ulLine;                     // in the script, for reports
+    char    cText[SEQUENCE_TEXT_MAX];
+} SequenceStep;
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Variables and tables
+//
+///////////////////////////////////////////////////////////////////////////////
+
+static SequenceStep gsSequenceStep[SEQUENCE_STEPS_MAX];
+static guint32 gulSequenceSteps;
+static char gcSequenceName[100];
+
+// Running sequence
+static SequenceHooks gsSequenceHooks;
+static gboolean gfSequenceRunning = FALSE;
+static guint32 gulSequenceStep;                 // current step
+static guint16 guiSequenceSeen;                 // expect: lines seen so far
+static gint64  gllSequenceStart_usec;
+static TimerwheelTimer gsSequenceTimer;         // expect timeout, end of wait
+static void sequence_next(void);
+
+// fail texts in force
+static char *gpcSequenceFail[SEQUENCE_FAILS_MAX];
+static guint32 gulSequenceFailLine[SEQUENCE_FAILS_MAX];
+static guint8 gucSequenceFails;
+
+static char lcTempSequenceString[2*SEQUENCE_TEXT_MAX + 200];
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Public routines
+//
+///////////////////////////////////////////////////////////////////////////////
+
+
+////////////////////////////////////////////////////////////////////////////
+// Name:         sequence_finish
+// Description:  The sequence is over: report and tell the front end
+// Parameters:   lfIsPassed - TRUE if every step passed
+//               paucDetail - why it didn't, or "" if it did
+// Return:       None
+////////////////////////////////////////////////////////////////////////////
+static void
+sequence_finish(gboolean lfIsPassed, char *paucDetail)
+{
+    gdouble ldElapsed_sec = (g_get_monotonic_time() - gllSequenceStart_usec) / 1e6;
+
+    gfSequenceRunning = FALSE;
+    timerwheel_cancel(&gsSequenceTimer);
+    if (lfIsPassed)
+    {
+        snprintf(lcTempSequenceString, sizeof(lcTempSequenceString), "Sequence %s passed: %u steps in %.1f s\r\n",
+                 gcSequenceName, gulSequenceSteps, ldElapsed_sec);
+    }
+    else
+    {
+        snprintf(lcTempSequenceString, sizeof(lcTempSequenceString), "***ERROR*** sequence %s FAILED after %.1f s: %s\r\n",
+                 gcSequenceName, ldElapsed_sec, paucDetail);
+    }
+    gsSequenceHooks.status_write(lcTempSequenceString);
+    if (gsSequenceHooks.finished) gsSequenceHooks.finished(lfIsPassed);
+}
+// end sequence_finish
+
+
+////////////////////////////////////////////////////////////////////////////
+// Name:         sequence_expired
+// Description:  Timer handler - the current expect has timed out, or the
+//               current wait is over
+// Parameters:   pasTimer - gsSequenceTimer
+// Return:       None
+////////////////////////////////////////////////////////////////////////////
+static void
+sequence_expired(TimerwheelTimer *pasTimer)
+{
+    SequenceStep *plsStep = &gsSequenceStep[gulSequenceStep];
+    char lcDetail[SEQUENCE_TEXT_MAX + 100];
+
+    if (!gfSequenceRunning) return;
+
+    if (SEQUENCE_EXPECT == plsStep->ucType)
+    {
+        snprintf(lcDetail, sizeof(lcDetail), "line %u expected %u \"%s\" within %u msec, saw %u",
+                 plsStep->ulLine, plsStep->uiCount, plsStep->cText, plsStep->ulMsec, guiSequenceSeen);
+        sequence_finish(FALSE, lcDetail);
+        return;
+    }
+    ++gulSequenceStep;
+    sequence_next();
+}
+// end sequence_expired
+
+
+////////////////////////////////////////////////////////////////////////////
+// Name:         sequence_next
+// Description:  Run steps from the current one until one has to wait
+//               (expect, wait) or the script ends
+// Parameters:   None
+// Return:       None
+////////////////////////////////////////////////////////////////////////////
+static void
+sequence_next(void)
+{
+    SequenceStep *plsStep;
+    char lcDetail[SEQUENCE_TEXT_MAX + 100];
+
+    for (; gulSequenceStep < gulSequenceSteps; ++gulSequenceStep)
+    {
+        plsStep = &gsSequenceStep[gulSequenceStep];
+        switch (plsStep->ucType)
+        {
+        case SEQUENCE_SEND:
+            if (!isUSBConnectionOK)
+            {
+                snprintf(lcDetail, sizeof(lcDetail), "line %u can't send, the serial port isn't connected", plsStep->ulLine);
+                sequence_finish(FALSE, lcDetail);
+                return;
+            }
+            serial_write(plsStep->cText);
+            break;
+        case SEQUENCE_FAIL:
+            gpcSequenceFail[gucSequenceFails]     = plsStep->cText;
+            gulSequenceFailLine[gucSequenceFails] = plsStep->ulLine;
+            ++gucSequenceFails;
+            break;
+        case SEQUENCE_EXPECT:
+            guiSequenceSeen = 0;
+            // fall through
+        case SEQUENCE_WAIT:
+            timerwheel_start(&gsSequenceTimer, plsStep->ulMsec, 0, sequence_expired, NULL);
+            return;
+        default:
+            break;
+        }
+    }
+    sequence_finish(TRUE, "");
+}
+// end sequence_next
+
+
+////////////////////////////////////////////////////////////////////////////
+// Name:         sequence_is_running
+// Description:  Is a sequence running?
+// Parameters:   None
+// Return:       TRUE if so
+////////////////////////////////////////////////////////////////////////////
+gboolean
+sequence_is_running(void)
+{
+    return gfSequenceRunning;
+}
+// end sequence_is_running
+
+
+////////////////////////////////////////////////////////////////////////////
+// Name:         sequence_line
+// Description:  A line has been received: check it against the fail texts
+//               and the current expect
+// Parameters:   paucLine - NULL-terminated line
+// Return:       None
+////////////////////////////////////////////////////////////////////////////
+void
+sequence_line(char *paucLine)
+{
+    SequenceStep *plsStep;
+    char lcDetail[2*SEQUENCE_TEXT_MAX + 100];
+    guint8 lucFail;
+
+    if (!gfSequenceRunning) return;
+
+    for (lucFail = 0; lucFail < gucSequenceFails; ++lucFail)
+    {
+        if (strstr(paucLine, gpcSequenceFail[lucFail]))
+        {
+            snprintf(lcDetail, sizeof(lcDetail), "received \"%.*s\" (fail on line %u)",
+                     SEQUENCE_TEXT_MAX, paucLine, gulSequenceFailLine[lucFail]);
+            sequence_finish(FALSE, lcDetail);
+            return;
+        }
+    }
+
+    plsStep = &gsSequenceStep[gulSequenceStep];
+    if (SEQUENCE_EXPECT != plsStep->ucType || !strstr(paucLine, plsStep->cText)) return;
+    if (++guiSequenceSeen < plsStep->uiCount) return;
+
+    timerwheel_cancel(&gsSequenceTimer);
+    ++gulSequenceStep;
+    sequence_next();
+}
+// end sequence_line
+
+
+////////////////////////////////////////////////////////////////////////////
+// Name:         sequence_load
+// Description:  Read a sequence script; see the top of this file
+//               Not while a sequence is running
+// Parameters:   paucName - script file name
+//               error    - where to say what's wrong
+// Return:       TRUE if it was read
+////////////////////////////////////////////////////////////////////////////
+gboolean
+sequence_load(char *paucName, GError **error)
+{
+    gchar *plcContents;
+    gchar **pplcLines;
+    gchar *plcLine;
+    gchar *plcArg;
+    gchar *plcEnd;
+    gchar *plcText;
+    char *plcLastSend = NULL;
+    gboolean lfIsReply;
+    SequenceStep *plsStep;
+    guint32 lulLine;
+    guint8 lucFails = 0;
+    gboolean lfIsOK = TRUE;
+
+    if (!g_file_get_contents(paucName, &plcContents, NULL, error)) return FALSE;
+    pplcLines = g_strsplit(plcContents, "\n", -1);
+    g_free(plcContents);
+
+    gulSequenceSteps = 0;
+    for (lulLine = 0; lfIsOK && pplcLines[lulLine]; ++lulLine)
+    {
+        plcLine = g_strstrip(pplcLines[lulLine]);
+        if (!*plcLine || '#' == *plcLine) continue;
+        if (gulSequenceSteps >= SEQUENCE_STEPS_MAX)
+        {
+            g_set_error(error, G_FILE_ERROR, G_FILE_ERROR_INVAL, "%s: more than %d steps", paucName, SEQUENCE_STEPS_MAX);
+            lfIsOK = FALSE;
+            break;
+        }
+        plsStep = &gsSequenceStep[gulSequenceSteps];
+        memset(plsStep, 0, sizeof(*plsStep));
+        plsStep->ulLine  = lulLine + 1;
+        plsStep->uiCount = 1;
+
+        // Keyword, then its arguments
+        plcArg = plcLine + strcspn(plcLine, " \t");
+        if (*plcArg) *plcArg++ = '\0';
+        plcArg = g_strchug(plcArg);
+        plcText = plcArg;
+        if (0 == strcmp(plcLine, "send"))       plsStep->ucType = SEQUENCE_SEND;
+        else if (0 == strcmp(plcLine, "fail"))  plsStep->ucType = SEQUENCE_FAIL;
+        else if (0 == strcmp(plcLine, "wait") || 0 == strcmp(plcLine, "expect") || 0 == strcmp(plcLine, "reply"))
+        {
+            lfIsReply = ('r' == plcLine[0]);
+            plsStep->ucType = ('w' == plcLine[0]) ? SEQUENCE_WAIT : SEQUENCE_EXPECT;
+            if (SEQUENCE_EXPECT == plsStep->ucType && !lfIsReply && g_ascii_isdigit(*plcArg))
+            {
+                // Optional count, "3x"
+                guint64 lullCount = g_ascii_strtoull(plcArg, &plcEnd, 10);
+
+                if ('x' == *plcEnd)
+                {
+                    plsStep->uiCount = (guint16)CLAMP(lullCount, 1, G_MAXUINT16);
+                    plcArg = g_strchug(plcEnd + 1);
+                }
+            }
+            plsStep->ulMsec = (guint32)MIN(g_ascii_strtoull(plcArg, &plcEnd, 10), G_MAXUINT32);
+            if (plcEnd == plcArg || (*plcEnd && !g_ascii_isspace(*plcEnd)))
+            {
+                g_set_error(error, G_FILE_ERROR, G_FILE_ERROR_INVAL, "%s line %u: %s needs a time in msec",
+                            paucName, lulLine + 1, plcLine);
+                lfIsOK = FALSE;
+                break;
+            }
+            plcText = g_strchug(plcEnd);
+            if ((SEQUENCE_WAIT == plsStep->ucType || lfIsReply) && *plcText)
+            {
+                g_set_error(error, G_FILE_ERROR, G_FILE_ERROR_INVAL, "%s line %u: %s takes only a time", paucName, lulLine + 1, plcLine);
+                lfIsOK = FALSE;
+                break;
+            }
+
+            // reply: expect what the last command sent is answered with
+            if (lfIsReply)
+            {
+                plcText = plcLastSend ? correlate_reply(plcLastSend) : NULL;
+                if (!plcText)
+                {
+                    g_set_error(error, G_FILE_ERROR, G_FILE_ERROR_INVAL,
+                                "%s line %u: reply needs a send before it of a command with a known reply (+++MENU:N, D, P, V, their lower case reads, or Z)",
+                                paucName, lulLine + 1);
+                    lfIsOK = FALSE;
+                    break;
+                }
+            }
+        }
+        else
+        {
+            g_set_error(error, G_FILE_ERROR, G_FILE_ERROR_INVAL, "%s line %u: unknown step \"%s\" (send, expect, reply, wait or fail)",
+                        paucName, lulLine + 1, plcLine);
+            lfIsOK = FALSE;
+            break;
+        }
+
+        if (SEQUENCE_WAIT != plsStep->ucType)
+        {
+            gchar *plcCompressed = g_strcompress(plcText);
+
+            if (!*plcCompressed || strlen(plcCompressed) >= SEQUENCE_TEXT_MAX)
+            {
+                g_set_error(error, G_FILE_ERROR, G_FILE_ERROR_INVAL, "%s line %u: %s needs a text of 1 to %d characters",
+                            paucName, lulLine + 1, plcLine, SEQUENCE_TEXT_MAX - 1);
+                lfIsOK = FALSE;
+            }
+            g_strlcpy(plsStep->cText, plcCompressed, sizeof(plsStep->cText));
+            g_free(plcCompressed);
+            if (SEQUENCE_SEND == plsStep->ucType) plcLastSend = plsStep->cText;
+        }
+        if (lfIsOK && SEQUENCE_FAIL == plsStep->ucType && ++lucFails > SEQUENCE_FAILS_MAX)
+        {
+            g_set_error(error, G_FILE_ERROR, G_FILE_ERROR_INVAL, "%s line %u: more than %d fail steps",
+                        paucName, lulLine + 1, SEQUENCE_FAILS_MAX);
+            lfIsOK = FALSE;
+        }
+        ++gulSequenceSteps;
+    }
+    g_strfreev(pplcLines);
+
+    if (lfIsOK && 0 == gulSequenceSteps)
+    {
+        g_set_error(error, G_FILE_ERROR, G_FILE_ERROR_INVAL, "%s has no steps", paucName);
+        lfIsOK = FALSE;
+    }
+    if (!lfIsOK)
+    {
+        gulSequenceSteps = 0;
+        return FALSE;
+    }
+    plcText = g_path_get_basename(paucName);
+    g_strlcpy(gcSequenceName, plcText, sizeof(gcSequenceName));
+    g_free(plcText);
+    return TRUE;
+}
+// end sequence_load
+
+
+////////////////////////////////////////////////////////////////////////////
+// Name:         sequence_start
+// Description:  Run the loaded sequence from its first step
+// Parameters:   pasHooks - Status and end of sequence routines
+// Return:       None
+////////////////////////////////////////////////////////////////////////////
+void
+sequence_start(SequenceHooks *pasHooks)
+{
+    gsSequenceHooks       = *pasHooks;
+    gulSequenceStep       = 0;
+    gucSequenceFails      = 0;
+    gllSequenceStart_usec = g_get_monotonic_time();
+    gfSequenceRunning     = TRUE;
+
+    snprintf(lcTempSequenceString, sizeof(lcTempSequenceString), "Sequence %s started, %u steps\r\n",
+             gcSequenceName, gulSequenceSteps);
+    gsSequenceHooks.status_write(lcTempSequenceString);
+    sequence_next();
+}
+// end sequence_start
+
+
+////////////////////////////////////////////////////////////////////////////
+// Name:         sequence_stop
+// Description:  Stop the running sequence; it counts as failed
+// Parameters:   None
+// Return:       None
+////////////////////////////////////////////////////////////////////////////
+void
+sequence_stop(void)
+{
+    char lcDetail[100];
+
+    if (!gfSequenceRunning) return;
+
+    snprintf(lcDetail, sizeof(lcDetail), "stopped at line %u", gsSequenceStep[gulSequenceStep].ulLine);
+    sequence_finish(FALSE, lcDetail);
+}
+// end sequence_stop
+
@@ -0,0 +1,48 @@
+/*
+ * File:   sequence.h
+ * Author: Mark Bersalona
+ *
+ * Created on 2024.07.15
+ */
+
+#ifndef SEQUENCE_H
+#define SEQUENCE_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Definitions
+//
+///////////////////////////////////////////////////////////////////////////////
+
+// Routines a running sequence calls.
+// The GTK display and the headless front end each supply their own.
+typedef struct
+{
+    void (*status_write)(char *paucWriteBuf);              // write to Status
+    void (*finished)(gboolean lfIsPassed);                 // the sequence passed, failed or was stopped
+} SequenceHooks;
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Public routines
+//
+///////////////////////////////////////////////////////////////////////////////
+
+// All on the UI thread (main loop)
+gboolean sequence_is_running(void);
+void sequence_line(char *paucLine);
+gboolean sequence_load(char *paucName, GError **error);
+void sequence_start(SequenceHooks *pasHooks);
+void sequence_stop(void);
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* SEQUENCE_H */
+
@@ -13,15 +13,16 @@
 //
 ///////////////////////////////////////////////////////////////////////////////
 
-#include <gtk/gtk.h>
+#include <glib.h>
 //#include <stdio.h>
 #include <stdlib.h>
 #include <fcntl.h>          // File Control Definitions
 #include <termios.h>        // POSIX Terminal Control definitions
 #include <string.h>
 #include "gconfig.h"
-#include "main.h"
-#include "display.h"
+#include "serial.h"
+#include "metrics.h"
+#include "trace.h"
 
 ///////////////////////////////////////////////////////////////////////////////
 //
@@ -36,6 +37,38 @@ gboolean isUSBConnectionOK = FALSE;
 gboolean isFirstSerialFail = TRUE;
 int fd; /* file descriptor of the port */
 
+// I/O channel for serial-to-USB port
+GIOChannel *gIOChannelSerialUSB;
+
+// serial_write() is called from the main loop (menus, sequences) and,
+// with --pipeline, from the parser thread; GIOChannel isn't thread-safe
+static GMutex gSerialWriteLock;
+
+// Startup: port opened in a thread while the UI is being built
+static GThread *gpSerialOpenThread = NULL;
+static char    *gpcSerialOpenName;
+static int      giSerialOpenBaud;
+
+// Where serial_read() sends each received string
+static void (*serial_receive_handler)(char *paucReceiveMsg) = NULL;
+
+// Line assembly buffer, allocated by serial_set_line_max()
+static char    *gpcSerialLine = NULL;
+static guint32  gulSerialLineMax;           // bytes, including the NULL
+static guint32  gulSerialLineLongest;       // longest line received, bytes
+static guint32  gulSerialLineCount;         // characters kept
+static guint32  gulSerialLineBytes;         // characters received, including any dropped
+static guint64  gullSerialLineStart_ns;
+
+// --pipeline: serial_attach() hands the port to a reader thread
+static void (*serial_reader_start)(int lfd) = NULL;
+
+// Command/response correlation: told of each message serial_write() sends,
+// and of each line as soon as it's assembled (on the thread reading the
+// port, before it's queued, so replies are timed when they arrive)
+static void (*serial_write_handler)(char *paucMessage) = NULL;
+static void (*serial_reply_handler)(char *paucLine) = NULL;
+
 char lcSerialTempString[40];
 
 
@@ -99,6 +132,277 @@ serial_open(char *name, int baud)
 }
 // end serial_open
 
+////////////////////////////////////////////////////////////////////////////
+// Name:         serial_attach
+// Description:  Hook up the serial read and error callbacks to an
+//               already opened serial-to-USB port
+// Parameters:   int lfd - file descriptor from serial_open
+// Return:       None
+////////////////////////////////////////////////////////////////////////////
+static void
+serial_attach(int lfd)
+{
+    // (a --pipeline parser thread may be writing to the old channel)
+    g_mutex_lock(&gSerialWriteLock);
+    isUSBConnectionOK = TRUE;
+    isFirstSerialFail = TRUE;
+    gIOChannelSerialUSB = g_io_channel_unix_new(lfd);  // creates the correct reference for callback
+
+    // Set encoding
+    g_io_channel_set_encoding(gIOChannelSerialUSB, NULL, NULL);
+    g_mutex_unlock(&gSerialWriteLock);
+
+    // Specify callback routines for serial read and error
+    if (serial_reader_start)
+    {
+        serial_reader_start(lfd);
+    }
+    else
+    {
+        g_io_add_watch(gIOChannelSerialUSB,
+                       G_IO_IN,
+                       serial_read,
+                       NULL);
+    }
+    g_io_add_watch(gIOChannelSerialUSB,
+                   G_IO_ERR|G_IO_HUP|G_IO_NVAL,
+                   serial_error,
+                   NULL);
+}
+// end serial_attach
+
+////////////////////////////////////////////////////////////////////////////
+// Name:         serial_connect
+// Description:  Open the serial-to-USB port and hook up the serial read
+//               and error callbacks
+// Parameters:   char *name - name of port to open
+//               int baud - baud rate
+// Return:       File descriptor, or <0 if the port couldn't be opened
+////////////////////////////////////////////////////////////////////////////
+int
+serial_connect(char *name, int baud)
+{
+    int lfd = serial_open(name, baud);
+    if (lfd<0)
+    {
+        isUSBConnectionOK = FALSE;
+    }
+    else
+    {
+        serial_attach(lfd);
+    }
+    return lfd;
+}
+// end serial_connect
+
+////////////////////////////////////////////////////////////////////////////
+// Name:         serial_open_thread
+// Description:  Thread routine for serial_open_start
+// Parameters:   data - unused
+// Return:       serial_open result, as a pointer
+////////////////////////////////////////////////////////////////////////////
+static gpointer
+serial_open_thread(gpointer data)
+{
+    return GINT_TO_POINTER(serial_open(gpcSerialOpenName, giSerialOpenBaud));
+}
+// end serial_open_thread
+
+////////////////////////////////////////////////////////////////////////////
+// Name:         serial_open_start
+// Description:  Start opening the serial-to-USB port in a thread, so
+//               a slow open/tcsetattr overlaps with startup
+//               Finish with serial_open_finish()
+// Parameters:   char *name - name of port to open
+//               int baud - baud rate
+// Return:       None
+////////////////////////////////////////////////////////////////////////////
+void
+serial_open_start(char *name, int baud)
+{
+    gpcSerialOpenName  = name;
+    giSerialOpenBaud   = baud;
+    gpSerialOpenThread = g_thread_new("serial_open", serial_open_thread, NULL);
+}
+// end serial_open_start
+
+////////////////////////////////////////////////////////////////////////////
+// Name:         serial_open_finish
+// Description:  Wait for serial_open_start() to finish; if the port
+//               opened, hook up the serial read and error callbacks
+//               (must be called from the main loop thread)
+// Parameters:   None
+// Return:       File descriptor, or <0 if the port couldn't be opened
+////////////////////////////////////////////////////////////////////////////
+int
+serial_open_finish(void)
+{
+    int lfd = -1;
+
+    if (gpSerialOpenThread)
+    {
+        lfd = GPOINTER_TO_INT(g_thread_join(gpSerialOpenThread));
+        gpSerialOpenThread = NULL;
+        if (lfd<0)
+        {
+            isUSBConnectionOK = FALSE;
+        }
+        else
+        {
+            serial_attach(lfd);
+        }
+    }
+    return lfd;
+}
+// end serial_open_finish
+
+////////////////////////////////////////////////////////////////////////////
+// Name:         serial_set_receive_handler
+// Description:  Set the routine serial_read() calls with each complete
+//               received string (CRLF stripped, NULL-terminated)
+// Parameters:   handler - receive routine, e.g. main_receive_msg_write
+// Return:       None
+////////////////////////////////////////////////////////////////////////////
+void
+serial_set_receive_handler(void (*handler)(char *paucReceiveMsg))
+{
+    serial_receive_handler = handler;
+}
+// end serial_set_receive_handler
+
+////////////////////////////////////////////////////////////////////////////
+// Name:         serial_set_line_max
+// Description:  Size the line assembly buffer; characters of a line past
+//               the end are dropped (the line is truncated)
+//               Call before the port is opened
+// Parameters:   lulBytes - longest line kept, including the NULL
+// Return:       None
+////////////////////////////////////////////////////////////////////////////
+void
+serial_set_line_max(guint32 lulBytes)
+{
+    g_free(gpcSerialLine);
+    gulSerialLineMax = MAX(lulBytes, 4);
+    gpcSerialLine    = g_malloc0(gulSerialLineMax);
+}
+// end serial_set_line_max
+
+////////////////////////////////////////////////////////////////////////////
+// Name:         serial_memory
+// Description:  Memory footprint of the line assembly buffer
+// Parameters:   palReserved - set to bytes allocated
+//               palUsed     - set to the longest line received, bytes
+// Return:       None
+////////////////////////////////////////////////////////////////////////////
+void
+serial_memory(guint32 *palReserved, guint32 *palUsed)
+{
+    *palReserved = gpcSerialLine ? gulSerialLineMax : 0;
+    *palUsed     = MIN(gulSerialLineLongest, *palReserved);
+}
+// end serial_memory
+
+////////////////////////////////////////////////////////////////////////////
+// Name:         serial_assemble
+// Description:  Add a received character to the line being assembled;
+//               at LF, strip the CRLF and hand the line to the receive
+//               handler. Lines past the buffer are truncated
+// Parameters:   lcChar - received character
+// Return:       None
+////////////////////////////////////////////////////////////////////////////
+static void
+serial_assemble(char lcChar)
+{
+    if (!gpcSerialLine) serial_set_line_max(RECEIVE_FIFO_MSG_LENGTH_MAX);
+    if (0 == gulSerialLineBytes) gullSerialLineStart_ns = trace_start();
+    ++gulSerialLineBytes;
+    if (gulSerialLineCount < gulSerialLineMax - 1) gpcSerialLine[gulSerialLineCount++] = lcChar;
+    if ('\n' != lcChar) return;
+
+    // Overwrite the \r\n (just the \n, if \r never came or was dropped)
+    while (gulSerialLineCount > 0 &&
+           ('\n' == gpcSerialLine[gulSerialLineCount-1] || '\r' == gpcSerialLine[gulSerialLineCount-1]))
+    {
+        --gulSerialLineCount;
+    }
+    gpcSerialLine[gulSerialLineCount] = '\0';
+    if (gulSerialLineBytes > gulSerialLineLongest) gulSerialLineLongest = MIN(gulSerialLineBytes, gulSerialLineMax);
+    metrics_add(METRICS_BYTES_RECEIVED, gulSerialLineBytes);
+    metrics_add(METRICS_LINES_RECEIVED, 1);
+
+    trace_line_received();
+
+    // Time any reply, then save received string to receive FIFO
+    if (serial_reply_handler) serial_reply_handler(gpcSerialLine);
+    if (serial_receive_handler) serial_receive_handler(gpcSerialLine);
+    trace_end(TRACE_SERIAL_READ, gullSerialLineStart_ns);
+
+    gulSerialLineCount = 0;
+    gulSerialLineBytes = 0;
+}
+// end serial_assemble
+
+////////////////////////////////////////////////////////////////////////////
+// Name:         serial_receive_bytes
+// Description:  Assemble lines from a block of received characters
+//               (--pipeline reader thread; serial_read() otherwise)
+// Parameters:   paucBytes - received characters
+//               lulLength - number of characters
+// Return:       None
+////////////////////////////////////////////////////////////////////////////
+void
+serial_receive_bytes(char *paucBytes, guint32 lulLength)
+{
+    guint32 lulIndex;
+
+    for (lulIndex = 0; lulIndex < lulLength; ++lulIndex) serial_assemble(paucBytes[lulIndex]);
+}
+// end serial_receive_bytes
+
+////////////////////////////////////////////////////////////////////////////
+// Name:         serial_set_reader
+// Description:  --pipeline: have each opened port handed to a reader
+//               thread, instead of read by serial_read() in the main loop
+//               (the error callback and serial_write() are unchanged)
+// Parameters:   pafStart - starts a reader on the port's descriptor
+// Return:       None
+////////////////////////////////////////////////////////////////////////////
+void
+serial_set_reader(void (*pafStart)(int lfd))
+{
+    serial_reader_start = pafStart;
+}
+// end serial_set_reader
+
+////////////////////////////////////////////////////////////////////////////
+// Name:         serial_set_write_handler
+// Description:  Set the routine serial_write() calls with each message
+//               it is about to write
+// Parameters:   handler - e.g. correlate_sent
+// Return:       None
+////////////////////////////////////////////////////////////////////////////
+void
+serial_set_write_handler(void (*handler)(char *paucMessage))
+{
+    serial_write_handler = handler;
+}
+// end serial_set_write_handler
+
+////////////////////////////////////////////////////////////////////////////
+// Name:         serial_set_reply_handler
+// Description:  Set the routine called with each complete received line
+//               as soon as it's assembled, before the receive handler
+//               (--pipeline: on the reader thread)
+// Parameters:   handler - e.g. correlate_line
+// Return:       None
+////////////////////////////////////////////////////////////////////////////
+void
+serial_set_reply_handler(void (*handler)(char *paucLine))
+{
+    serial_reply_handler = handler;
+}
+// end serial_set_reply_handler
+
 ////////////////////////////////////////////////////////////////////////////
 // Name:         serial_read
 // Description:  Callback routine to read serial port
@@ -111,8 +415,6 @@ gboolean
 serial_read(GIOChannel *gio, GIOCondition condition, gpointer data) // GdkInputCondition condition )
 {
     static gsize n = 1;
-    static char ucSerialReadBuffer[10000] = "";
-    static int  count = 0;
     gchar buf;
     GIOStatus readStatus;
     gboolean lfReturnValue = TRUE;
@@ -158,20 +460,8 @@ serial_read(GIOChannel *gio, GIOCondition condition, gpointer data) // GdkInputC
         }
         if (n > 0)
         {
-            ucSerialReadBuffer[count++] = buf;
-        }
-        if (buf == '\n')
-        {
-            if (count<2) count=2; // just in case \n received too early in msg
-            ucSerialReadBuffer[count-2] = '\0';  // overwrite \r\n
-            //g_print("%s\r\n",msg);
-
-            // Save received string to receive FIFO
-            main_receive_msg_write(ucSerialReadBuffer);
-
-            count = 0;
-            memset(ucSerialReadBuffer, 0, sizeof(ucSerialReadBuffer));
-            n = 0; // drop out after every complete message since ...read_chars seems to always block
+            serial_assemble(buf);
+            if (buf == '\n') n = 0; // drop out after every complete message since ...read_chars seems to always block
         }
     } // while (n>0)
     return lfReturnValue;
@@ -181,13 +471,15 @@ serial_read(GIOChannel *gio, GIOCondition condition, gpointer data) // GdkInputC
 ////////////////////////////////////////////////////////////////////////////
 // Name:         serial_write
 // Description:  Write NULL-terminated string out the serial port
+//               Any thread; one message is written at a time
 // Parameters:   paucMessage - pointer to NULL-terminated string
 // Return:       Size of message written
 ////////////////////////////////////////////////////////////////////////////
 int serial_write(char * paucMessage)
 {
-    gssize lsizeByteWritten;
+    gsize lsizeByteWritten = 0;
 
+    g_mutex_lock(&gSerialWriteLock);
     if (isUSBConnectionOK)
     {
         ///////////////////////////////////////////////////////
@@ -199,10 +491,14 @@ int serial_write(char * paucMessage)
         //g_usleep(125000); // Delay n useconds
         ///////////////////////////////////////////////////////
         // Write message out the serial port
+        // (its reply may arrive on the reader thread before the write
+        //  returns, so the correlator is told first)
+        if (serial_write_handler) serial_write_handler(paucMessage);
         g_io_channel_write_chars(gIOChannelSerialUSB, paucMessage, -1, &lsizeByteWritten, NULL);
         // Send it out NOW!!
         g_io_channel_flush(gIOChannelSerialUSB, NULL);
     }
+    g_mutex_unlock(&gSerialWriteLock);
 
     return (int)lsizeByteWritten;
 }
@@ -25,13 +25,26 @@ extern "C" {
 extern gboolean isUSBConnectionOK;
 extern gboolean isFirstSerialFail;
 
+// I/O channel for serial-to-USB port
+extern GIOChannel *gIOChannelSerialUSB;
+
 ///////////////////////////////////////////////////////////////////////////////
 //
 // Public routines
 //
 ///////////////////////////////////////////////////////////////////////////////
 
+int serial_connect(char *name, int baud);
 int serial_open(char *name, int baud);
+int serial_open_finish(void);
+void serial_open_start(char *name, int baud);
+void serial_receive_bytes(char *paucBytes, guint32 lulLength);
+void serial_memory(guint32 *palReserved, guint32 *palUsed);
+void serial_set_line_max(guint32 lulBytes);
+void serial_set_reader(void (*pafStart)(int lfd));
+void serial_set_receive_handler(void (*handler)(char *paucReceiveMsg));
+void serial_set_reply_handler(void (*handler)(char *paucLine));
+void serial_set_write_handler(void (*handler)(char *paucMessage));
 int serial_write(char * paucMessage);
 gboolean serial_read(GIOChannel *gio, GIOCondition condition, gpointer data); // GdkInputCondition condition )
 gboolean serial_error(GIOChannel *gio, GIOCondition condition, gpointer data);
@@ -0,0 +1,825 @@
+/*
+ * File:   sessionlog.c
+ * Author: Mark Bersalona
+ *
+ * Created on 2024.07.15
+ * Sensaphone WSG30 Temperature Display Diagnostic binary session log
+ *
+ * Optional structured companion to the text logfile: every received line
+ * with its host timestamp, source port and the fields the parser found in
+ * it, in checksummed blocks with a sparse time index so a reader can seek
+ * to any time in a multi-day capture with a binary search.
+ * See sessionlog.h for the file layout.
+ */
+
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Includes
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include <glib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include "gconfig.h"
+#include "sessionlog.h"
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Definitions
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#define SESSIONLOG_FILE_HEADER_BYTES   (16)
+#define SESSIONLOG_BLOCK_HEADER_BYTES  (32)
+#define SESSIONLOG_RECORD_HEADER_BYTES (16)
+
+#define SESSIONLOG_MAGIC_FILE   ("WSG30SL")
+#define SESSIONLOG_MAGIC_BLOCK  (0x4B4C4253)    // "SBLK"
+#define SESSIONLOG_MAGIC_INDEX  (0x58444953)    // "SIDX"
+#define SESSIONLOG_MAGIC_END    (0x444E4553)    // "SEND"
+
+// Sparse time index entry, one per block
+typedef struct
+{
+    gint64  llFirst_usec;
+    guint64 lullOffset;
+} SessionlogIndex;
+
+struct _SessionlogReader
+{
+    GMappedFile    *gMapped;
+    const guint8   *pucData;
+    gsize           lsizeEnd;                   // end of the last block
+    GArray         *gIndex;                     // SessionlogIndex
+    char            ucPort[SESSIONLOG_PORT_MAX][SESSIONLOG_PORT_NAME_MAX];
+    guint8          lucPortCount;
+    guint32         lulBlock;                   // next block to read
+    const guint8   *pucRecord;                  // next record in current block
+    const guint8   *pucRecordEnd;
+    gint64          llSkipUntil_usec;           // seek target not reached yet
+    guint32         lulBadBlocks;
+};
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Variables and tables
+//
+///////////////////////////////////////////////////////////////////////////////
+
+static guint32 gulSessionlogCRCTable[256];
+
+// Writer
+static int      giSessionlogFd = -1;
+static gboolean gfSessionlogEnabled = FALSE;
+static guint8   gucSessionlogBlock[SESSIONLOG_BLOCK_BYTES];
+static guint32  gulSessionlogBlockBytes;
+static guint32  gulSessionlogBlockRecords;
+static gint64   gllSessionlogBlockFirst_usec;
+static gint64   gllSessionlogBlockLast_usec;
+static gint64   gllSessionlogBlockStarted_usec; // monotonic, for sessionlog_tick()
+static guint64  gullSessionlogOffset;           // file offset of next block
+static GArray  *gSessionlogIndex = NULL;
+static char     gucSessionlogPort[SESSIONLOG_PORT_MAX][SESSIONLOG_PORT_NAME_MAX];
+static guint8   gucSessionlogPortCount;
+
+// Writes finished blocks, so a slow disk doesn't hold up the caller
+static GThreadPool *gSessionlogWritePool = NULL;
+
+// Written blocks' buffers, kept for reuse so steady-state logging
+// doesn't allocate
+#define SESSIONLOG_BLOCK_SPARES  (4)
+static guint8 *gpucSessionlogSpare[SESSIONLOG_BLOCK_SPARES];
+static guint8  gucSessionlogSpareCount;
+static GMutex  gSessionlogSpareMutex;
+
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Encoding
+//
+///////////////////////////////////////////////////////////////////////////////
+
+////////////////////////////////////////////////////////////////////////////
+// Name:         sessionlog_crc32
+// Description:  CRC-32 (IEEE 802.3, as used by zlib/gzip)
+// Parameters:   paucData - bytes
+//               lulCount - number of bytes
+// Return:       CRC-32
+////////////////////////////////////////////////////////////////////////////
+static guint32
+sessionlog_crc32(const guint8 *paucData, guint32 lulCount)
+{
+    guint32 lulCRC = 0xFFFFFFFF;
+    guint32 i, j;
+
+    if (0 == gulSessionlogCRCTable[1])
+    {
+        for (i = 0; i < 256; ++i)
+        {
+            lulCRC = i;
+            for (j = 0; j < 8; ++j) lulCRC = (lulCRC & 1) ? (0xEDB88320 ^ (lulCRC >> 1)) : (lulCRC >> 1);
+            gulSessionlogCRCTable[i] = lulCRC;
+        }
+        lulCRC = 0xFFFFFFFF;
+    }
+
+    for (i = 0; i < lulCount; ++i) lulCRC = gulSessionlogCRCTable[(lulCRC ^ paucData[i]) & 0xFF] ^ (lulCRC >> 8);
+
+    return lulCRC ^ 0xFFFFFFFF;
+}
+// end sessionlog_crc32
+
+
+////////////////////////////////////////////////////////////////////////////
+// Name:         sessionlog_put16
+// Description:  Store a 16-bit value, little-endian
+// Parameters:   paucBuf  - where to store it
+//               luiValue - value
+// Return:       None
+////////////////////////////////////////////////////////////////////////////
+static void
+sessionlog_put16(guint8 *paucBuf, guint16 luiValue)
+{
+    paucBuf[0] = luiValue;
+    paucBuf[1] = luiValue >> 8;
+}
+// end sessionlog_put16
+
+
+////////////////////////////////////////////////////////////////////////////
+// Name:         sessionlog_put32
+// Description:  Store a 32-bit value, little-endian
+// Parameters:   paucBuf  - where to store it
+//               lulValue - value
+// Return:       None
+////////////////////////////////////////////////////////////////////////////
+static void
+sessionlog_put32(guint8 *paucBuf, guint32 lulValue)
+{
+    sessionlog_put16(paucBuf,   lulValue);
+    sessionlog_put16(paucBuf+2, lulValue >> 16);
+}
+// end sessionlog_put32
+
+
+////////////////////////////////////////////////////////////////////////////
+// Name:         sessionlog_put64
+// Description:  Store a 64-bit value, little-endian
+// Parameters:   paucBuf   - where to store it
+//               lullValue - value
+// Return:       None
+////////////////////////////////////////////////////////////////////////////
+static void
+sessionlog_put64(guint8 *paucBuf, guint64 lullValue)
+{
+    sessionlog_put32(paucBuf,   lullValue);
+    sessionlog_put32(paucBuf+4, lullValue >> 32);
+}
+// end sessionlog_put64
+
+
+////////////////////////////////////////////////////////////////////////////
+// Name:         sessionlog_get16
+// Description:  Load a 16-bit little-endian value
+// Parameters:   paucBuf - where to load it from
+// Return:       Value
+////////////////////////////////////////////////////////////////////////////
+static guint16
+sessionlog_get16(const guint8 *paucBuf)
+{
+    return paucBuf[0] | (paucBuf[1] << 8);
+}
+// end sessionlog_get16
+
+
+////////////////////////////////////////////////////////////////////////////
+// Name:         sessionlog_get32
+// Description:  Load a 32-bit little-endian value
+// Parameters:   paucBuf - where to load it from
+// Return:       Value
+////////////////////////////////////////////////////////////////////////////
+static guint32
+sessionlog_get32(const guint8 *paucBuf)
+{
+    return sessionlog_get16(paucBuf) | ((guint32)sessionlog_get16(paucBuf+2) << 16);
+}
+// end sessionlog_get32
+
+
+////////////////////////////////////////////////////////////////////////////
+// Name:         sessionlog_get64
+// Description:  Load a 64-bit little-endian value
+// Parameters:   paucBuf - where to load it from
+// Return:       Value
+////////////////////////////////////////////////////////////////////////////
+static guint64
+sessionlog_get64(const guint8 *paucBuf)
+{
+    return sessionlog_get32(paucBuf) | ((guint64)sessionlog_get32(paucBuf+4) << 32);
+}
+// end sessionlog_get64
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Writer
+//
+///////////////////////////////////////////////////////////////////////////////
+
+////////////////////////////////////////////////////////////////////////////
+// Name:         sessionlog_write_all
+// Description:  write() a whole buffer to the session log, retrying on
+//               EINTR and partial writes
+// Parameters:   paucBuf  - bytes to write
+//               lulCount - number of bytes
+// Return:       None
+////////////////////////////////////////////////////////////////////////////
+static void
+sessionlog_write_all(const guint8 *paucBuf, guint32 lulCount)
+{
+    ssize_t liWritten;
+
+    while (lulCount)
+    {
+        liWritten = write(giSessionlogFd, paucBuf, lulCount);
+        if (liWritten < 0)
+        {
+            if (EINTR == errno) continue;
+            g_printerr("Session log write error: %s\r\n", g_strerror(errno));
+            return;
+        }
+        paucBuf  += liWritten;
+        lulCount -= (guint32)liWritten;
+    }
+}
+// end sessionlog_write_all
+
+
+////////////////////////////////////////////////////////////////////////////
+// Name:         sessionlog_block_write
+// Description:  Write thread - write a finished block, then keep its
+//               buffer for reuse (or free it if there are enough spares)
+// Parameters:   data      - block: u32 size, then the block itself
+//               user_data - unused
+// Return:       None
+////////////////////////////////////////////////////////////////////////////
+static void
+sessionlog_block_write(gpointer data, gpointer user_data)
+{
+    guint8 *pucBlock = (guint8 *)data;
+
+    sessionlog_write_all(pucBlock+4, sessionlog_get32(pucBlock));
+
+    g_mutex_lock(&gSessionlogSpareMutex);
+    if (gucSessionlogSpareCount < SESSIONLOG_BLOCK_SPARES)
+    {
+        gpucSessionlogSpare[gucSessionlogSpareCount++] = pucBlock;
+        pucBlock = NULL;
+    }
+    g_mutex_unlock(&gSessionlogSpareMutex);
+    g_free(pucBlock);
+}
+// end sessionlog_block_write
+
+
+////////////////////////////////////////////////////////////////////////////
+// Name:         sessionlog_flush
+// Description:  Finish the current block: add it to the time index and
+//               hand it to the write thread
+// Parameters:   None
+// Return:       None
+////////////////////////////////////////////////////////////////////////////
+static void
+sessionlog_flush(void)
+{
+    SessionlogIndex lsIndex;
+    guint32 lulSize = SESSIONLOG_BLOCK_HEADER_BYTES + gulSessionlogBlockBytes;
+    guint8 *pucBlock;
+
+    if (0 == gulSessionlogBlockRecords) return;
+
+    // Buffers are all full-block size, so any spare will do
+    g_mutex_lock(&gSessionlogSpareMutex);
+    pucBlock = gucSessionlogSpareCount ? gpucSessionlogSpare[--gucSessionlogSpareCount] : NULL;
+    g_mutex_unlock(&gSessionlogSpareMutex);
+    if (!pucBlock) pucBlock = g_malloc(4 + SESSIONLOG_BLOCK_HEADER_BYTES + SESSIONLOG_BLOCK_BYTES);
+    sessionlog_put32(pucBlock, lulSize);
+    sessionlog_put32(pucBlock+4,  SESSIONLOG_MAGIC_BLOCK);
+    sessionlog_put32(pucBlock+8,  gulSessionlogBlockBytes);
+    sessionlog_put32(pucBlock+12, gulSessionlogBlockRecords);
+    sessionlog_put32(pucBlock+16, sessionlog_crc32(gucSessionlogBlock, gulSessionlogBlockBytes));
+    sessionlog_put64(pucBlock+20, gllSessionlogBlockFirst_usec);
+    sessionlog_put64(pucBlock+28, gllSessionlogBlockLast_usec);
+    memcpy(pucBlock+4+SESSIONLOG_BLOCK_HEADER_BYTES, gucSessionlogBlock, gulSessionlogBlockBytes);
+    g_thread_pool_push(gSessionlogWritePool, pucBlock, NULL);
+
+    lsIndex.llFirst_usec = gllSessionlogBlockFirst_usec;
+    lsIndex.lullOffset   = gullSessionlogOffset;
+    g_array_append_val(gSessionlogIndex, lsIndex);
+    gullSessionlogOffset += lulSize;
+
+    gulSessionlogBlockBytes   = 0;
+    gulSessionlogBlockRecords = 0;
+}
+// end sessionlog_flush
+
+
+////////////////////////////////////////////////////////////////////////////
+// Name:         sessionlog_open
+// Description:  Create (or truncate) a session log and write its header
+// Parameters:   paucName - file name
+// Return:       TRUE if the session log is open
+////////////////////////////////////////////////////////////////////////////
+gboolean
+sessionlog_open(char *paucName)
+{
+    guint8 lucHeader[SESSIONLOG_FILE_HEADER_BYTES];
+
+    if (gfSessionlogEnabled) sessionlog_close();
+
+    giSessionlogFd = open(paucName, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (giSessionlogFd < 0) return FALSE;
+
+    memset(lucHeader, 0, sizeof(lucHeader));
+    memcpy(lucHeader, SESSIONLOG_MAGIC_FILE, sizeof(SESSIONLOG_MAGIC_FILE));
+    sessionlog_put32(lucHeader+8,  SESSIONLOG_VERSION);
+    sessionlog_put32(lucHeader+12, SESSIONLOG_BLOCK_BYTES);
+    sessionlog_write_all(lucHeader, sizeof(lucHeader));
+
+    gullSessionlogOffset      = sizeof(lucHeader);
+    gulSessionlogBlockBytes   = 0;
+    gulSessionlogBlockRecords = 0;
+    gucSessionlogPortCount    = 0;
+    // A day of 5-second blocks before the index has to grow
+    gSessionlogIndex     = g_array_sized_new(FALSE, FALSE, sizeof(SessionlogIndex), 24*60*60/SESSIONLOG_FLUSH_SEC);
+    gSessionlogWritePool = g_thread_pool_new(sessionlog_block_write, NULL, 1, FALSE, NULL);
+    gfSessionlogEnabled  = TRUE;
+
+    return TRUE;
+}
+// end sessionlog_open
+
+
+////////////////////////////////////////////////////////////////////////////
+// Name:         sessionlog_close
+// Description:  Write the last block and the trailer (time index and port
+//               names), then close the session log
+// Parameters:   None
+// Return:       None
+////////////////////////////////////////////////////////////////////////////
+void
+sessionlog_close(void)
+{
+    GByteArray *lgTrailer;
+    guint8 lucBuf[16];
+    guint32 i;
+
+    if (!gfSessionlogEnabled) return;
+
+    sessionlog_flush();
+    g_thread_pool_free(gSessionlogWritePool, FALSE, TRUE);
+    gSessionlogWritePool = NULL;
+
+    lgTrailer = g_byte_array_new();
+    sessionlog_put32(lucBuf,   SESSIONLOG_MAGIC_INDEX);
+    sessionlog_put32(lucBuf+4, gSessionlogIndex->len);
+    g_byte_array_append(lgTrailer, lucBuf, 8);
+    for (i = 0; i < gSessionlogIndex->len; ++i)
+    {
+        SessionlogIndex *lpsIndex = &g_array_index(gSessionlogIndex, SessionlogIndex, i);
+        sessionlog_put64(lucBuf,   lpsIndex->llFirst_usec);
+        sessionlog_put64(lucBuf+8, lpsIndex->lullOffset);
+        g_byte_array_append(lgTrailer, lucBuf, 16);
+    }
+    sessionlog_put32(lucBuf, gucSessionlogPortCount);
+    g_byte_array_append(lgTrailer, lucBuf, 4);
+    for (i = 0; i < gucSessionlogPortCount; ++i)
+    {
+        sessionlog_put16(lucBuf, strlen(gucSessionlogPort[i]));
+        g_byte_array_append(lgTrailer, lucBuf, 2);
+        g_byte_array_append(lgTrailer, (guint8 *)gucSessionlogPort[i], strlen(gucSessionlogPort[i]));
+    }
+    sessionlog_put64(lucBuf,   gullSessionlogOffset);
+    sessionlog_put32(lucBuf+8, SESSIONLOG_MAGIC_END);
+    g_byte_array_append(lgTrailer, lucBuf, 12);
+    sessionlog_write_all(lgTrailer->data, lgTrailer->len);
+    g_byte_array_free(lgTrailer, TRUE);
+
+    close(giSessionlogFd);
+    giSessionlogFd = -1;
+    g_array_free(gSessionlogIndex, TRUE);
+    gSessionlogIndex = NULL;
+    gfSessionlogEnabled = FALSE;
+}
+// end sessionlog_close
+
+
+////////////////////////////////////////////////////////////////////////////
+// Name:         sessionlog_is_enabled
+// Description:  Is the session log open?
+// Parameters:   None
+// Return:       TRUE if received messages are being recorded
+////////////////////////////////////////////////////////////////////////////
+gboolean
+sessionlog_is_enabled(void)
+{
+    return gfSessionlogEnabled;
+}
+// end sessionlog_is_enabled
+
+
+////////////////////////////////////////////////////////////////////////////
+// Name:         sessionlog_port
+// Description:  Index of a source port, adding it to the port table
+//               (saved in the trailer) if it is new
+// Parameters:   paucPortName - port, e.g. "/dev/ttyUSB0"
+// Return:       Port index for sessionlog_write()
+////////////////////////////////////////////////////////////////////////////
+guint8
+sessionlog_port(char *paucPortName)
+{
+    guint8 i;
+
+    for (i = 0; i < gucSessionlogPortCount; ++i)
+    {
+        if (0 == strcmp(gucSessionlogPort[i], paucPortName)) return i;
+    }
+    if (gucSessionlogPortCount == SESSIONLOG_PORT_MAX) return SESSIONLOG_PORT_MAX-1;
+
+    g_strlcpy(gucSessionlogPort[gucSessionlogPortCount], paucPortName, SESSIONLOG_PORT_NAME_MAX);
+    return gucSessionlogPortCount++;
+}
+// end sessionlog_port
+
+
+////////////////////////////////////////////////////////////////////////////
+// Name:         sessionlog_write
+// Description:  Add a received line to the session log
+//               Does nothing if the session log isn't open
+// Parameters:   llTimestamp_usec - host time the line was received
+//               lucPort          - source port, see sessionlog_port()
+//               paucLine         - received NULL-terminated line
+//               lulFieldMask     - fields found by parse_msg()
+// Return:       None
+////////////////////////////////////////////////////////////////////////////
+void
+sessionlog_write(gint64 llTimestamp_usec, guint8 lucPort, char *paucLine, guint32 lulFieldMask)
+{
+    guint32 lulLength;
+    guint8 *pucRecord;
+
+    if (!gfSessionlogEnabled) return;
+
+    lulLength = MIN(strlen(paucLine), RECEIVE_FIFO_MSG_LENGTH_MAX-1);
+    if (gulSessionlogBlockBytes + SESSIONLOG_RECORD_HEADER_BYTES + lulLength > SESSIONLOG_BLOCK_BYTES) sessionlog_flush();
+
+    if (0 == gulSessionlogBlockRecords)
+    {
+        gllSessionlogBlockFirst_usec   = llTimestamp_usec;
+        gllSessionlogBlockStarted_usec = g_get_monotonic_time();
+    }
+    gllSessionlogBlockLast_usec = llTimestamp_usec;
+
+    pucRecord = &gucSessionlogBlock[gulSessionlogBlockBytes];
+    sessionlog_put64(pucRecord,    llTimestamp_usec);
+    sessionlog_put32(pucRecord+8,  lulFieldMask);
+    pucRecord[12] = lucPort;
+    pucRecord[13] = 0;
+    sessionlog_put16(pucRecord+14, lulLength);
+    memcpy(pucRecord+SESSIONLOG_RECORD_HEADER_BYTES, paucLine, lulLength);
+
+    gulSessionlogBlockBytes += SESSIONLOG_RECORD_HEADER_BYTES + lulLength;
+    ++gulSessionlogBlockRecords;
+}
+// end sessionlog_write
+
+
+////////////////////////////////////////////////////////////////////////////
+// Name:         sessionlog_tick
+// Description:  Call periodically - writes out a partly filled block once
+//               it is SESSIONLOG_FLUSH_SEC old, so a quiet device doesn't
+//               leave recent lines sitting in memory
+// Parameters:   None
+// Return:       None
+////////////////////////////////////////////////////////////////////////////
+void
+sessionlog_tick(void)
+{
+    if (gfSessionlogEnabled && gulSessionlogBlockRecords &&
+        g_get_monotonic_time() - gllSessionlogBlockStarted_usec >= (gint64)SESSIONLOG_FLUSH_SEC*G_USEC_PER_SEC)
+    {
+        sessionlog_flush();
+    }
+}
+// end sessionlog_tick
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Reader
+//
+///////////////////////////////////////////////////////////////////////////////
+
+////////////////////////////////////////////////////////////////////////////
+// Name:         sessionlog_reader_load_trailer
+// Description:  Load the time index and port names from the trailer
+// Parameters:   pasReader - reader
+//               lsizeSize - file size
+// Return:       TRUE if the file has a valid trailer
+////////////////////////////////////////////////////////////////////////////
+static gboolean
+sessionlog_reader_load_trailer(SessionlogReader *pasReader, gsize lsizeSize)
+{
+    const guint8 *pucData = pasReader->pucData;
+    const guint8 *pucEnd  = pucData + lsizeSize;
+    const guint8 *pucTrailer;
+    SessionlogIndex lsIndex;
+    guint64 lullOffset;
+    guint32 lulCount, i;
+    guint16 luiLength;
+
+    if (lsizeSize < SESSIONLOG_FILE_HEADER_BYTES + 20) return FALSE;
+    if (SESSIONLOG_MAGIC_END != sessionlog_get32(pucEnd-4)) return FALSE;
+    lullOffset = sessionlog_get64(pucEnd-12);
+    if (lullOffset < SESSIONLOG_FILE_HEADER_BYTES || lullOffset + 8 > lsizeSize - 12) return FALSE;
+
+    pucTrailer = pucData + lullOffset;
+    if (SESSIONLOG_MAGIC_INDEX != sessionlog_get32(pucTrailer)) return FALSE;
+    lulCount = sessionlog_get32(pucTrailer+4);
+    pucTrailer += 8;
+    if ((guint64)lulCount*16 + 4 > (guint64)(pucEnd - 12 - pucTrailer)) return FALSE;
+    for (i = 0; i < lulCount; ++i, pucTrailer += 16)
+    {
+        lsIndex.llFirst_usec = sessionlog_get64(pucTrailer);
+        lsIndex.lullOffset   = sessionlog_get64(pucTrailer+8);
+        g_array_append_val(pasReader->gIndex, lsIndex);
+    }
+
+    lulCount = sessionlog_get32(pucTrailer);
+    pucTrailer += 4;
+    for (i = 0; i < lulCount && pucTrailer + 2 <= pucEnd - 12; ++i)
+    {
+        luiLength = sessionlog_get16(pucTrailer);
+        pucTrailer += 2;
+        if (pucTrailer + luiLength > pucEnd - 12) break;
+        if (i < SESSIONLOG_PORT_MAX)
+        {
+            memcpy(pasReader->ucPort[i], pucTrailer, MIN(luiLength, SESSIONLOG_PORT_NAME_MAX-1));
+            pasReader->lucPortCount = i+1;
+        }
+        pucTrailer += luiLength;
+    }
+
+    pasReader->lsizeEnd = lullOffset;
+    return TRUE;
+}
+// end sessionlog_reader_load_trailer
+
+
+////////////////////////////////////////////////////////////////////////////
+// Name:         sessionlog_reader_scan
+// Description:  Rebuild the time index from the block headers, for a
+//               session log that was never closed (no trailer)
+//               Stops at the first incomplete block
+// Parameters:   pasReader - reader
+//               lsizeSize - file size
+// Return:       None
+////////////////////////////////////////////////////////////////////////////
+static void
+sessionlog_reader_scan(SessionlogReader *pasReader, gsize lsizeSize)
+{
+    const guint8 *pucBlock;
+    SessionlogIndex lsIndex;
+    gsize lsizeOffset = SESSIONLOG_FILE_HEADER_BYTES;
+    guint32 lulPayload;
+
+    g_array_set_size(pasReader->gIndex, 0);
+    while (lsizeOffset + SESSIONLOG_BLOCK_HEADER_BYTES <= lsizeSize)
+    {
+        pucBlock = pasReader->pucData + lsizeOffset;
+        lulPayload = sessionlog_get32(pucBlock+4);
+        if (SESSIONLOG_MAGIC_BLOCK != sessionlog_get32(pucBlock)) break;
+        if (lsizeOffset + SESSIONLOG_BLOCK_HEADER_BYTES + lulPayload > lsizeSize) break;
+
+        lsIndex.llFirst_usec = sessionlog_get64(pucBlock+16);
+        lsIndex.lullOffset   = lsizeOffset;
+        g_array_append_val(pasReader->gIndex, lsIndex);
+        lsizeOffset += SESSIONLOG_BLOCK_HEADER_BYTES + lulPayload;
+    }
+    pasReader->lsizeEnd = lsizeOffset;
+}
+// end sessionlog_reader_scan
+
+
+////////////////////////////////////////////////////////////////////////////
+// Name:         sessionlog_reader_open
+// Description:  Map a session log for reading and load its time index
+// Parameters:   paucName - file name
+//               error    - return location for an error, or NULL
+// Return:       Reader, positioned at the first record; NULL on error
+////////////////////////////////////////////////////////////////////////////
+SessionlogReader *
+sessionlog_reader_open(char *paucName, GError **error)
+{
+    SessionlogReader *lpsReader;
+    GMappedFile *lgMapped;
+    gsize lsizeSize;
+
+    lgMapped = g_mapped_file_new(paucName, FALSE, error);
+    if (!lgMapped) return NULL;
+
+    lsizeSize = g_mapped_file_get_length(lgMapped);
+    if (lsizeSize < SESSIONLOG_FILE_HEADER_BYTES ||
+        0 != memcmp(g_mapped_file_get_contents(lgMapped), SESSIONLOG_MAGIC_FILE, sizeof(SESSIONLOG_MAGIC_FILE)))
+    {
+        g_set_error(error, G_FILE_ERROR, G_FILE_ERROR_INVAL, "%s is not a WSG30 session log", paucName);
+        g_mapped_file_unref(lgMapped);
+        return NULL;
+    }
+
+    lpsReader = g_new0(SessionlogReader, 1);
+    lpsReader->gMapped = lgMapped;
+    lpsReader->pucData = (const guint8 *)g_mapped_file_get_contents(lgMapped);
+    lpsReader->gIndex  = g_array_new(FALSE, FALSE, sizeof(SessionlogIndex));
+    lpsReader->llSkipUntil_usec = G_MININT64;
+    if (!sessionlog_reader_load_trailer(lpsReader, lsizeSize)) sessionlog_reader_scan(lpsReader, lsizeSize);
+
+    return lpsReader;
+}
+// end sessionlog_reader_open
+
+
+////////////////////////////////////////////////////////////////////////////
+// Name:         sessionlog_reader_close
+// Description:  Unmap a session log and free the reader
+// Parameters:   pasReader - reader
+// Return:       None
+////////////////////////////////////////////////////////////////////////////
+void
+sessionlog_reader_close(SessionlogReader *pasReader)
+{
+    if (!pasReader) return;
+    g_array_free(pasReader->gIndex, TRUE);
+    g_mapped_file_unref(pasReader->gMapped);
+    g_free(pasReader);
+}
+// end sessionlog_reader_close
+
+
+////////////////////////////////////////////////////////////////////////////
+// Name:         sessionlog_reader_seek
+// Description:  Position the reader at the first record at or after a
+//               time: binary search of the time index for the block, then
+//               skip forward within that block
+// Parameters:   pasReader        - reader
+//               llTimestamp_usec - host time, usec since 1970
+// Return:       None
+////////////////////////////////////////////////////////////////////////////
+void
+sessionlog_reader_seek(SessionlogReader *pasReader, gint64 llTimestamp_usec)
+{
+    guint32 lulLow  = 0;
+    guint32 lulHigh = pasReader->gIndex->len;
+    guint32 lulMid;
+
+    // Last block starting at or before the time
+    while (lulHigh - lulLow > 1)
+    {
+        lulMid = lulLow + (lulHigh - lulLow)/2;
+        if (g_array_index(pasReader->gIndex, SessionlogIndex, lulMid).llFirst_usec <= llTimestamp_usec) lulLow = lulMid;
+        else lulHigh = lulMid;
+    }
+
+    pasReader->lulBlock = lulLow;
+    pasReader->pucRecord = pasReader->pucRecordEnd = NULL;
+    pasReader->llSkipUntil_usec = llTimestamp_usec;
+}
+// end sessionlog_reader_seek
+
+
+////////////////////////////////////////////////////////////////////////////
+// Name:         sessionlog_reader_next
+// Description:  Read the next record
+//               Blocks with a bad checksum are skipped and counted
+// Parameters:   pasReader - reader
+//               pasRecord - where to put the record
+// Return:       TRUE if a record was read, FALSE at the end of the log
+////////////////////////////////////////////////////////////////////////////
+gboolean
+sessionlog_reader_next(SessionlogReader *pasReader, SessionlogRecord *pasRecord)
+{
+    const guint8 *pucBlock;
+    guint64 lullOffset;
+    guint32 lulPayload;
+    guint16 luiLength;
+
+    while (TRUE)
+    {
+        // Next block?
+        if (pasReader->pucRecord + SESSIONLOG_RECORD_HEADER_BYTES > pasReader->pucRecordEnd)
+        {
+            if (pasReader->lulBlock >= pasReader->gIndex->len) return FALSE;
+            lullOffset = g_array_index(pasReader->gIndex, SessionlogIndex, pasReader->lulBlock).lullOffset;
+            ++pasReader->lulBlock;
+
+            pucBlock = pasReader->pucData + lullOffset;
+            if (lullOffset + SESSIONLOG_BLOCK_HEADER_BYTES > pasReader->lsizeEnd ||
+                SESSIONLOG_MAGIC_BLOCK != sessionlog_get32(pucBlock) ||
+                lullOffset + SESSIONLOG_BLOCK_HEADER_BYTES + (lulPayload = sessionlog_get32(pucBlock+4)) > pasReader->lsizeEnd ||
+                sessionlog_crc32(pucBlock + SESSIONLOG_BLOCK_HEADER_BYTES, lulPayload) != sessionlog_get32(pucBlock+12))
+            {
+                ++pasReader->lulBadBlocks;
+                pasReader->pucRecord = pasReader->pucRecordEnd = NULL;
+                continue;
+            }
+            pasReader->pucRecord    = pucBlock + SESSIONLOG_BLOCK_HEADER_BYTES;
+            pasReader->pucRecordEnd = pasReader->pucRecord + lulPayload;
+            continue;
+        }
+
+        // Next record in this block
+        luiLength = sessionlog_get16(pasReader->pucRecord+14);
+        if (pasReader->pucRecord + SESSIONLOG_RECORD_HEADER_BYTES + luiLength > pasReader->pucRecordEnd)
+        {
+            ++pasReader->lulBadBlocks;
+            pasReader->pucRecord = pasReader->pucRecordEnd = NULL;
+            continue;
+        }
+        pasRecord->llTimestamp_usec = sessionlog_get64(pasReader->pucRecord);
+        pasRecord->lulFieldMask     = sessionlog_get32(pasReader->pucRecord+8);
+        pasRecord->lucPort          = pasReader->pucRecord[12];
+        luiLength = MIN(luiLength, sizeof(pasRecord->ucLine)-1);
+        memcpy(pasRecord->ucLine, pasReader->pucRecord + SESSIONLOG_RECORD_HEADER_BYTES, luiLength);
+        pasRecord->ucLine[luiLength] = 0;
+        pasReader->pucRecord += SESSIONLOG_RECORD_HEADER_BYTES + sessionlog_get16(pasReader->pucRecord+14);
+
+        if (pasRecord->llTimestamp_usec < pasReader->llSkipUntil_usec) continue;
+        pasReader->llSkipUntil_usec = G_MININT64;
+        return TRUE;
+    }
+}
+// end sessionlog_reader_next
+
+
+////////////////////////////////////////////////////////////////////////////
+// Name:         sessionlog_reader_port_name
+// Description:  Name of a source port
+// Parameters:   pasReader - reader
+//               lucPort   - port index from a record
+// Return:       Port name, or "?" if not known (e.g. no trailer)
+////////////////////////////////////////////////////////////////////////////
+char *
+sessionlog_reader_port_name(SessionlogReader *pasReader, guint8 lucPort)
+{
+    return (lucPort < pasReader->lucPortCount) ? pasReader->ucPort[lucPort] : "?";
+}
+// end sessionlog_reader_port_name
+
+
+////////////////////////////////////////////////////////////////////////////
+// Name:         sessionlog_reader_time_range
+// Description:  Host time of the first and last records
+// Parameters:   pasReader        - reader
+//               pallFirst_usec   - where to put the first record's time
+//               pallLast_usec    - where to put the last record's time
+// Return:       None (both 0 for an empty session log)
+////////////////////////////////////////////////////////////////////////////
+void
+sessionlog_reader_time_range(SessionlogReader *pasReader, gint64 *pallFirst_usec, gint64 *pallLast_usec)
+{
+    guint64 lullOffset;
+
+    *pallFirst_usec = *pallLast_usec = 0;
+    if (0 == pasReader->gIndex->len) return;
+
+    *pallFirst_usec = g_array_index(pasReader->gIndex, SessionlogIndex, 0).llFirst_usec;
+    lullOffset = g_array_index(pasReader->gIndex, SessionlogIndex, pasReader->gIndex->len-1).lullOffset;
+    if (lullOffset + SESSIONLOG_BLOCK_HEADER_BYTES <= pasReader->lsizeEnd)
+    {
+        *pallLast_usec = sessionlog_get64(pasReader->pucData + lullOffset + 24);
+    }
+}
+// end sessionlog_reader_time_range
+
+
+////////////////////////////////////////////////////////////////////////////
+// Name:         sessionlog_reader_bad_blocks
+// Description:  Number of blocks skipped because of a bad checksum or
+//               damaged record
+// Parameters:   pasReader - reader
+// Return:       Bad block count
+////////////////////////////////////////////////////////////////////////////
+guint32
+sessionlog_reader_bad_blocks(SessionlogReader *pasReader)
+{
+    return pasReader->lulBadBlocks;
+}
+// end sessionlog_reader_bad_blocks
+
@@ -0,0 +1,81 @@
+/*
+ * File:   sessionlog.h
+ * Author: Mark Bersalona
+ *
+ * Created on 2024.07.15
+ */
+
+#ifndef SESSIONLOG_H
+#define SESSIONLOG_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Definitions
+//
+///////////////////////////////////////////////////////////////////////////////
+
+// File layout (all integers little-endian)
+//
+//   File header  "WSG30SL\0", u32 version, u32 block size
+//   Blocks       u32 "SBLK", u32 payload bytes, u32 record count,
+//                u32 CRC-32 of payload, u64 first and u64 last timestamp,
+//                then the records:
+//                  u64 host timestamp (usec since 1970), u32 parsed-field
+//                  mask (1 << PARSE_FIELD_xxx), u8 port, u8 0, u16 length,
+//                  raw line (no terminator)
+//   Trailer      u32 "SIDX", u32 block count, per block u64 first
+//                timestamp and u64 file offset (the sparse time index),
+//                u32 port count, per port u16 length and name,
+//                u64 trailer offset, u32 "SEND"
+//
+// The trailer is written when the session log is closed; if it is missing
+// (crash, power loss) the reader rebuilds the index from the block headers.
+#define SESSIONLOG_VERSION        (1)
+#define SESSIONLOG_PORT_MAX       (16)
+#define SESSIONLOG_PORT_NAME_MAX  (64)
+
+// One record, as returned by sessionlog_reader_next()
+typedef struct
+{
+    gint64  llTimestamp_usec;                       // host time, usec since 1970
+    guint32 lulFieldMask;                           // parsed fields in this line
+    guint8  lucPort;                                // source port index
+    char    ucLine[RECEIVE_FIFO_MSG_LENGTH_MAX];    // raw line, NULL-terminated
+} SessionlogRecord;
+
+typedef struct _SessionlogReader SessionlogReader;
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Public routines
+//
+///////////////////////////////////////////////////////////////////////////////
+
+// Writer
+void sessionlog_close(void);
+gboolean sessionlog_is_enabled(void);
+gboolean sessionlog_open(char *paucName);
+guint8 sessionlog_port(char *paucPortName);
+void sessionlog_tick(void);
+void sessionlog_write(gint64 llTimestamp_usec, guint8 lucPort, char *paucLine, guint32 lulFieldMask);
+
+// Reader
+void sessionlog_reader_close(SessionlogReader *pasReader);
+guint32 sessionlog_reader_bad_blocks(SessionlogReader *pasReader);
+gboolean sessionlog_reader_next(SessionlogReader *pasReader, SessionlogRecord *pasRecord);
+SessionlogReader *sessionlog_reader_open(char *paucName, GError **error);
+char *sessionlog_reader_port_name(SessionlogReader *pasReader, guint8 lucPort);
+void sessionlog_reader_seek(SessionlogReader *pasReader, gint64 llTimestamp_usec);
+void sessionlog_reader_time_range(SessionlogReader *pasReader, gint64 *pallFirst_usec, gint64 *pallLast_usec);
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* SESSIONLOG_H */
+
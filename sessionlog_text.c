@@ -0,0 +1,150 @@
+/*
+ * File:   sessionlog_text.c
+ * Author: Mark Bersalona
+ *
+ * Created on 2024.07.15
+ * Convert a WSG30 Temperature Display binary session log back to text
+ *
+ * Prints each record as "<local date/time>  <port>  <line>", optionally
+ * with the parsed fields found in it. --from seeks straight to the block
+ * holding that time using the session log's time index.
+ */
+
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Includes
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include <glib.h>
+#include <stdio.h>
+#include <string.h>
+#include "gconfig.h"
+#include "parse.h"
+#include "sessionlog.h"
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Variables and tables
+//
+///////////////////////////////////////////////////////////////////////////////
+
+// Command line options
+static gchar    *gpcTextFrom   = NULL;
+static gchar    *gpcTextTo     = NULL;
+static gboolean  gfTextFields  = FALSE;
+
+static GOptionEntry gsTextOptions[] =
+{
+    { "from",   'f', 0, G_OPTION_ARG_STRING, &gpcTextFrom,  "Start at local time \"YYYY-MM-DD HH:MM[:SS]\"", "TIME" },
+    { "to",     't', 0, G_OPTION_ARG_STRING, &gpcTextTo,    "Stop at local time \"YYYY-MM-DD HH:MM[:SS]\"", "TIME" },
+    { "fields", 'F', 0, G_OPTION_ARG_NONE,   &gfTextFields, "Also list the parsed fields found in each line", NULL },
+    { NULL }
+};
+
+
+////////////////////////////////////////////////////////////////////////////
+// Name:         sessionlog_text_time
+// Description:  Convert a local time string to usec since 1970
+// Parameters:   paucTime - "YYYY-MM-DD HH:MM[:SS]"
+//               pallTime_usec - where to put the time
+// Return:       TRUE if the time was understood
+////////////////////////////////////////////////////////////////////////////
+static gboolean
+sessionlog_text_time(char *paucTime, gint64 *pallTime_usec)
+{
+    GDateTime *lgDateTime;
+    int liYear, liMonth, liDay, liHour, liMinute;
+    int liSecond = 0;
+
+    if (sscanf(paucTime, "%d-%d-%d %d:%d:%d", &liYear, &liMonth, &liDay, &liHour, &liMinute, &liSecond) < 5) return FALSE;
+    lgDateTime = g_date_time_new_local(liYear, liMonth, liDay, liHour, liMinute, liSecond);
+    if (!lgDateTime) return FALSE;
+
+    *pallTime_usec = g_date_time_to_unix(lgDateTime) * G_USEC_PER_SEC;
+    g_date_time_unref(lgDateTime);
+    return TRUE;
+}
+// end sessionlog_text_time
+
+
+////////////////////////////////////////////////////////////////////////////
+// Name:         main
+// Description:  Main routine for the session log to text converter
+// Parameters:   Standard main arguments, see gsTextOptions
+// Return:       0 on conventional exit; error otherwise
+////////////////////////////////////////////////////////////////////////////
+int main(int argc, char** argv)
+{
+    GError *error = NULL;
+    GOptionContext *lgOptionContext;
+    SessionlogReader *lpsReader;
+    SessionlogRecord lsRecord;
+    GDateTime *lgDateTime;
+    gchar *plcTime;
+    gint64 llFrom_usec = G_MININT64;
+    gint64 llTo_usec   = G_MAXINT64;
+    guint8 lucField;
+    char lcFields[PARSE_FIELD_COUNT*24];
+
+    lgOptionContext = g_option_context_new("SESSIONLOG - print a WSG30 binary session log as text");
+    g_option_context_add_main_entries(lgOptionContext, gsTextOptions, NULL);
+    if (!g_option_context_parse(lgOptionContext, &argc, &argv, &error) || argc != 2)
+    {
+        g_printerr("%s\r\n", error ? error->message : "Expected one session log file name");
+        g_clear_error(&error);
+        return 1;
+    }
+    g_option_context_free(lgOptionContext);
+
+    if ((gpcTextFrom && !sessionlog_text_time(gpcTextFrom, &llFrom_usec)) ||
+        (gpcTextTo   && !sessionlog_text_time(gpcTextTo,   &llTo_usec)))
+    {
+        g_printerr("Times are \"YYYY-MM-DD HH:MM[:SS]\", local time\r\n");
+        return 1;
+    }
+
+    lpsReader = sessionlog_reader_open(argv[1], &error);
+    if (!lpsReader)
+    {
+        g_printerr("%s\r\n", error->message);
+        g_clear_error(&error);
+        return 1;
+    }
+    if (gpcTextFrom) sessionlog_reader_seek(lpsReader, llFrom_usec);
+
+    while (sessionlog_reader_next(lpsReader, &lsRecord))
+    {
+        if (lsRecord.llTimestamp_usec > llTo_usec) break;
+
+        lgDateTime = g_date_time_new_from_unix_local(lsRecord.llTimestamp_usec / G_USEC_PER_SEC);
+        plcTime = g_date_time_format(lgDateTime, "%Y.%m.%d %H:%M:%S");
+        printf("%s.%03u  %s  %s", plcTime, (guint32)(lsRecord.llTimestamp_usec % G_USEC_PER_SEC)/1000,
+               sessionlog_reader_port_name(lpsReader, lsRecord.lucPort), lsRecord.ucLine);
+        g_free(plcTime);
+        g_date_time_unref(lgDateTime);
+
+        if (gfTextFields && lsRecord.lulFieldMask)
+        {
+            lcFields[0] = 0;
+            for (lucField = 0; lucField < PARSE_FIELD_COUNT; ++lucField)
+            {
+                if (!(lsRecord.lulFieldMask & (1UL << lucField))) continue;
+                if (lcFields[0]) g_strlcat(lcFields, ",", sizeof(lcFields));
+                g_strlcat(lcFields, parse_field_name(lucField), sizeof(lcFields));
+            }
+            printf("  [%s]", lcFields);
+        }
+        printf("\r\n");
+    }
+
+    if (sessionlog_reader_bad_blocks(lpsReader))
+    {
+        g_printerr("%u damaged block(s) skipped\r\n", sessionlog_reader_bad_blocks(lpsReader));
+    }
+    sessionlog_reader_close(lpsReader);
+    return (0);
+}
+// end main
+
@@ -0,0 +1,102 @@
+/*
+ * File:   timefmt.c
+ * Author: Mark Bersalona
+ *
+ * Created on 2024.07.15
+ * Sensaphone WSG30 Temperature Display Diagnostic cached local time
+ *
+ * The local time and its text forms are worked out at most once a second,
+ * into static buffers, so the periodic and Status paths can show the time
+ * without allocating (g_date_time_new_now_local() and g_date_time_format()
+ * allocate on every call). Main thread only.
+ */
+
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Includes
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#define _GNU_SOURCE         // localtime_r
+#include <glib.h>
+#include <time.h>
+#include "timefmt.h"
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Variables and tables
+//
+///////////////////////////////////////////////////////////////////////////////
+
+static time_t    gTimefmtSecond = -1;
+static struct tm gsTimefmtLocal;
+static char      gucTimefmtLocal[32];       // "YYYY-MM-DD HH:MM:SS"
+static char      gucTimefmtClock[16];       // "HH:MM:SS"
+
+
+////////////////////////////////////////////////////////////////////////////
+// Name:         timefmt_refresh
+// Description:  Work out the local time again if the second has changed
+// Parameters:   None
+// Return:       None
+////////////////////////////////////////////////////////////////////////////
+static void
+timefmt_refresh(void)
+{
+    time_t lNow = time(NULL);
+
+    if (lNow == gTimefmtSecond) return;
+    gTimefmtSecond = lNow;
+
+    localtime_r(&lNow, &gsTimefmtLocal);
+    strftime(gucTimefmtLocal, sizeof(gucTimefmtLocal), "%Y-%m-%d %H:%M:%S", &gsTimefmtLocal);
+    strftime(gucTimefmtClock, sizeof(gucTimefmtClock), "%H:%M:%S", &gsTimefmtLocal);
+}
+// end timefmt_refresh
+
+
+////////////////////////////////////////////////////////////////////////////
+// Name:         timefmt_clock
+// Description:  Local time of day
+// Parameters:   None
+// Return:       "HH:MM:SS", valid until the next call
+////////////////////////////////////////////////////////////////////////////
+char *
+timefmt_clock(void)
+{
+    timefmt_refresh();
+    return gucTimefmtClock;
+}
+// end timefmt_clock
+
+
+////////////////////////////////////////////////////////////////////////////
+// Name:         timefmt_local
+// Description:  Local date and time
+// Parameters:   None
+// Return:       "YYYY-MM-DD HH:MM:SS", valid until the next call
+////////////////////////////////////////////////////////////////////////////
+char *
+timefmt_local(void)
+{
+    timefmt_refresh();
+    return gucTimefmtLocal;
+}
+// end timefmt_local
+
+
+////////////////////////////////////////////////////////////////////////////
+// Name:         timefmt_tm
+// Description:  Local time broken down, e.g. for strftime()
+// Parameters:   None
+// Return:       Pointer to the cached local time
+////////////////////////////////////////////////////////////////////////////
+struct tm *
+timefmt_tm(void)
+{
+    timefmt_refresh();
+    return &gsTimefmtLocal;
+}
+// end timefmt_tm
+
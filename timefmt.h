@@ -0,0 +1,31 @@
+/*
+ * File:   timefmt.h
+ * Author: Mark Bersalona
+ *
+ * Created on 2024.07.15
+ */
+
+#ifndef TIMEFMT_H
+#define TIMEFMT_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Public routines
+//
+///////////////////////////////////////////////////////////////////////////////
+
+char *timefmt_clock(void);
+char *timefmt_local(void);
+struct tm *timefmt_tm(void);
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* TIMEFMT_H */
+
@@ -0,0 +1,414 @@
+/*
+ * File:   timerwheel.c
+ * Author: Mark Bersalona
+ *
+ * Created on 2024.07.15
+ * Hierarchical timer wheel for the periodic housekeeping
+ *
+ * Instead of testing every second whether each piece of housekeeping is
+ * due (elapsed%300, countdowns, ...), each registers a deadline and costs
+ * nothing until it expires. timerwheel_run() is called from the periodic
+ * callback; it advances one tick at a time to the current monotonic time,
+ * refiling a higher level's slot into the level below each time a level
+ * turns over, and calls the handlers in the level 0 slot.
+ *
+ * Timers may be started and cancelled from any thread (with --pipeline the
+ * parser thread arms the sticky error timers); handlers are always called
+ * from timerwheel_run(), without the wheel's lock held.
+ */
+
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Includes
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include <glib.h>
+#include <stdio.h>
+#include "gconfig.h"
+#include "timerwheel.h"
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Definitions
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#define TIMERWHEEL_SLOT_MASK   (TIMERWHEEL_SLOTS - 1)
+#define TIMERWHEEL_TICK_USEC   ((gint64)TIMERWHEEL_TICK_MSEC * 1000)
+
+// Lateness histogram, one bucket per power of 2 microseconds
+#define TIMERWHEEL_LATENESS_BUCKETS (32)
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Variables and tables
+//
+///////////////////////////////////////////////////////////////////////////////
+
+// Slot list heads (circular, so a timer unlinks itself without knowing
+// which slot it's in)
+static TimerwheelTimer gsTimerwheelSlot[TIMERWHEEL_LEVELS][TIMERWHEEL_SLOTS];
+static gboolean gfTimerwheelInitialized = FALSE;
+static GMutex   gTimerwheelMutex;       // slots, links and gllTimerwheelNext_tick
+
+// Next tick to process
+static gint64 gllTimerwheelNext_tick;
+
+// Jitter: how late handlers were called after their deadlines, and the
+// longest time between timerwheel_run() calls (periodic callback stalls)
+static guint32 gulTimerwheelExpired;
+static guint32 gulTimerwheelLateness[TIMERWHEEL_LATENESS_BUCKETS];
+static gint64  gllTimerwheelLatenessMax_usec;
+static gint64  gllTimerwheelLastRun_usec;
+static gint64  gllTimerwheelGapMax_usec;
+
+
+////////////////////////////////////////////////////////////////////////////
+// Name:         timerwheel_initialize
+// Description:  Empty the slots and start the wheels at the current time
+// Parameters:   None
+// Return:       None
+////////////////////////////////////////////////////////////////////////////
+static void
+timerwheel_initialize(void)
+{
+    guint8 lucLevel;
+    guint8 lucSlot;
+
+    for (lucLevel = 0; lucLevel < TIMERWHEEL_LEVELS; ++lucLevel)
+    {
+        for (lucSlot = 0; lucSlot < TIMERWHEEL_SLOTS; ++lucSlot)
+        {
+            gsTimerwheelSlot[lucLevel][lucSlot].psNext = &gsTimerwheelSlot[lucLevel][lucSlot];
+            gsTimerwheelSlot[lucLevel][lucSlot].psPrev = &gsTimerwheelSlot[lucLevel][lucSlot];
+        }
+    }
+    gllTimerwheelNext_tick = g_get_monotonic_time() / TIMERWHEEL_TICK_USEC;
+    gfTimerwheelInitialized = TRUE;
+}
+// end timerwheel_initialize
+
+
+////////////////////////////////////////////////////////////////////////////
+// Name:         timerwheel_link
+// Description:  Add a timer to the end of a list
+// Parameters:   pasHead  - list head
+//               pasTimer - timer
+// Return:       None
+////////////////////////////////////////////////////////////////////////////
+static void
+timerwheel_link(TimerwheelTimer *pasHead, TimerwheelTimer *pasTimer)
+{
+    pasTimer->psNext = pasHead;
+    pasTimer->psPrev = pasHead->psPrev;
+    pasHead->psPrev->psNext = pasTimer;
+    pasHead->psPrev = pasTimer;
+}
+// end timerwheel_link
+
+
+////////////////////////////////////////////////////////////////////////////
+// Name:         timerwheel_take
+// Description:  Move all of a list onto an empty one
+// Parameters:   pasHead - list head, left empty
+//               pasTo   - empty list head
+// Return:       None
+////////////////////////////////////////////////////////////////////////////
+static void
+timerwheel_take(TimerwheelTimer *pasHead, TimerwheelTimer *pasTo)
+{
+    pasTo->psNext = pasTo->psPrev = pasTo;
+    if (pasHead->psNext == pasHead) return;
+
+    pasTo->psNext = pasHead->psNext;
+    pasTo->psPrev = pasHead->psPrev;
+    pasTo->psNext->psPrev = pasTo;
+    pasTo->psPrev->psNext = pasTo;
+    pasHead->psNext = pasHead->psPrev = pasHead;
+}
+// end timerwheel_take
+
+
+////////////////////////////////////////////////////////////////////////////
+// Name:         timerwheel_file
+// Description:  Put a timer in the slot for its deadline
+//               Deadlines already past go in the next tick's slot
+// Parameters:   pasTimer - timer, not linked
+// Return:       None
+////////////////////////////////////////////////////////////////////////////
+static void
+timerwheel_file(TimerwheelTimer *pasTimer)
+{
+    gint64 llDue_tick = pasTimer->llDue_tick;
+    gint64 llDelta_tick;
+    guint8 lucLevel;
+
+    if (llDue_tick < gllTimerwheelNext_tick) llDue_tick = gllTimerwheelNext_tick;
+    llDelta_tick = llDue_tick - gllTimerwheelNext_tick;
+
+    for (lucLevel = 0; lucLevel < TIMERWHEEL_LEVELS - 1; ++lucLevel)
+    {
+        if (llDelta_tick < ((gint64)1 << (TIMERWHEEL_SLOT_BITS * (lucLevel + 1)))) break;
+    }
+    // Beyond the last level: wait in its farthest slot, refiled each turn
+    if (llDelta_tick >= ((gint64)1 << (TIMERWHEEL_SLOT_BITS * TIMERWHEEL_LEVELS)))
+    {
+        llDue_tick = gllTimerwheelNext_tick + ((gint64)1 << (TIMERWHEEL_SLOT_BITS * TIMERWHEEL_LEVELS)) - 1;
+    }
+    timerwheel_link(&gsTimerwheelSlot[lucLevel][(llDue_tick >> (TIMERWHEEL_SLOT_BITS * lucLevel)) & TIMERWHEEL_SLOT_MASK],
+                    pasTimer);
+}
+// end timerwheel_file
+
+
+////////////////////////////////////////////////////////////////////////////
+// Name:         timerwheel_unlink
+// Description:  Take a timer out of its slot
+// Parameters:   pasTimer - linked timer
+// Return:       None
+////////////////////////////////////////////////////////////////////////////
+static void
+timerwheel_unlink(TimerwheelTimer *pasTimer)
+{
+    pasTimer->psPrev->psNext = pasTimer->psNext;
+    pasTimer->psNext->psPrev = pasTimer->psPrev;
+    pasTimer->psNext = pasTimer->psPrev = NULL;
+}
+// end timerwheel_unlink
+
+
+////////////////////////////////////////////////////////////////////////////
+// Name:         timerwheel_set_due
+// Description:  Set a timer's deadline, rounding up to a whole tick
+// Parameters:   pasTimer   - timer
+//               llDue_usec - monotonic deadline
+// Return:       None
+////////////////////////////////////////////////////////////////////////////
+static void
+timerwheel_set_due(TimerwheelTimer *pasTimer, gint64 llDue_usec)
+{
+    pasTimer->llDue_usec = llDue_usec;
+    pasTimer->llDue_tick = (llDue_usec + TIMERWHEEL_TICK_USEC - 1) / TIMERWHEEL_TICK_USEC;
+}
+// end timerwheel_set_due
+
+
+////////////////////////////////////////////////////////////////////////////
+// Name:         timerwheel_lateness_record
+// Description:  Add a handler's lateness to the jitter statistics
+// Parameters:   llLate_usec - time from deadline to handler call
+// Return:       None
+////////////////////////////////////////////////////////////////////////////
+static void
+timerwheel_lateness_record(gint64 llLate_usec)
+{
+    guint8 lucBucket = 0;
+
+    if (llLate_usec < 0) llLate_usec = 0;
+    while (lucBucket < TIMERWHEEL_LATENESS_BUCKETS-1 && (1LL << (lucBucket+1)) <= llLate_usec) ++lucBucket;
+    ++gulTimerwheelLateness[lucBucket];
+    if (llLate_usec > gllTimerwheelLatenessMax_usec) gllTimerwheelLatenessMax_usec = llLate_usec;
+    ++gulTimerwheelExpired;
+}
+// end timerwheel_lateness_record
+
+
+////////////////////////////////////////////////////////////////////////////
+// Name:         timerwheel_lateness_percentile
+// Description:  Estimate a lateness percentile from the histogram
+// Parameters:   luiPercent - 0..100
+// Return:       Upper bound of the bucket holding the percentile (or the
+//               maximum, if less), usec
+////////////////////////////////////////////////////////////////////////////
+static guint64
+timerwheel_lateness_percentile(guint16 luiPercent)
+{
+    guint64 lullCount = 0;
+    guint8  lucBucket;
+
+    if (0 == gulTimerwheelExpired) return 0;
+
+    for (lucBucket = 0; lucBucket < TIMERWHEEL_LATENESS_BUCKETS; ++lucBucket)
+    {
+        lullCount += gulTimerwheelLateness[lucBucket];
+        if (lullCount*100 >= (guint64)gulTimerwheelExpired*luiPercent) break;
+    }
+    return MIN(1ULL << (lucBucket+1), (guint64)gllTimerwheelLatenessMax_usec);
+}
+// end timerwheel_lateness_percentile
+
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Public routines
+//
+///////////////////////////////////////////////////////////////////////////////
+
+////////////////////////////////////////////////////////////////////////////
+// Name:         timerwheel_start
+// Description:  Start (or restart) a timer
+//               A periodic timer's next deadline is its last deadline plus
+//               the period, so it doesn't drift with periodic callback lag
+// Parameters:   pasTimer       - caller-owned timer, zeroed before first use
+//               lulDelay_msec  - time to the first expiry
+//               lulPeriod_msec - time between expiries, 0 for one-shot
+//               pafExpired     - handler
+//               pvData         - for the handler (pasTimer->pvData)
+// Return:       None
+////////////////////////////////////////////////////////////////////////////
+void
+timerwheel_start(TimerwheelTimer *pasTimer, guint32 lulDelay_msec, guint32 lulPeriod_msec,
+                 void (*pafExpired)(TimerwheelTimer *pasTimer), gpointer pvData)
+{
+    g_mutex_lock(&gTimerwheelMutex);
+    if (!gfTimerwheelInitialized) timerwheel_initialize();
+    if (pasTimer->psNext) timerwheel_unlink(pasTimer);
+
+    pasTimer->lulPeriod_msec = lulPeriod_msec;
+    pasTimer->pafExpired     = pafExpired;
+    pasTimer->pvData         = pvData;
+    timerwheel_set_due(pasTimer, g_get_monotonic_time() + (gint64)lulDelay_msec * 1000);
+    timerwheel_file(pasTimer);
+    g_mutex_unlock(&gTimerwheelMutex);
+}
+// end timerwheel_start
+
+
+////////////////////////////////////////////////////////////////////////////
+// Name:         timerwheel_cancel
+// Description:  Stop a timer (nothing happens if it isn't running)
+// Parameters:   pasTimer - timer
+// Return:       None
+////////////////////////////////////////////////////////////////////////////
+void
+timerwheel_cancel(TimerwheelTimer *pasTimer)
+{
+    g_mutex_lock(&gTimerwheelMutex);
+    if (pasTimer->psNext) timerwheel_unlink(pasTimer);
+    g_mutex_unlock(&gTimerwheelMutex);
+}
+// end timerwheel_cancel
+
+
+////////////////////////////////////////////////////////////////////////////
+// Name:         timerwheel_is_pending
+// Description:  Whether a timer is running
+// Parameters:   pasTimer - timer
+// Return:       TRUE if it will expire
+////////////////////////////////////////////////////////////////////////////
+gboolean
+timerwheel_is_pending(TimerwheelTimer *pasTimer)
+{
+    gboolean lfIsPending;
+
+    g_mutex_lock(&gTimerwheelMutex);
+    lfIsPending = (NULL != pasTimer->psNext);
+    g_mutex_unlock(&gTimerwheelMutex);
+    return lfIsPending;
+}
+// end timerwheel_is_pending
+
+
+////////////////////////////////////////////////////////////////////////////
+// Name:         timerwheel_run
+// Description:  Call the handlers of all timers due by now
+//               Handlers may start or cancel any timer, including their own
+//               After a stall, a periodic timer is called once for each
+//               period missed (catch-up), so counts driven by it stay right
+// Parameters:   None
+// Return:       Number of handlers called
+////////////////////////////////////////////////////////////////////////////
+guint32
+timerwheel_run(void)
+{
+    TimerwheelTimer lsDue;
+    TimerwheelTimer *plsTimer;
+    void (*lpfExpired)(TimerwheelTimer *pasTimer);
+    gint64 llNow_usec;
+    gint64 llNow_tick;
+    gint64 llTick;
+    guint8 lucLevel;
+    guint8 lucSlot;
+    guint32 lulExpired = 0;
+
+    g_mutex_lock(&gTimerwheelMutex);
+    if (!gfTimerwheelInitialized) timerwheel_initialize();
+    llNow_usec = g_get_monotonic_time();
+    llNow_tick = llNow_usec / TIMERWHEEL_TICK_USEC;
+    if (gllTimerwheelLastRun_usec && llNow_usec - gllTimerwheelLastRun_usec > gllTimerwheelGapMax_usec)
+    {
+        gllTimerwheelGapMax_usec = llNow_usec - gllTimerwheelLastRun_usec;
+    }
+    gllTimerwheelLastRun_usec = llNow_usec;
+
+    while (gllTimerwheelNext_tick <= llNow_tick)
+    {
+        llTick = gllTimerwheelNext_tick;
+
+        // Level 0 turned over: refile the next slot of level 1 into level 0,
+        // and so on up while each level turns over too
+        for (lucLevel = 1; lucLevel < TIMERWHEEL_LEVELS; ++lucLevel)
+        {
+            if (llTick & (((gint64)1 << (TIMERWHEEL_SLOT_BITS * lucLevel)) - 1)) break;
+
+            lucSlot = (llTick >> (TIMERWHEEL_SLOT_BITS * lucLevel)) & TIMERWHEEL_SLOT_MASK;
+            timerwheel_take(&gsTimerwheelSlot[lucLevel][lucSlot], &lsDue);
+            while (lsDue.psNext != &lsDue)
+            {
+                plsTimer = lsDue.psNext;
+                timerwheel_unlink(plsTimer);
+                timerwheel_file(plsTimer);
+            }
+        }
+
+        // Anything started from a handler now goes in a later tick
+        ++gllTimerwheelNext_tick;
+
+        timerwheel_take(&gsTimerwheelSlot[0][llTick & TIMERWHEEL_SLOT_MASK], &lsDue);
+        while (lsDue.psNext != &lsDue)
+        {
+            plsTimer = lsDue.psNext;
+            timerwheel_unlink(plsTimer);
+            timerwheel_lateness_record(llNow_usec - plsTimer->llDue_usec);
+            if (plsTimer->lulPeriod_msec)
+            {
+                timerwheel_set_due(plsTimer, plsTimer->llDue_usec + (gint64)plsTimer->lulPeriod_msec * 1000);
+                timerwheel_file(plsTimer);
+            }
+            lpfExpired = plsTimer->pafExpired;
+            g_mutex_unlock(&gTimerwheelMutex);
+            lpfExpired(plsTimer);
+            g_mutex_lock(&gTimerwheelMutex);
+            ++lulExpired;
+        }
+    }
+    g_mutex_unlock(&gTimerwheelMutex);
+    return lulExpired;
+}
+// end timerwheel_run
+
+
+
+////////////////////////////////////////////////////////////////////////////
+// Name:         timerwheel_report
+// Description:  Format the timer jitter statistics for Status: handlers
+//               called, lateness percentiles after their deadlines (a
+//               tick's worth is expected) and the longest periodic gap
+// Parameters:   paucReport - buffer for the report, CRLF terminated
+//               lulSize    - size of buffer
+// Return:       None
+////////////////////////////////////////////////////////////////////////////
+void
+timerwheel_report(char *paucReport, guint32 lulSize)
+{
+    snprintf(paucReport, lulSize,
+             "Timers: %u expired, lateness p50 <%lums p99 <%lums max %lums, longest periodic gap %lums\r\n",
+             gulTimerwheelExpired,
+             (unsigned long)(timerwheel_lateness_percentile(50) + 999) / 1000,
+             (unsigned long)(timerwheel_lateness_percentile(99) + 999) / 1000,
+             (unsigned long)(gllTimerwheelLatenessMax_usec + 999) / 1000,
+             (unsigned long)(gllTimerwheelGapMax_usec + 999) / 1000);
+}
+// end timerwheel_report
@@ -0,0 +1,64 @@
+/*
+ * File:   timerwheel.h
+ * Author: Mark Bersalona
+ *
+ * Created on 2024.07.15
+ */
+
+#ifndef TIMERWHEEL_H
+#define TIMERWHEEL_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Definitions
+//
+///////////////////////////////////////////////////////////////////////////////
+
+// Hierarchical timer wheel on the monotonic clock
+//
+// TIMERWHEEL_LEVELS wheels of TIMERWHEEL_SLOTS slots; a slot of level N
+// spans TIMERWHEEL_SLOTS^N ticks of TIMERWHEEL_TICK_MSEC, so the wheels
+// reach 64^4 ticks (48 days at 250 msec). Later deadlines wait in the last
+// level and are re-filed as it turns. Timers are caller-owned and linked
+// into the slots, so adding and cancelling are O(1) and never allocate.
+#define TIMERWHEEL_SLOT_BITS   (6)
+#define TIMERWHEEL_SLOTS       (1 << TIMERWHEEL_SLOT_BITS)
+#define TIMERWHEEL_LEVELS      (4)
+
+typedef struct _TimerwheelTimer TimerwheelTimer;
+
+struct _TimerwheelTimer
+{
+    TimerwheelTimer *psNext;                // slot list links
+    TimerwheelTimer *psPrev;
+    gint64  llDue_usec;                     // monotonic deadline
+    gint64  llDue_tick;
+    guint32 lulPeriod_msec;                 // 0 = one-shot
+    void (*pafExpired)(TimerwheelTimer *pasTimer);
+    gpointer pvData;                        // for the handler
+};
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Public routines
+//
+///////////////////////////////////////////////////////////////////////////////
+
+void timerwheel_cancel(TimerwheelTimer *pasTimer);
+gboolean timerwheel_is_pending(TimerwheelTimer *pasTimer);
+void timerwheel_report(char *paucReport, guint32 lulSize);
+guint32 timerwheel_run(void);
+void timerwheel_start(TimerwheelTimer *pasTimer, guint32 lulDelay_msec, guint32 lulPeriod_msec,
+                      void (*pafExpired)(TimerwheelTimer *pasTimer), gpointer pvData);
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* TIMERWHEEL_H */
+
@@ -0,0 +1,287 @@
+/*
+ * File:   trace.c
+ * Author: Mark Bersalona
+ *
+ * Created on 2024.07.15
+ * Per-line pipeline tracing
+ *
+ * When enabled (--trace), each stage a received line goes through (serial
+ * read, FIFO wait, logfile queueing, display, parse, session log/export)
+ * and each periodic tick records a span in a preallocated ring of the
+ * latest TRACE_RING_EVENTS spans. trace_dump() writes the ring as Chrome
+ * trace-event JSON, which opens in Perfetto (ui.perfetto.dev) or
+ * chrome://tracing: one track for the main loop, one for the logfile
+ * writer thread (and, with --pipeline, the reader and parser threads),
+ * each line's spans tagged with its line number.
+ */
+
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Includes
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#define _GNU_SOURCE
+#include <glib.h>
+#include <stdio.h>
+#include <unistd.h>
+#include "gconfig.h"
+#include "metrics.h"
+#include "trace.h"
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Definitions
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#define TRACE_RING_MASK   (TRACE_RING_EVENTS - 1)
+
+
+typedef struct
+{
+    guint64 ullStart_ns;
+    guint32 ulDuration_ns;      // saturates at 4.29 s
+    guint32 ulLine;             // 0 = not a line's span
+    guint8  ucStage;
+    guint8  ucThread;           // TRACE_THREAD_xxx, the Chrome trace tid
+} TraceEvent;
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Variables and tables
+//
+///////////////////////////////////////////////////////////////////////////////
+
+static gboolean   gfTraceEnabled = FALSE;
+static TraceEvent gsTraceRing[TRACE_RING_EVENTS];
+static guint64    gullTracePosition;            // spans ever recorded
+
+// Thread each span is recorded on; logfile disk writes are always the
+// writer thread's
+static __thread guint8 gucTraceThread = TRACE_THREAD_MAIN;
+static char *pucTraceThreadNames[TRACE_THREAD_COUNT] =
+{
+    "",
+    "main loop",
+    "logfile writer",
+    "pipeline reader",
+    "pipeline parser",
+};
+
+// Line numbers: lines are numbered as they're received, and leave the
+// FIFO in the same order
+static guint32 gulTraceLineIn;
+static guint32 gulTraceLineOut;
+
+static char *pucTraceStageNames[TRACE_STAGE_COUNT] =
+{
+    "serial_read",
+    "fifo_wait",
+    "logfile_write",
+    "display_receive_line",
+    "parse_msg",
+    "sessionlog/export",
+    "periodic",
+    "logfile disk write",
+};
+
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Public routines
+//
+///////////////////////////////////////////////////////////////////////////////
+
+////////////////////////////////////////////////////////////////////////////
+// Name:         trace_enable
+// Description:  Turn tracing on or off
+// Parameters:   lfEnable - TRUE to record spans
+// Return:       None
+////////////////////////////////////////////////////////////////////////////
+void
+trace_enable(gboolean lfEnable)
+{
+    gfTraceEnabled = lfEnable;
+}
+// end trace_enable
+
+
+////////////////////////////////////////////////////////////////////////////
+// Name:         trace_is_enabled
+// Description:  Whether tracing is on
+// Parameters:   None
+// Return:       TRUE if spans are being recorded
+////////////////////////////////////////////////////////////////////////////
+gboolean
+trace_is_enabled(void)
+{
+    return gfTraceEnabled;
+}
+// end trace_is_enabled
+
+
+////////////////////////////////////////////////////////////////////////////
+// Name:         trace_memory
+// Description:  Memory footprint of the span ring
+// Parameters:   palReserved - set to bytes reserved
+//               palUsed     - set to bytes holding spans
+// Return:       None
+////////////////////////////////////////////////////////////////////////////
+void
+trace_memory(guint32 *palReserved, guint32 *palUsed)
+{
+    *palReserved = sizeof(gsTraceRing);
+    *palUsed     = MIN(__atomic_load_n(&gullTracePosition, __ATOMIC_RELAXED), TRACE_RING_EVENTS) * sizeof(TraceEvent);
+}
+// end trace_memory
+
+
+////////////////////////////////////////////////////////////////////////////
+// Name:         trace_start
+// Description:  Start of a span
+// Parameters:   None
+// Return:       Monotonic time, nsec; 0 if tracing is off
+////////////////////////////////////////////////////////////////////////////
+guint64
+trace_start(void)
+{
+    return gfTraceEnabled ? metrics_now_ns() : 0;
+}
+// end trace_start
+
+
+////////////////////////////////////////////////////////////////////////////
+// Name:         trace_end
+// Description:  End of a span: record it in the ring
+//               Any thread; a slot is reserved atomically
+// Parameters:   lucStage     - TRACE_xxx
+//               lullStart_ns - from trace_start(); nothing is recorded if 0
+// Return:       None
+////////////////////////////////////////////////////////////////////////////
+void
+trace_end(guint8 lucStage, guint64 lullStart_ns)
+{
+    TraceEvent *plsEvent;
+    guint64 lullDuration_ns;
+
+    if (0 == lullStart_ns) return;
+
+    lullDuration_ns = metrics_now_ns() - lullStart_ns;
+    plsEvent = &gsTraceRing[__atomic_fetch_add(&gullTracePosition, 1, __ATOMIC_RELAXED) & TRACE_RING_MASK];
+    plsEvent->ullStart_ns   = lullStart_ns;
+    plsEvent->ulDuration_ns = (guint32)MIN(lullDuration_ns, G_MAXUINT32);
+    plsEvent->ucStage       = lucStage;
+    plsEvent->ucThread      = (TRACE_LOGFILE_DISK == lucStage) ? TRACE_THREAD_WRITER : gucTraceThread;
+    switch (lucStage)
+    {
+    case TRACE_SERIAL_READ:
+        plsEvent->ulLine = gulTraceLineIn;
+        break;
+    case TRACE_TICK:
+    case TRACE_LOGFILE_DISK:
+        plsEvent->ulLine = 0;
+        break;
+    default:
+        plsEvent->ulLine = gulTraceLineOut;
+        break;
+    }
+}
+// end trace_end
+
+
+////////////////////////////////////////////////////////////////////////////
+// Name:         trace_line_received
+// Description:  A line was received (call before its serial_read span ends)
+// Parameters:   None
+// Return:       None
+////////////////////////////////////////////////////////////////////////////
+void
+trace_line_received(void)
+{
+    ++gulTraceLineIn;
+}
+// end trace_line_received
+
+
+////////////////////////////////////////////////////////////////////////////
+// Name:         trace_line_dequeued
+// Description:  A line left the FIFO; the spans that follow are its own
+// Parameters:   None
+// Return:       None
+////////////////////////////////////////////////////////////////////////////
+void
+trace_line_dequeued(void)
+{
+    ++gulTraceLineOut;
+}
+// end trace_line_dequeued
+
+
+////////////////////////////////////////////////////////////////////////////
+// Name:         trace_set_thread
+// Description:  Name the calling thread's track (--pipeline threads)
+// Parameters:   lucThread - TRACE_THREAD_xxx
+// Return:       None
+////////////////////////////////////////////////////////////////////////////
+void
+trace_set_thread(guint8 lucThread)
+{
+    gucTraceThread = lucThread;
+}
+// end trace_set_thread
+
+
+////////////////////////////////////////////////////////////////////////////
+// Name:         trace_dump
+// Description:  Write the ring, oldest span first, as Chrome trace-event
+//               JSON (timestamps are CLOCK_MONOTONIC)
+// Parameters:   paucName  - file name
+//               palEvents - set to the number of spans written
+// Return:       TRUE if written
+////////////////////////////////////////////////////////////////////////////
+gboolean
+trace_dump(char *paucName, guint32 *palEvents)
+{
+    FILE *plsFile;
+    TraceEvent *plsEvent;
+    guint64 lullEnd = __atomic_load_n(&gullTracePosition, __ATOMIC_ACQUIRE);
+    guint64 lullPosition = (lullEnd > TRACE_RING_EVENTS) ? lullEnd - TRACE_RING_EVENTS : 0;
+    guint32 lulPid = (guint32)getpid();
+    guint8 lucThread;
+    gboolean lfIsWritten;
+
+    *palEvents = 0;
+    plsFile = fopen(paucName, "w");
+    if (!plsFile) return FALSE;
+
+    fprintf(plsFile, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n"
+            "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":%u,\"args\":{\"name\":\"WSG30TempDisplay\"}}",
+            lulPid);
+    for (lucThread = TRACE_THREAD_MAIN; lucThread < TRACE_THREAD_COUNT; ++lucThread)
+    {
+        fprintf(plsFile, ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%u,\"tid\":%u,\"args\":{\"name\":\"%s\"}}",
+                lulPid, lucThread, pucTraceThreadNames[lucThread]);
+    }
+    for ( ; lullPosition < lullEnd; ++lullPosition)
+    {
+        plsEvent = &gsTraceRing[lullPosition & TRACE_RING_MASK];
+        if (plsEvent->ucStage >= TRACE_STAGE_COUNT) continue;
+
+        fprintf(plsFile, ",\n{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"X\",\"ts\":%lu.%03u,\"dur\":%u.%03u,\"pid\":%u,\"tid\":%u",
+                pucTraceStageNames[plsEvent->ucStage],
+                plsEvent->ulLine ? "line" : "loop",
+                (unsigned long)(plsEvent->ullStart_ns / 1000), (guint32)(plsEvent->ullStart_ns % 1000),
+                plsEvent->ulDuration_ns / 1000, plsEvent->ulDuration_ns % 1000,
+                lulPid, plsEvent->ucThread);
+        if (plsEvent->ulLine) fprintf(plsFile, ",\"args\":{\"line\":%u}", plsEvent->ulLine);
+        fputc('}', plsFile);
+        ++*palEvents;
+    }
+    fputs("\n]}\n", plsFile);
+    lfIsWritten = !ferror(plsFile);
+    return (0 == fclose(plsFile)) && lfIsWritten;
+}
+// end trace_dump
+
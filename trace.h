@@ -0,0 +1,66 @@
+/*
+ * File:   trace.h
+ * Author: Mark Bersalona
+ *
+ * Created on 2024.07.15
+ */
+
+#ifndef TRACE_H
+#define TRACE_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Definitions
+//
+///////////////////////////////////////////////////////////////////////////////
+
+// Traced stages, in pipeline order
+#define TRACE_SERIAL_READ     (0)   // first character to line handed to the FIFO
+#define TRACE_FIFO_WAIT       (1)   // line waiting in the receive FIFO
+#define TRACE_LOGFILE_WRITE   (2)   // logfile_write() (queueing for the writer)
+#define TRACE_DISPLAY         (3)   // display_receive_line()
+#define TRACE_PARSE           (4)   // parse_msg()
+#define TRACE_RECORD          (5)   // session log and telemetry export
+#define TRACE_TICK            (6)   // whole periodic callback
+#define TRACE_LOGFILE_DISK    (7)   // writer thread write()/fdatasync()
+#define TRACE_STAGE_COUNT     (8)
+
+// Threads, each a track in the dump
+#define TRACE_THREAD_MAIN     (1)
+#define TRACE_THREAD_WRITER   (2)
+#define TRACE_THREAD_READER   (3)   // --pipeline
+#define TRACE_THREAD_PARSER   (4)   // --pipeline
+#define TRACE_THREAD_COUNT    (5)
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Public routines
+//
+///////////////////////////////////////////////////////////////////////////////
+
+// Recording: trace_start() returns 0 while tracing is off, and
+// trace_end() ignores a 0 start, so a disabled span costs two calls
+// and two tests
+void trace_end(guint8 lucStage, guint64 lullStart_ns);
+void trace_line_dequeued(void);
+void trace_line_received(void);
+void trace_set_thread(guint8 lucThread);
+guint64 trace_start(void);
+
+// Control
+gboolean trace_dump(char *paucName, guint32 *palEvents);
+void trace_enable(gboolean lfEnable);
+gboolean trace_is_enabled(void);
+void trace_memory(guint32 *palReserved, guint32 *palUsed);
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* TRACE_H */
+